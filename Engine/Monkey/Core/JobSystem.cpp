@@ -0,0 +1,500 @@
+﻿#include "JobSystem.h"
+#include "Common/Log.h"
+#include "Math/Math.h"
+
+#include <memory>
+
+static thread_local int32 g_ThreadIndex = -1;
+
+JobSystem::JobQueue*			JobSystem::s_Queue = nullptr;
+std::vector<JobSystem::WorkStealingQueue*>	JobSystem::s_LocalQueues;
+std::vector<std::thread>		JobSystem::s_Threads;
+std::mutex						JobSystem::s_Mutex;
+std::mutex						JobSystem::s_InlineMutex;
+std::condition_variable			JobSystem::s_WakeCond;
+std::atomic<int32>				JobSystem::s_NumQueued(0);
+std::atomic<int32>				JobSystem::s_NumSleeping(0);
+std::mutex						JobSystem::s_WaitMutex;
+std::atomic<int32>				JobSystem::s_NumWaiting(0);
+std::unordered_map<JobCounter*, std::vector<JobSystem::Job*>>	JobSystem::s_WaitingJobs;
+bool							JobSystem::s_Quit = false;
+
+JobSystem::JobQueue::JobQueue(uint32 capacity)
+	: m_EnqueuePos(0)
+	, m_DequeuePos(0)
+{
+	// capacity必须为2的幂
+	m_Cells = new Cell[capacity];
+	m_Mask  = capacity - 1;
+
+	for (uint32 i = 0; i < capacity; ++i) {
+		m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+		m_Cells[i].job = nullptr;
+	}
+}
+
+JobSystem::JobQueue::~JobQueue()
+{
+	delete[] m_Cells;
+	m_Cells = nullptr;
+}
+
+bool JobSystem::JobQueue::Push(Job* job)
+{
+	Cell* cell = nullptr;
+	uint32 pos = m_EnqueuePos.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		cell = &m_Cells[pos & m_Mask];
+		uint32 sequence = cell->sequence.load(std::memory_order_acquire);
+		int32 diff = (int32)sequence - (int32)pos;
+
+		if (diff == 0)
+		{
+			if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		}
+		else if (diff < 0)
+		{
+			// 队列已满
+			return false;
+		}
+		else
+		{
+			pos = m_EnqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->job = job;
+	cell->sequence.store(pos + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool JobSystem::JobQueue::Pop(Job*& job)
+{
+	Cell* cell = nullptr;
+	uint32 pos = m_DequeuePos.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		cell = &m_Cells[pos & m_Mask];
+		uint32 sequence = cell->sequence.load(std::memory_order_acquire);
+		int32 diff = (int32)sequence - (int32)(pos + 1);
+
+		if (diff == 0)
+		{
+			if (m_DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		}
+		else if (diff < 0)
+		{
+			// 队列为空
+			return false;
+		}
+		else
+		{
+			pos = m_DequeuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	job = cell->job;
+	cell->sequence.store(pos + m_Mask + 1, std::memory_order_release);
+
+	return true;
+}
+
+JobSystem::WorkStealingQueue::WorkStealingQueue(uint32 capacity)
+	: m_Top(0)
+	, m_Bottom(0)
+{
+	// capacity必须为2的幂
+	m_Cells = new std::atomic<Job*>[capacity];
+	m_Mask  = capacity - 1;
+
+	for (uint32 i = 0; i < capacity; ++i) {
+		m_Cells[i].store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+JobSystem::WorkStealingQueue::~WorkStealingQueue()
+{
+	delete[] m_Cells;
+	m_Cells = nullptr;
+}
+
+bool JobSystem::WorkStealingQueue::Push(Job* job)
+{
+	int64 bottom = m_Bottom.load(std::memory_order_relaxed);
+	int64 top    = m_Top.load(std::memory_order_acquire);
+
+	// 队列已满
+	if (bottom - top > m_Mask) {
+		return false;
+	}
+
+	m_Cells[bottom & m_Mask].store(job, std::memory_order_relaxed);
+	m_Bottom.store(bottom + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool JobSystem::WorkStealingQueue::Pop(Job*& job)
+{
+	int64 bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+	m_Bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64 top = m_Top.load(std::memory_order_relaxed);
+
+	// 队列为空
+	if (top > bottom)
+	{
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	job = m_Cells[bottom & m_Mask].load(std::memory_order_relaxed);
+	if (top != bottom) {
+		return true;
+	}
+
+	// 只剩最后一个时和Steal竞争
+	bool success = m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+
+	return success;
+}
+
+bool JobSystem::WorkStealingQueue::Steal(Job*& job)
+{
+	int64 top = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64 bottom = m_Bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom) {
+		return false;
+	}
+
+	Job* stolen = m_Cells[top & m_Mask].load(std::memory_order_relaxed);
+	if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return false;
+	}
+
+	job = stolen;
+
+	return true;
+}
+
+bool JobSystem::Init(int32 numThreads)
+{
+	if (s_Queue) {
+		return false;
+	}
+
+	if (numThreads <= 0) {
+		numThreads = std::thread::hardware_concurrency();
+	}
+	numThreads = MMath::Max(numThreads, 1);
+
+	s_Quit  = false;
+	s_Queue = new JobQueue(QUEUE_CAPACITY);
+
+	// 主线程和每个工作线程各一个
+	for (int32 i = 0; i < numThreads; ++i) {
+		s_LocalQueues.push_back(new WorkStealingQueue(QUEUE_CAPACITY));
+	}
+
+	// 调用Init的线程作为主线程，和工作线程一样可以执行Job
+	g_ThreadIndex = 0;
+
+	for (int32 i = 1; i < numThreads; ++i) {
+		s_Threads.push_back(std::thread(&JobSystem::WorkerLoop, i));
+	}
+
+	MLOG("JobSystem : %d threads.", numThreads);
+
+	return true;
+}
+
+void JobSystem::Destroy()
+{
+	if (!s_Queue) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		s_Quit = true;
+	}
+	s_WakeCond.notify_all();
+
+	for (int32 i = 0; i < s_Threads.size(); ++i) {
+		s_Threads[i].join();
+	}
+	s_Threads.clear();
+
+	// 剩余的Job在当前线程执行完，保证counter都能归零
+	while (ExecuteOne()) {
+
+	}
+
+	for (int32 i = 0; i < s_LocalQueues.size(); ++i) {
+		delete s_LocalQueues[i];
+	}
+	s_LocalQueues.clear();
+
+	delete s_Queue;
+	s_Queue = nullptr;
+}
+
+int32 JobSystem::GetThreadIndex()
+{
+	// 未初始化时Job都在调用线程上执行，只有一份线程数据
+	return s_Queue ? g_ThreadIndex : 0;
+}
+
+void JobSystem::Run(const JobFunction& function, JobCounter* counter, JobCounter* dependency)
+{
+	if (counter) {
+		counter->m_Count.fetch_add(1);
+	}
+
+	Job* job = new Job();
+	job->function   = function;
+	job->counter    = counter;
+	job->dependency = dependency;
+
+	if (dependency)
+	{
+		// 先增加s_NumWaiting再检查计数，和Execute中先减计数再检查s_NumWaiting对应，
+		// 保证dependency归零时一定能看到这个Job
+		std::lock_guard<std::mutex> lock(s_WaitMutex);
+		s_NumWaiting.fetch_add(1);
+		if (!dependency->IsComplete())
+		{
+			s_WaitingJobs[dependency].push_back(job);
+			return;
+		}
+		s_NumWaiting.fetch_sub(1);
+	}
+
+	Submit(job);
+}
+
+void JobSystem::ParallelFor(int32 count, int32 grainSize, const RangeFunction& function, JobCounter* counter)
+{
+	if (count <= 0) {
+		return;
+	}
+
+	grainSize = MMath::Max(grainSize, 1);
+	int32 numJobs = (count + grainSize - 1) / grainSize;
+
+	// 没有工作线程或者只有一个Job并且需要等待时直接在当前线程执行
+	if (counter == nullptr && GetThreadIndex() >= 0 && (s_Threads.size() == 0 || numJobs == 1))
+	{
+		for (int32 begin = 0; begin < count; begin += grainSize) {
+			function(begin, MMath::Min(begin + grainSize, count));
+		}
+		return;
+	}
+
+	JobCounter localCounter;
+	JobCounter* jobCounter = counter ? counter : &localCounter;
+
+	// 异步执行时function需要在返回之后依然有效
+	std::shared_ptr<RangeFunction> rangeFunction = std::make_shared<RangeFunction>(function);
+
+	for (int32 i = 0; i < numJobs; ++i)
+	{
+		int32 begin = i * grainSize;
+		int32 end   = MMath::Min(begin + grainSize, count);
+		Run([rangeFunction, begin, end] { (*rangeFunction)(begin, end); }, jobCounter);
+	}
+
+	if (counter == nullptr) {
+		Wait(&localCounter);
+	}
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+	if (counter == nullptr) {
+		return;
+	}
+
+	// 没有线程索引的线程不执行Job，只等待
+	bool canExecute = GetThreadIndex() >= 0;
+
+	while (!counter->IsComplete())
+	{
+		if (!canExecute || !ExecuteOne()) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::Submit(Job* job)
+{
+	if (!s_Queue)
+	{
+		Execute(job);
+		return;
+	}
+
+	// 没有工作线程时放入队列的Job只能由有索引的线程执行，没有索引的线程Wait时会一直等下去
+	if (s_Threads.size() == 0)
+	{
+		ExecuteInline(job);
+		return;
+	}
+
+	// 有索引的线程放入自己的队列，其它线程放入全局队列
+	int32 threadIndex = g_ThreadIndex;
+	bool local  = threadIndex >= 0 && threadIndex < s_LocalQueues.size();
+	bool pushed = local ? s_LocalQueues[threadIndex]->Push(job) : s_Queue->Push(job);
+
+	// 队列已满时直接在当前线程执行，工作线程可能正在等待当前线程，不能等队列空出位置
+	if (!pushed)
+	{
+		ExecuteInline(job);
+		return;
+	}
+
+	s_NumQueued.fetch_add(1);
+
+	if (s_NumSleeping.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		s_WakeCond.notify_one();
+	}
+}
+
+bool JobSystem::ExecuteOne()
+{
+	if (!s_Queue) {
+		return false;
+	}
+
+	// 先取自己队列中最新的Job，其次是全局队列，最后从其它线程的队列窃取
+	Job* job = nullptr;
+	int32 threadIndex = g_ThreadIndex;
+	bool found = threadIndex >= 0 && threadIndex < s_LocalQueues.size() && s_LocalQueues[threadIndex]->Pop(job);
+
+	if (!found) {
+		found = s_Queue->Pop(job) || StealOne(job);
+	}
+
+	if (!found) {
+		return false;
+	}
+	s_NumQueued.fetch_sub(1);
+
+	// 进入队列的Job依赖都已经完成
+	Execute(job);
+
+	return true;
+}
+
+bool JobSystem::StealOne(Job*& job)
+{
+	// 从下一个线程开始轮询，避免所有线程都去窃取同一个队列
+	int32 numQueues = (int32)s_LocalQueues.size();
+	int32 start = MMath::Max(g_ThreadIndex + 1, 0);
+
+	for (int32 i = 0; i < numQueues; ++i)
+	{
+		int32 victim = (start + i) % numQueues;
+		if (victim != g_ThreadIndex && s_LocalQueues[victim]->Steal(job)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	JobCounter* counter = job->counter;
+
+	job->function();
+	delete job;
+
+	// 归零之后counter可能已经被释放，只有存在等待的Job时才会再访问它
+	if (counter && counter->m_Count.fetch_sub(1) == 1 && s_NumWaiting.load() > 0) {
+		ReleaseWaiting(counter);
+	}
+}
+
+void JobSystem::ExecuteInline(Job* job)
+{
+	if (g_ThreadIndex >= 0)
+	{
+		Execute(job);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(s_InlineMutex);
+	g_ThreadIndex = GetNumThreads();
+	Execute(job);
+	g_ThreadIndex = -1;
+}
+
+void JobSystem::ReleaseWaiting(JobCounter* counter)
+{
+	std::vector<Job*> jobs;
+
+	{
+		std::lock_guard<std::mutex> lock(s_WaitMutex);
+
+		// 有Job在等待时counter一定还存活，计数可能已经被重新使用
+		auto it = s_WaitingJobs.find(counter);
+		if (it == s_WaitingJobs.end() || !counter->IsComplete()) {
+			return;
+		}
+
+		jobs.swap(it->second);
+		s_WaitingJobs.erase(it);
+		s_NumWaiting.fetch_sub((int32)jobs.size());
+	}
+
+	for (int32 i = 0; i < jobs.size(); ++i) {
+		Submit(jobs[i]);
+	}
+}
+
+void JobSystem::WorkerLoop(int32 threadIndex)
+{
+	g_ThreadIndex = threadIndex;
+
+	while (true)
+	{
+		if (ExecuteOne()) {
+			continue;
+		}
+
+		// 短暂自旋，避免频繁进入睡眠
+		bool executed = false;
+		for (int32 i = 0; i < 64 && !executed; ++i)
+		{
+			std::this_thread::yield();
+			executed = ExecuteOne();
+		}
+
+		if (executed) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(s_Mutex);
+		s_NumSleeping.fetch_add(1);
+		s_WakeCond.wait(lock, [] { return s_Quit || s_NumQueued.load() > 0; });
+		s_NumSleeping.fetch_sub(1);
+
+		if (s_Quit) {
+			return;
+		}
+	}
+}
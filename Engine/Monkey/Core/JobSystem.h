@@ -0,0 +1,177 @@
+﻿#pragma once
+
+#include "Common/Common.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+// Job完成计数。提交Job时加1，Job执行完毕后减1，为0时表示关联的Job全部完成。
+class JobCounter
+{
+public:
+	JobCounter()
+		: m_Count(0)
+	{
+
+	}
+
+	inline bool IsComplete() const
+	{
+		return m_Count.load() == 0;
+	}
+
+	inline int32 GetValue() const
+	{
+		return m_Count.load();
+	}
+
+private:
+	JobCounter(const JobCounter& other);
+
+	void operator=(const JobCounter& other);
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int32>	m_Count;
+};
+
+// 引擎级的任务系统，所有Demo以及引擎模块共用一组工作线程。
+// 工作线程数量按CPU核心数确定，每个有索引的线程拥有自己的无锁双端队列，
+// 优先执行自己队列尾部的Job，空闲时从其它线程队列的头部窃取。
+// 没有索引的线程提交的Job进入全局队列。等待JobCounter的线程也会执行Job，不会空等。
+class JobSystem
+{
+public:
+	typedef std::function<void()>							JobFunction;
+	typedef std::function<void(int32 begin, int32 end)>		RangeFunction;
+
+	// numThreads为总线程数(包含调用Wait的线程)，<= 0时使用CPU核心数
+	static bool Init(int32 numThreads = 0);
+
+	static void Destroy();
+
+	// counter不为空时计数加1，Job完成后减1。dependency不为空时，等它完成之后才会执行这个Job，
+	// 在此之前Job挂在dependency的等待列表上，不进入队列。dependency需要存活到这个Job开始执行。
+	static void Run(const JobFunction& function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+	// 将[0, count)按grainSize切分为若干Job。counter为空时等待全部完成之后再返回，否则立即返回。
+	static void ParallelFor(int32 count, int32 grainSize, const RangeFunction& function, JobCounter* counter = nullptr);
+
+	// 等待counter归零，等待期间当前线程也会执行队列中的Job
+	static void Wait(JobCounter* counter);
+
+	// 总线程数，包含调用Wait的线程
+	static inline int32 GetNumThreads()
+	{
+		return (int32)s_Threads.size() + 1;
+	}
+
+	// 每个线程独立的数据需要按这个数量分配，比GetNumThreads多出的一个给没有索引的线程使用
+	static inline int32 GetNumThreadSlots()
+	{
+		return GetNumThreads() + 1;
+	}
+
+	// 调用Init的主线程返回0，工作线程返回[1, GetNumThreads())，其它线程返回-1。
+	// 没有工作线程或者队列已满时，没有索引的线程直接执行提交的Job，执行期间返回GetNumThreads()，
+	// 这样的线程同一时间只有一个。其它线程调用Wait时只等待不执行Job，
+	// 所以Job中可以用这个索引访问每个线程独立的数据，不会有两个线程共用同一个索引。
+	static int32 GetThreadIndex();
+
+private:
+	struct Job
+	{
+		JobFunction		function;
+		JobCounter*		counter = nullptr;
+		JobCounter*		dependency = nullptr;
+	};
+
+	// 有界的多生产者多消费者无锁队列，用于没有索引的线程提交Job
+	class JobQueue
+	{
+	public:
+		JobQueue(uint32 capacity);
+
+		~JobQueue();
+
+		bool Push(Job* job);
+
+		bool Pop(Job*& job);
+
+	private:
+		struct Cell
+		{
+			std::atomic<uint32>	sequence;
+			Job*				job;
+		};
+
+		Cell*					m_Cells;
+		uint32					m_Mask;
+		std::atomic<uint32>		m_EnqueuePos;
+		std::atomic<uint32>		m_DequeuePos;
+	};
+
+	// 有界的Chase-Lev双端队列，只有所属线程可以Push和Pop，其它线程通过Steal从另一端取出
+	class WorkStealingQueue
+	{
+	public:
+		WorkStealingQueue(uint32 capacity);
+
+		~WorkStealingQueue();
+
+		bool Push(Job* job);
+
+		bool Pop(Job*& job);
+
+		bool Steal(Job*& job);
+
+	private:
+		std::atomic<Job*>*		m_Cells;
+		int64					m_Mask;
+		std::atomic<int64>		m_Top;
+		std::atomic<int64>		m_Bottom;
+	};
+
+	enum
+	{
+		QUEUE_CAPACITY = 4096,
+	};
+
+	static void Submit(Job* job);
+
+	static bool ExecuteOne();
+
+	static bool StealOne(Job*& job);
+
+	static void Execute(Job* job);
+
+	// 在当前线程执行，没有索引的线程临时使用最后一个索引
+	static void ExecuteInline(Job* job);
+
+	// counter归零时把等待它的Job放入队列
+	static void ReleaseWaiting(JobCounter* counter);
+
+	static void WorkerLoop(int32 threadIndex);
+
+private:
+	static JobQueue*					s_Queue;
+	static std::vector<WorkStealingQueue*>	s_LocalQueues;
+	static std::vector<std::thread>		s_Threads;
+
+	static std::mutex					s_Mutex;
+	static std::mutex					s_InlineMutex;
+	static std::condition_variable		s_WakeCond;
+	static std::atomic<int32>			s_NumQueued;
+	static std::atomic<int32>			s_NumSleeping;
+
+	static std::mutex											s_WaitMutex;
+	static std::unordered_map<JobCounter*, std::vector<Job*>>	s_WaitingJobs;
+	static std::atomic<int32>									s_NumWaiting;
+	static bool							s_Quit;
+};
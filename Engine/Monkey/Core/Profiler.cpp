@@ -0,0 +1,193 @@
+﻿#include "Profiler.h"
+#include "JobSystem.h"
+#include "Common/Log.h"
+#include "Math/Math.h"
+#include "Demo/FileManager.h"
+
+thread_local CPUProfiler::ThreadBuffer*	CPUProfiler::s_ThreadBuffer = nullptr;
+std::mutex								CPUProfiler::s_Mutex;
+std::vector<CPUProfiler::ThreadBuffer*>	CPUProfiler::s_Buffers;
+std::atomic<bool>						CPUProfiler::s_Active(false);
+std::atomic<uint32>						CPUProfiler::s_CaptureID(0);
+CPUProfiler::TraceAppender				CPUProfiler::s_Appender;
+std::string								CPUProfiler::s_Filename;
+int32									CPUProfiler::s_RequestFrames = 0;
+int32									CPUProfiler::s_FramesLeft = 0;
+int32									CPUProfiler::s_FlushFrames = 0;
+double									CPUProfiler::s_CaptureBegin = 0.0;
+double									CPUProfiler::s_CaptureEnd = 0.0;
+double									CPUProfiler::s_LastFrameTime = 0.0;
+
+CPUProfiler::ThreadBuffer* CPUProfiler::GetThreadBuffer()
+{
+	if (s_ThreadBuffer) {
+		return s_ThreadBuffer;
+	}
+
+	// 每个线程只注册一次，缓冲一直保留到Destroy
+	ThreadBuffer* buffer = new ThreadBuffer();
+	buffer->events.resize(EVENTS_PER_THREAD);
+	buffer->count.store(0);
+	buffer->captureID.store(0);
+	buffer->jobThreadIndex = JobSystem::GetThreadIndex();
+	buffer->numDropped = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		buffer->threadID = (int32)s_Buffers.size();
+		s_Buffers.push_back(buffer);
+	}
+
+	s_ThreadBuffer = buffer;
+	return buffer;
+}
+
+void CPUProfiler::WriteEvent(const char* name, double beginTime, double endTime)
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+
+	// 新的一次采集，由所属线程自己清空
+	uint32 captureID = s_CaptureID.load(std::memory_order_acquire);
+	if (buffer->captureID.load(std::memory_order_relaxed) != captureID)
+	{
+		buffer->count.store(0, std::memory_order_relaxed);
+		buffer->numDropped = 0;
+		buffer->captureID.store(captureID, std::memory_order_release);
+	}
+
+	int32 index = buffer->count.load(std::memory_order_relaxed);
+	if (index >= EVENTS_PER_THREAD)
+	{
+		buffer->numDropped += 1;
+		return;
+	}
+
+	Event& event = buffer->events[index];
+	event.name      = name;
+	event.beginTime = beginTime;
+	event.endTime   = endTime;
+
+	buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void CPUProfiler::BeginCapture(int32 numFrames, const std::string& filename)
+{
+	if (IsCapturing())
+	{
+		MLOG("CPU profiler is already capturing.");
+		return;
+	}
+
+	s_Filename      = filename;
+	s_RequestFrames = MMath::Max(numFrames, 1);
+}
+
+void CPUProfiler::EndFrame()
+{
+	double now = GenericPlatformTime::Seconds();
+
+	if (s_Active.load(std::memory_order_relaxed))
+	{
+		WriteEvent("Frame", s_LastFrameTime, now);
+
+		s_FramesLeft -= 1;
+		if (s_FramesLeft <= 0)
+		{
+			s_Active.store(false);
+			s_CaptureEnd  = now;
+			s_FlushFrames = FLUSH_FRAMES;
+		}
+	}
+	else if (s_FlushFrames > 0)
+	{
+		s_FlushFrames -= 1;
+		if (s_FlushFrames == 0) {
+			WriteCapture();
+		}
+	}
+	else if (s_RequestFrames > 0)
+	{
+		s_FramesLeft    = s_RequestFrames;
+		s_RequestFrames = 0;
+		s_CaptureBegin  = now;
+		s_CaptureID.fetch_add(1, std::memory_order_release);
+		s_Active.store(true);
+	}
+
+	s_LastFrameTime = now;
+}
+
+void CPUProfiler::SetTraceAppender(const TraceAppender& appender)
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	s_Appender = appender;
+}
+
+void CPUProfiler::WriteCapture()
+{
+	std::string json = "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"Monkey\"}}";
+	char buffer[256];
+
+	uint32 captureID = s_CaptureID.load(std::memory_order_acquire);
+	int32 numEvents  = 0;
+	int32 numDropped = 0;
+
+	std::lock_guard<std::mutex> lock(s_Mutex);
+
+	for (int32 i = 0; i < s_Buffers.size(); ++i)
+	{
+		ThreadBuffer* threadBuffer = s_Buffers[i];
+		if (threadBuffer->captureID.load(std::memory_order_acquire) != captureID) {
+			continue;
+		}
+
+		if (threadBuffer->jobThreadIndex > 0) {
+			snprintf(buffer, sizeof(buffer), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"Worker %d\"}}", threadBuffer->threadID, threadBuffer->jobThreadIndex);
+		}
+		else {
+			snprintf(buffer, sizeof(buffer), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"Thread %d\"}}", threadBuffer->threadID, threadBuffer->threadID);
+		}
+		json += buffer;
+
+		int32 count = threadBuffer->count.load(std::memory_order_acquire);
+		for (int32 j = 0; j < count; ++j)
+		{
+			const Event& event = threadBuffer->events[j];
+			snprintf(buffer, sizeof(buffer), ",\n{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d}", event.name, event.beginTime * 1000000.0, (event.endTime - event.beginTime) * 1000000.0, threadBuffer->threadID);
+			json += buffer;
+		}
+
+		numEvents  += count;
+		numDropped += threadBuffer->numDropped;
+	}
+
+	if (s_Appender) {
+		s_Appender(json, s_CaptureBegin, s_CaptureEnd);
+	}
+
+	json += "\n]}\n";
+
+	if (!FileManager::WriteCacheFile(s_Filename, (const uint8*)json.data(), (uint32)json.size())) {
+		return;
+	}
+
+	MLOG("Trace %s saved, %d events, %d dropped.", FileManager::GetCachePath(s_Filename).c_str(), numEvents, numDropped);
+}
+
+void CPUProfiler::Destroy()
+{
+	s_Active.store(false);
+	s_RequestFrames = 0;
+	s_FlushFrames   = 0;
+
+	std::lock_guard<std::mutex> lock(s_Mutex);
+
+	// 工作线程已经退出，缓冲可以直接释放。其它线程的s_ThreadBuffer不再使用。
+	for (int32 i = 0; i < s_Buffers.size(); ++i) {
+		delete s_Buffers[i];
+	}
+	s_Buffers.clear();
+	s_Appender = nullptr;
+
+	s_ThreadBuffer = nullptr;
+}
@@ -0,0 +1,136 @@
+﻿#pragma once
+
+#include "Common/Common.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+// MONKEY_DEBUG在所有平台上都是打开的，这里按NDEBUG区分：Release等定义了NDEBUG的配置默认关闭，
+// 需要时可以通过-DMONKEY_PROFILE=1单独打开
+#ifndef MONKEY_PROFILE
+	#if defined(NDEBUG)
+		#define MONKEY_PROFILE 0
+	#else
+		#define MONKEY_PROFILE 1
+	#endif
+#endif
+
+// CPU端的帧时间线采集。
+// 每个线程写自己的事件缓冲，写入不加锁；只有BeginCapture之后的numFrames帧会记录事件，
+// 采集结束后以Chrome trace格式(chrome://tracing)写入缓存目录。
+// 时间统一使用GenericPlatformTime::Seconds，GPU时间线通过TraceAppender合并到同一个文件。
+class CPUProfiler
+{
+public:
+	// 追加[beginTime, endTime]之间的其它事件，每个事件以",\n"开头
+	typedef std::function<void(std::string& json, double beginTime, double endTime)> TraceAppender;
+
+	// 从下一帧开始采集numFrames帧，结果写入缓存目录下的filename
+	static void BeginCapture(int32 numFrames, const std::string& filename);
+
+	// 每帧结束时由引擎调用一次
+	static void EndFrame();
+
+	static void SetTraceAppender(const TraceAppender& appender);
+
+	static void Destroy();
+
+	static void WriteEvent(const char* name, double beginTime, double endTime);
+
+	static FORCEINLINE bool IsActive()
+	{
+		return s_Active.load(std::memory_order_relaxed);
+	}
+
+	static inline bool IsCapturing()
+	{
+		return s_Active.load(std::memory_order_relaxed) || s_RequestFrames > 0 || s_FlushFrames > 0;
+	}
+
+private:
+	struct Event
+	{
+		const char*		name;
+		double			beginTime;
+		double			endTime;
+	};
+
+	// 只有所属线程写入，count使用release写，读取时acquire，读到的事件总是完整的
+	struct ThreadBuffer
+	{
+		std::vector<Event>		events;
+		std::atomic<int32>		count;
+		std::atomic<uint32>		captureID;
+		int32					threadID;
+		int32					jobThreadIndex;
+		int32					numDropped;
+	};
+
+	enum
+	{
+		EVENTS_PER_THREAD = 64 * 1024,
+		FLUSH_FRAMES      = 4,	// 采集结束后等待几帧，让GPU的结果读回来
+	};
+
+	static ThreadBuffer* GetThreadBuffer();
+
+	static void WriteCapture();
+
+private:
+	static thread_local ThreadBuffer*	s_ThreadBuffer;
+
+	static std::mutex					s_Mutex;
+	static std::vector<ThreadBuffer*>	s_Buffers;
+	static std::atomic<bool>			s_Active;
+	static std::atomic<uint32>			s_CaptureID;
+	static TraceAppender				s_Appender;
+
+	// 以下只在主线程访问
+	static std::string					s_Filename;
+	static int32						s_RequestFrames;
+	static int32						s_FramesLeft;
+	static int32						s_FlushFrames;
+	static double						s_CaptureBegin;
+	static double						s_CaptureEnd;
+	static double						s_LastFrameTime;
+};
+
+class CPUProfileScope
+{
+public:
+	FORCEINLINE CPUProfileScope(const char* inName)
+		: name(inName)
+		, active(CPUProfiler::IsActive())
+		, beginTime(0.0)
+	{
+		if (active) {
+			beginTime = GenericPlatformTime::Seconds();
+		}
+	}
+
+	FORCEINLINE ~CPUProfileScope()
+	{
+		if (active) {
+			CPUProfiler::WriteEvent(name, beginTime, GenericPlatformTime::Seconds());
+		}
+	}
+
+private:
+	const char*		name;
+	bool			active;
+	double			beginTime;
+};
+
+#if MONKEY_PROFILE
+	#define PROFILE_ZONE_CONCAT_INNER(a, b) a##b
+	#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_INNER(a, b)
+	#define PROFILE_ZONE(name) CPUProfileScope PROFILE_ZONE_CONCAT(profileZone, __LINE__)(name)
+	#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#else
+	#define PROFILE_ZONE(name)
+	#define PROFILE_FUNCTION()
+#endif
@@ -0,0 +1,211 @@
+﻿#include "DVKAnimator.h"
+
+#include "Math/Quat.h"
+#include "Math/Vector3.h"
+#include "Core/Profiler.h"
+
+namespace vk_demo
+{
+
+	DVKAnimator::DVKAnimator()
+	{
+
+	}
+
+	DVKAnimator::~DVKAnimator()
+	{
+		model = nullptr;
+		mesh  = nullptr;
+	}
+
+	DVKAnimator* DVKAnimator::Create(DVKModel* model, DVKMesh* mesh)
+	{
+		if (model == nullptr || mesh == nullptr || model->animations.size() == 0)
+		{
+			MLOGE("DVKAnimator need a model with animations.");
+			return nullptr;
+		}
+
+		DVKAnimator* animator = new DVKAnimator();
+		animator->model = model;
+		animator->mesh  = mesh;
+
+		// 未被动画驱动的节点使用当前的local矩阵
+		animator->bindLocals.resize(model->linearNodes.size());
+		for (int32 i = 0; i < model->linearNodes.size(); ++i) {
+			animator->bindLocals[i] = model->linearNodes[i]->localMatrix;
+		}
+
+		animator->boneNodes.resize(mesh->bones.size());
+		animator->boneInverseBindPoses.resize(mesh->bones.size());
+		for (int32 i = 0; i < mesh->bones.size(); ++i)
+		{
+			DVKBone* bone = model->bones[mesh->bones[i]];
+			animator->boneNodes[i] = bone->nodeIndex;
+			animator->boneInverseBindPoses[i] = bone->inverseBindPose;
+		}
+
+		int32 maxClips = 0;
+		animator->animBindings.resize(model->animations.size());
+		for (int32 i = 0; i < model->animations.size(); ++i)
+		{
+			std::vector<ClipBinding>& bindings = animator->animBindings[i];
+			for (auto it = model->animations[i].clips.begin(); it != model->animations[i].clips.end(); ++it)
+			{
+				if (it->second.nodeIndex == -1) {
+					continue;
+				}
+				ClipBinding binding;
+				binding.clip      = &(it->second);
+				binding.nodeIndex = it->second.nodeIndex;
+				bindings.push_back(binding);
+			}
+			maxClips = MMath::Max(maxClips, (int32)bindings.size());
+		}
+		animator->cursorStride = maxClips * 3;
+
+		if (mesh->linkNode) {
+			animator->postTransform = mesh->linkNode->GetGlobalMatrix().Inverse();
+		}
+
+		// contexts[0]给主线程使用，最后一个给没有索引的线程使用
+		int32 numThreads = JobSystem::GetNumThreads();
+		animator->contexts.resize(JobSystem::GetNumThreadSlots());
+		for (int32 i = 0; i < animator->contexts.size(); ++i)
+		{
+			animator->contexts[i].locals.resize(model->linearNodes.size());
+			animator->contexts[i].globals.resize(model->linearNodes.size());
+		}
+
+		MLOG("DVKAnimator : %d bones, %d threads.", (int32)mesh->bones.size(), numThreads);
+
+		return animator;
+	}
+
+	int32 DVKAnimator::AddInstance(int32 animIndex, float time, float speed)
+	{
+		DVKAnimInstance instance;
+		instance.animIndex = MMath::Clamp(animIndex, 0, (int32)animBindings.size() - 1);
+		instance.time      = time;
+		instance.speed     = speed;
+		instances.push_back(instance);
+
+		cursors.resize(instances.size() * cursorStride, 0);
+		palettes.resize(instances.size() * GetPaletteStride(), 0.0f);
+
+		return (int32)instances.size() - 1;
+	}
+
+	void DVKAnimator::Update(float delta, int32 count)
+	{
+		PROFILE_FUNCTION();
+
+		if (count < 0 || count > instances.size()) {
+			count = (int32)instances.size();
+		}
+
+		if (count == 0) {
+			return;
+		}
+
+		// 实例数量不超过batchSize时JobSystem直接在当前线程执行
+		JobSystem::ParallelFor(count, batchSize, [this, delta](int32 begin, int32 end) {
+			PROFILE_ZONE("DVKAnimator::Evaluate");
+			WorkerContext& context = contexts[JobSystem::GetThreadIndex()];
+			for (int32 i = begin; i < end; ++i) {
+				Evaluate(i, delta, context);
+			}
+		});
+	}
+
+	void DVKAnimator::Evaluate(int32 index, float delta, WorkerContext& context)
+	{
+		DVKAnimInstance& instance = instances[index];
+		const DVKAnimation& animation = model->animations[instance.animIndex];
+
+		instance.time += delta * instance.speed;
+		if (animation.duration > 0.0f)
+		{
+			instance.time = MMath::Fmod(instance.time, animation.duration);
+			if (instance.time < 0.0f) {
+				instance.time += animation.duration;
+			}
+		}
+
+		std::vector<Matrix4x4>& locals  = context.locals;
+		std::vector<Matrix4x4>& globals = context.globals;
+		locals = bindLocals;
+
+		// 采样动画数据
+		const std::vector<ClipBinding>& bindings = animBindings[instance.animIndex];
+		int32* instCursors = cursors.data() + index * cursorStride;
+
+		for (int32 i = 0; i < bindings.size(); ++i)
+		{
+			const DVKAnimationClip* clip = bindings[i].clip;
+			float alpha = 0.0f;
+
+			Quat prevRot(0, 0, 0, 1);
+			Quat nextRot(0, 0, 0, 1);
+			clip->rotations.GetValue(instance.time, prevRot, nextRot, alpha, instCursors[i * 3 + 0]);
+			Quat rotation = MMath::Lerp(prevRot, nextRot, alpha);
+
+			Vector3 prevPos(0, 0, 0);
+			Vector3 nextPos(0, 0, 0);
+			clip->positions.GetValue(instance.time, prevPos, nextPos, alpha, instCursors[i * 3 + 1]);
+			Vector3 position = MMath::Lerp(prevPos, nextPos, alpha);
+
+			Vector3 prevScale(1, 1, 1);
+			Vector3 nextScale(1, 1, 1);
+			clip->scales.GetValue(instance.time, prevScale, nextScale, alpha, instCursors[i * 3 + 2]);
+			Vector3 scale = MMath::Lerp(prevScale, nextScale, alpha);
+
+			Matrix4x4& local = locals[bindings[i].nodeIndex];
+			local.SetIdentity();
+			local.AppendScale(scale);
+			local.Append(rotation.ToMatrix());
+			local.AppendTranslation(position);
+		}
+
+		// linearNodes中父节点总在子节点之前
+		const std::vector<int32>& nodeParents = model->nodeParents;
+		for (int32 i = 0; i < locals.size(); ++i)
+		{
+			globals[i] = locals[i];
+			if (nodeParents[i] != -1) {
+				globals[i].Append(globals[nodeParents[i]]);
+			}
+		}
+
+		// 转为对偶四元数
+		float* palette = palettes.data() + index * GetPaletteStride();
+		for (int32 i = 0; i < boneNodes.size(); ++i)
+		{
+			float* dst = palette + i * 8;
+
+			if (boneNodes[i] == -1)
+			{
+				dst[0] = 0; dst[1] = 0; dst[2] = 0; dst[3] = 1;
+				dst[4] = 0; dst[5] = 0; dst[6] = 0; dst[7] = 0;
+				continue;
+			}
+
+			Matrix4x4 boneTransform = boneInverseBindPoses[i];
+			boneTransform.Append(globals[boneNodes[i]]);
+			boneTransform.Append(postTransform);
+
+			Quat quat   = boneTransform.ToQuat();
+			Vector3 pos = boneTransform.GetOrigin();
+
+			dst[0] = quat.x;
+			dst[1] = quat.y;
+			dst[2] = quat.z;
+			dst[3] = quat.w;
+			dst[4] = (+0.5) * ( pos.x * quat.w + pos.y * quat.z - pos.z * quat.y);
+			dst[5] = (+0.5) * (-pos.x * quat.z + pos.y * quat.w + pos.z * quat.x);
+			dst[6] = (+0.5) * ( pos.x * quat.y - pos.y * quat.x + pos.z * quat.w);
+			dst[7] = (-0.5) * ( pos.x * quat.x + pos.y * quat.y + pos.z * quat.z);
+		}
+	}
+
+};
@@ -0,0 +1,118 @@
+﻿#pragma once
+
+#include "Engine.h"
+#include "DVKModel.h"
+
+#include "Common/Common.h"
+#include "Core/JobSystem.h"
+#include "Math/Math.h"
+#include "Math/Matrix4x4.h"
+
+#include <vector>
+
+namespace vk_demo
+{
+
+	struct DVKAnimInstance
+	{
+		int32	animIndex = 0;
+		float	time = 0.0f;
+		float	speed = 1.0f;
+	};
+
+	// 多个实例共享同一个Model的骨骼以及动画数据，每个实例有自己的播放时间和速度。
+	// 实例被分成若干批次交给JobSystem计算，调用线程也参与计算，
+	// 输出为对偶四元数格式的骨骼数据，每个骨骼两个RGBA32F像素，可以直接拷贝到骨骼动画贴图。
+	class DVKAnimator
+	{
+	private:
+		struct ClipBinding
+		{
+			const DVKAnimationClip*	clip = nullptr;
+			int32					nodeIndex = -1;
+		};
+
+		struct WorkerContext
+		{
+			std::vector<Matrix4x4>	locals;
+			std::vector<Matrix4x4>	globals;
+		};
+
+	public:
+		~DVKAnimator();
+
+	private:
+		DVKAnimator();
+
+	public:
+
+		int32 AddInstance(int32 animIndex, float time = 0.0f, float speed = 1.0f);
+
+		// 更新前count个实例，count < 0时更新全部实例。只能在主线程调用。
+		void Update(float delta, int32 count = -1);
+
+		inline DVKAnimInstance& GetInstance(int32 index)
+		{
+			return instances[index];
+		}
+
+		inline int32 GetInstanceCount() const
+		{
+			return (int32)instances.size();
+		}
+
+		inline int32 GetBoneCount() const
+		{
+			return (int32)boneNodes.size();
+		}
+
+		// 每个实例占用的float数量，bones * 8
+		inline int32 GetPaletteStride() const
+		{
+			return (int32)boneNodes.size() * 8;
+		}
+
+		inline const float* GetPalette(int32 index) const
+		{
+			return palettes.data() + index * GetPaletteStride();
+		}
+
+		inline int32 GetThreadCount() const
+		{
+			return JobSystem::GetNumThreads();
+		}
+
+		static DVKAnimator* Create(DVKModel* model, DVKMesh* mesh);
+
+	private:
+
+		void Evaluate(int32 index, float delta, WorkerContext& context);
+
+	public:
+		DVKModel*						model = nullptr;
+		DVKMesh*						mesh = nullptr;
+
+		// 骨骼最终矩阵右乘postTransform之后再转为对偶四元数，默认为mesh所在节点global矩阵的逆
+		Matrix4x4						postTransform;
+
+		std::vector<DVKAnimInstance>	instances;
+		std::vector<float>				palettes;
+
+		// 每个批次的实例数量
+		int32							batchSize = 32;
+
+	private:
+		std::vector<std::vector<ClipBinding>>	animBindings;
+		std::vector<Matrix4x4>					bindLocals;
+		std::vector<int32>						boneNodes;
+		std::vector<Matrix4x4>					boneInverseBindPoses;
+
+		// 每个实例每个clip的position/rotation/scale三个通道各自的cursor
+		std::vector<int32>				cursors;
+		int32							cursorStride = 0;
+
+		// 按JobSystem::GetThreadIndex()索引，只在Job中访问，JobSystem保证执行Job的线程索引各不相同
+		std::vector<WorkerContext>		contexts;
+	};
+
+};
@@ -5,17 +5,31 @@
 
 namespace vk_demo
 {
+	DVKBuffer::~DVKBuffer()
+	{
+		VulkanDeferredDeletionQueue& deletionQueue = vulkanDevice->GetDeferredDeletionQueue();
+		if (buffer != VK_NULL_HANDLE) {
+			deletionQueue.EnqueueResource(VulkanDeferredDeletionQueue::Type::Buffer, buffer);
+			buffer = VK_NULL_HANDLE;
+		}
+		if (allocation != nullptr) {
+			deletionQueue.EnqueueResourceAllocation(allocation);
+			allocation = nullptr;
+		}
+		memory = VK_NULL_HANDLE;
+		mapped = nullptr;
+		vulkanDevice = nullptr;
+	}
+
 	DVKBuffer* DVKBuffer::CreateBuffer(std::shared_ptr<VulkanDevice> vulkanDevice, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, void *data)
 	{
 		DVKBuffer* dvkBuffer = new DVKBuffer();
 		dvkBuffer->device = vulkanDevice->GetInstanceHandle();
+		dvkBuffer->vulkanDevice = vulkanDevice;
 		
 		VkDevice vkDevice = vulkanDevice->GetInstanceHandle();
 		
-		uint32 memoryTypeIndex = 0;
 		VkMemoryRequirements memReqs = {};
-		VkMemoryAllocateInfo memAlloc;
-		ZeroVulkanStruct(memAlloc, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 		
 		VkBufferCreateInfo bufferCreateInfo;
 		ZeroVulkanStruct(bufferCreateInfo, VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO);
@@ -24,13 +38,18 @@ namespace vk_demo
 		vkCreateBuffer(vkDevice, &bufferCreateInfo, nullptr, &(dvkBuffer->buffer));
 
 		vkGetBufferMemoryRequirements(vkDevice, dvkBuffer->buffer, &memReqs);
-		vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, memoryPropertyFlags, &memoryTypeIndex);
-		memAlloc.allocationSize  = memReqs.size;
-		memAlloc.memoryTypeIndex = memoryTypeIndex;
-		
-		vkAllocateMemory(vkDevice, &memAlloc, nullptr, &dvkBuffer->memory);
+		dvkBuffer->allocation = vulkanDevice->GetResourceHeapManager().AllocateBufferMemory(memReqs, memoryPropertyFlags, __FILE__, __LINE__);
+		if (dvkBuffer->allocation == nullptr)
+		{
+			MLOGE("Failed allocate buffer memory.");
+			vkDestroyBuffer(vkDevice, dvkBuffer->buffer, VULKAN_CPU_ALLOCATOR);
+			dvkBuffer->buffer = VK_NULL_HANDLE;
+			delete dvkBuffer;
+			return nullptr;
+		}
+		dvkBuffer->memory     = dvkBuffer->allocation->GetHandle();
 
-		dvkBuffer->size       = memAlloc.allocationSize;
+		dvkBuffer->size       = memReqs.size;
 		dvkBuffer->alignment  = memReqs.alignment;
 		dvkBuffer->usageFlags = usageFlags;
 		dvkBuffer->memoryPropertyFlags = memoryPropertyFlags;
@@ -56,21 +75,22 @@ namespace vk_demo
 		if (mapped) {
 			return VK_SUCCESS;
 		}
-		return vkMapMemory(device, memory, offset, size, 0, &mapped);
+		// HostVisible的page在分配时已经常驻映射
+		if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0) {
+			return VK_ERROR_MEMORY_MAP_FAILED;
+		}
+		mapped = (uint8*)allocation->GetMappedPointer() + offset;
+		return VK_SUCCESS;
 	}
 
 	void DVKBuffer::UnMap()
 	{
-		if (!mapped) {
-			return;
-		}
-		vkUnmapMemory(device, memory);
 		mapped = nullptr;
 	}
 
 	VkResult DVKBuffer::Bind(VkDeviceSize offset)
 	{
-		return vkBindBufferMemory(device, buffer, memory, offset);
+		return vkBindBufferMemory(device, buffer, memory, allocation->GetOffset() + offset);
 	}
 
 	void DVKBuffer::SetupDescriptor(VkDeviceSize size, VkDeviceSize offset)
@@ -90,22 +110,14 @@ namespace vk_demo
 
 	VkResult DVKBuffer::Flush(VkDeviceSize size, VkDeviceSize offset)
 	{
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size   = size;
-		return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
+		allocation->FlushMappedMemory(offset, size);
+		return VK_SUCCESS;
 	}
 
 	VkResult DVKBuffer::Invalidate(VkDeviceSize size, VkDeviceSize offset)
 	{
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size   = size;
-		return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
+		allocation->InvalidateMappedMemory(offset, size);
+		return VK_SUCCESS;
 	}
 
 }
@@ -23,24 +23,20 @@ namespace vk_demo
 
 		}
 	public:
-		~DVKBuffer()
-		{
-			if (buffer != VK_NULL_HANDLE) {
-				vkDestroyBuffer(device, buffer, nullptr);
-				buffer = VK_NULL_HANDLE;
-			}
-			if (memory != VK_NULL_HANDLE) {
-				vkFreeMemory(device, memory, nullptr);
-				memory = VK_NULL_HANDLE;
-			}
-		}
+		// buffer和memory交给DeferredDeletionQueue，等使用过它的帧完成后释放
+		~DVKBuffer();
+
 	public:
 
 		VkDevice				device = VK_NULL_HANDLE;
+		std::shared_ptr<VulkanDevice>	vulkanDevice = nullptr;
 
 		VkBuffer				buffer = VK_NULL_HANDLE;
 		VkDeviceMemory			memory = VK_NULL_HANDLE;
 
+		// 从VulkanResourceHeapManager分配的子块，memory为其所在page的句柄
+		VulkanResourceAllocation*	allocation = nullptr;
+
 		VkDescriptorBufferInfo	descriptor;
 
 		VkDeviceSize			size = 0;
@@ -53,6 +49,7 @@ namespace vk_demo
 
 	public:
 
+		// 没有可用的内存类型时返回nullptr
 		static DVKBuffer* CreateBuffer(std::shared_ptr<VulkanDevice> device, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, void *data = nullptr);
 
 		VkResult Map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
@@ -1,6 +1,8 @@
 ﻿#include "DVKCommand.h"
+#include "DVKMaterial.h"
 
 #include "Vulkan/VulkanCommon.h"
+#include "Core/Profiler.h"
 
 namespace vk_demo
 {
@@ -50,6 +52,9 @@ namespace vk_demo
 		vkResetFences(vulkanDevice->GetInstanceHandle(), 1, &fence);
 		vkQueueSubmit(queue->GetHandle(), 1, &submitInfo, fence);
 		vkWaitForFences(vulkanDevice->GetInstanceHandle(), 1, &fence, true, MAX_uint64);
+
+		// RingBuffer中由这个队列读取的数据跟随本次提交回收
+		DVKRingBuffer::SubmitQueueAll(queue->GetHandle(), fence);
 	}
 
 	void DVKCommandBuffer::Begin()
@@ -107,4 +112,150 @@ namespace vk_demo
 		return cmdBuffer;
 	}
 
+	DVKParallelCommandRecorder::DVKParallelCommandRecorder()
+	{
+
+	}
+
+	DVKParallelCommandRecorder::~DVKParallelCommandRecorder()
+	{
+		JobSystem::Wait(&counter);
+
+		VkDevice device = vulkanDevice->GetInstanceHandle();
+
+		// 销毁pool时会一并释放分配的command buffer
+		for (int32 i = 0; i < frames.size(); ++i)
+		{
+			for (int32 j = 0; j < frames[i].threads.size(); ++j) {
+				vkDestroyCommandPool(device, frames[i].threads[j].commandPool, VULKAN_CPU_ALLOCATOR);
+			}
+		}
+		frames.clear();
+
+		vulkanDevice = nullptr;
+	}
+
+	DVKParallelCommandRecorder* DVKParallelCommandRecorder::Create(std::shared_ptr<VulkanDevice> vulkanDevice, int32 numFrames)
+	{
+		VkDevice device = vulkanDevice->GetInstanceHandle();
+
+		DVKParallelCommandRecorder* recorder = new DVKParallelCommandRecorder();
+		recorder->vulkanDevice = vulkanDevice;
+		recorder->frames.resize(numFrames);
+
+		// 按JobSystem::GetThreadIndex()索引，0为主线程，最后一个给没有索引的线程直接执行Job时使用
+		int32 numThreads = JobSystem::GetNumThreadSlots();
+
+		VkCommandPoolCreateInfo cmdPoolInfo;
+		ZeroVulkanStruct(cmdPoolInfo, VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO);
+		cmdPoolInfo.queueFamilyIndex = vulkanDevice->GetGraphicsQueue()->GetFamilyIndex();
+		cmdPoolInfo.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		for (int32 i = 0; i < numFrames; ++i)
+		{
+			recorder->frames[i].threads.resize(numThreads);
+			for (int32 j = 0; j < numThreads; ++j) {
+				VERIFYVULKANRESULT(vkCreateCommandPool(device, &cmdPoolInfo, VULKAN_CPU_ALLOCATOR, &(recorder->frames[i].threads[j].commandPool)));
+			}
+		}
+
+		return recorder;
+	}
+
+	void DVKParallelCommandRecorder::BeginFrame(int32 inFrameIndex, VkRenderPass inRenderPass, VkFramebuffer inFramebuffer, uint32 inSubpass)
+	{
+		// 上一帧没有调用ExecuteCommands时，需要等录制结束才能重置
+		JobSystem::Wait(&counter);
+		recorded.clear();
+
+		frameIndex  = inFrameIndex;
+		renderPass  = inRenderPass;
+		framebuffer = inFramebuffer;
+		subpass     = inSubpass;
+
+		VkDevice device = vulkanDevice->GetInstanceHandle();
+
+		FrameCommands& frame = frames[frameIndex];
+		for (int32 i = 0; i < frame.threads.size(); ++i)
+		{
+			ThreadCommands& thread = frame.threads[i];
+			if (thread.used > 0)
+			{
+				VERIFYVULKANRESULT(vkResetCommandPool(device, thread.commandPool, 0));
+				thread.used = 0;
+			}
+		}
+	}
+
+	VkCommandBuffer DVKParallelCommandRecorder::AcquireCommandBuffer(FrameCommands& frame)
+	{
+		// 只在Job中调用，索引一定在[0, GetNumThreadSlots())之内
+		ThreadCommands& thread = frame.threads[JobSystem::GetThreadIndex()];
+
+		if (thread.used == thread.cmdBuffers.size())
+		{
+			VkCommandBufferAllocateInfo cmdBufferAllocateInfo;
+			ZeroVulkanStruct(cmdBufferAllocateInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO);
+			cmdBufferAllocateInfo.commandPool        = thread.commandPool;
+			cmdBufferAllocateInfo.level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			cmdBufferAllocateInfo.commandBufferCount = 1;
+
+			VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+			VERIFYVULKANRESULT(vkAllocateCommandBuffers(vulkanDevice->GetInstanceHandle(), &cmdBufferAllocateInfo, &cmdBuffer));
+			thread.cmdBuffers.push_back(cmdBuffer);
+		}
+
+		thread.used += 1;
+
+		return thread.cmdBuffers[thread.used - 1];
+	}
+
+	void DVKParallelCommandRecorder::Record(const RecordFunction& function)
+	{
+		recorded.push_back(VK_NULL_HANDLE);
+		VkCommandBuffer* slot = &(recorded.back());
+
+		FrameCommands* frame = &(frames[frameIndex]);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo;
+		ZeroVulkanStruct(inheritanceInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO);
+		inheritanceInfo.renderPass  = renderPass;
+		inheritanceInfo.subpass     = subpass;
+		inheritanceInfo.framebuffer = framebuffer;
+
+		JobSystem::Run([this, function, slot, frame, inheritanceInfo] {
+			PROFILE_ZONE("DVKParallelCommandRecorder::Record");
+
+			VkCommandBuffer cmdBuffer = AcquireCommandBuffer(*frame);
+
+			VkCommandBufferBeginInfo cmdBufferBeginInfo;
+			ZeroVulkanStruct(cmdBufferBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
+			cmdBufferBeginInfo.flags            = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			cmdBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+			VERIFYVULKANRESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo));
+
+			function(cmdBuffer);
+
+			VERIFYVULKANRESULT(vkEndCommandBuffer(cmdBuffer));
+
+			*slot = cmdBuffer;
+		}, &counter);
+	}
+
+	void DVKParallelCommandRecorder::ExecuteCommands(VkCommandBuffer primaryCmdBuffer)
+	{
+		PROFILE_FUNCTION();
+
+		JobSystem::Wait(&counter);
+
+		if (recorded.size() == 0) {
+			return;
+		}
+
+		std::vector<VkCommandBuffer> cmdBuffers(recorded.begin(), recorded.end());
+		vkCmdExecuteCommands(primaryCmdBuffer, cmdBuffers.size(), cmdBuffers.data());
+
+		recorded.clear();
+	}
+
 }
@@ -6,10 +6,12 @@
 #include "Math/Math.h"
 
 #include "Vulkan/VulkanCommon.h"
+#include "Core/JobSystem.h"
 
 #include <string>
 #include <cstring>
 #include <vector>
+#include <deque>
 #include <memory>
 
 class VulkanDevice;
@@ -47,4 +49,62 @@ namespace vk_demo
 		bool								isBegun;
 	};
 
+	// 多线程录制secondary command buffer。
+	// 每一帧每个线程各有一个VkCommandPool，BeginFrame时整体vkResetCommandPool，线程之间不需要加锁。
+	// Record提交的录制任务交给JobSystem执行，ExecuteCommands按照Record的调用顺序执行，与录制线程无关。
+	class DVKParallelCommandRecorder
+	{
+	public:
+		typedef std::function<void(VkCommandBuffer cmdBuffer)> RecordFunction;
+
+	private:
+		struct ThreadCommands
+		{
+			VkCommandPool					commandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer>	cmdBuffers;
+			int32							used = 0;
+		};
+
+		struct FrameCommands
+		{
+			// 按JobSystem::GetThreadIndex()索引，数量为GetNumThreadSlots()，只在Record的Job中访问，JobSystem保证执行Job的线程索引各不相同
+			std::vector<ThreadCommands>		threads;
+		};
+
+		DVKParallelCommandRecorder();
+
+	public:
+		~DVKParallelCommandRecorder();
+
+		// frameIndex对应的上一次提交必须已经执行完毕，使用backbuffer index时由DemoBase的fence保证
+		void BeginFrame(int32 frameIndex, VkRenderPass renderPass, VkFramebuffer framebuffer, uint32 subpass = 0);
+
+		// function在工作线程上执行，传入的secondary command buffer已经Begin并且填好了inheritance信息，返回后自动End
+		void Record(const RecordFunction& function);
+
+		// 等待所有录制完成，按Record的顺序调用vkCmdExecuteCommands。
+		// primary command buffer需要以VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS开始RenderPass。
+		void ExecuteCommands(VkCommandBuffer primaryCmdBuffer);
+
+		static DVKParallelCommandRecorder* Create(std::shared_ptr<VulkanDevice> vulkanDevice, int32 numFrames);
+
+	private:
+		VkCommandBuffer AcquireCommandBuffer(FrameCommands& frame);
+
+	public:
+		std::shared_ptr<VulkanDevice>		vulkanDevice = nullptr;
+
+	private:
+		std::vector<FrameCommands>			frames;
+		int32								frameIndex = 0;
+
+		VkRenderPass						renderPass = VK_NULL_HANDLE;
+		VkFramebuffer						framebuffer = VK_NULL_HANDLE;
+		uint32								subpass = 0;
+
+		// deque在尾部插入时已有元素的地址不变，录制线程可以直接写入自己的位置
+		std::deque<VkCommandBuffer>			recorded;
+		JobCounter							counter;
+	};
+
 }
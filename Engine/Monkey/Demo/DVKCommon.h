@@ -3,6 +3,7 @@
 #include "DemoBase.h"
 #include "DVKBuffer.h"
 #include "DVKCommand.h"
+#include "DVKUploadContext.h"
 #include "DVKUtils.h"
 #include "DVKIndexBuffer.h"
 #include "DVKVertexBuffer.h"
@@ -15,5 +16,7 @@
 #include "DVKCamera.h"
 #include "DVKRenderTarget.h"
 #include "DVKCompute.h"
+#include "DVKProfiler.h"
+#include "DVKMeshCache.h"
 #include "FileManager.h"
 #include "ImageGUIContext.h"
\ No newline at end of file
@@ -13,6 +13,8 @@ namespace vk_demo
         ringBuffer->bufferSize   = 8 * 1024 * 1024; // 8MB
         ringBuffer->bufferOffset = ringBuffer->bufferSize;
         ringBuffer->minAlignment = vulkanDevice->GetLimits().minUniformBufferOffsetAlignment;
+        // 计算队列上的提交读取之后就可以回收，不需要等待图形帧的fence
+        ringBuffer->queue        = vulkanDevice->GetComputeQueue()->GetHandle();
         ringBuffer->realBuffer   = vk_demo::DVKBuffer::CreateBuffer(
             vulkanDevice,
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
@@ -38,8 +40,10 @@ namespace vk_demo
         textures.clear();
         uniformBuffers.clear();
         
-        vkDestroyPipeline(vulkanDevice->GetInstanceHandle(), pipeline, VULKAN_CPU_ALLOCATOR);
-        pipeline = VK_NULL_HANDLE;
+        if (pipeline != VK_NULL_HANDLE) {
+            vulkanDevice->GetDeferredDeletionQueue().EnqueueResource(VulkanDeferredDeletionQueue::Type::Pipeline, pipeline);
+            pipeline = VK_NULL_HANDLE;
+        }
         
         ringBufferRefCount -= 1;
         if (ringBufferRefCount == 0) {
@@ -144,7 +148,7 @@ namespace vk_demo
         VkDevice device = vulkanDevice->GetInstanceHandle();
         if (pipeline != VK_NULL_HANDLE)
         {
-            vkDestroyPipeline(device, pipeline, VULKAN_CPU_ALLOCATOR);
+            vulkanDevice->GetDeferredDeletionQueue().EnqueueResource(VulkanDeferredDeletionQueue::Type::Pipeline, pipeline);
             pipeline = VK_NULL_HANDLE;
         }
         
@@ -1,83 +1,92 @@
 ﻿#include "DVKIndexBuffer.h"
 #include "DVKBuffer.h"
 #include "DVKCommand.h"
+#include "DVKUploadContext.h"
 
 namespace vk_demo
 {
 	DVKIndexBuffer* DVKIndexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, std::vector<uint32> indices)
+	{
+		DVKUploadContext* uploader = DVKUploadContext::Create(vulkanDevice, cmdBuffer);
+		DVKIndexBuffer* indexBuffer = Create(vulkanDevice, uploader, indices);
+		uploader->Flush();
+		delete uploader;
+		return indexBuffer;
+	}
+
+	DVKIndexBuffer* DVKIndexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, const std::vector<uint32>& indices)
+	{
+		return Create(vulkanDevice, uploader, indices.data(), indices.size());
+	}
+
+	DVKIndexBuffer* DVKIndexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, const uint32* indices, int32 count)
 	{
 		VkDevice device = vulkanDevice->GetInstanceHandle();
 
 		DVKIndexBuffer* indexBuffer = new DVKIndexBuffer();
 		indexBuffer->device = device;
-		indexBuffer->indexCount = indices.size();
+		indexBuffer->indexCount = count;
 		indexBuffer->indexType = VK_INDEX_TYPE_UINT32;
 
 		vk_demo::DVKBuffer* indexStaging = vk_demo::DVKBuffer::CreateBuffer(
 			vulkanDevice, 
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-			indices.size() * sizeof(uint32), 
-			indices.data()
+			count * sizeof(uint32), 
+			(void*)indices
 		);
 
 		indexBuffer->dvkBuffer = vk_demo::DVKBuffer::CreateBuffer(
 			vulkanDevice, 
 			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-			indices.size() * sizeof(uint32)
+			count * sizeof(uint32)
 		);
 
-		cmdBuffer->Begin();
-
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = indices.size() * sizeof(uint32);
-
-		vkCmdCopyBuffer(cmdBuffer->cmdBuffer, indexStaging->buffer, indexBuffer->dvkBuffer->buffer, 1, &copyRegion);
-
-		cmdBuffer->End();
-		cmdBuffer->Submit();
-
-		delete indexStaging;
+		uploader->CopyBuffer(indexStaging, indexBuffer->dvkBuffer, count * sizeof(uint32), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 
 		return indexBuffer;
 	}
 
 	DVKIndexBuffer* DVKIndexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, std::vector<uint16> indices)
+	{
+		DVKUploadContext* uploader = DVKUploadContext::Create(vulkanDevice, cmdBuffer);
+		DVKIndexBuffer* indexBuffer = Create(vulkanDevice, uploader, indices);
+		uploader->Flush();
+		delete uploader;
+		return indexBuffer;
+	}
+
+	DVKIndexBuffer* DVKIndexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, const std::vector<uint16>& indices)
+	{
+		return Create(vulkanDevice, uploader, indices.data(), indices.size());
+	}
+
+	DVKIndexBuffer* DVKIndexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, const uint16* indices, int32 count)
 	{
 		VkDevice device = vulkanDevice->GetInstanceHandle();
 
 		DVKIndexBuffer* indexBuffer = new DVKIndexBuffer();
 		indexBuffer->device = device;
-		indexBuffer->indexCount = indices.size();
+		indexBuffer->indexCount = count;
 		indexBuffer->indexType = VK_INDEX_TYPE_UINT16;
-		
+
 		vk_demo::DVKBuffer* indexStaging = vk_demo::DVKBuffer::CreateBuffer(
 			vulkanDevice, 
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-			indices.size() * sizeof(uint16), 
-			indices.data()
+			count * sizeof(uint16), 
+			(void*)indices
 		);
 
 		indexBuffer->dvkBuffer = vk_demo::DVKBuffer::CreateBuffer(
 			vulkanDevice, 
 			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-			indices.size() * sizeof(uint16)
+			count * sizeof(uint16)
 		);
 
-		cmdBuffer->Begin();
-
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = indices.size() * sizeof(uint16);
-
-		vkCmdCopyBuffer(cmdBuffer->cmdBuffer, indexStaging->buffer, indexBuffer->dvkBuffer->buffer, 1, &copyRegion);
-        
-		cmdBuffer->End();
-		cmdBuffer->Submit();
-        
-		delete indexStaging;
+		uploader->CopyBuffer(indexStaging, indexBuffer->dvkBuffer, count * sizeof(uint16), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 
 		return indexBuffer;
 	}
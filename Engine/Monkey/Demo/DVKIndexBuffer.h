@@ -3,6 +3,7 @@
 #include "Engine.h"
 #include "DVKBuffer.h"
 #include "DVKCommand.h"
+#include "DVKUploadContext.h"
 
 #include "Common/Common.h"
 #include "Math/Math.h"
@@ -43,6 +44,15 @@ namespace vk_demo
 
 		static DVKIndexBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, std::vector<uint32> indices);
 
+		static DVKIndexBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, const std::vector<uint16>& indices);
+
+		static DVKIndexBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, const std::vector<uint32>& indices);
+
+		// 直接从内存(例如映射的缓存文件)上传，数据只需要在调用期间有效
+		static DVKIndexBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, const uint16* indices, int32 count);
+
+		static DVKIndexBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, const uint32* indices, int32 count);
+
 	public:
 		VkDevice		device = VK_NULL_HANDLE;
 		DVKBuffer*		dvkBuffer = nullptr;
@@ -1,17 +1,153 @@
 ﻿#include "DVKMaterial.h"
 #include "DVKDefaultRes.h"
 
+#include "Core/Profiler.h"
+
 namespace vk_demo
 {
 
+	std::vector<DVKRingBuffer*> DVKRingBuffer::ringBuffers;
+
+	DVKRingBuffer::DVKRingBuffer()
+	{
+		ringBuffers.push_back(this);
+	}
+
+	DVKRingBuffer::~DVKRingBuffer()
+	{
+		MLOG("RingBuffer high water mark : %dKB/%dKB, frame : %dKB, stall : %d", int32(highWaterMark / 1024), int32(bufferSize / 1024), int32(frameHighWaterMark / 1024), stallCount);
+
+		for (int32 i = 0; i < ringBuffers.size(); ++i)
+		{
+			if (ringBuffers[i] == this) 
+			{
+				ringBuffers.erase(ringBuffers.begin() + i);
+				break;
+			}
+		}
+
+		realBuffer->UnMap();
+		delete realBuffer;
+		realBuffer = nullptr;
+	}
+
+	uint64 DVKRingBuffer::AllocateMemory(uint64 size)
+	{
+		uint64 allocationOffset = Align<uint64>(bufferOffset, minAlignment);
+		uint64 padding = allocationOffset - bufferOffset;
+
+		// 尾部放不下就回到头部，尾部剩余的空间算作当前帧占用
+		if (allocationOffset + size > bufferSize) 
+		{
+			allocationOffset = 0;
+			padding = bufferSize - bufferOffset;
+		}
+
+		// 会覆盖in flight的数据，等待最老的一帧完成
+		uint64 required = padding + size;
+		while (usedSize + required > bufferSize && RetireSegments(true))
+		{
+
+		}
+
+		if (usedSize + required > bufferSize) 
+		{
+			// 单帧的数据量已经超过RingBuffer大小，只能直接覆盖
+			if (!overflowed) 
+			{
+				MLOGE("RingBuffer overflow, size : %dKB, frame : %dKB", int32(bufferSize / 1024), int32((frameSize + required) / 1024));
+				overflowed = true;
+			}
+			usedSize  = 0;
+			frameSize = 0;
+		}
+
+		bufferOffset = allocationOffset + size;
+		usedSize    += required;
+		frameSize   += required;
+
+		highWaterMark      = MMath::Max(highWaterMark, usedSize);
+		frameHighWaterMark = MMath::Max(frameHighWaterMark, frameSize);
+
+		return allocationOffset;
+	}
+
+	void DVKRingBuffer::SubmitFrame(VkFence fence)
+	{
+		// fence在reset之前必须已经完成，之前用它绑定的分段都已经不再被读取。
+		// 标记为已完成，避免RetireSegments去等待复用后的新提交。
+		for (int32 i = 0; i < segments.size(); ++i)
+		{
+			if (segments[i].fence == fence) {
+				segments[i].fence = VK_NULL_HANDLE;
+			}
+		}
+
+		if (frameSize > 0) 
+		{
+			FrameSegment segment;
+			segment.size  = frameSize;
+			segment.fence = fence;
+			segments.push_back(segment);
+			frameSize = 0;
+		}
+
+		while (RetireSegments(false))
+		{
+
+		}
+	}
+
+	bool DVKRingBuffer::RetireSegments(bool wait)
+	{
+		if (segments.empty()) {
+			return false;
+		}
+
+		const FrameSegment& segment = segments.front();
+		if (segment.fence != VK_NULL_HANDLE && vkGetFenceStatus(device, segment.fence) != VK_SUCCESS) 
+		{
+			if (!wait) {
+				return false;
+			}
+			stallCount += 1;
+			vkWaitForFences(device, 1, &segment.fence, VK_TRUE, MAX_uint64);
+		}
+
+		usedSize -= segment.size;
+		segments.pop_front();
+
+		return true;
+	}
+
+	void DVKRingBuffer::SubmitFrameAll(VkFence fence)
+	{
+		for (int32 i = 0; i < ringBuffers.size(); ++i) {
+			ringBuffers[i]->SubmitFrame(fence);
+		}
+	}
+
+	void DVKRingBuffer::SubmitQueueAll(VkQueue queue, VkFence fence)
+	{
+		for (int32 i = 0; i < ringBuffers.size(); ++i)
+		{
+			if (ringBuffers[i]->queue == queue) {
+				ringBuffers[i]->SubmitFrame(fence);
+			}
+		}
+	}
+
 	DVKRingBuffer*	DVKMaterial::ringBuffer = nullptr;
 	int32			DVKMaterial::ringBufferRefCount = 0;
+
+	DVKGfxPipelineBatch*				DVKMaterial::pendingPipelines = nullptr;
+	std::vector<DVKGfxPipelineBatch*>	DVKMaterial::buildingPipelines;
     
 	void DVKMaterial::InitRingBuffer(std::shared_ptr<VulkanDevice> vulkanDevice)
 	{
 		ringBuffer = new DVKRingBuffer();
 		ringBuffer->device		 = vulkanDevice->GetInstanceHandle();
-		ringBuffer->bufferSize   = 32 * 1024 * 1024; // 32MB
+		ringBuffer->bufferSize   = 16 * 1024 * 1024; // 16MB
 		ringBuffer->bufferOffset = ringBuffer->bufferSize;
 		ringBuffer->minAlignment = vulkanDevice->GetLimits().minUniformBufferOffsetAlignment;
 		ringBuffer->realBuffer   = vk_demo::DVKBuffer::CreateBuffer(
@@ -46,6 +182,10 @@ namespace vk_demo
         
         if (pipeline) 
 		{
+			// 还没创建完成的pipeline被批次引用着，先等待完成
+			if (!pipeline->IsReady()) {
+				BuildPendingPipelines();
+			}
             delete pipeline;
             pipeline = nullptr;
         }
@@ -100,6 +240,9 @@ namespace vk_demo
 	{
         // 创建descriptorSet
         descriptorSet = shader->AllocateDescriptorSet();
+        if (descriptorSet) {
+            descriptorSet->BeginUpdate();
+        }
         
 		// 从Shader获取buffer信息
         for (auto it = shader->bufferParams.begin(); it != shader->bufferParams.end(); ++it)
@@ -165,12 +308,37 @@ namespace vk_demo
             texture.stageFlags      = it->second.stageFlags;
             textures.insert(std::make_pair(it->first, texture));
         }
+
+		if (!descriptorSet) {
+			return;
+		}
+
+		// 所有UniformBuffer的写入合并为一次更新
+		descriptorSet->EndUpdate();
+
+		// 预先解析handle，之后的更新不再需要字符串查找
+		for (auto it = uniformBuffers.begin(); it != uniformBuffers.end(); ++it) {
+			uniformHandles.push_back(&(*it));
+		}
+
+		for (auto it = storageBuffers.begin(); it != storageBuffers.end(); ++it) {
+			it->second.descriptorHandle = descriptorSet->GetBindingHandle(it->first);
+			storageHandles.push_back(&(*it));
+		}
+
+		for (auto it = textures.begin(); it != textures.end(); ++it) {
+			it->second.descriptorHandle = descriptorSet->GetBindingHandle(it->first);
+			textureHandles.push_back(&(*it));
+		}
 	}
     
     void DVKMaterial::PreparePipeline()
     {
         if (pipeline) 
 		{
+			if (!pipeline->IsReady()) {
+				BuildPendingPipelines();
+			}
             delete pipeline;
             pipeline = nullptr;
         }
@@ -188,8 +356,63 @@ namespace vk_demo
         );
     }
 
+	void DVKMaterial::RequestPipeline()
+	{
+		if (pipeline) 
+		{
+			if (!pipeline->IsReady()) {
+				BuildPendingPipelines();
+			}
+			delete pipeline;
+			pipeline = nullptr;
+		}
+
+		if (pendingPipelines == nullptr) {
+			pendingPipelines = new DVKGfxPipelineBatch();
+		}
+
+		pipelineInfo.shader = shader;
+		pipeline = pendingPipelines->Add(
+			vulkanDevice,
+			pipelineCache,
+			pipelineInfo,
+			shader->inputBindings,
+			shader->inputAttributes,
+			shader->pipelineLayout,
+			renderPass
+		);
+	}
+
+	void DVKMaterial::BuildPendingPipelines(bool wait)
+	{
+		PROFILE_FUNCTION();
+
+		if (pendingPipelines)
+		{
+			pendingPipelines->Build(wait);
+			buildingPipelines.push_back(pendingPipelines);
+			pendingPipelines = nullptr;
+		}
+
+		if (wait) {
+			WaitPendingPipelines();
+		}
+	}
+
+	void DVKMaterial::WaitPendingPipelines()
+	{
+		for (int32 i = 0; i < buildingPipelines.size(); ++i)
+		{
+			buildingPipelines[i]->Wait();
+			delete buildingPipelines[i];
+		}
+		buildingPipelines.clear();
+	}
+
 	void DVKMaterial::BeginFrame()
 	{
+		PROFILE_FUNCTION();
+
 		if (actived) {
 			return;
 		}
@@ -285,6 +508,62 @@ namespace vk_demo
 		);
 	}
 
+	int32 DVKMaterial::GetUniformHandle(const std::string& name) const
+	{
+		auto it = uniformBuffers.find(name);
+		for (int32 i = 0; it != uniformBuffers.end() && i < uniformHandles.size(); ++i)
+		{
+			if (uniformHandles[i] == &(*it)) {
+				return i;
+			}
+		}
+
+		MLOGE("Uniform %s not found.", name.c_str());
+		return -1;
+	}
+
+	int32 DVKMaterial::GetTextureHandle(const std::string& name) const
+	{
+		auto it = textures.find(name);
+		for (int32 i = 0; it != textures.end() && i < textureHandles.size(); ++i)
+		{
+			if (textureHandles[i] == &(*it)) {
+				return i;
+			}
+		}
+
+		MLOGE("Texture %s not found.", name.c_str());
+		return -1;
+	}
+
+	int32 DVKMaterial::GetStorageBufferHandle(const std::string& name) const
+	{
+		auto it = storageBuffers.find(name);
+		for (int32 i = 0; it != storageBuffers.end() && i < storageHandles.size(); ++i)
+		{
+			if (storageHandles[i] == &(*it)) {
+				return i;
+			}
+		}
+
+		MLOGE("StorageBuffer %s not found.", name.c_str());
+		return -1;
+	}
+
+	void DVKMaterial::BeginUpdate()
+	{
+		if (descriptorSet) {
+			descriptorSet->BeginUpdate();
+		}
+	}
+
+	void DVKMaterial::EndUpdate()
+	{
+		if (descriptorSet) {
+			descriptorSet->EndUpdate();
+		}
+	}
+
     void DVKMaterial::SetLocalUniform(const std::string& name, void* dataPtr, uint32 size)
     {
         auto it = uniformBuffers.find(name);
@@ -294,9 +573,28 @@ namespace vk_demo
             return;
         }
         
-        if (it->second.dataSize != size) 
+        UpdateLocalUniform(*it, dataPtr, size);
+    }
+
+	void DVKMaterial::SetLocalUniform(int32 handle, void* dataPtr, uint32 size)
+	{
+		if (handle < 0 || handle >= uniformHandles.size()) 
+		{
+			MLOGE("Invalid uniform handle %d.", handle);
+			return;
+		}
+
+		UpdateLocalUniform(*uniformHandles[handle], dataPtr, size);
+	}
+
+	void DVKMaterial::UpdateLocalUniform(BuffersMap::value_type& uniform, void* dataPtr, uint32 size)
+	{
+		const std::string& name = uniform.first;
+		DVKSimulateBuffer& uboBuffer = uniform.second;
+
+        if (uboBuffer.dataSize != size) 
 		{
-            MLOGE("Uniform %s size not match, dst=%ud src=%ud", name.c_str(), it->second.dataSize, size);
+            MLOGE("Uniform %s size not match, dst=%ud src=%ud", name.c_str(), uboBuffer.dataSize, size);
             return;
         }
 
@@ -307,15 +605,15 @@ namespace vk_demo
 
 		// 拷贝数据至ringbuffer
 		uint8* ringCPUData = (uint8*)(ringBuffer->GetMappedPointer());
-		uint64 ringOffset  = ringBuffer->AllocateMemory(it->second.dataSize);
-		uint64 bufferSize  = it->second.dataSize;
+		uint64 ringOffset  = ringBuffer->AllocateMemory(uboBuffer.dataSize);
+		uint64 bufferSize  = uboBuffer.dataSize;
 		
 		// 拷贝数据
 		memcpy(ringCPUData + ringOffset, dataPtr, bufferSize);
 
 		// 记录Offset
-		dynOffsets[it->second.dynamicIndex] = ringOffset;
-    }
+		dynOffsets[uboBuffer.dynamicIndex] = ringOffset;
+	}
 
 	void DVKMaterial::SetGlobalUniform(const std::string& name, void* dataPtr, uint32 size)
 	{
@@ -326,18 +624,37 @@ namespace vk_demo
 			return;
 		}
 
-		if (it->second.dataSize != size) 
+		UpdateGlobalUniform(*it, dataPtr, size);
+	}
+
+	void DVKMaterial::SetGlobalUniform(int32 handle, void* dataPtr, uint32 size)
+	{
+		if (handle < 0 || handle >= uniformHandles.size()) 
+		{
+			MLOGE("Invalid uniform handle %d.", handle);
+			return;
+		}
+
+		UpdateGlobalUniform(*uniformHandles[handle], dataPtr, size);
+	}
+
+	void DVKMaterial::UpdateGlobalUniform(BuffersMap::value_type& uniform, void* dataPtr, uint32 size)
+	{
+		const std::string& name = uniform.first;
+		DVKSimulateBuffer& uboBuffer = uniform.second;
+
+		if (uboBuffer.dataSize != size) 
 		{
-			MLOGE("Uniform %s size not match, dst=%ud src=%ud", name.c_str(), it->second.dataSize, size);
+			MLOGE("Uniform %s size not match, dst=%ud src=%ud", name.c_str(), uboBuffer.dataSize, size);
 			return;
 		}
         
-		if (it->second.dataContent.size() != size) {
-			it->second.dataContent.resize(size);
+		if (uboBuffer.dataContent.size() != size) {
+			uboBuffer.dataContent.resize(size);
 		}
 
-		it->second.global = true;
-		memcpy(it->second.dataContent.data(), dataPtr, size);
+		uboBuffer.global = true;
+		memcpy(uboBuffer.dataContent.data(), dataPtr, size);
 	}
     
     void DVKMaterial::SetTexture(const std::string& name, DVKTexture* texture)
@@ -349,18 +666,34 @@ namespace vk_demo
             return;
         }
         
+        UpdateTexture(*it, texture);
+    }
+
+	void DVKMaterial::SetTexture(int32 handle, DVKTexture* texture)
+	{
+		if (handle < 0 || handle >= textureHandles.size()) 
+		{
+			MLOGE("Invalid texture handle %d.", handle);
+			return;
+		}
+
+		UpdateTexture(*textureHandles[handle], texture);
+	}
+
+	void DVKMaterial::UpdateTexture(TexturesMap::value_type& param, DVKTexture* texture)
+	{
 		if (texture == nullptr) 
 		{
-			MLOGE("Texture %s can't be null.", name.c_str());
+			MLOGE("Texture %s can't be null.", param.first.c_str());
 			return;
 		}
 
-        if (it->second.texture != texture) 
+        if (param.second.texture != texture) 
 		{
-            it->second.texture = texture;
-            descriptorSet->WriteImage(name, texture);
+            param.second.texture = texture;
+            descriptorSet->WriteImage(param.second.descriptorHandle, texture);
         }
-    }
+	}
     
 	void DVKMaterial::SetInputAttachment(const std::string& name, DVKTexture* texture)
 	{
@@ -376,19 +709,36 @@ namespace vk_demo
 			return;
 		}
 
+		UpdateStorageBuffer(*it, buffer);
+	}
+
+	void DVKMaterial::SetStorageBuffer(int32 handle, DVKBuffer* buffer)
+	{
+		if (handle < 0 || handle >= storageHandles.size()) 
+		{
+			MLOGE("Invalid storage buffer handle %d.", handle);
+			return;
+		}
+
+		UpdateStorageBuffer(*storageHandles[handle], buffer);
+	}
+
+	void DVKMaterial::UpdateStorageBuffer(BuffersMap::value_type& param, DVKBuffer* buffer)
+	{
 		if (buffer == nullptr) 
 		{
-			MLOGE("StorageBuffer %s can't be null.", name.c_str());
+			MLOGE("StorageBuffer %s can't be null.", param.first.c_str());
 			return;
 		}
 
-		if (it->second.bufferInfo.buffer != buffer->buffer) 
+		DVKSimulateBuffer& storageBuffer = param.second;
+		if (storageBuffer.bufferInfo.buffer != buffer->buffer) 
 		{
-			it->second.dataSize          = buffer->size;
-			it->second.bufferInfo.buffer = buffer->buffer;
-			it->second.bufferInfo.offset = 0;
-			it->second.bufferInfo.range  = buffer->size;
-			descriptorSet->WriteBuffer(name, buffer);
+			storageBuffer.dataSize          = buffer->size;
+			storageBuffer.bufferInfo.buffer = buffer->buffer;
+			storageBuffer.bufferInfo.offset = 0;
+			storageBuffer.bufferInfo.range  = buffer->size;
+			descriptorSet->WriteBuffer(storageBuffer.descriptorHandle, buffer);
 		}
 	}
 
@@ -4,6 +4,8 @@
 #include <cstring>
 #include <memory>
 #include <unordered_map>
+#include <deque>
+#include <vector>
 
 #include "DVKUtils.h"
 #include "DVKBuffer.h"
@@ -31,6 +33,7 @@ namespace vk_demo
         VkDescriptorType		descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         VkShaderStageFlags		stageFlags = 0;
 		VkDescriptorBufferInfo	bufferInfo;
+		int32					descriptorHandle = -1;
 	};
     
     struct DVKSimulateTexture
@@ -40,41 +43,58 @@ namespace vk_demo
         VkDescriptorType    descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
         VkShaderStageFlags  stageFlags = 0;
         DVKTexture*         texture = nullptr;
+        int32               descriptorHandle = -1;
     };
     
+	// 按提交分段的RingBuffer，每段分配在提交时和读取它的那次提交的fence绑定，
+	// 空间不够时只等待最老的一段完成，不会覆盖GPU还在读取的数据。
 	class DVKRingBuffer
 	{
-	public:
-		DVKRingBuffer()
+	private:
+		struct FrameSegment
 		{
+			uint64		size = 0;
+			VkFence		fence = VK_NULL_HANDLE;
+		};
 
-		}
+	public:
+		DVKRingBuffer();
 
-		virtual ~DVKRingBuffer()
-		{
-			realBuffer->UnMap();
-			delete realBuffer;
-			realBuffer = nullptr;
-		}
+		virtual ~DVKRingBuffer();
 
 		void* GetMappedPointer()
 		{
 			return realBuffer->mapped;
 		}
 
-		uint64 AllocateMemory(uint64 size)
+		uint64 AllocateMemory(uint64 size);
+
+		// 当前帧的分配已经随fence提交。fence被复用时之前使用它的提交一定已经完成
+		void SubmitFrame(VkFence fence);
+
+		inline uint64 GetHighWaterMark() const
 		{
-			uint64 allocationOffset = Align<uint64>(bufferOffset, minAlignment);
-            
-			if (allocationOffset + size <= bufferSize) 
-			{
-				bufferOffset = allocationOffset + size;
-				return allocationOffset;
-			}
+			return highWaterMark;
+		}
 
-			bufferOffset = 0;
-			return bufferOffset;
+		inline uint64 GetFrameHighWaterMark() const
+		{
+			return frameHighWaterMark;
+		}
+
+		inline int32 GetStallCount() const
+		{
+			return stallCount;
 		}
+
+		// 通知所有RingBuffer当前帧已提交，由DemoBase::Present调用，还没有提交的分配都由这一帧读取
+		static void SubmitFrameAll(VkFence fence);
+
+		// 通知消费队列为queue的RingBuffer，当前的分配已经随该队列的这次提交提交，由DVKCommandBuffer::Submit调用
+		static void SubmitQueueAll(VkQueue queue, VkFence fence);
+
+	private:
+		bool RetireSegments(bool wait);
         
 	public:
 		VkDevice		device = VK_NULL_HANDLE;
@@ -82,6 +102,19 @@ namespace vk_demo
 		uint64			bufferOffset = 0;
 		uint32			minAlignment = 0;
 		DVKBuffer*		realBuffer = nullptr;
+		// 读取数据的队列，为VK_NULL_HANDLE时只由DemoBase::Present的提交绑定
+		VkQueue			queue = VK_NULL_HANDLE;
+
+	private:
+		std::deque<FrameSegment>	segments;
+		uint64						usedSize = 0;
+		uint64						frameSize = 0;
+		uint64						highWaterMark = 0;
+		uint64						frameHighWaterMark = 0;
+		int32						stallCount = 0;
+		bool						overflowed = false;
+
+		static std::vector<DVKRingBuffer*>	ringBuffers;
 	};
     
 	class DVKMaterial
@@ -91,6 +124,8 @@ namespace vk_demo
 		typedef std::unordered_map<std::string, DVKSimulateBuffer>		BuffersMap;
 		typedef std::unordered_map<std::string, DVKSimulateTexture>		TexturesMap;
 		typedef std::shared_ptr<VulkanDevice>							VulkanDeviceRef;
+		typedef std::vector<BuffersMap::value_type*>					BufferHandles;
+		typedef std::vector<TexturesMap::value_type*>					TextureHandles;
 
 		DVKMaterial()
 		{
@@ -106,6 +141,19 @@ namespace vk_demo
 
         void PreparePipeline();
 
+		// 把pipeline加入待创建列表，由BuildPendingPipelines在多个线程上统一创建
+		void RequestPipeline();
+
+		inline bool IsPipelinePending() const
+		{
+			return pipeline == nullptr || !pipeline->IsReady();
+		}
+
+		// 创建所有RequestPipeline请求的pipeline，wait为false时在后台线程创建，之后需要调用WaitPendingPipelines
+		static void BuildPendingPipelines(bool wait = true);
+
+		static void WaitPendingPipelines();
+
 		void BeginObject();
 
 		void EndObject();
@@ -126,11 +174,36 @@ namespace vk_demo
 
 		void SetInputAttachment(const std::string& name, DVKTexture* texture);
 
+		// 名字只在这里查找一次，返回的handle在材质的生命周期内有效，找不到时返回-1
+		int32 GetUniformHandle(const std::string& name) const;
+
+		int32 GetTextureHandle(const std::string& name) const;
+
+		int32 GetStorageBufferHandle(const std::string& name) const;
+
+		void SetLocalUniform(int32 handle, void* dataPtr, uint32 size);
+
+		void SetGlobalUniform(int32 handle, void* dataPtr, uint32 size);
+
+		void SetTexture(int32 handle, DVKTexture* texture);
+
+		void SetStorageBuffer(int32 handle, DVKBuffer* buffer);
+
+		// BeginUpdate和EndUpdate之间的SetTexture/SetStorageBuffer合并为一次vkUpdateDescriptorSets
+		void BeginUpdate();
+
+		void EndUpdate();
+
+		// pipeline还在等待创建时先创建完成，不会返回VK_NULL_HANDLE
 		inline VkPipeline GetPipeline() const
 		{
+			if (pipeline && !pipeline->IsReady()) {
+				BuildPendingPipelines();
+			}
 			return pipeline->pipeline;
 		}
 
+		// layout来自shader，RequestPipeline时就已经有效，不需要等待创建
 		inline VkPipelineLayout GetPipelineLayout() const
 		{
 			return pipeline->pipelineLayout;
@@ -148,11 +221,22 @@ namespace vk_demo
 
 		void Prepare();
 
+		void UpdateLocalUniform(BuffersMap::value_type& uniform, void* dataPtr, uint32 size);
+
+		void UpdateGlobalUniform(BuffersMap::value_type& uniform, void* dataPtr, uint32 size);
+
+		void UpdateTexture(TexturesMap::value_type& param, DVKTexture* texture);
+
+		void UpdateStorageBuffer(BuffersMap::value_type& param, DVKBuffer* buffer);
+
 	private:
 
 		static DVKRingBuffer*	ringBuffer;
 		static int32			ringBufferRefCount;
 
+		static DVKGfxPipelineBatch*					pendingPipelines;
+		static std::vector<DVKGfxPipelineBatch*>	buildingPipelines;
+
 	public:
 
 		VulkanDeviceRef			vulkanDevice = nullptr;
@@ -174,6 +258,10 @@ namespace vk_demo
 		BuffersMap				storageBuffers;
 		TexturesMap				textures;
 
+		BufferHandles			uniformHandles;
+		BufferHandles			storageHandles;
+		TextureHandles			textureHandles;
+
 		bool                    actived = false;
 	};
 
@@ -0,0 +1,421 @@
+﻿#include "DVKMeshCache.h"
+#include "DVKModel.h"
+#include "FileManager.h"
+
+#include "Utils/Crc.h"
+#include "Utils/BinaryStream.h"
+
+namespace vk_demo
+{
+
+	template<typename T>
+	static void WriteChannel(BinaryWriter& writer, const DVKAnimChannel<T>& channel)
+	{
+		writer.WriteArray(channel.keys);
+		writer.WriteArray(channel.values);
+	}
+
+	template<typename T>
+	static bool ReadChannel(BinaryReader& reader, DVKAnimChannel<T>& channel)
+	{
+		return reader.ReadArray(channel.keys) && reader.ReadArray(channel.values) && channel.keys.size() == channel.values.size();
+	}
+
+	std::string DVKMeshCache::GetCacheName(const std::string& filename, const std::vector<VertexAttribute>& attributes, const DVKModelLoadOptions& options)
+	{
+		// 缓存目录不保留层级，路径分隔符替换掉
+		std::string name = filename;
+		for (int32 i = 0; i < name.size(); ++i)
+		{
+			if (name[i] == '/' || name[i] == '\\' || name[i] == ':') {
+				name[i] = '_';
+			}
+		}
+
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%08x.meshcache", HashLayout(attributes, options));
+
+		return name + suffix;
+	}
+
+	uint32 DVKMeshCache::HashLayout(const std::vector<VertexAttribute>& attributes, const DVKModelLoadOptions& options)
+	{
+		// packGeometry只影响Buffer的创建方式，不影响缓存的数据
+		std::vector<int32> layout;
+		for (int32 i = 0; i < attributes.size(); ++i) {
+			layout.push_back((int32)attributes[i]);
+		}
+		layout.push_back(options.index32 ? 1 : 0);
+
+		return Crc::MemCrc32(layout.data(), (int32)(layout.size() * sizeof(int32)));
+	}
+
+	bool DVKMeshCache::Save(const DVKModel* model, const std::string& cacheName, uint64 sourceHash)
+	{
+		// 数组相对于数据起始位置对齐，映射的起始地址按页对齐，header的大小也需要满足对齐
+		static_assert(sizeof(FileHeader) % BINARY_ARRAY_ALIGNMENT == 0, "FileHeader breaks array alignment.");
+
+		BinaryWriter writer;
+		FileHeader header = {};
+		writer.Write(header);
+
+		writer.WriteArray(model->attributes);
+
+		// nodes，linearNodes中父节点总是在子节点之前
+		writer.Write((uint32)model->linearNodes.size());
+		for (int32 i = 0; i < model->linearNodes.size(); ++i)
+		{
+			const DVKNode* node = model->linearNodes[i];
+			writer.WriteString(node->name);
+			writer.Write((int32)(node->parent ? node->parent->index : -1));
+			writer.Write(node->localMatrix.m, sizeof(node->localMatrix.m));
+		}
+
+		// bones
+		writer.Write((uint32)model->bones.size());
+		for (int32 i = 0; i < model->bones.size(); ++i)
+		{
+			const DVKBone* bone = model->bones[i];
+			writer.WriteString(bone->name);
+			writer.Write(bone->parent);
+			writer.Write(bone->inverseBindPose.m, sizeof(bone->inverseBindPose.m));
+		}
+
+		// meshes
+		writer.Write((uint32)model->meshes.size());
+		for (int32 i = 0; i < model->meshes.size(); ++i)
+		{
+			const DVKMesh* mesh = model->meshes[i];
+			writer.Write((int32)mesh->linkNode->index);
+			writer.WriteString(mesh->material.diffuse);
+			writer.WriteString(mesh->material.normalmap);
+			writer.WriteString(mesh->material.specular);
+			writer.Write((uint32)(mesh->isSkin ? 1 : 0));
+			writer.WriteArray(mesh->bones);
+			writer.Write(mesh->bounding.min);
+			writer.Write(mesh->bounding.max);
+
+			writer.Write((uint32)mesh->primitives.size());
+			for (int32 j = 0; j < mesh->primitives.size(); ++j)
+			{
+				const DVKPrimitive* primitive = mesh->primitives[j];
+				writer.Write(primitive->vertexCount);
+				writer.WriteArray(primitive->vertices);
+				writer.WriteArray(primitive->indices);
+				writer.WriteArray(primitive->indices32);
+			}
+		}
+
+		// animations
+		writer.Write((uint32)model->animations.size());
+		for (int32 i = 0; i < model->animations.size(); ++i)
+		{
+			const DVKAnimation& animation = model->animations[i];
+			writer.WriteString(animation.name);
+			writer.Write(animation.duration);
+			writer.Write((uint32)animation.clips.size());
+
+			for (auto it = animation.clips.begin(); it != animation.clips.end(); ++it)
+			{
+				const DVKAnimationClip& clip = it->second;
+				writer.WriteString(clip.nodeName);
+				writer.Write(clip.duration);
+				WriteChannel(writer, clip.positions);
+				WriteChannel(writer, clip.scales);
+				WriteChannel(writer, clip.rotations);
+			}
+		}
+
+		header.magic      = FILE_MAGIC;
+		header.version    = FILE_VERSION;
+		header.sourceHash = sourceHash;
+		header.layoutHash = HashLayout(model->attributes, model->loadOptions);
+		header.dataSize   = (uint32)(writer.data.size() - sizeof(FileHeader));
+		header.dataCrc    = Crc::MemCrc32(writer.data.data() + sizeof(FileHeader), header.dataSize);
+		memcpy(writer.data.data(), &header, sizeof(FileHeader));
+
+		if (!FileManager::WriteCacheFile(cacheName, writer.data.data(), (uint32)writer.data.size())) {
+			return false;
+		}
+
+		MLOG("Mesh cache %s saved, %d meshes.", cacheName.c_str(), (int32)model->meshes.size());
+
+		return true;
+	}
+
+	bool DVKMeshCache::Load(DVKModel* model, const std::string& cacheName, uint64 sourceHash)
+	{
+		const uint8* dataPtr = nullptr;
+		uint32 dataSize = 0;
+		if (!FileManager::MapCacheFile(cacheName, dataPtr, dataSize)) {
+			return false;
+		}
+
+		FileHeader header;
+		const char* error = nullptr;
+
+		if (dataSize < sizeof(FileHeader)) {
+			error = "file too small";
+		}
+		else
+		{
+			memcpy(&header, dataPtr, sizeof(FileHeader));
+			if (header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+				error = "unknown format";
+			}
+			else if (header.dataSize != dataSize - sizeof(FileHeader)) {
+				error = "size mismatch";
+			}
+			else if (header.sourceHash != sourceHash) {
+				error = "source changed";
+			}
+			else if (header.layoutHash != HashLayout(model->attributes, model->loadOptions)) {
+				error = "layout changed";
+			}
+			// 长度正确但内容损坏的文件在解析前就拒绝
+			else if (Crc::MemCrc32(dataPtr + sizeof(FileHeader), header.dataSize) != header.dataCrc) {
+				error = "crc mismatch";
+			}
+		}
+
+		BinaryReader reader;
+		reader.data   = dataPtr + sizeof(FileHeader);
+		reader.size   = error ? 0 : header.dataSize;
+		reader.offset = 0;
+
+		std::vector<VertexAttribute> attributes;
+		if (!error && (!reader.ReadArray(attributes) || attributes != model->attributes)) {
+			error = "layout changed";
+		}
+
+		// 先解析到临时数据中，全部成功之后才交给model
+		std::vector<DVKNode*>	linearNodes;
+		std::vector<DVKMesh*>	meshes;
+		std::vector<DVKBone*>	bones;
+		std::vector<DVKAnimation> animations;
+
+		struct PrimitiveData
+		{
+			DVKPrimitive*	primitive;
+			const float*	vertices;
+			const void*		indices;
+		};
+		std::vector<PrimitiveData> primitiveDatas;
+
+		// nodes
+		uint32 numNodes = 0;
+		if (!error && (!reader.Read(numNodes) || numNodes == 0)) {
+			error = "truncated";
+		}
+
+		for (uint32 i = 0; error == nullptr && i < numNodes; ++i)
+		{
+			DVKNode* node = new DVKNode();
+			int32 parent  = -1;
+
+			if (!reader.ReadString(node->name) || !reader.Read(parent) || !reader.Read(node->localMatrix.m, sizeof(node->localMatrix.m)) || parent >= (int32)i || (i > 0 && parent < 0))
+			{
+				delete node;
+				error = "bad node";
+				break;
+			}
+
+			node->index = i;
+			if (parent >= 0) {
+				node->parent = linearNodes[parent];
+				node->parent->children.push_back(node);
+			}
+			linearNodes.push_back(node);
+		}
+
+		// bones
+		uint32 numBones = 0;
+		if (!error && !reader.Read(numBones)) {
+			error = "truncated";
+		}
+
+		for (uint32 i = 0; error == nullptr && i < numBones; ++i)
+		{
+			DVKBone* bone = new DVKBone();
+			bone->index = i;
+			bones.push_back(bone);
+
+			if (!reader.ReadString(bone->name) || !reader.Read(bone->parent) || !reader.Read(bone->inverseBindPose.m, sizeof(bone->inverseBindPose.m))) {
+				error = "truncated";
+			}
+			else if (bone->parent < -1 || bone->parent >= (int32)numBones) {
+				error = "bad bone";
+			}
+		}
+
+		// meshes
+		uint32 numMeshes = 0;
+		if (!error && !reader.Read(numMeshes)) {
+			error = "truncated";
+		}
+
+		for (uint32 i = 0; error == nullptr && i < numMeshes; ++i)
+		{
+			DVKMesh* mesh = new DVKMesh();
+			int32 nodeIndex = -1;
+			uint32 isSkin = 0;
+			uint32 numPrimitives = 0;
+
+			if (!reader.Read(nodeIndex) || nodeIndex < 0 || nodeIndex >= (int32)linearNodes.size() ||
+				!reader.ReadString(mesh->material.diffuse) || !reader.ReadString(mesh->material.normalmap) || !reader.ReadString(mesh->material.specular) ||
+				!reader.Read(isSkin) || !reader.ReadArray(mesh->bones) || !reader.Read(mesh->bounding.min) || !reader.Read(mesh->bounding.max) ||
+				!reader.Read(numPrimitives))
+			{
+				delete mesh;
+				error = "bad mesh";
+				break;
+			}
+
+			for (int32 j = 0; j < mesh->bones.size(); ++j)
+			{
+				if (mesh->bones[j] < 0 || mesh->bones[j] >= (int32)bones.size()) {
+					error = "bad mesh";
+				}
+			}
+
+			if (error)
+			{
+				delete mesh;
+				break;
+			}
+
+			// 挂到node上之后由node负责释放
+			mesh->isSkin   = isSkin != 0;
+			mesh->linkNode = linearNodes[nodeIndex];
+			mesh->linkNode->meshes.push_back(mesh);
+			meshes.push_back(mesh);
+			mesh->bounding.UpdateCorners();
+
+			for (uint32 j = 0; error == nullptr && j < numPrimitives; ++j)
+			{
+				DVKPrimitive* primitive = new DVKPrimitive();
+				mesh->primitives.push_back(primitive);
+
+				uint32 numFloats = 0;
+				uint32 numIndices16 = 0;
+				uint32 numIndices32 = 0;
+				const uint16* indices16 = nullptr;
+				const uint32* indices32 = nullptr;
+				PrimitiveData primitiveData = { primitive, nullptr, nullptr };
+
+				if (!reader.Read(primitive->vertexCount) || !reader.SkipArray(primitiveData.vertices, numFloats) || !reader.SkipArray(indices16, numIndices16) || !reader.SkipArray(indices32, numIndices32)) {
+					error = "truncated";
+					break;
+				}
+
+				primitive->vertices.assign(primitiveData.vertices, primitiveData.vertices + numFloats);
+				if (model->loadOptions.index32)
+				{
+					primitive->indices32.resize(numIndices32);
+					memcpy(primitive->indices32.data(), indices32, numIndices32 * sizeof(uint32));
+					primitiveData.indices = indices32;
+				}
+				else
+				{
+					primitive->indices.resize(numIndices16);
+					memcpy(primitive->indices.data(), indices16, numIndices16 * sizeof(uint16));
+					primitiveData.indices = indices16;
+				}
+
+				primitive->indexCount  = model->loadOptions.index32 ? numIndices32 : numIndices16;
+				primitive->triangleNum = primitive->indexCount / 3;
+
+				mesh->vertexCount   += primitive->vertexCount;
+				mesh->triangleCount += primitive->triangleNum;
+
+				primitiveDatas.push_back(primitiveData);
+			}
+		}
+
+		// animations
+		uint32 numAnimations = 0;
+		if (!error && !reader.Read(numAnimations)) {
+			error = "truncated";
+		}
+
+		for (uint32 i = 0; error == nullptr && i < numAnimations; ++i)
+		{
+			animations.push_back(DVKAnimation());
+			DVKAnimation& animation = animations.back();
+			uint32 numClips = 0;
+
+			if (!reader.ReadString(animation.name) || !reader.Read(animation.duration) || !reader.Read(numClips)) {
+				error = "truncated";
+				break;
+			}
+
+			for (uint32 j = 0; j < numClips; ++j)
+			{
+				DVKAnimationClip clip;
+				if (!reader.ReadString(clip.nodeName) || !reader.Read(clip.duration) || !ReadChannel(reader, clip.positions) || !ReadChannel(reader, clip.scales) || !ReadChannel(reader, clip.rotations)) {
+					error = "truncated";
+					break;
+				}
+				animation.clips.insert(std::make_pair(clip.nodeName, clip));
+			}
+		}
+
+		if (!error && reader.offset != reader.size) {
+			error = "size mismatch";
+		}
+
+		if (error)
+		{
+			// root会释放所有子节点以及挂在上面的mesh
+			if (linearNodes.size() > 0) {
+				delete linearNodes[0];
+			}
+			for (int32 i = 0; i < bones.size(); ++i) {
+				delete bones[i];
+			}
+			FileManager::UnmapCacheFile(dataPtr, dataSize);
+
+			MLOG("Mesh cache %s rejected: %s", cacheName.c_str(), error);
+			return false;
+		}
+
+		model->rootNode    = linearNodes[0];
+		model->linearNodes = linearNodes;
+		model->meshes      = meshes;
+		model->bones       = bones;
+		model->animations.swap(animations);
+
+		for (int32 i = 0; i < linearNodes.size(); ++i) {
+			model->nodesMap.insert(std::make_pair(linearNodes[i]->name, linearNodes[i]));
+		}
+
+		for (int32 i = 0; i < bones.size(); ++i) {
+			model->bonesMap.insert(std::make_pair(bones[i]->name, bones[i]));
+		}
+
+		// 顶点和索引直接从映射的内存上传，packGeometry模式下Buffer由PackGeometry统一创建
+		if (model->uploader && !model->loadOptions.packGeometry)
+		{
+			for (int32 i = 0; i < primitiveDatas.size(); ++i)
+			{
+				const PrimitiveData& primitiveData = primitiveDatas[i];
+				DVKPrimitive* primitive = primitiveData.primitive;
+
+				primitive->vertexBuffer = DVKVertexBuffer::Create(model->device, model->uploader, primitiveData.vertices, (int32)primitive->vertices.size(), model->attributes);
+				if (model->loadOptions.index32) {
+					primitive->indexBuffer = DVKIndexBuffer::Create(model->device, model->uploader, (const uint32*)primitiveData.indices, primitive->indexCount);
+				}
+				else {
+					primitive->indexBuffer = DVKIndexBuffer::Create(model->device, model->uploader, (const uint16*)primitiveData.indices, primitive->indexCount);
+				}
+			}
+		}
+
+		FileManager::UnmapCacheFile(dataPtr, dataSize);
+
+		MLOG("Mesh cache %s loaded, %d meshes.", cacheName.c_str(), (int32)meshes.size());
+
+		return true;
+	}
+
+};
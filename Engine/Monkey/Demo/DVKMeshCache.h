@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include "Common/Common.h"
+#include "Vulkan/VulkanCommon.h"
+
+#include <string>
+#include <vector>
+
+namespace vk_demo
+{
+	class DVKModel;
+	struct DVKModelLoadOptions;
+
+	// DVKModel::LoadFromFile的二进制缓存。
+	// 保存已经按VertexAttribute交错好的顶点、拆分好的索引、节点层级、骨骼以及动画数据，
+	// 加载时直接映射缓存文件，顶点和索引从映射的内存上传，不再经过Assimp。
+	// 源文件内容的hash或者顶点布局变化时缓存失效，重新导入后覆盖。
+	class DVKMeshCache
+	{
+	private:
+		enum
+		{
+			FILE_MAGIC   = 0x434D5644, // DVMC
+			FILE_VERSION = 3,
+		};
+
+		struct FileHeader
+		{
+			uint32	magic;
+			uint32	version;
+			uint64	sourceHash;
+			uint32	layoutHash;
+			uint32	dataSize;
+			uint32	dataCrc;
+		};
+
+	public:
+		// 缓存文件名由源文件路径和顶点布局组成，位于缓存目录
+		static std::string GetCacheName(const std::string& filename, const std::vector<VertexAttribute>& attributes, const DVKModelLoadOptions& options);
+
+		// 成功时填充model并通过model的uploader创建Buffer，失败时model不会被修改
+		static bool Load(DVKModel* model, const std::string& cacheName, uint64 sourceHash);
+
+		static bool Save(const DVKModel* model, const std::string& cacheName, uint64 sourceHash);
+
+	private:
+		static uint32 HashLayout(const std::vector<VertexAttribute>& attributes, const DVKModelLoadOptions& options);
+	};
+
+};
@@ -1,7 +1,10 @@
 ﻿#include "DVKModel.h"
 
+#include "DVKMeshCache.h"
 #include "FileManager.h"
 #include "Math/Matrix4x4.h"
+#include "Core/Profiler.h"
+#include "Utils/BinaryStream.h"
 
 #include <assimp/Importer.hpp> 
 #include <assimp/scene.h>     
@@ -76,7 +79,6 @@ namespace vk_demo
         DVKModel* model   = new DVKModel();
         model->device     = vulkanDevice;
         model->attributes = attributes;
-        model->cmdBuffer  = cmdBuffer;
         
 		int32 stride = 0;
 		for (int32 i = 0; i < attributes.size(); ++i) {
@@ -115,12 +117,12 @@ namespace vk_demo
         return model;
     }
 
-	DVKModel* DVKModel::LoadFromFile(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, const std::vector<VertexAttribute>& attributes)
+	DVKModel* DVKModel::LoadFromFile(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, const std::vector<VertexAttribute>& attributes, const DVKModelLoadOptions& options)
     {
         DVKModel* model   = new DVKModel();
         model->device     = vulkanDevice;
 		model->attributes = attributes;
-		model->cmdBuffer  = cmdBuffer;
+		model->loadOptions = options;
         
         int assimpFlags = aiProcess_Triangulate | aiProcess_FlipUVs;
 		
@@ -151,12 +153,49 @@ namespace vk_demo
             return model;
         }
         
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFileFromMemory(dataPtr, dataSize, assimpFlags);
-        
-		model->LoadBones(scene);
-		model->LoadNode(scene->mRootNode, scene);
-        model->LoadAnim(scene);
+		// 所有Primitive的数据合并到少量批次里上传，只在最后等待一次
+		if (cmdBuffer) {
+			model->uploader = DVKUploadContext::Create(vulkanDevice);
+		}
+
+		std::string cacheName;
+		uint64 sourceHash = 0;
+		bool cached = false;
+		if (options.useCache)
+		{
+			cacheName  = DVKMeshCache::GetCacheName(filename, attributes, options);
+			sourceHash = HashFileContent(dataPtr, dataSize);
+			cached     = DVKMeshCache::Load(model, cacheName, sourceHash);
+		}
+
+		if (cached) {
+			model->CompileSkeleton();
+		}
+		else
+		{
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFileFromMemory(dataPtr, dataSize, assimpFlags);
+
+			model->LoadBones(scene);
+			model->LoadNode(scene->mRootNode, scene);
+			model->LoadAnim(scene);
+			model->CompileSkeleton();
+
+			if (options.useCache) {
+				DVKMeshCache::Save(model, cacheName, sourceHash);
+			}
+		}
+
+		if (options.packGeometry) {
+			model->PackGeometry();
+		}
+
+		if (model->uploader)
+		{
+			model->uploader->WaitAll();
+			delete model->uploader;
+			model->uploader = nullptr;
+		}
 
 		delete[] dataPtr;
         
@@ -429,7 +468,10 @@ namespace vk_demo
     {
         int32 stride = vertices.size() / aiMesh->mNumVertices;
 
-        if (indices.size() > 65535)
+		// packGeometry模式下Buffer在所有mesh加载完之后统一创建
+		bool createBuffers = uploader && !loadOptions.packGeometry;
+
+        if (indices.size() > 65535 && !loadOptions.index32)
         {
             std::unordered_map<uint32, uint32> indicesMap;
             DVKPrimitive* primitive = nullptr;
@@ -464,13 +506,13 @@ namespace vk_demo
                 }
             }
             
-            if (cmdBuffer)
+            if (createBuffers)
             {
                 for (int32 i = 0; i < mesh->primitives.size(); ++i)
                 {
                     primitive = mesh->primitives[i];
-                    primitive->vertexBuffer = DVKVertexBuffer::Create(device, cmdBuffer, primitive->vertices, attributes);
-                    primitive->indexBuffer  = DVKIndexBuffer::Create(device, cmdBuffer, primitive->indices);
+                    primitive->vertexBuffer = DVKVertexBuffer::Create(device, uploader, primitive->vertices, attributes);
+                    primitive->indexBuffer  = DVKIndexBuffer::Create(device, uploader, primitive->indices);
                 }
             }
         }
@@ -478,15 +520,23 @@ namespace vk_demo
         {
             DVKPrimitive* primitive = new DVKPrimitive();
             primitive->vertices = vertices;
-            for (uint16 i = 0; i < indices.size(); ++i) {
-                primitive->indices.push_back(indices[i]);
+            if (loadOptions.index32) {
+                primitive->indices32 = indices;
+            }
+            else {
+                primitive->indices.assign(indices.begin(), indices.end());
             }
             mesh->primitives.push_back(primitive);
             
-            if (cmdBuffer)
+            if (createBuffers)
             {
-                primitive->vertexBuffer = DVKVertexBuffer::Create(device, cmdBuffer, primitive->vertices, attributes);
-                primitive->indexBuffer  = DVKIndexBuffer::Create(device, cmdBuffer, primitive->indices);
+                primitive->vertexBuffer = DVKVertexBuffer::Create(device, uploader, primitive->vertices, attributes);
+                if (loadOptions.index32) {
+                    primitive->indexBuffer = DVKIndexBuffer::Create(device, uploader, primitive->indices32);
+                }
+                else {
+                    primitive->indexBuffer = DVKIndexBuffer::Create(device, uploader, primitive->indices);
+                }
             }
         }
         
@@ -494,7 +544,8 @@ namespace vk_demo
         {
             DVKPrimitive* primitive = mesh->primitives[i];
             primitive->vertexCount  = primitive->vertices.size() / stride;
-            primitive->triangleNum  = primitive->indices.size() / 3;
+            primitive->indexCount   = loadOptions.index32 ? primitive->indices32.size() : primitive->indices.size();
+            primitive->triangleNum  = primitive->indexCount / 3;
             
             mesh->vertexCount   += primitive->vertexCount;
             mesh->triangleCount += primitive->triangleNum;
@@ -540,7 +591,8 @@ namespace vk_demo
     DVKNode* DVKModel::LoadNode(const aiNode* aiNode, const aiScene* aiScene)
     {
 		DVKNode* vkNode = new DVKNode();
-		vkNode->name = aiNode->mName.C_Str();
+		vkNode->name  = aiNode->mName.C_Str();
+		vkNode->index = linearNodes.size();
 
 		if (rootNode == nullptr) {
 			rootNode = vkNode;
@@ -645,6 +697,47 @@ namespace vk_demo
         }
     }
 
+	void DVKModel::CompileSkeleton()
+	{
+		nodeParents.resize(linearNodes.size());
+		for (int32 i = 0; i < linearNodes.size(); ++i) {
+			nodeParents[i] = linearNodes[i]->parent ? linearNodes[i]->parent->index : -1;
+		}
+
+		posePositions.resize(linearNodes.size(), Vector3(0, 0, 0));
+		poseRotations.resize(linearNodes.size(), Quat(0, 0, 0, 1));
+		poseScales.resize(linearNodes.size(), Vector3(1, 1, 1));
+		poseAnimated.resize(linearNodes.size(), 0);
+
+		// 加载时把bone和动画clip绑定到node索引，运行时不再通过名称查找
+		for (int32 i = 0; i < bones.size(); ++i)
+		{
+			auto it = nodesMap.find(bones[i]->name);
+			bones[i]->nodeIndex = it != nodesMap.end() ? it->second->index : -1;
+		}
+
+		for (int32 i = 0; i < animations.size(); ++i)
+		{
+			for (auto it = animations[i].clips.begin(); it != animations[i].clips.end(); ++it)
+			{
+				auto nodeIt = nodesMap.find(it->second.nodeName);
+				it->second.nodeIndex = nodeIt != nodesMap.end() ? nodeIt->second->index : -1;
+			}
+		}
+	}
+
+	void DVKModel::UpdateGlobalMatrices()
+	{
+		for (int32 i = 0; i < linearNodes.size(); ++i)
+		{
+			DVKNode* node = linearNodes[i];
+			node->globalMatrix = node->localMatrix;
+			if (nodeParents[i] != -1) {
+				node->globalMatrix.Append(linearNodes[nodeParents[i]]->globalMatrix);
+			}
+		}
+	}
+
 	void DVKModel::GotoAnimation(float time)
 	{
 		if (animIndex == -1) {
@@ -653,12 +746,17 @@ namespace vk_demo
         
 		DVKAnimation& animation = animations[animIndex];
         animation.time = MMath::Clamp(time, 0.0f, animation.duration);
+
+		std::fill(poseAnimated.begin(), poseAnimated.end(), 0);
         
-		// update nodes animation
+		// 采样动画数据
 		for (auto it = animation.clips.begin(); it != animation.clips.end(); ++it)
 		{
 			vk_demo::DVKAnimationClip& clip = it->second;
-			vk_demo::DVKNode* node = nodesMap[clip.nodeName];
+			int32 nodeIndex = clip.nodeIndex;
+			if (nodeIndex == -1) {
+				continue;
+			}
             
 			float alpha = 0.0f;
             
@@ -666,39 +764,55 @@ namespace vk_demo
 			Quat prevRot(0, 0, 0, 1);
 			Quat nextRot(0, 0, 0, 1);
 			clip.rotations.GetValue(animation.time, prevRot, nextRot, alpha);
-			Quat retRot = MMath::Lerp(prevRot, nextRot, alpha);
+			poseRotations[nodeIndex] = MMath::Lerp(prevRot, nextRot, alpha);
             
 			// position
 			Vector3 prevPos(0, 0, 0);
 			Vector3 nextPos(0, 0, 0);
 			clip.positions.GetValue(animation.time, prevPos, nextPos, alpha);
-			Vector3 retPos = MMath::Lerp(prevPos, nextPos, alpha);
+			posePositions[nodeIndex] = MMath::Lerp(prevPos, nextPos, alpha);
             
 			// scale
 			Vector3 prevScale(1, 1, 1);
 			Vector3 nextScale(1, 1, 1);
 			clip.scales.GetValue(animation.time, prevScale, nextScale, alpha);
-			Vector3 retScale = MMath::Lerp(prevScale, nextScale, alpha);
-            
+			poseScales[nodeIndex] = MMath::Lerp(prevScale, nextScale, alpha);
+
+			poseAnimated[nodeIndex] = 1;
+		}
+
+		// 更新local矩阵
+		for (int32 i = 0; i < linearNodes.size(); ++i)
+		{
+			if (!poseAnimated[i]) {
+				continue;
+			}
+			DVKNode* node = linearNodes[i];
 			node->localMatrix.SetIdentity();
-			node->localMatrix.AppendScale(retScale);
-			node->localMatrix.Append(retRot.ToMatrix());
-			node->localMatrix.AppendTranslation(retPos);
+			node->localMatrix.AppendScale(poseScales[i]);
+			node->localMatrix.Append(poseRotations[i].ToMatrix());
+			node->localMatrix.AppendTranslation(posePositions[i]);
 		}
 
+		UpdateGlobalMatrices();
+
 		// update bones
 		for (int32 i = 0; i < bones.size(); ++i)
 		{
 			DVKBone* bone = bones[i];
-			DVKNode* node = nodesMap[bone->name];
+			if (bone->nodeIndex == -1) {
+				continue;
+			}
 			// 注意行列矩阵的区别
 			bone->finalTransform = bone->inverseBindPose;
-			bone->finalTransform.Append(node->GetGlobalMatrix());
+			bone->finalTransform.Append(linearNodes[bone->nodeIndex]->globalMatrix);
 		}
 	}
     
 	void DVKModel::Update(float time, float delta)
 	{
+		PROFILE_FUNCTION();
+
 		if (animIndex == -1) {
 			return;
 		}
@@ -713,6 +827,20 @@ namespace vk_demo
 		GotoAnimation(animation.time);
 	}
 
+	void DVKModel::BakeAnimations(float sampleRate)
+	{
+		for (int32 i = 0; i < animations.size(); ++i)
+		{
+			for (auto it = animations[i].clips.begin(); it != animations[i].clips.end(); ++it)
+			{
+				DVKAnimationClip& clip = it->second;
+				clip.positions.Bake(sampleRate);
+				clip.scales.Bake(sampleRate);
+				clip.rotations.Bake(sampleRate);
+			}
+		}
+	}
+
 	void DVKModel::SetAnimation(int32 index)
 	{
 		if (index >= animations.size()) {
@@ -732,6 +860,117 @@ namespace vk_demo
 		return animations[index];
 	}
 
+	void DVKModel::PackGeometry()
+	{
+		std::vector<float>  vertices;
+		std::vector<uint16> indices;
+		std::vector<uint32> indices32;
+
+		int32 numVertices = 0;
+		drawCommands.clear();
+
+		// 16位索引时每个Primitive的索引依然是局部的，依靠vertexOffset定位顶点
+		for (int32 i = 0; i < meshes.size(); ++i)
+		{
+			DVKMesh* mesh = meshes[i];
+			for (int32 j = 0; j < mesh->primitives.size(); ++j)
+			{
+				DVKPrimitive* primitive = mesh->primitives[j];
+				primitive->firstIndex   = loadOptions.index32 ? indices32.size() : indices.size();
+				primitive->vertexOffset = numVertices;
+
+				vertices.insert(vertices.end(), primitive->vertices.begin(), primitive->vertices.end());
+				if (loadOptions.index32) {
+					indices32.insert(indices32.end(), primitive->indices32.begin(), primitive->indices32.end());
+				}
+				else {
+					indices.insert(indices.end(), primitive->indices.begin(), primitive->indices.end());
+				}
+				numVertices += primitive->vertexCount;
+
+				VkDrawIndexedIndirectCommand drawCommand = {};
+				drawCommand.indexCount    = primitive->indexCount;
+				drawCommand.instanceCount = 1;
+				drawCommand.firstIndex    = primitive->firstIndex;
+				drawCommand.vertexOffset  = primitive->vertexOffset;
+				drawCommand.firstInstance = 0;
+				drawCommands.push_back(drawCommand);
+			}
+		}
+
+		if (!uploader || drawCommands.size() == 0) {
+			return;
+		}
+
+		packedVertexBuffer = DVKVertexBuffer::Create(device, uploader, vertices, attributes);
+		if (loadOptions.index32) {
+			packedIndexBuffer = DVKIndexBuffer::Create(device, uploader, indices32);
+		}
+		else {
+			packedIndexBuffer = DVKIndexBuffer::Create(device, uploader, indices);
+		}
+
+		VkDeviceSize commandsSize = drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand);
+
+		DVKBuffer* commandStaging = DVKBuffer::CreateBuffer(
+			device,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			commandsSize,
+			drawCommands.data()
+		);
+
+		packedIndirectBuffer = DVKBuffer::CreateBuffer(
+			device,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			commandsSize
+		);
+
+		uploader->CopyBuffer(commandStaging, packedIndirectBuffer, commandsSize, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+		for (int32 i = 0; i < meshes.size(); ++i)
+		{
+			DVKMesh* mesh = meshes[i];
+			for (int32 j = 0; j < mesh->primitives.size(); ++j)
+			{
+				DVKPrimitive* primitive  = mesh->primitives[j];
+				primitive->vertexBuffer  = packedVertexBuffer;
+				primitive->indexBuffer   = packedIndexBuffer;
+				primitive->sharedBuffers = true;
+			}
+		}
+	}
+
+	void DVKModel::BindPackedBuffers(VkCommandBuffer cmdBuffer)
+	{
+		if (!packedVertexBuffer) {
+			return;
+		}
+
+		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &(packedVertexBuffer->dvkBuffer->buffer), &(packedVertexBuffer->offset));
+		vkCmdBindIndexBuffer(cmdBuffer, packedIndexBuffer->dvkBuffer->buffer, 0, packedIndexBuffer->indexType);
+	}
+
+	void DVKModel::DrawPackedIndirect(VkCommandBuffer cmdBuffer)
+	{
+		if (!packedIndirectBuffer) {
+			return;
+		}
+
+		BindPackedBuffers(cmdBuffer);
+
+		if (device->GetPhysicalFeatures().multiDrawIndirect) {
+			vkCmdDrawIndexedIndirect(cmdBuffer, packedIndirectBuffer->buffer, 0, drawCommands.size(), sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else 
+		{
+			for (int32 i = 0; i < drawCommands.size(); ++i) {
+				vkCmdDrawIndexedIndirect(cmdBuffer, packedIndirectBuffer->buffer, i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+			}
+		}
+	}
+
 	VkVertexInputBindingDescription DVKModel::GetInputBinding()
 	{
 		int32 stride = 0;
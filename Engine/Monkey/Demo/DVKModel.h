@@ -6,6 +6,7 @@
 #include "DVKBuffer.h"
 #include "DVKIndexBuffer.h"
 #include "DVKVertexBuffer.h"
+#include "DVKUploadContext.h"
 
 #include "Common/Common.h"
 #include "Math/Math.h"
@@ -20,6 +21,7 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <algorithm>
 
 struct aiMesh;
 struct aiScene;
@@ -63,6 +65,17 @@ namespace vk_demo
 		}
     };
     
+	struct DVKModelLoadOptions
+	{
+		// 索引超过65535的mesh不再拆分成多个Primitive，直接使用32位索引，索引数据保存在indices32中
+		bool	index32 = false;
+
+		// 模型所有Primitive共用一个VertexBuffer和IndexBuffer，通过firstIndex和vertexOffset绘制
+		bool	packGeometry = false;
+		// 使用缓存目录下的二进制缓存，源文件或顶点布局变化时重新通过Assimp导入
+		bool	useCache = true;
+	};
+
 	struct DVKPrimitive
 	{
 		DVKIndexBuffer*		indexBuffer = nullptr;
@@ -72,10 +85,17 @@ namespace vk_demo
 		std::vector<float>	vertices;
         std::vector<float>  instanceDatas;
 		std::vector<uint16>	indices;
+		std::vector<uint32>	indices32;
         
         int32               vertexCount = 0;
         int32               triangleNum = 0;
 
+		// packGeometry模式下在共享Buffer中的位置，indexBuffer和vertexBuffer由DVKModel持有
+		int32				indexCount = 0;
+		int32				firstIndex = 0;
+		int32				vertexOffset = 0;
+		bool				sharedBuffers = false;
+
 		DVKPrimitive()
 		{
 
@@ -83,11 +103,11 @@ namespace vk_demo
         
 		~DVKPrimitive()
 		{
-			if (indexBuffer) {
+			if (indexBuffer && !sharedBuffers) {
 				delete indexBuffer;
 			}
 
-			if (vertexBuffer) {
+			if (vertexBuffer && !sharedBuffers) {
 				delete vertexBuffer;
 			}
 
@@ -104,6 +124,9 @@ namespace vk_demo
 			if (vertexBuffer && !indexBuffer) {
 				vkCmdDraw(cmdBuffer, vertexCount, 1, 0, 0);
 			}
+			else if (sharedBuffers) {
+				vkCmdDrawIndexed(cmdBuffer, indexCount, indexBuffer->instanceCount, firstIndex, vertexOffset, 0);
+			}
 			else {
 				vkCmdDrawIndexed(cmdBuffer, indexBuffer->indexCount, indexBuffer->instanceCount, 0, 0, 0);
 			}
@@ -138,12 +161,7 @@ namespace vk_demo
 				vkCmdBindIndexBuffer(cmdBuffer, indexBuffer->dvkBuffer->buffer, 0, indexBuffer->indexType);
 			}
             
-			if (vertexBuffer && !indexBuffer) {
-				vkCmdDraw(cmdBuffer, vertexCount, 1, 0, 0);
-			}
-			else {
-				vkCmdDrawIndexed(cmdBuffer, indexBuffer->indexCount, indexBuffer->instanceCount, 0, 0, 0);
-			}
+			DrawOnly(cmdBuffer);
 		}
 	};
 
@@ -159,6 +177,7 @@ namespace vk_demo
 		std::string     name;
         int32           index = -1;
         int32           parent = -1;
+        int32           nodeIndex = -1;
         Matrix4x4       inverseBindPose;
 		Matrix4x4		finalTransform;
     };
@@ -176,7 +195,20 @@ namespace vk_demo
 		std::vector<float>	   keys;
 		std::vector<ValueType> values;
 
+		// 上一次命中的关键帧区间，顺序播放时基本都能直接命中
+		int32				   cursor = 0;
+
+		// 按固定帧率重采样后的数据，帧索引可以直接计算
+		std::vector<ValueType> bakedValues;
+		float				   bakedRate = 0.0f;
+
 		void GetValue(float key, ValueType& outPrevValue, ValueType& outNextValue, float& outAlpha)
+		{
+			GetValue(key, outPrevValue, outNextValue, outAlpha, cursor);
+		}
+
+		// 使用外部的cursor，多个实例共享同一份动画数据时各自保存cursor
+		void GetValue(float key, ValueType& outPrevValue, ValueType& outNextValue, float& outAlpha, int32& frameCursor) const
 		{
 			outAlpha = 0.0f;
 
@@ -200,14 +232,18 @@ namespace vk_demo
 				return;
 			}
 
-			int32 frameIndex = 0;
-			for (int32 i = 0; i < keys.size() - 1; ++i) {
-				if (key <= keys[i + 1]) 
-				{
-					frameIndex = i;
-					break;
-				}
+			if (bakedRate > 0.0f)
+			{
+				float frame      = (key - keys.front()) * bakedRate;
+				int32 frameIndex = MMath::Min((int32)frame, (int32)bakedValues.size() - 2);
+
+				outPrevValue = bakedValues[frameIndex + 0];
+				outNextValue = bakedValues[frameIndex + 1];
+				outAlpha     = MMath::Min(frame - frameIndex, 1.0f);
+				return;
 			}
+
+			int32 frameIndex = FindFrame(key, frameCursor);
             
 			outPrevValue = values[frameIndex + 0];
 			outNextValue = values[frameIndex + 1];
@@ -216,11 +252,64 @@ namespace vk_demo
 			float nextKey = keys[frameIndex + 1];
 			outAlpha      = (key - prevKey) / (nextKey - prevKey);
 		}
+
+		// 查找满足keys[i] < key <= keys[i + 1]的区间，key需要在(keys.front(), keys.back())之间
+		int32 FindFrame(float key, int32& frameCursor) const
+		{
+			int32 lastFrame = (int32)keys.size() - 2;
+			if (frameCursor < 0 || frameCursor > lastFrame) {
+				frameCursor = 0;
+			}
+
+			// 先检查当前区间和下一个区间
+			if (key > keys[frameCursor])
+			{
+				if (key <= keys[frameCursor + 1]) {
+					return frameCursor;
+				}
+				if (frameCursor < lastFrame && key <= keys[frameCursor + 2]) 
+				{
+					frameCursor += 1;
+					return frameCursor;
+				}
+			}
+
+			// 跳转或者倒放时退化为二分查找
+			frameCursor = (int32)(std::lower_bound(keys.begin() + 1, keys.end(), key) - keys.begin()) - 1;
+			return frameCursor;
+		}
+
+		// 以sampleRate的帧率重采样，sampleRate <= 0时恢复为关键帧查找
+		void Bake(float sampleRate)
+		{
+			bakedValues.clear();
+			bakedRate = 0.0f;
+
+			if (keys.size() < 2 || sampleRate <= 0.0f) {
+				return;
+			}
+
+			int32 frameCount = MMath::CeilToInt((keys.back() - keys.front()) * sampleRate) + 1;
+			frameCount = MMath::Max(frameCount, 2);
+			bakedValues.resize(frameCount);
+
+			for (int32 i = 0; i < frameCount; ++i)
+			{
+				ValueType prevValue = values.front();
+				ValueType nextValue = values.front();
+				float alpha = 0.0f;
+				GetValue(keys.front() + i / sampleRate, prevValue, nextValue, alpha);
+				bakedValues[i] = MMath::Lerp(prevValue, nextValue, alpha);
+			}
+
+			bakedRate = sampleRate;
+		}
 	};
 
 	struct DVKAnimationClip
 	{
 		std::string					nodeName;
+		int32						nodeIndex = -1;
 		float						duration;
 		DVKAnimChannel<Vector3>		positions;
 		DVKAnimChannel<Vector3>		scales;
@@ -294,6 +383,7 @@ namespace vk_demo
     struct DVKNode
     {
         std::string					name;
+		int32						index = -1;
 
 		std::vector<DVKMesh*>		meshes;
 
@@ -333,8 +423,10 @@ namespace vk_demo
 				const Matrix4x4& matrix = GetGlobalMatrix();
 				for (int32 i = 0; i < meshes.size(); ++i)
 				{
-					Vector3 mmin = matrix.TransformPosition(meshes[i]->bounding.min);
-					Vector3 mmax = matrix.TransformPosition(meshes[i]->bounding.max);
+					Vector3 bounds[2] = { meshes[i]->bounding.min, meshes[i]->bounding.max };
+					matrix.TransformPositions(bounds, bounds, 2);
+					const Vector3& mmin = bounds[0];
+					const Vector3& mmax = bounds[1];
 					outBounds.min = Vector3::Min(outBounds.min, mmin);
 					outBounds.min = Vector3::Min(outBounds.min, mmax);
 					outBounds.max = Vector3::Max(outBounds.max, mmin);
@@ -373,6 +465,8 @@ namespace vk_demo
     
     class DVKModel
     {
+		friend class DVKMeshCache;
+
     private:
         DVKModel()
 			: device(nullptr)
@@ -395,6 +489,21 @@ namespace vk_demo
 				delete bones[i];
 			}
 			bones.clear();
+
+			if (packedVertexBuffer) {
+				delete packedVertexBuffer;
+				packedVertexBuffer = nullptr;
+			}
+
+			if (packedIndexBuffer) {
+				delete packedIndexBuffer;
+				packedIndexBuffer = nullptr;
+			}
+
+			if (packedIndirectBuffer) {
+				delete packedIndirectBuffer;
+				packedIndirectBuffer = nullptr;
+			}
         }
 
 		void Update(float time, float delta);
@@ -405,11 +514,28 @@ namespace vk_demo
 
 		void GotoAnimation(float time);
 
+		// 按linearNodes顺序一次性计算所有节点的globalMatrix
+		void UpdateGlobalMatrices();
+
+		// 把所有动画重采样为固定帧率，采样时不再查找关键帧
+		void BakeAnimations(float sampleRate);
+
 		VkVertexInputBindingDescription GetInputBinding();
 
 		std::vector<VkVertexInputAttributeDescription> GetInputAttributes();
+
+		// packGeometry模式：绑定一次共享的Buffer，之后逐个mesh调用DrawOnly即可
+		void BindPackedBuffers(VkCommandBuffer cmdBuffer);
+
+		// packGeometry模式：一次indirect绘制所有Primitive，不支持multiDrawIndirect时逐条提交
+		void DrawPackedIndirect(VkCommandBuffer cmdBuffer);
+
+		inline bool IsPacked() const
+		{
+			return packedVertexBuffer != nullptr;
+		}
         
-        static DVKModel* LoadFromFile(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, const std::vector<VertexAttribute>& attributes);
+        static DVKModel* LoadFromFile(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, const std::vector<VertexAttribute>& attributes, const DVKModelLoadOptions& options = DVKModelLoadOptions());
         
         static DVKModel* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, const std::vector<float>& vertices, const std::vector<uint16>& indices, const std::vector<VertexAttribute>& attributes);
         
@@ -430,6 +556,10 @@ namespace vk_demo
         void LoadPrimitives(std::vector<float>& vertices, std::vector<uint32>& indices, DVKMesh* mesh, const aiMesh* aiMesh, const aiScene* aiScene);
         
         void LoadAnim(const aiScene* aiScene);
+
+		void CompileSkeleton();
+
+		void PackGeometry();
         
     public:
         typedef std::unordered_map<std::string, DVKNode*> NodesMap;
@@ -450,9 +580,26 @@ namespace vk_demo
 		std::vector<DVKAnimation>		animations;
 		int32							animIndex = -1;
 
+		// linearNodes中父节点总是在子节点之前，nodeParents记录父节点在linearNodes中的索引
+		std::vector<int32>				nodeParents;
+
+		// 动画采样得到的local TRS，按node索引存储
+		std::vector<Vector3>			posePositions;
+		std::vector<Quat>				poseRotations;
+		std::vector<Vector3>			poseScales;
+		std::vector<uint8>				poseAnimated;
+
+		DVKModelLoadOptions				loadOptions;
+
+		// packGeometry模式下所有Primitive共用的Buffer，drawCommands按meshes顺序排列
+		DVKVertexBuffer*				packedVertexBuffer = nullptr;
+		DVKIndexBuffer*					packedIndexBuffer = nullptr;
+		DVKBuffer*						packedIndirectBuffer = nullptr;
+		std::vector<VkDrawIndexedIndirectCommand>	drawCommands;
+
 	private:
 
-		DVKCommandBuffer*				cmdBuffer = nullptr;
+		DVKUploadContext*				uploader = nullptr;
         bool                            loadSkin = false;
     };
     
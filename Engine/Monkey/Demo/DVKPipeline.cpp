@@ -1,5 +1,8 @@
 ﻿#include "DVKPipeline.h"
 
+#include "Core/Profiler.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+
 namespace vk_demo
 {
 
@@ -17,7 +20,21 @@ namespace vk_demo
 		pipeline->vulkanDevice   = vulkanDevice;
 		pipeline->pipelineLayout = pipelineLayout;
 
-		VkDevice device = vulkanDevice->GetInstanceHandle();
+		CreatePipeline(pipeline, pipelineCache, pipelineInfo, inputBindings, vertexInputAttributs, renderPass);
+		
+		return pipeline;
+	}
+
+	void DVKGfxPipeline::CreatePipeline(
+		DVKGfxPipeline* pipeline,
+		VkPipelineCache pipelineCache,
+		DVKGfxPipelineInfo& pipelineInfo, 
+		const std::vector<VkVertexInputBindingDescription>& inputBindings, 
+		const std::vector<VkVertexInputAttributeDescription>& vertexInputAttributs,
+		VkRenderPass renderPass
+	)
+	{
+		VkDevice device = pipeline->vulkanDevice->GetInstanceHandle();
 
 		VkPipelineVertexInputStateCreateInfo vertexInputState;
 		ZeroVulkanStruct(vertexInputState, VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO);
@@ -55,7 +72,7 @@ namespace vk_demo
 		
 		VkGraphicsPipelineCreateInfo pipelineCreateInfo;
 		ZeroVulkanStruct(pipelineCreateInfo, VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO);
-		pipelineCreateInfo.layout 				= pipelineLayout;
+		pipelineCreateInfo.layout 				= pipeline->pipelineLayout;
 		pipelineCreateInfo.renderPass 			= renderPass;
 		pipelineCreateInfo.subpass              = pipelineInfo.subpass;
 		pipelineCreateInfo.stageCount 			= shaderStages.size();
@@ -74,8 +91,87 @@ namespace vk_demo
 		}
 
 		VERIFYVULKANRESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, VULKAN_CPU_ALLOCATOR, &(pipeline->pipeline)));
-		
+
+		pipeline->ready.store(true, std::memory_order_release);
+	}
+
+	DVKGfxPipeline* DVKGfxPipelineBatch::Add(
+		std::shared_ptr<VulkanDevice> vulkanDevice,
+		VkPipelineCache pipelineCache,
+		const DVKGfxPipelineInfo& pipelineInfo, 
+		const std::vector<VkVertexInputBindingDescription>& inputBindings, 
+		const std::vector<VkVertexInputAttributeDescription>& vertexInputAttributs,
+		VkPipelineLayout pipelineLayout,
+		VkRenderPass renderPass
+	)
+	{
+		if (building) {
+			MLOGE("Can't add pipeline to a batch in building.");
+			return nullptr;
+		}
+
+		DVKGfxPipeline* pipeline = new DVKGfxPipeline();
+		pipeline->vulkanDevice   = vulkanDevice;
+		pipeline->pipelineLayout = pipelineLayout;
+
+		Job job;
+		job.pipeline        = pipeline;
+		job.pipelineCache   = pipelineCache;
+		job.pipelineInfo    = pipelineInfo;
+		job.inputBindings   = inputBindings;
+		job.inputAttributes = vertexInputAttributs;
+		job.renderPass      = renderPass;
+		jobs.push_back(job);
+
 		return pipeline;
 	}
 
+	void DVKGfxPipelineBatch::Build(bool wait)
+	{
+		if (jobs.size() == 0 || building) {
+			return;
+		}
+
+		startTime = GenericPlatformTime::Seconds();
+		building  = true;
+
+		for (int32 i = 0; i < jobs.size(); ++i)
+		{
+			JobSystem::Run([this, i] {
+				PROFILE_ZONE("DVKGfxPipeline::CreatePipeline");
+				Job& job = jobs[i];
+				DVKGfxPipeline::CreatePipeline(job.pipeline, job.pipelineCache, job.pipelineInfo, job.inputBindings, job.inputAttributes, job.renderPass);
+			}, &counter);
+		}
+
+		// wait为true时当前线程也参与创建
+		if (wait) {
+			Wait();
+		}
+	}
+
+	void DVKGfxPipelineBatch::Wait()
+	{
+		if (jobs.size() == 0) {
+			return;
+		}
+
+		// 没有调用Build时在当前线程上创建
+		if (!building)
+		{
+			startTime = GenericPlatformTime::Seconds();
+			for (int32 i = 0; i < jobs.size(); ++i)
+			{
+				Job& job = jobs[i];
+				DVKGfxPipeline::CreatePipeline(job.pipeline, job.pipelineCache, job.pipelineInfo, job.inputBindings, job.inputAttributes, job.renderPass);
+			}
+		}
+
+		JobSystem::Wait(&counter);
+
+		MLOG("Created %d pipelines on %d threads in %.2fms", (int32)jobs.size(), building ? JobSystem::GetNumThreads() : 1, (GenericPlatformTime::Seconds() - startTime) * 1000.0);
+		jobs.clear();
+		building = false;
+	}
+
 }
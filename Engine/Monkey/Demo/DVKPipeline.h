@@ -6,6 +6,7 @@
 #include "Math/Math.h"
 
 #include "Vulkan/VulkanCommon.h"
+#include "Core/JobSystem.h"
 
 #include "DVKShader.h"
 
@@ -13,6 +14,7 @@
 #include <cstring>
 #include <vector>
 #include <memory>
+#include <atomic>
 
 namespace vk_demo
 {
@@ -160,15 +162,15 @@ namespace vk_demo
 		DVKGfxPipeline()
 			: vulkanDevice(nullptr)
 			, pipeline(VK_NULL_HANDLE)
+			, ready(false)
 		{
 
 		}
 
 		~DVKGfxPipeline()
 		{
-			VkDevice device = vulkanDevice->GetInstanceHandle();
 			if (pipeline != VK_NULL_HANDLE) {
-				vkDestroyPipeline(device, pipeline, VULKAN_CPU_ALLOCATOR);
+				vulkanDevice->GetDeferredDeletionQueue().EnqueueResource(VulkanDeferredDeletionQueue::Type::Pipeline, pipeline);
 			}
 		}
 
@@ -182,6 +184,24 @@ namespace vk_demo
 			VkRenderPass renderPass
 		);
 
+		// 由DVKGfxPipelineBatch创建时，完成之前pipeline为VK_NULL_HANDLE
+		inline bool IsReady() const
+		{
+			return ready.load(std::memory_order_acquire);
+		}
+
+	private:
+		friend class DVKGfxPipelineBatch;
+
+		static void CreatePipeline(
+			DVKGfxPipeline* pipeline,
+			VkPipelineCache pipelineCache,
+			DVKGfxPipelineInfo& pipelineInfo, 
+			const std::vector<VkVertexInputBindingDescription>& inputBindings, 
+			const std::vector<VkVertexInputAttributeDescription>& vertexInputAttributs,
+			VkRenderPass renderPass
+		);
+
 	public:
 		
 		typedef std::shared_ptr<VulkanDevice> VulkanDeviceRef;
@@ -189,6 +209,63 @@ namespace vk_demo
 		VulkanDeviceRef		vulkanDevice;
 		VkPipeline			pipeline;
 		VkPipelineLayout	pipelineLayout;
+
+	private:
+		std::atomic<bool>	ready;
+	};
+
+	// 批量创建pipeline，每个pipeline作为一个Job交给JobSystem，在多个线程上同时调用vkCreateGraphicsPipelines。
+	// VkPipelineCache本身是线程安全的，所有pipeline可以共用同一个cache。
+	class DVKGfxPipelineBatch
+	{
+	private:
+		struct Job
+		{
+			DVKGfxPipeline*									pipeline = nullptr;
+			VkPipelineCache									pipelineCache = VK_NULL_HANDLE;
+			DVKGfxPipelineInfo								pipelineInfo;
+			std::vector<VkVertexInputBindingDescription>	inputBindings;
+			std::vector<VkVertexInputAttributeDescription>	inputAttributes;
+			VkRenderPass									renderPass = VK_NULL_HANDLE;
+		};
+
+	public:
+		DVKGfxPipelineBatch()
+		{
+
+		}
+
+		~DVKGfxPipelineBatch()
+		{
+			Wait();
+		}
+
+		// 参数会被拷贝，shader需要保证在Build完成之前有效
+		DVKGfxPipeline* Add(
+			std::shared_ptr<VulkanDevice> vulkanDevice,
+			VkPipelineCache pipelineCache,
+			const DVKGfxPipelineInfo& pipelineInfo, 
+			const std::vector<VkVertexInputBindingDescription>& inputBindings, 
+			const std::vector<VkVertexInputAttributeDescription>& vertexInputAttributs,
+			VkPipelineLayout pipelineLayout,
+			VkRenderPass renderPass
+		);
+
+		// wait为false时立即返回，之后需要调用Wait。
+		void Build(bool wait = true);
+
+		void Wait();
+
+		inline int32 GetCount() const
+		{
+			return (int32)jobs.size();
+		}
+
+	private:
+		std::vector<Job>			jobs;
+		JobCounter					counter;
+		bool						building = false;
+		double						startTime = 0.0;
 	};
 
 };
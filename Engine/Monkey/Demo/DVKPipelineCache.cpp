@@ -0,0 +1,161 @@
+﻿#include "DVKPipelineCache.h"
+#include "FileManager.h"
+
+#include "Utils/Crc.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include <vector>
+
+namespace vk_demo
+{
+
+	const char* DVKPipelineCache::Validate(std::shared_ptr<VulkanDevice> vulkanDevice, const uint8* dataPtr, uint32 dataSize)
+	{
+		const VkPhysicalDeviceProperties& properties = vulkanDevice->GetDeviceProperties();
+
+		if (dataSize < sizeof(FileHeader)) {
+			return "file too small";
+		}
+
+		FileHeader header;
+		memcpy(&header, dataPtr, sizeof(FileHeader));
+
+		if (header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+			return "unknown format";
+		}
+
+		if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID || header.driverVersion != properties.driverVersion) {
+			return "device or driver changed";
+		}
+
+		if (memcmp(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+			return "pipeline cache uuid changed";
+		}
+
+		if (header.dataSize != dataSize - sizeof(FileHeader)) {
+			return "size mismatch";
+		}
+
+		const uint8* cacheData = dataPtr + sizeof(FileHeader);
+		if (Crc::MemCrc32(cacheData, header.dataSize) != header.dataCrc) {
+			return "crc mismatch";
+		}
+
+		// 驱动自己的头：headerSize, headerVersion, vendorID, deviceID, uuid
+		uint32 vkHeader[4];
+		if (header.dataSize < sizeof(vkHeader) + VK_UUID_SIZE) {
+			return "invalid vulkan header";
+		}
+		memcpy(vkHeader, cacheData, sizeof(vkHeader));
+
+		// headerSize至少是VkPipelineCacheHeaderVersionOne的32字节，且不能超出数据范围
+		if (vkHeader[0] < sizeof(vkHeader) + VK_UUID_SIZE || vkHeader[0] > header.dataSize) {
+			return "invalid vulkan header";
+		}
+
+		if (vkHeader[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || vkHeader[2] != properties.vendorID || vkHeader[3] != properties.deviceID) {
+			return "invalid vulkan header";
+		}
+
+		if (memcmp(cacheData + sizeof(vkHeader), properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+			return "invalid vulkan header";
+		}
+
+		return nullptr;
+	}
+
+	VkPipelineCache DVKPipelineCache::Create(std::shared_ptr<VulkanDevice> vulkanDevice, const std::string& filename, bool* outWarm)
+	{
+		VkDevice device  = vulkanDevice->GetInstanceHandle();
+		double startTime = GenericPlatformTime::Seconds();
+
+		uint8* dataPtr  = nullptr;
+		uint32 dataSize = 0;
+		bool warm = false;
+
+		VkPipelineCacheCreateInfo createInfo;
+		ZeroVulkanStruct(createInfo, VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO);
+
+		if (FileManager::ReadCacheFile(filename, dataPtr, dataSize))
+		{
+			const char* error = Validate(vulkanDevice, dataPtr, dataSize);
+			if (error == nullptr)
+			{
+				createInfo.initialDataSize = dataSize - sizeof(FileHeader);
+				createInfo.pInitialData    = dataPtr + sizeof(FileHeader);
+				warm = true;
+			}
+			else {
+				MLOG("Pipeline cache %s rejected: %s", filename.c_str(), error);
+			}
+		}
+
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		if (vkCreatePipelineCache(device, &createInfo, VULKAN_CPU_ALLOCATOR, &pipelineCache) != VK_SUCCESS && warm)
+		{
+			// 驱动仍然拒绝了数据，退回到空的cache
+			MLOG("Pipeline cache %s rejected by driver.", filename.c_str());
+			createInfo.initialDataSize = 0;
+			createInfo.pInitialData    = nullptr;
+			warm = false;
+			VERIFYVULKANRESULT(vkCreatePipelineCache(device, &createInfo, VULKAN_CPU_ALLOCATOR, &pipelineCache));
+		}
+
+		if (dataPtr) {
+			delete[] dataPtr;
+		}
+
+		if (warm) {
+			MLOG("Pipeline cache %s loaded, %dKB, %.2fms", filename.c_str(), int32(createInfo.initialDataSize / 1024), (GenericPlatformTime::Seconds() - startTime) * 1000.0);
+		}
+		else {
+			MLOG("Pipeline cache %s is cold.", filename.c_str());
+		}
+
+		if (outWarm) {
+			*outWarm = warm;
+		}
+
+		return pipelineCache;
+	}
+
+	bool DVKPipelineCache::Save(std::shared_ptr<VulkanDevice> vulkanDevice, VkPipelineCache pipelineCache, const std::string& filename)
+	{
+		if (pipelineCache == VK_NULL_HANDLE) {
+			return false;
+		}
+
+		VkDevice device = vulkanDevice->GetInstanceHandle();
+		const VkPhysicalDeviceProperties& properties = vulkanDevice->GetDeviceProperties();
+
+		size_t cacheSize = 0;
+		VERIFYVULKANRESULT(vkGetPipelineCacheData(device, pipelineCache, &cacheSize, nullptr));
+		if (cacheSize == 0) {
+			return false;
+		}
+
+		std::vector<uint8> fileData(sizeof(FileHeader) + cacheSize);
+		uint8* cacheData = fileData.data() + sizeof(FileHeader);
+		VERIFYVULKANRESULT(vkGetPipelineCacheData(device, pipelineCache, &cacheSize, cacheData));
+
+		FileHeader header;
+		header.magic         = FILE_MAGIC;
+		header.version       = FILE_VERSION;
+		header.vendorID      = properties.vendorID;
+		header.deviceID      = properties.deviceID;
+		header.driverVersion = properties.driverVersion;
+		header.dataSize      = (uint32)cacheSize;
+		header.dataCrc       = Crc::MemCrc32(cacheData, (int32)cacheSize);
+		memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+		memcpy(fileData.data(), &header, sizeof(FileHeader));
+
+		if (!FileManager::WriteCacheFile(filename, fileData.data(), (uint32)(sizeof(FileHeader) + cacheSize))) {
+			return false;
+		}
+
+		MLOG("Pipeline cache %s saved, %dKB", filename.c_str(), int32(cacheSize / 1024));
+
+		return true;
+	}
+
+};
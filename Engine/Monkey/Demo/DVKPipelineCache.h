@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include "Common/Common.h"
+#include "Vulkan/VulkanCommon.h"
+
+#include <string>
+#include <memory>
+
+class VulkanDevice;
+
+namespace vk_demo
+{
+
+	// 把VkPipelineCache保存到磁盘，下次启动时加载，避免每次都重新编译pipeline。
+	// 文件头记录设备信息和数据的CRC，设备、驱动变化或者文件损坏时丢弃旧数据。
+	class DVKPipelineCache
+	{
+	private:
+		enum
+		{
+			FILE_MAGIC   = 0x43505644, // DVPC
+			FILE_VERSION = 1,
+		};
+
+		struct FileHeader
+		{
+			uint32	magic;
+			uint32	version;
+			uint32	vendorID;
+			uint32	deviceID;
+			uint32	driverVersion;
+			uint8	uuid[VK_UUID_SIZE];
+			uint32	dataSize;
+			uint32	dataCrc;
+		};
+
+	public:
+		// 加载失败时返回一个空的VkPipelineCache，outWarm表示是否加载到了有效数据
+		static VkPipelineCache Create(std::shared_ptr<VulkanDevice> vulkanDevice, const std::string& filename, bool* outWarm = nullptr);
+
+		static bool Save(std::shared_ptr<VulkanDevice> vulkanDevice, VkPipelineCache pipelineCache, const std::string& filename);
+
+	private:
+		static const char* Validate(std::shared_ptr<VulkanDevice> vulkanDevice, const uint8* dataPtr, uint32 dataSize);
+	};
+
+};
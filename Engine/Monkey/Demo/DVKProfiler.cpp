@@ -0,0 +1,425 @@
+﻿#include "DVKProfiler.h"
+#include "DVKCommand.h"
+#include "FileManager.h"
+#include "Engine.h"
+
+#include "Common/Log.h"
+#include "Core/Profiler.h"
+#include "Vulkan/VulkanDevice.h"
+#include "Vulkan/VulkanQueue.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include "imgui.h"
+
+namespace vk_demo
+{
+
+	DVKGPUProfiler::DVKGPUProfiler()
+		: m_VulkanDevice(nullptr)
+		, m_Current(nullptr)
+		, m_FrameNumber(0)
+		, m_MaxQueries(0)
+		, m_NumDropped(0)
+		, m_CaptureFrames(30)
+		, m_TimestampMask(0)
+		, m_TimestampPeriod(0.0)
+		, m_TimeOffset(0.0)
+		, m_Supported(false)
+	{
+
+	}
+
+	DVKGPUProfiler::~DVKGPUProfiler()
+	{
+		VkDevice device = m_VulkanDevice->GetInstanceHandle();
+
+		for (int32 i = 0; i < m_Frames.size(); ++i)
+		{
+			if (m_Frames[i].queryPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device, m_Frames[i].queryPool, VULKAN_CPU_ALLOCATOR);
+			}
+		}
+		m_Frames.clear();
+
+		if (m_Supported) {
+			CPUProfiler::SetTraceAppender(nullptr);
+		}
+
+		m_VulkanDevice = nullptr;
+	}
+
+	DVKGPUProfiler* DVKGPUProfiler::Create(std::shared_ptr<VulkanDevice> vulkanDevice, int32 numFrames, int32 maxZones)
+	{
+		DVKGPUProfiler* profiler = new DVKGPUProfiler();
+		profiler->m_VulkanDevice = vulkanDevice;
+		profiler->m_MaxQueries   = maxZones * 2;
+
+		// graphics队列的timestampValidBits为0时不支持时间戳
+		uint32 queueCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(vulkanDevice->GetPhysicalHandle(), &queueCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueProps(queueCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(vulkanDevice->GetPhysicalHandle(), &queueCount, queueProps.data());
+
+		uint32 validBits = queueProps[vulkanDevice->GetGraphicsQueue()->GetFamilyIndex()].timestampValidBits;
+		if (validBits == 0)
+		{
+			MLOG("GPU profiler disabled, timestamps are not supported.");
+			return profiler;
+		}
+
+		profiler->m_Supported       = true;
+		profiler->m_TimestampMask   = validBits >= 64 ? MAX_uint64 : ((uint64)1 << validBits) - 1;
+		profiler->m_TimestampPeriod = vulkanDevice->GetLimits().timestampPeriod * 1.0e-9;
+		profiler->m_QueryResults.resize(profiler->m_MaxQueries);
+		profiler->m_ZoneStack.reserve(16);
+
+		VkQueryPoolCreateInfo queryPoolCreateInfo;
+		ZeroVulkanStruct(queryPoolCreateInfo, VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO);
+		queryPoolCreateInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = profiler->m_MaxQueries;
+
+		profiler->m_Frames.resize(numFrames);
+		for (int32 i = 0; i < numFrames; ++i)
+		{
+			VERIFYVULKANRESULT(vkCreateQueryPool(vulkanDevice->GetInstanceHandle(), &queryPoolCreateInfo, VULKAN_CPU_ALLOCATOR, &(profiler->m_Frames[i].queryPool)));
+			profiler->m_Frames[i].zones.reserve(maxZones);
+		}
+
+		profiler->Calibrate();
+
+		// CPU采集的trace里同时带上GPU时间线
+		CPUProfiler::SetTraceAppender([profiler](std::string& json, double beginTime, double endTime) {
+			profiler->AppendTraceEvents(json, beginTime, endTime);
+		});
+
+		return profiler;
+	}
+
+	void DVKGPUProfiler::Calibrate()
+	{
+		if (!m_Supported) {
+			return;
+		}
+
+		if (CalibrateTimeDomains()) {
+			return;
+		}
+
+		VkDevice device = m_VulkanDevice->GetInstanceHandle();
+		std::shared_ptr<VulkanQueue> queue = m_VulkanDevice->GetGraphicsQueue();
+
+		vkQueueWaitIdle(queue->GetHandle());
+
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkCommandPoolCreateInfo poolCreateInfo;
+		ZeroVulkanStruct(poolCreateInfo, VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO);
+		poolCreateInfo.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolCreateInfo.queueFamilyIndex = queue->GetFamilyIndex();
+		VERIFYVULKANRESULT(vkCreateCommandPool(device, &poolCreateInfo, VULKAN_CPU_ALLOCATOR, &commandPool));
+
+		// 借用第一帧的QueryPool，之后BeginFrame会重置
+		VkQueryPool queryPool = m_Frames[0].queryPool;
+
+		DVKCommandBuffer* cmdBuffer = DVKCommandBuffer::Create(m_VulkanDevice, commandPool);
+		cmdBuffer->Begin();
+		vkCmdResetQueryPool(cmdBuffer->cmdBuffer, queryPool, 0, 1);
+		vkCmdWriteTimestamp(cmdBuffer->cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 0);
+
+		// 时间戳在提交与fence之间写入，取中点
+		double cpuBegin = GenericPlatformTime::Seconds();
+		cmdBuffer->Submit();
+		double cpuEnd = GenericPlatformTime::Seconds();
+
+		uint64 ticks = 0;
+		VERIFYVULKANRESULT(vkGetQueryPoolResults(device, queryPool, 0, 1, sizeof(uint64), &ticks, sizeof(uint64), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+		delete cmdBuffer;
+		vkDestroyCommandPool(device, commandPool, VULKAN_CPU_ALLOCATOR);
+
+		m_TimeOffset = (cpuBegin + cpuEnd) * 0.5 - (ticks & m_TimestampMask) * m_TimestampPeriod;
+		m_Frames[0].pending = false;
+	}
+
+	bool DVKGPUProfiler::CalibrateTimeDomains()
+	{
+#if defined(VK_EXT_calibrated_timestamps) && (PLATFORM_WINDOWS || PLATFORM_LINUX || PLATFORM_ANDROID)
+		if (!m_VulkanDevice->IsExtensionEnabled(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+			return false;
+		}
+
+		// 和GenericPlatformTime::Seconds()使用同一个时钟
+#if PLATFORM_WINDOWS
+		const VkTimeDomainEXT hostDomain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+		const VkTimeDomainEXT hostDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+
+		VkInstance instance = Engine::Get()->GetVulkanRHI()->GetInstance();
+		VkDevice device     = m_VulkanDevice->GetInstanceHandle();
+
+		PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT getTimeDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+		PFN_vkGetCalibratedTimestampsEXT getTimestamps = (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT");
+		if (!getTimeDomains || !getTimestamps) {
+			return false;
+		}
+
+		uint32 numDomains = 0;
+		getTimeDomains(m_VulkanDevice->GetPhysicalHandle(), &numDomains, nullptr);
+		std::vector<VkTimeDomainEXT> domains(numDomains);
+		getTimeDomains(m_VulkanDevice->GetPhysicalHandle(), &numDomains, domains.data());
+
+		bool hasDevice = false;
+		bool hasHost   = false;
+		for (int32 i = 0; i < domains.size(); ++i)
+		{
+			hasDevice = hasDevice || domains[i] == VK_TIME_DOMAIN_DEVICE_EXT;
+			hasHost   = hasHost   || domains[i] == hostDomain;
+		}
+
+		if (!hasDevice || !hasHost) {
+			return false;
+		}
+
+		VkCalibratedTimestampInfoEXT infos[2];
+		ZeroVulkanStruct(infos[0], VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT);
+		ZeroVulkanStruct(infos[1], VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT);
+		infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+		infos[1].timeDomain = hostDomain;
+
+		uint64_t timestamps[2] = { 0, 0 };
+		uint64_t maxDeviation  = 0;
+		if (getTimestamps(device, 2, infos, timestamps, &maxDeviation) != VK_SUCCESS) {
+			return false;
+		}
+
+		// 换算方式和各平台的Seconds()一致
+#if PLATFORM_WINDOWS
+		double hostTime = timestamps[1] * GenericPlatformTime::GetSecondsPerCycle() + 16777216.0;
+#else
+		double hostTime = timestamps[1] * 1.0e-9;
+#endif
+
+		m_TimeOffset = hostTime - (timestamps[0] & m_TimestampMask) * m_TimestampPeriod;
+
+		MLOG("GPU profiler calibrated with %s, max deviation %.3fus.", VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME, maxDeviation * 1.0e-3);
+
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void DVKGPUProfiler::WriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32& query)
+	{
+		query = m_Current->numQueries;
+		m_Current->numQueries += 1;
+		vkCmdWriteTimestamp(commandBuffer, stage, m_Current->queryPool, query);
+	}
+
+	void DVKGPUProfiler::BeginFrame(VkCommandBuffer commandBuffer)
+	{
+		if (!m_Supported) {
+			return;
+		}
+
+		FrameQueries& frame = m_Frames[m_FrameNumber % m_Frames.size()];
+		if (frame.pending) {
+			ResolveFrame(frame);
+		}
+
+		frame.zones.clear();
+		frame.numQueries  = 0;
+		frame.frameNumber = m_FrameNumber;
+		frame.pending     = true;
+
+		m_FrameNumber += 1;
+		m_Current = &frame;
+		m_ZoneStack.clear();
+
+		vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, m_MaxQueries);
+
+		BeginZone(commandBuffer, "Frame");
+	}
+
+	void DVKGPUProfiler::EndFrame(VkCommandBuffer commandBuffer)
+	{
+		if (!m_Current) {
+			return;
+		}
+
+		if (m_ZoneStack.size() != 1) {
+			MLOGE("GPU profiler zones are not balanced, %d zones still open.", (int32)m_ZoneStack.size() - 1);
+		}
+
+		while (m_ZoneStack.size() > 0) {
+			EndZone(commandBuffer);
+		}
+
+		m_Current = nullptr;
+	}
+
+	void DVKGPUProfiler::BeginZone(VkCommandBuffer commandBuffer, const char* name)
+	{
+		if (!m_Current) {
+			return;
+		}
+
+		// 超出容量的Zone直接忽略，保持栈平衡。已打开的Zone需要给结束时间戳预留位置
+		if (m_Current->numQueries + m_ZoneStack.size() + 2 > m_MaxQueries)
+		{
+			m_ZoneStack.push_back(-1);
+			return;
+		}
+
+		ZoneQuery zone;
+		zone.name  = name;
+		zone.depth = m_ZoneStack.size();
+		WriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, zone.beginQuery);
+
+		m_ZoneStack.push_back(m_Current->zones.size());
+		m_Current->zones.push_back(zone);
+	}
+
+	void DVKGPUProfiler::EndZone(VkCommandBuffer commandBuffer)
+	{
+		if (!m_Current || m_ZoneStack.size() == 0) {
+			return;
+		}
+
+		int32 index = m_ZoneStack.back();
+		m_ZoneStack.pop_back();
+
+		if (index >= 0) {
+			WriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_Current->zones[index].endQuery);
+		}
+	}
+
+	void DVKGPUProfiler::ResolveFrame(FrameQueries& frame)
+	{
+		frame.pending = false;
+
+		if (frame.numQueries == 0) {
+			return;
+		}
+
+		// 不带WAIT_BIT，GPU还没执行完时返回VK_NOT_READY，丢弃这一帧
+		VkResult result = vkGetQueryPoolResults(
+			m_VulkanDevice->GetInstanceHandle(),
+			frame.queryPool,
+			0,
+			frame.numQueries,
+			frame.numQueries * sizeof(uint64),
+			m_QueryResults.data(),
+			sizeof(uint64),
+			VK_QUERY_RESULT_64_BIT
+		);
+
+		if (result != VK_SUCCESS)
+		{
+			m_NumDropped += 1;
+			return;
+		}
+
+		DVKGPUFrame resolved;
+		resolved.frameNumber = frame.frameNumber;
+		resolved.zones.resize(frame.zones.size());
+
+		for (int32 i = 0; i < frame.zones.size(); ++i)
+		{
+			const ZoneQuery& query = frame.zones[i];
+			uint64 beginTicks = m_QueryResults[query.beginQuery] & m_TimestampMask;
+			uint64 endTicks   = m_QueryResults[query.endQuery]   & m_TimestampMask;
+
+			DVKGPUZone& zone = resolved.zones[i];
+			zone.name     = query.name;
+			zone.depth    = query.depth;
+			zone.begin    = beginTicks * m_TimestampPeriod + m_TimeOffset;
+			zone.duration = endTicks > beginTicks ? (endTicks - beginTicks) * m_TimestampPeriod : 0.0;
+		}
+
+		if (m_History.size() >= MAX_HISTORY) {
+			m_History.pop_front();
+		}
+		m_History.push_back(resolved);
+	}
+
+	void DVKGPUProfiler::DrawGUI()
+	{
+		if (!ImGui::CollapsingHeader("GPU Profiler", ImGuiTreeNodeFlags_DefaultOpen)) {
+			return;
+		}
+
+		if (!m_Supported)
+		{
+			ImGui::Text("Timestamps not supported");
+			return;
+		}
+
+		if (m_History.size() == 0)
+		{
+			ImGui::Text("Waiting for results...");
+			return;
+		}
+
+		const DVKGPUFrame& frame = m_History.back();
+		for (int32 i = 0; i < frame.zones.size(); ++i)
+		{
+			const DVKGPUZone& zone = frame.zones[i];
+			ImGui::Text("%*s%-16s %7.3f ms", zone.depth * 2, "", zone.name, zone.duration * 1000.0);
+		}
+
+		if (ImGui::Button("Export GPU Trace")) {
+			ExportChromeTrace("gpu_trace.json");
+		}
+
+#if MONKEY_PROFILE
+		// CPU和GPU时间线一起采集，CPU zone被编译掉时不显示
+		ImGui::SliderInt("Capture Frames", &m_CaptureFrames, 1, 120);
+		if (CPUProfiler::IsCapturing()) {
+			ImGui::Text("Capturing...");
+		}
+		else if (ImGui::Button("Capture Trace")) {
+			CPUProfiler::BeginCapture(m_CaptureFrames, "trace.json");
+		}
+#endif
+	}
+
+	void DVKGPUProfiler::AppendTraceEvents(std::string& json, double beginTime, double endTime) const
+	{
+		char buffer[256];
+
+		snprintf(buffer, sizeof(buffer), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}", TRACE_THREAD_ID);
+		json += buffer;
+
+		for (int32 i = 0; i < m_History.size(); ++i)
+		{
+			const DVKGPUFrame& frame = m_History[i];
+			if (frame.zones[0].begin < beginTime || frame.zones[0].begin > endTime) {
+				continue;
+			}
+
+			for (int32 j = 0; j < frame.zones.size(); ++j)
+			{
+				const DVKGPUZone& zone = frame.zones[j];
+				snprintf(buffer, sizeof(buffer), ",\n{\"name\":\"%s\",\"cat\":\"gpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d}", zone.name, zone.begin * 1000000.0, zone.duration * 1000000.0, TRACE_THREAD_ID);
+				json += buffer;
+			}
+		}
+	}
+
+	bool DVKGPUProfiler::ExportChromeTrace(const std::string& filename) const
+	{
+		std::string json = "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"Monkey\"}}";
+		AppendTraceEvents(json, 0.0, MAX_dbl);
+		json += "\n]}\n";
+
+		if (!FileManager::WriteCacheFile(filename, (const uint8*)json.data(), (uint32)json.size())) {
+			return false;
+		}
+
+		MLOG("GPU trace %s saved, %d frames.", FileManager::GetCachePath(filename).c_str(), (int32)m_History.size());
+
+		return true;
+	}
+
+};
@@ -0,0 +1,156 @@
+﻿#pragma once
+
+#include "Common/Common.h"
+#include "Vulkan/VulkanCommon.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+
+class VulkanDevice;
+
+namespace vk_demo
+{
+	struct DVKGPUZone
+	{
+		const char*		name = nullptr;
+		int32			depth = 0;
+		double			begin = 0.0;		// 秒，与GenericPlatformTime::Seconds()同一个时间轴
+		double			duration = 0.0;		// 秒
+	};
+
+	struct DVKGPUFrame
+	{
+		uint64					frameNumber = 0;
+		std::vector<DVKGPUZone>	zones;		// zones[0]为整帧
+	};
+
+	// 基于vkCmdWriteTimestamp的GPU计时器。
+	// 每一帧使用独立的QueryPool，numFrames帧之后复用时才读取结果，读取不等待GPU，未完成的帧直接丢弃。
+	// Zone可以嵌套，名字只保存指针，需要是常量字符串。所有Zone需要在同一个线程里录制。
+	class DVKGPUProfiler
+	{
+	private:
+		enum
+		{
+			MAX_HISTORY     = 256,
+			TRACE_THREAD_ID = 1000,	// GPU时间线在trace中使用的tid
+		};
+
+		struct ZoneQuery
+		{
+			const char*	name = nullptr;
+			int32		depth = 0;
+			uint32		beginQuery = 0;
+			uint32		endQuery = 0;
+		};
+
+		struct FrameQueries
+		{
+			VkQueryPool				queryPool = VK_NULL_HANDLE;
+			std::vector<ZoneQuery>	zones;
+			uint32					numQueries = 0;
+			uint64					frameNumber = 0;
+			bool					pending = false;
+		};
+
+		DVKGPUProfiler();
+
+	public:
+		~DVKGPUProfiler();
+
+		// numFrames需要不小于同时在飞的帧数，否则读取结果时GPU还没有执行完
+		static DVKGPUProfiler* Create(std::shared_ptr<VulkanDevice> vulkanDevice, int32 numFrames = 4, int32 maxZones = 64);
+
+		// 需要在RenderPass之外调用，会重置这一帧的QueryPool
+		void BeginFrame(VkCommandBuffer commandBuffer);
+
+		void EndFrame(VkCommandBuffer commandBuffer);
+
+		void BeginZone(VkCommandBuffer commandBuffer, const char* name);
+
+		void EndZone(VkCommandBuffer commandBuffer);
+
+		// 重新计算GPU时间戳与CPU时间的偏移。设备支持VK_EXT_calibrated_timestamps时同时读取两个时钟，
+		// 否则提交一个时间戳并取提交与等待之间的中点，会等待GPU空闲
+		void Calibrate();
+
+		// 在ImGui窗口内绘制最近一帧的结果，需要在ImageGUIContext的StartFrame与EndFrame之间调用
+		void DrawGUI();
+
+		// 导出历史帧为Chrome trace格式(chrome://tracing)，文件位于缓存目录
+		bool ExportChromeTrace(const std::string& filename) const;
+
+		// 按Chrome trace格式追加[beginTime, endTime]之间开始的帧，每个事件以",\n"开头
+		void AppendTraceEvents(std::string& json, double beginTime, double endTime) const;
+
+		inline bool IsSupported() const
+		{
+			return m_Supported;
+		}
+
+		inline const std::deque<DVKGPUFrame>& GetHistory() const
+		{
+			return m_History;
+		}
+
+		inline uint32 GetNumDroppedFrames() const
+		{
+			return m_NumDropped;
+		}
+
+	private:
+		bool CalibrateTimeDomains();
+
+		void ResolveFrame(FrameQueries& frame);
+
+		void WriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32& query);
+
+	private:
+		std::shared_ptr<VulkanDevice>	m_VulkanDevice;
+		std::vector<FrameQueries>		m_Frames;
+		std::vector<int32>				m_ZoneStack;
+		std::vector<uint64>				m_QueryResults;
+		std::deque<DVKGPUFrame>			m_History;
+
+		FrameQueries*					m_Current;
+		uint64							m_FrameNumber;
+		uint32							m_MaxQueries;
+		uint32							m_NumDropped;
+		int32							m_CaptureFrames;
+		uint64							m_TimestampMask;
+		double							m_TimestampPeriod;	// 秒/tick
+		double							m_TimeOffset;		// CPU时间 = tick * period + offset
+		bool							m_Supported;
+	};
+
+	class DVKGPUProfileScope
+	{
+	public:
+		DVKGPUProfileScope(DVKGPUProfiler* inProfiler, VkCommandBuffer inCommandBuffer, const char* name)
+			: profiler(inProfiler)
+			, commandBuffer(inCommandBuffer)
+		{
+			if (profiler) {
+				profiler->BeginZone(commandBuffer, name);
+			}
+		}
+
+		~DVKGPUProfileScope()
+		{
+			if (profiler) {
+				profiler->EndZone(commandBuffer);
+			}
+		}
+
+	private:
+		DVKGPUProfiler*		profiler;
+		VkCommandBuffer		commandBuffer;
+	};
+
+};
+
+#define DVK_GPU_ZONE_CONCAT_INNER(a, b) a##b
+#define DVK_GPU_ZONE_CONCAT(a, b) DVK_GPU_ZONE_CONCAT_INNER(a, b)
+#define DVK_GPU_ZONE(profiler, commandBuffer, name) vk_demo::DVKGPUProfileScope DVK_GPU_ZONE_CONCAT(gpuZone, __LINE__)(profiler, commandBuffer, name)
@@ -6,30 +6,17 @@ namespace vk_demo
 {
 	DVKShaderModule* DVKShaderModule::Create(std::shared_ptr<VulkanDevice> vulkanDevice, const char* filename, VkShaderStageFlagBits stage)
 	{
-		VkDevice device = vulkanDevice->GetInstanceHandle();
+		DVKShaderModule* dvkModule = new DVKShaderModule();
+		dvkModule->device = vulkanDevice->GetInstanceHandle();
+		dvkModule->stage  = stage;
 
-		uint8* dataPtr  = nullptr;
-        uint32 dataSize = 0;
-        if (!FileManager::ReadFile(filename, dataPtr, dataSize))
+		// 相同内容的shader共享同一个VkShaderModule
+		if (!DVKShaderCache::AcquireModule(vulkanDevice, filename, dvkModule))
 		{
 			MLOGE("Failed load file:%s", filename);
+			delete dvkModule;
 			return nullptr;
 		}
-        
-        VkShaderModuleCreateInfo moduleCreateInfo;
-        ZeroVulkanStruct(moduleCreateInfo, VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO);
-        moduleCreateInfo.codeSize = dataSize;
-        moduleCreateInfo.pCode    = (uint32_t*)dataPtr;
-        
-        VkShaderModule shaderModule = VK_NULL_HANDLE;
-        VERIFYVULKANRESULT(vkCreateShaderModule(device, &moduleCreateInfo, VULKAN_CPU_ALLOCATOR, &shaderModule));
-
-		DVKShaderModule* dvkModule = new DVKShaderModule();
-		dvkModule->data   = dataPtr;
-		dvkModule->size   = dataSize;
-		dvkModule->device = device;
-		dvkModule->handle = shaderModule;
-		dvkModule->stage  = stage;
 
 		return dvkModule;
 	}
@@ -45,6 +32,8 @@ namespace vk_demo
         
         DVKShader* shader = new DVKShader();
         shader->device     = vulkanDevice->GetInstanceHandle();
+        shader->deletionQueue = &(vulkanDevice->GetDeferredDeletionQueue());
+        shader->layoutCache   = &(vulkanDevice->GetLayoutCache());
         shader->dynamicUBO = dynamicUBO;
         
         shader->vertShaderModule = vertModule;
@@ -69,54 +58,39 @@ namespace vk_demo
         return Create(vulkanDevice, false, vert, frag, geom, comp, tesc, tese);
 	}
 
-    void DVKShader::ProcessAttachments(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkPipelineStageFlags stageFlags)
+    void DVKShader::AddResource(DVKShaderReflection& reflection, const std::string& name, int32 set, int32 binding, VkDescriptorType descriptorType, uint32 bufferSize)
+    {
+        DVKShaderReflection::Resource resource;
+        resource.name           = name;
+        resource.set            = set;
+        resource.binding        = binding;
+        resource.descriptorType = descriptorType;
+        resource.bufferSize     = bufferSize;
+        reflection.resources.push_back(resource);
+    }
+
+    void DVKShader::ProcessAttachments(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
     {
         // 获取attachment信息
         for (int32 i = 0; i < resources.subpass_inputs.size(); ++i)
         {
             spirv_cross::Resource& res      = resources.subpass_inputs[i];
-            spirv_cross::SPIRType type      = compiler.get_type(res.type_id);
-            spirv_cross::SPIRType base_type = compiler.get_type(res.base_type_id);
             const std::string &varName      = compiler.get_name(res.id);
             
             int32 set     = compiler.get_decoration(res.id, spv::DecorationDescriptorSet);
             int32 binding = compiler.get_decoration(res.id, spv::DecorationBinding);
             
-            VkDescriptorSetLayoutBinding setLayoutBinding = {};
-            setLayoutBinding.binding             = binding;
-            setLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-            setLayoutBinding.descriptorCount    = 1;
-            setLayoutBinding.stageFlags         = stageFlags;
-            setLayoutBinding.pImmutableSamplers = nullptr;
-            
-            setLayoutsInfo.AddDescriptorSetLayoutBinding(varName, set, setLayoutBinding);
-            
-			auto it = imageParams.find(varName);
-			if (it == imageParams.end())
-			{
-				ImageInfo imageInfo = {};
-				imageInfo.set            = set;
-				imageInfo.binding        = binding;
-				imageInfo.stageFlags     = stageFlags;
-				imageInfo.descriptorType = setLayoutBinding.descriptorType;
-				imageParams.insert(std::make_pair(varName, imageInfo));
-			}
-			else
-			{
-				it->second.stageFlags |= stageFlags;
-			}
-
+            AddResource(reflection, varName, set, binding, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0);
         }
     }
     
-    void DVKShader::ProcessUniformBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags)
+    void DVKShader::ProcessUniformBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
     {
         // 获取Uniform Buffer信息
         for (int32 i = 0; i < resources.uniform_buffers.size(); ++i)
         {
             spirv_cross::Resource& res      = resources.uniform_buffers[i];
             spirv_cross::SPIRType type      = compiler.get_type(res.type_id);
-            spirv_cross::SPIRType base_type = compiler.get_type(res.base_type_id);
             const std::string &varName      = compiler.get_name(res.id);
             const std::string &typeName     = compiler.get_name(res.base_type_id);
             uint32 uniformBufferStructSize  = compiler.get_declared_struct_size(type);
@@ -125,76 +99,31 @@ namespace vk_demo
             int32 binding = compiler.get_decoration(res.id, spv::DecorationBinding);
             
             // [layout (binding = 0) uniform MVPDynamicBlock] 标记为Dynamic的buffer
-            VkDescriptorSetLayoutBinding setLayoutBinding = {};
-            setLayoutBinding.binding             = binding;
-            setLayoutBinding.descriptorType     = (typeName.find("Dynamic") != std::string::npos || dynamicUBO) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            setLayoutBinding.descriptorCount    = 1;
-            setLayoutBinding.stageFlags         = stageFlags;
-            setLayoutBinding.pImmutableSamplers = nullptr;
-            
-            setLayoutsInfo.AddDescriptorSetLayoutBinding(varName, set, setLayoutBinding);
+            // dynamicUBO是DVKShader的参数，在ProcessShaderModule中处理
+            VkDescriptorType descriptorType = typeName.find("Dynamic") != std::string::npos ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
             
-            // 保存UBO变量信息
-            auto it = bufferParams.find(varName);
-            if (it == bufferParams.end())
-            {
-                BufferInfo bufferInfo = {};
-				bufferInfo.set            = set;
-				bufferInfo.binding        = binding;
-				bufferInfo.bufferSize     = uniformBufferStructSize;
-				bufferInfo.stageFlags     = stageFlags;
-				bufferInfo.descriptorType = setLayoutBinding.descriptorType;
-				bufferParams.insert(std::make_pair(varName, bufferInfo));
-            }
-            else
-            {
-                it->second.stageFlags |= setLayoutBinding.stageFlags;
-            }
+            AddResource(reflection, varName, set, binding, descriptorType, uniformBufferStructSize);
         }
     }
     
-    void DVKShader::ProcessTextures(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags)
+    void DVKShader::ProcessTextures(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
     {
         // 获取Texture
         for (int32 i = 0; i < resources.sampled_images.size(); ++i)
         {
             spirv_cross::Resource& res      = resources.sampled_images[i];
-            spirv_cross::SPIRType type      = compiler.get_type(res.type_id);
-            spirv_cross::SPIRType base_type = compiler.get_type(res.base_type_id);
             const std::string&      varName = compiler.get_name(res.id);
             
             int32 set     = compiler.get_decoration(res.id, spv::DecorationDescriptorSet);
             int32 binding = compiler.get_decoration(res.id, spv::DecorationBinding);
             
-            VkDescriptorSetLayoutBinding setLayoutBinding = {};
-            setLayoutBinding.binding             = binding;
-            setLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            setLayoutBinding.descriptorCount    = 1;
-            setLayoutBinding.stageFlags         = stageFlags;
-            setLayoutBinding.pImmutableSamplers = nullptr;
-            
-            setLayoutsInfo.AddDescriptorSetLayoutBinding(varName, set, setLayoutBinding);
-            
-			auto it = imageParams.find(varName);
-			if (it == imageParams.end())
-			{
-				ImageInfo imageInfo = {};
-				imageInfo.set            = set;
-				imageInfo.binding        = binding;
-				imageInfo.stageFlags     = stageFlags;
-				imageInfo.descriptorType = setLayoutBinding.descriptorType;
-				imageParams.insert(std::make_pair(varName, imageInfo));
-			}
-			else
-			{
-				it->second.stageFlags |= stageFlags;
-			}
+            AddResource(reflection, varName, set, binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0);
         }
     }
     
-    void DVKShader::ProcessInput(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags)
+    void DVKShader::ProcessInput(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
     {
-        if (stageFlags != VK_SHADER_STAGE_VERTEX_BIT) {
+        if (reflection.stage != VK_SHADER_STAGE_VERTEX_BIT) {
             return;
         }
 
@@ -229,88 +158,53 @@ namespace vk_demo
             DVKAttribute dvkAttribute = {};
             dvkAttribute.location  = location;
             dvkAttribute.attribute = attribute;
-            m_InputAttributes.push_back(dvkAttribute);
+            reflection.inputAttributes.push_back(dvkAttribute);
         }
     }
     
-	void DVKShader::ProcessStorageBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags)
+	void DVKShader::ProcessStorageBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
 	{
 		for (int32 i = 0; i < resources.storage_buffers.size(); ++i)
 		{
 			spirv_cross::Resource& res      = resources.storage_buffers[i];
-			spirv_cross::SPIRType type      = compiler.get_type(res.type_id);
-			spirv_cross::SPIRType base_type = compiler.get_type(res.base_type_id);
 			const std::string &varName      = compiler.get_name(res.id);
 
 			int32 set     = compiler.get_decoration(res.id, spv::DecorationDescriptorSet);
 			int32 binding = compiler.get_decoration(res.id, spv::DecorationBinding);
 
-			VkDescriptorSetLayoutBinding setLayoutBinding = {};
-			setLayoutBinding.binding            = binding;
-			setLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			setLayoutBinding.descriptorCount    = 1;
-			setLayoutBinding.stageFlags         = stageFlags;
-			setLayoutBinding.pImmutableSamplers = nullptr;
-
-			setLayoutsInfo.AddDescriptorSetLayoutBinding(varName, set, setLayoutBinding);
-
-			// 保存UBO变量信息
-			auto it = bufferParams.find(varName);
-			if (it == bufferParams.end())
-			{
-				BufferInfo bufferInfo = {};
-				bufferInfo.set            = set;
-				bufferInfo.binding        = binding;
-				bufferInfo.bufferSize     = 0;
-				bufferInfo.stageFlags     = stageFlags;
-				bufferInfo.descriptorType = setLayoutBinding.descriptorType;
-				bufferParams.insert(std::make_pair(varName, bufferInfo));
-			}
-			else
-			{
-				it->second.stageFlags = it->second.stageFlags | setLayoutBinding.stageFlags;
-			}
+			AddResource(reflection, varName, set, binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0);
 		}
 	}
 
-    void DVKShader::ProcessStorageImages(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags)
+    void DVKShader::ProcessStorageImages(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
     {
         for (int32 i = 0; i < resources.storage_images.size(); ++i)
         {
             spirv_cross::Resource& res      = resources.storage_images[i];
-            spirv_cross::SPIRType type      = compiler.get_type(res.type_id);
-            spirv_cross::SPIRType base_type = compiler.get_type(res.base_type_id);
             const std::string&      varName = compiler.get_name(res.id);
             
             int32 set     = compiler.get_decoration(res.id, spv::DecorationDescriptorSet);
             int32 binding = compiler.get_decoration(res.id, spv::DecorationBinding);
             
-            VkDescriptorSetLayoutBinding setLayoutBinding = {};
-            setLayoutBinding.binding             = binding;
-            setLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-            setLayoutBinding.descriptorCount    = 1;
-            setLayoutBinding.stageFlags         = stageFlags;
-            setLayoutBinding.pImmutableSamplers = nullptr;
-            
-            setLayoutsInfo.AddDescriptorSetLayoutBinding(varName, set, setLayoutBinding);
-            
-			auto it = imageParams.find(varName);
-			if (it == imageParams.end())
-			{
-				ImageInfo imageInfo = {};
-				imageInfo.set            = set;
-				imageInfo.binding        = binding;
-				imageInfo.stageFlags     = stageFlags;
-				imageInfo.descriptorType = setLayoutBinding.descriptorType;
-				imageParams.insert(std::make_pair(varName, imageInfo));
-			}
-			else
-			{
-				it->second.stageFlags |= stageFlags;
-			}
-            
+            AddResource(reflection, varName, set, binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0);
         }
     }
+
+	void DVKShader::Reflect(const DVKShaderModule* shaderModule, DVKShaderReflection& reflection)
+	{
+		reflection.stage = shaderModule->stage;
+
+		// 反编译Shader获取相关信息
+		spirv_cross::Compiler compiler((uint32*)shaderModule->data, shaderModule->size / sizeof(uint32));
+		spirv_cross::ShaderResources resources = compiler.get_shader_resources();
+		
+        ProcessAttachments(compiler, resources, reflection);
+        ProcessUniformBuffers(compiler, resources, reflection);
+        ProcessTextures(compiler, resources, reflection);
+        ProcessStorageImages(compiler, resources, reflection);
+        ProcessInput(compiler, resources, reflection);
+		ProcessStorageBuffers(compiler, resources, reflection);
+	}
     
 	void DVKShader::ProcessShaderModule(DVKShaderModule* shaderModule)
 	{
@@ -326,17 +220,68 @@ namespace vk_demo
 		shaderCreateInfo.pName  = "main";
 		shaderStageCreateInfos.push_back(shaderCreateInfo);
 
-		// 反编译Shader获取相关信息
-		spirv_cross::Compiler compiler((uint32*)shaderModule->data, shaderModule->size / sizeof(uint32));
-		spirv_cross::ShaderResources resources = compiler.get_shader_resources();
-		
-        ProcessAttachments(compiler, resources, shaderModule->stage);
-        ProcessUniformBuffers(compiler, resources, shaderModule->stage);
-        ProcessTextures(compiler, resources, shaderModule->stage);
-        ProcessStorageImages(compiler, resources, shaderModule->stage);
-        ProcessInput(compiler, resources, shaderModule->stage);
-		ProcessStorageBuffers(compiler, resources, shaderModule->stage);
+		// 相同内容的shader只反射一次
+		const DVKShaderReflection* reflection = DVKShaderCache::GetReflection(shaderModule);
+		VkShaderStageFlags stageFlags = shaderModule->stage;
+
+		for (int32 i = 0; i < reflection->resources.size(); ++i)
+		{
+			const DVKShaderReflection::Resource& resource = reflection->resources[i];
 
+			VkDescriptorSetLayoutBinding setLayoutBinding = {};
+			setLayoutBinding.binding            = resource.binding;
+			setLayoutBinding.descriptorType     = resource.descriptorType;
+			setLayoutBinding.descriptorCount    = 1;
+			setLayoutBinding.stageFlags         = stageFlags;
+			setLayoutBinding.pImmutableSamplers = nullptr;
+
+			if (dynamicUBO && setLayoutBinding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+				setLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			}
+
+			setLayoutsInfo.AddDescriptorSetLayoutBinding(resource.name, resource.set, setLayoutBinding);
+
+			bool isBuffer = setLayoutBinding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || setLayoutBinding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || setLayoutBinding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+			// 保存变量信息
+			if (isBuffer)
+			{
+				auto it = bufferParams.find(resource.name);
+				if (it == bufferParams.end())
+				{
+					BufferInfo bufferInfo = {};
+					bufferInfo.set            = resource.set;
+					bufferInfo.binding        = resource.binding;
+					bufferInfo.bufferSize     = resource.bufferSize;
+					bufferInfo.stageFlags     = stageFlags;
+					bufferInfo.descriptorType = setLayoutBinding.descriptorType;
+					bufferParams.insert(std::make_pair(resource.name, bufferInfo));
+				}
+				else
+				{
+					it->second.stageFlags |= stageFlags;
+				}
+			}
+			else
+			{
+				auto it = imageParams.find(resource.name);
+				if (it == imageParams.end())
+				{
+					ImageInfo imageInfo = {};
+					imageInfo.set            = resource.set;
+					imageInfo.binding        = resource.binding;
+					imageInfo.stageFlags     = stageFlags;
+					imageInfo.descriptorType = setLayoutBinding.descriptorType;
+					imageParams.insert(std::make_pair(resource.name, imageInfo));
+				}
+				else
+				{
+					it->second.stageFlags |= stageFlags;
+				}
+			}
+		}
+
+		m_InputAttributes.insert(m_InputAttributes.end(), reflection->inputAttributes.begin(), reflection->inputAttributes.end());
 	}
 
 	void DVKShader::Compile()
@@ -454,25 +399,154 @@ namespace vk_demo
             });
         }
         
-		for (int32 i = 0; i < setLayoutsInfo.setLayouts.size(); ++i)
+		// 布局相同的shader共享DescriptorSetLayout和PipelineLayout，pipeline之间的layout也因此兼容
+		for (int32 i = 0; i < setLayoutsInfo.setLayouts.size(); ++i) {
+			descriptorSetLayouts.push_back(layoutCache->GetDescriptorSetLayout(setLayoutsInfo.setLayouts[i].bindings));
+		}
+
+		pipelineLayout = layoutCache->GetPipelineLayout(descriptorSetLayouts);
+	}
+
+	DVKDescriptorSet::~DVKDescriptorSet()
+	{
+		if (allocator && !transient) {
+			allocator->Free(descriptorSets.data());
+		}
+		allocator = nullptr;
+	}
+
+	DVKDescriptorSetAllocator::DVKDescriptorSetAllocator(VkDevice inDevice, VulkanDeferredDeletionQueue* inDeletionQueue, const DVKDescriptorSetLayoutsInfo& inSetLayoutsInfo, const std::vector<VkDescriptorSetLayout>& inDescriptorSetLayouts)
+		: device(inDevice)
+		, deletionQueue(inDeletionQueue)
+		, setLayoutsInfo(inSetLayoutsInfo)
+		, descriptorSetLayouts(inDescriptorSetLayouts)
+	{
+
+	}
+
+	DVKDescriptorSetAllocator::~DVKDescriptorSetAllocator()
+	{
+		// pool的销毁走延迟删除队列
+		for (int32 i = 0; i < pools.size(); ++i) {
+			delete pools[i];
+		}
+		pools.clear();
+
+		for (int32 i = 0; i < transientPools.size(); ++i)
 		{
-			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
-			DVKDescriptorSetLayoutInfo& setLayoutInfo = setLayoutsInfo.setLayouts[i];
-			
-			VkDescriptorSetLayoutCreateInfo descSetLayoutInfo;
-			ZeroVulkanStruct(descSetLayoutInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO);
-			descSetLayoutInfo.bindingCount = setLayoutInfo.bindings.size();
-			descSetLayoutInfo.pBindings    = setLayoutInfo.bindings.data();
-			VERIFYVULKANRESULT(vkCreateDescriptorSetLayout(device, &descSetLayoutInfo, VULKAN_CPU_ALLOCATOR, &descriptorSetLayout));
-
-			descriptorSetLayouts.push_back(descriptorSetLayout);
+			TransientPool& transientPool = transientPools[i];
+			for (int32 j = 0; j < transientPool.descriptorSets.size(); ++j) {
+				delete transientPool.descriptorSets[j];
+			}
+			delete transientPool.pool;
 		}
+		transientPools.clear();
+
+		freeSets.clear();
+	}
+
+	DVKDescriptorSetPool* DVKDescriptorSetAllocator::CreatePool(int32 maxGroups)
+	{
+		return new DVKDescriptorSetPool(device, deletionQueue, maxGroups, setLayoutsInfo, descriptorSetLayouts);
+	}
+
+	void DVKDescriptorSetAllocator::Allocate(VkDescriptorSet* descriptorSets)
+	{
+		int32 numSets = descriptorSetLayouts.size();
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// 按释放顺序排列，帧也是按顺序完成的，只需要检查队首
+		if (freeSets.size() > 0 && deletionQueue->IsFrameComplete(freeSets.front().frameNumber))
+		{
+			memcpy(descriptorSets, freeSets.front().descriptorSets.data(), sizeof(VkDescriptorSet) * numSets);
+			freeSets.pop_front();
+			return;
+		}
+
+		if (pools.size() > 0 && pools.back()->AllocateDescriptorSet(descriptorSets)) {
+			return;
+		}
+
+		// 新的pool容量翻倍
+		int32 maxGroups = MIN_POOL_GROUPS;
+		for (int32 i = 0; i < pools.size() && maxGroups < MAX_POOL_GROUPS; ++i) {
+			maxGroups *= 2;
+		}
+
+		DVKDescriptorSetPool* setPool = CreatePool(maxGroups);
+		pools.push_back(setPool);
+		setPool->AllocateDescriptorSet(descriptorSets);
+	}
+
+	void DVKDescriptorSetAllocator::Free(const VkDescriptorSet* descriptorSets)
+	{
+		FreeSets sets;
+		sets.descriptorSets.assign(descriptorSets, descriptorSets + descriptorSetLayouts.size());
+		sets.frameNumber = deletionQueue->GetFrameNumber();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		freeSets.push_back(sets);
+	}
+
+	DVKDescriptorSet* DVKDescriptorSetAllocator::AllocateTransient()
+	{
+		DVKDescriptorSet* dvkSet = new DVKDescriptorSet();
+		dvkSet->device    = device;
+		dvkSet->transient = true;
+		dvkSet->setLayoutsInfo = setLayoutsInfo;
+		dvkSet->descriptorSets.resize(setLayoutsInfo.setLayouts.size());
+
+		uint64 frameNumber = deletionQueue->GetFrameNumber();
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		TransientPool* target = nullptr;
+
+		// 优先使用当前帧已经在用的pool
+		for (int32 i = 0; i < transientPools.size(); ++i)
+		{
+			TransientPool& transientPool = transientPools[i];
+			if (transientPool.frameNumber == frameNumber && transientPool.pool->AllocateDescriptorSet(dvkSet->descriptorSets.data()))
+			{
+				target = &transientPool;
+				break;
+			}
+		}
+
+		// 其次回收GPU已经用完的pool
+		for (int32 i = 0; target == nullptr && i < transientPools.size(); ++i)
+		{
+			TransientPool& transientPool = transientPools[i];
+			if (transientPool.frameNumber == frameNumber || !deletionQueue->IsFrameComplete(transientPool.frameNumber)) {
+				continue;
+			}
+
+			for (int32 j = 0; j < transientPool.descriptorSets.size(); ++j) {
+				delete transientPool.descriptorSets[j];
+			}
+			transientPool.descriptorSets.clear();
+			transientPool.pool->Reset();
+			transientPool.frameNumber = frameNumber;
+			transientPool.pool->AllocateDescriptorSet(dvkSet->descriptorSets.data());
+
+			target = &transientPool;
+		}
+
+		if (target == nullptr)
+		{
+			TransientPool transientPool;
+			transientPool.pool        = CreatePool(MAX_POOL_GROUPS);
+			transientPool.frameNumber = frameNumber;
+			transientPool.pool->AllocateDescriptorSet(dvkSet->descriptorSets.data());
+			transientPools.push_back(transientPool);
+
+			target = &(transientPools.back());
+		}
+
+		target->descriptorSets.push_back(dvkSet);
 
-		VkPipelineLayoutCreateInfo pipeLayoutInfo;
-		ZeroVulkanStruct(pipeLayoutInfo, VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO);
-		pipeLayoutInfo.setLayoutCount = descriptorSetLayouts.size();
-		pipeLayoutInfo.pSetLayouts    = descriptorSetLayouts.data();
-		VERIFYVULKANRESULT(vkCreatePipelineLayout(device, &pipeLayoutInfo, VULKAN_CPU_ALLOCATOR, &pipelineLayout));
+		return dvkSet;
 	}
 	
 };
@@ -3,11 +3,14 @@
 #include <string>
 #include <cstring>
 #include <memory>
+#include <mutex>
+#include <deque>
 #include <unordered_map>
 
 #include "DVKUtils.h"
 #include "DVKBuffer.h"
 #include "DVKTexture.h"
+#include "DVKShaderCache.h"
 
 #include "FileManager.h"
 #include "Vulkan/VulkanCommon.h"
@@ -20,6 +23,7 @@ namespace spirv_cross
 
 namespace vk_demo
 {
+	class DVKDescriptorSetAllocator;
     
 	class DVKDescriptorSetLayoutInfo
 	{
@@ -131,8 +135,41 @@ namespace vk_demo
 		int32			location;
 	};
 
+	// 单个shader module的反射结果，由DVKShaderCache按内容缓存
+	struct DVKShaderReflection
+	{
+		struct Resource
+		{
+			std::string			name;
+			int32				set = 0;
+			int32				binding = 0;
+			VkDescriptorType	descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			uint32				bufferSize = 0;
+		};
+
+		VkShaderStageFlagBits		stage = VK_SHADER_STAGE_VERTEX_BIT;
+		std::vector<Resource>		resources;
+		std::vector<DVKAttribute>	inputAttributes;
+	};
+
 	class DVKDescriptorSet
 	{
+	private:
+		struct BindingHandle
+		{
+			int32				set;
+			int32				binding;
+			VkDescriptorType	descriptorType;
+		};
+
+		struct PendingWrite
+		{
+			int32					handle;
+			bool					isImage;
+			VkDescriptorImageInfo	imageInfo;
+			VkDescriptorBufferInfo	bufferInfo;
+		};
+
 	public:
 
 		DVKDescriptorSet()
@@ -140,73 +177,157 @@ namespace vk_demo
 
 		}
 
-		~DVKDescriptorSet()
-		{
-			
-		}
-        
-		void WriteImage(const std::string& name, DVKTexture* texture)
+		~DVKDescriptorSet();
+
+		// 名字只在这里查找一次，之后使用返回的handle写入。找不到时返回-1
+		int32 GetBindingHandle(const std::string& name)
 		{
 			auto it = setLayoutsInfo.paramsMap.find(name);
 			if (it == setLayoutsInfo.paramsMap.end()) 
 			{
 				MLOGE("Failed write buffer, %s not found!", name.c_str());
-				return;
+				return -1;
 			}
 
 			auto bindInfo = it->second;
 
-			VkWriteDescriptorSet writeDescriptorSet;
-			ZeroVulkanStruct(writeDescriptorSet, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
-			writeDescriptorSet.dstSet          = descriptorSets[bindInfo.set];
-			writeDescriptorSet.descriptorCount = 1;
-			writeDescriptorSet.descriptorType  = setLayoutsInfo.GetDescriptorType(bindInfo.set, bindInfo.binding);
-			writeDescriptorSet.pBufferInfo     = nullptr;
-			writeDescriptorSet.pImageInfo      = &(texture->descriptorInfo);
-			writeDescriptorSet.dstBinding      = bindInfo.binding;
-			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+			for (int32 i = 0; i < bindingHandles.size(); ++i)
+			{
+				if (bindingHandles[i].set == bindInfo.set && bindingHandles[i].binding == bindInfo.binding) {
+					return i;
+				}
+			}
+
+			BindingHandle handle;
+			handle.set            = bindInfo.set;
+			handle.binding        = bindInfo.binding;
+			handle.descriptorType = setLayoutsInfo.GetDescriptorType(bindInfo.set, bindInfo.binding);
+			bindingHandles.push_back(handle);
+
+			return bindingHandles.size() - 1;
 		}
 
-		void WriteBuffer(const std::string& name, const VkDescriptorBufferInfo* bufferInfo)
+		// BeginUpdate和EndUpdate之间的写入会合并为一次vkUpdateDescriptorSets，可以嵌套
+		void BeginUpdate()
 		{
-			auto it = setLayoutsInfo.paramsMap.find(name);
-			if (it == setLayoutsInfo.paramsMap.end()) 
+			updateDepth += 1;
+		}
+
+		void EndUpdate()
+		{
+			updateDepth -= 1;
+			if (updateDepth == 0) {
+				Flush();
+			}
+		}
+
+		void WriteImage(int32 handle, DVKTexture* texture)
+		{
+			PendingWrite* write = AddWrite(handle);
+			if (write)
 			{
-				MLOGE("Failed write buffer, %s not found!", name.c_str());
-				return;
+				write->isImage   = true;
+				write->imageInfo = texture->descriptorInfo;
+				FlushIfNeeded();
 			}
+		}
 
-			auto bindInfo = it->second;
+		void WriteBuffer(int32 handle, const VkDescriptorBufferInfo* bufferInfo)
+		{
+			PendingWrite* write = AddWrite(handle);
+			if (write)
+			{
+				write->isImage    = false;
+				write->bufferInfo = *bufferInfo;
+				FlushIfNeeded();
+			}
+		}
 
-			VkWriteDescriptorSet writeDescriptorSet;
-			ZeroVulkanStruct(writeDescriptorSet, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
-			writeDescriptorSet.dstSet          = descriptorSets[bindInfo.set];
-			writeDescriptorSet.descriptorCount = 1;
-			writeDescriptorSet.descriptorType  = setLayoutsInfo.GetDescriptorType(bindInfo.set, bindInfo.binding);
-			writeDescriptorSet.pBufferInfo     = bufferInfo;
-			writeDescriptorSet.dstBinding      = bindInfo.binding;
-			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		void WriteBuffer(int32 handle, DVKBuffer* buffer)
+		{
+			WriteBuffer(handle, &(buffer->descriptor));
+		}
+        
+		void WriteImage(const std::string& name, DVKTexture* texture)
+		{
+			int32 handle = GetBindingHandle(name);
+			if (handle >= 0) {
+				WriteImage(handle, texture);
+			}
+		}
+
+		void WriteBuffer(const std::string& name, const VkDescriptorBufferInfo* bufferInfo)
+		{
+			int32 handle = GetBindingHandle(name);
+			if (handle >= 0) {
+				WriteBuffer(handle, bufferInfo);
+			}
 		}
 
 		void WriteBuffer(const std::string& name, DVKBuffer* buffer)
 		{
-			auto it = setLayoutsInfo.paramsMap.find(name);
-			if (it == setLayoutsInfo.paramsMap.end()) 
-			{
-				MLOGE("Failed write buffer, %s not found!", name.c_str());
+			int32 handle = GetBindingHandle(name);
+			if (handle >= 0) {
+				WriteBuffer(handle, buffer);
+			}
+		}
+
+		void Flush()
+		{
+			if (pendingWrites.size() == 0) {
 				return;
 			}
 
-			auto bindInfo = it->second;
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets(pendingWrites.size());
+			for (int32 i = 0; i < pendingWrites.size(); ++i)
+			{
+				const PendingWrite& write = pendingWrites[i];
+				const BindingHandle& bindInfo = bindingHandles[write.handle];
+
+				VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[i];
+				ZeroVulkanStruct(writeDescriptorSet, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
+				writeDescriptorSet.dstSet          = descriptorSets[bindInfo.set];
+				writeDescriptorSet.descriptorCount = 1;
+				writeDescriptorSet.descriptorType  = bindInfo.descriptorType;
+				writeDescriptorSet.pBufferInfo     = write.isImage ? nullptr : &(write.bufferInfo);
+				writeDescriptorSet.pImageInfo      = write.isImage ? &(write.imageInfo) : nullptr;
+				writeDescriptorSet.dstBinding      = bindInfo.binding;
+			}
 
-			VkWriteDescriptorSet writeDescriptorSet;
-			ZeroVulkanStruct(writeDescriptorSet, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
-			writeDescriptorSet.dstSet          = descriptorSets[bindInfo.set];
-			writeDescriptorSet.descriptorCount = 1;
-			writeDescriptorSet.descriptorType  = setLayoutsInfo.GetDescriptorType(bindInfo.set, bindInfo.binding);
-			writeDescriptorSet.pBufferInfo     = &(buffer->descriptor);
-			writeDescriptorSet.dstBinding      = bindInfo.binding;
-			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+			vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
+			pendingWrites.clear();
+		}
+
+	private:
+
+		PendingWrite* AddWrite(int32 handle)
+		{
+			if (handle < 0 || handle >= bindingHandles.size())
+			{
+				MLOGE("Invalid binding handle %d.", handle);
+				return nullptr;
+			}
+
+			// 同一个binding在一次批量更新中只保留最后一次写入
+			for (int32 i = 0; i < pendingWrites.size(); ++i)
+			{
+				if (pendingWrites[i].handle == handle) {
+					return &(pendingWrites[i]);
+				}
+			}
+
+			PendingWrite write = {};
+			write.handle = handle;
+			pendingWrites.push_back(write);
+
+			return &(pendingWrites.back());
+		}
+
+		void FlushIfNeeded()
+		{
+			if (updateDepth == 0) {
+				Flush();
+			}
 		}
 
 	public:
@@ -215,28 +336,51 @@ namespace vk_demo
 
 		DVKDescriptorSetLayoutsInfo		setLayoutsInfo;
 		std::vector<VkDescriptorSet>	descriptorSets;
+
+		// 析构时把descriptorSets归还给allocator，transient的由allocator在帧结束后统一回收
+		std::shared_ptr<DVKDescriptorSetAllocator>	allocator;
+		bool										transient = false;
+
+	private:
+		std::vector<BindingHandle>		bindingHandles;
+		std::vector<PendingWrite>		pendingWrites;
+		int32							updateDepth = 0;
 	};
 
 	class DVKDescriptorSetPool
 	{
 	public:
-		DVKDescriptorSetPool(VkDevice inDevice, int32 inMaxSet, const DVKDescriptorSetLayoutsInfo& setLayoutsInfo, const std::vector<VkDescriptorSetLayout>& inDescriptorSetLayouts)
+		// maxGroups为可以分配的DescriptorSet组数，每组包含所有的setLayout
+		DVKDescriptorSetPool(VkDevice inDevice, VulkanDeferredDeletionQueue* inDeletionQueue, int32 maxGroups, const DVKDescriptorSetLayoutsInfo& setLayoutsInfo, const std::vector<VkDescriptorSetLayout>& inDescriptorSetLayouts)
 		{
 			device  = inDevice;
-			maxSet  = inMaxSet;
+			deletionQueue = inDeletionQueue;
+			maxSet  = maxGroups * inDescriptorSetLayouts.size();
 			usedSet = 0;
 			descriptorSetLayouts = inDescriptorSetLayouts;
 
+			// 同类型的descriptor合并到一起
 			std::vector<VkDescriptorPoolSize> poolSizes;
 			for (int32 i = 0; i < setLayoutsInfo.setLayouts.size(); ++i)
 			{
 				const DVKDescriptorSetLayoutInfo& setLayoutInfo = setLayoutsInfo.setLayouts[i];
 				for (int32 j = 0; j < setLayoutInfo.bindings.size(); ++j)
 				{
-					VkDescriptorPoolSize poolSize = {};
-					poolSize.type            = setLayoutInfo.bindings[j].descriptorType;
-					poolSize.descriptorCount = setLayoutInfo.bindings[j].descriptorCount;
-					poolSizes.push_back(poolSize);
+					const VkDescriptorSetLayoutBinding& binding = setLayoutInfo.bindings[j];
+
+					int32 index = 0;
+					while (index < poolSizes.size() && poolSizes[index].type != binding.descriptorType) {
+						index += 1;
+					}
+
+					if (index == poolSizes.size())
+					{
+						VkDescriptorPoolSize poolSize = {};
+						poolSize.type = binding.descriptorType;
+						poolSizes.push_back(poolSize);
+					}
+
+					poolSizes[index].descriptorCount += binding.descriptorCount * maxGroups;
 				}
 			}
 
@@ -252,7 +396,8 @@ namespace vk_demo
 		{
 			if (descriptorPool != VK_NULL_HANDLE)
 			{
-				vkDestroyDescriptorPool(device, descriptorPool, VULKAN_CPU_ALLOCATOR);
+				// 分配出去的DescriptorSet可能还在被in flight的帧使用
+				deletionQueue->EnqueueResource(VulkanDeferredDeletionQueue::Type::DescriptorPool, descriptorPool);
 				descriptorPool = VK_NULL_HANDLE;
 			}
 		}
@@ -264,7 +409,7 @@ namespace vk_demo
 
 		bool AllocateDescriptorSet(VkDescriptorSet* descriptorSet)
 		{
-			if (usedSet + descriptorSetLayouts.size() >= maxSet) {
+			if (usedSet + descriptorSetLayouts.size() > maxSet) {
 				return false;
 			}
 
@@ -279,15 +424,86 @@ namespace vk_demo
 
 			return true;
 		}
+
+		// 调用者需要保证从这个pool分配的DescriptorSet都已经不再被GPU使用
+		void Reset()
+		{
+			VERIFYVULKANRESULT(vkResetDescriptorPool(device, descriptorPool, 0));
+			usedSet = 0;
+		}
 		
 	public:
 		int32								maxSet;
 		int32								usedSet;
 		VkDevice							device = VK_NULL_HANDLE;
+		VulkanDeferredDeletionQueue*		deletionQueue = nullptr;
 		std::vector<VkDescriptorSetLayout>	descriptorSetLayouts;
 		VkDescriptorPool					descriptorPool = VK_NULL_HANDLE;
 	};
 
+	// 同一个shader的DescriptorSet分配器，有两种用法：
+	// Allocate分配长期存在的DescriptorSet，释放后进入空闲列表，等释放时的帧在GPU上完成之后再复用。
+	// AllocateTransient分配只在当前帧有效的DescriptorSet，帧完成之后整个pool通过vkResetDescriptorPool一次性回收。
+	class DVKDescriptorSetAllocator
+	{
+	private:
+		struct FreeSets
+		{
+			std::vector<VkDescriptorSet>	descriptorSets;
+			uint64							frameNumber;
+		};
+
+		struct TransientPool
+		{
+			DVKDescriptorSetPool*			pool;
+			uint64							frameNumber;
+			std::vector<DVKDescriptorSet*>	descriptorSets;
+		};
+
+		enum
+		{
+			MIN_POOL_GROUPS = 32,
+			MAX_POOL_GROUPS = 512,
+		};
+
+	public:
+		DVKDescriptorSetAllocator(VkDevice inDevice, VulkanDeferredDeletionQueue* inDeletionQueue, const DVKDescriptorSetLayoutsInfo& inSetLayoutsInfo, const std::vector<VkDescriptorSetLayout>& inDescriptorSetLayouts);
+
+		~DVKDescriptorSetAllocator();
+
+		void Allocate(VkDescriptorSet* descriptorSets);
+
+		void Free(const VkDescriptorSet* descriptorSets);
+
+		// 返回的对象由allocator持有，不要delete
+		DVKDescriptorSet* AllocateTransient();
+
+		inline int32 GetNumPools() const
+		{
+			return pools.size() + transientPools.size();
+		}
+
+		inline int32 GetNumFreeSets() const
+		{
+			return freeSets.size();
+		}
+
+	private:
+		DVKDescriptorSetPool* CreatePool(int32 maxGroups);
+
+	public:
+		VkDevice							device = VK_NULL_HANDLE;
+		VulkanDeferredDeletionQueue*		deletionQueue = nullptr;
+		DVKDescriptorSetLayoutsInfo			setLayoutsInfo;
+		std::vector<VkDescriptorSetLayout>	descriptorSetLayouts;
+
+	private:
+		std::mutex							mutex;
+		std::vector<DVKDescriptorSetPool*>	pools;
+		std::deque<FreeSets>				freeSets;
+		std::vector<TransientPool>			transientPools;
+	};
+
 	class DVKShaderModule
 	{
 	private:
@@ -300,16 +516,12 @@ namespace vk_demo
 		
 		~DVKShaderModule()
 		{
+			// handle和data由DVKShaderCache持有
 			if (handle != VK_NULL_HANDLE) 
 			{
-				vkDestroyShaderModule(device, handle, VULKAN_CPU_ALLOCATOR);
+				DVKShaderCache::ReleaseModule(this);
 				handle = VK_NULL_HANDLE;
-			}
-			
-			if (data) 
-			{
-				delete[] data;
-				data = nullptr;
+				data   = nullptr;
 			}
 		}
 
@@ -317,11 +529,12 @@ namespace vk_demo
 		
 	public:
 
-		VkDevice				device;
-		VkShaderStageFlagBits	stage;
-		VkShaderModule			handle;
-		uint8*					data;
-		uint32					size;
+		VkDevice				device = VK_NULL_HANDLE;
+		VkShaderStageFlagBits	stage = VK_SHADER_STAGE_VERTEX_BIT;
+		VkShaderModule			handle = VK_NULL_HANDLE;
+		uint8*					data = nullptr;
+		uint32					size = 0;
+		uint64					hash = 0;
 	};
 
 	class DVKShader
@@ -346,7 +559,6 @@ namespace vk_demo
 	private:
 		typedef std::vector<VkPipelineShaderStageCreateInfo>	ShaderStageInfoArray;
 		typedef std::vector<VkDescriptorSetLayout>				DescriptorSetLayouts;
-		typedef std::vector<DVKDescriptorSetPool*>				DVKDescriptorSetPools;
 
 		DVKShader()
 		{
@@ -392,22 +604,12 @@ namespace vk_demo
 				teseShaderModule = nullptr;
 			}
 
-			for (int32 i = 0; i < descriptorSetLayouts.size(); ++i) {
-				vkDestroyDescriptorSetLayout(device, descriptorSetLayouts[i], VULKAN_CPU_ALLOCATOR);
-			}
+			// layout由VulkanLayoutCache持有
 			descriptorSetLayouts.clear();
+			pipelineLayout = VK_NULL_HANDLE;
 
-			if (pipelineLayout != VK_NULL_HANDLE)
-			{
-				vkDestroyPipelineLayout(device, pipelineLayout, VULKAN_CPU_ALLOCATOR);
-				pipelineLayout = VK_NULL_HANDLE;
-			}
-
-			for (int32 i = 0; i < descriptorSetPools.size(); ++i) {
-				delete descriptorSetPools[i];
-			}
-			descriptorSetPools.clear();
-			
+			// 还未释放的DescriptorSet也持有allocator，pool在它们全部释放之后才销毁
+			descriptorAllocator = nullptr;
 		}
 
 		static DVKShader* Create(std::shared_ptr<VulkanDevice> vulkanDevice, const char* comp); 
@@ -426,22 +628,34 @@ namespace vk_demo
 			dvkSet->device = device;
 			dvkSet->setLayoutsInfo = setLayoutsInfo;
 			dvkSet->descriptorSets.resize(setLayoutsInfo.setLayouts.size());
+			dvkSet->allocator = GetDescriptorAllocator();
+			dvkSet->allocator->Allocate(dvkSet->descriptorSets.data());
 
-			for (int32 i = descriptorSetPools.size() - 1; i >= 0; --i)
-			{
-				if (descriptorSetPools[i]->AllocateDescriptorSet(dvkSet->descriptorSets.data())) {
-					return dvkSet;
-				}
+			return dvkSet;
+		}
+
+		// 只在当前帧有效，适合每帧都会变化的逐物体参数。不需要也不能delete
+		DVKDescriptorSet* AllocateTransientDescriptorSet()
+		{
+			if (setLayoutsInfo.setLayouts.size() == 0) {
+				return nullptr;
 			}
 
-			DVKDescriptorSetPool* setPool = new DVKDescriptorSetPool(device, 64, setLayoutsInfo, descriptorSetLayouts);
-			descriptorSetPools.push_back(setPool);
-			setPool->AllocateDescriptorSet(dvkSet->descriptorSets.data());
+			return GetDescriptorAllocator()->AllocateTransient();
+		}
 
-			return dvkSet;
+		std::shared_ptr<DVKDescriptorSetAllocator> GetDescriptorAllocator()
+		{
+			if (!descriptorAllocator) {
+				descriptorAllocator = std::make_shared<DVKDescriptorSetAllocator>(device, deletionQueue, setLayoutsInfo, descriptorSetLayouts);
+			}
+			return descriptorAllocator;
 		}
 
 	private:
+		friend class DVKShaderCache;
+
+		static void Reflect(const DVKShaderModule* shaderModule, DVKShaderReflection& reflection);
 
 		void Compile();
 
@@ -449,17 +663,19 @@ namespace vk_demo
         
         void GenerateInputInfo();
 
-		void ProcessStorageBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags);
+		static void ProcessStorageBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
         
-        void ProcessStorageImages(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags);
+        static void ProcessStorageImages(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
         
-        void ProcessInput(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags);
+        static void ProcessInput(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
         
-        void ProcessTextures(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags);
+        static void ProcessTextures(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
 
-        void ProcessAttachments(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkPipelineStageFlags stageFlags);
+        static void ProcessAttachments(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
+        
+        static void ProcessUniformBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
         
-        void ProcessUniformBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags);
+        static void AddResource(DVKShaderReflection& reflection, const std::string& name, int32 set, int32 binding, VkDescriptorType descriptorType, uint32 bufferSize);
         
 		void ProcessShaderModule(DVKShaderModule* shaderModule);
 
@@ -479,6 +695,8 @@ namespace vk_demo
 		DVKShaderModule*				teseShaderModule = nullptr;
 
 		VkDevice						device = VK_NULL_HANDLE;
+		VulkanDeferredDeletionQueue*	deletionQueue = nullptr;
+		VulkanLayoutCache*				layoutCache = nullptr;
         bool                            dynamicUBO = false;
 
 		ShaderStageInfoArray			shaderStageCreateInfos;
@@ -490,7 +708,7 @@ namespace vk_demo
         
 		DescriptorSetLayouts 			descriptorSetLayouts;
 		VkPipelineLayout 				pipelineLayout = VK_NULL_HANDLE;
-		DVKDescriptorSetPools			descriptorSetPools;
+		std::shared_ptr<DVKDescriptorSetAllocator>	descriptorAllocator;
 
 		std::unordered_map<std::string, BufferInfo>	bufferParams;
 		std::unordered_map<std::string, ImageInfo>	imageParams;
@@ -0,0 +1,287 @@
+﻿#include "DVKShaderCache.h"
+#include "DVKShader.h"
+#include "FileManager.h"
+
+#include "Utils/Crc.h"
+#include "Utils/BinaryStream.h"
+
+#include <vector>
+
+namespace vk_demo
+{
+
+	std::mutex																DVKShaderCache::s_Mutex;
+	std::unordered_map<std::string, uint64>									DVKShaderCache::s_FileHashes;
+	std::map<DVKShaderCache::ModuleKey, DVKShaderCache::ModuleEntry>		DVKShaderCache::s_Modules;
+	std::map<DVKShaderCache::ReflectionKey, DVKShaderReflection>			DVKShaderCache::s_Reflections;
+	bool																	DVKShaderCache::s_Dirty = false;
+
+	bool DVKShaderCache::AcquireModule(std::shared_ptr<VulkanDevice> vulkanDevice, const char* filename, DVKShaderModule* shaderModule)
+	{
+		VkDevice device = vulkanDevice->GetInstanceHandle();
+
+		// 同一个文件已经加载过并且module还存活，直接复用
+		{
+			std::lock_guard<std::mutex> lock(s_Mutex);
+			auto fileIt = s_FileHashes.find(filename);
+			if (fileIt != s_FileHashes.end())
+			{
+				auto it = s_Modules.find(ModuleKey(device, fileIt->second));
+				if (it != s_Modules.end())
+				{
+					it->second.refCount += 1;
+					shaderModule->hash   = fileIt->second;
+					shaderModule->handle = it->second.handle;
+					shaderModule->data   = it->second.data;
+					shaderModule->size   = it->second.size;
+					return true;
+				}
+			}
+		}
+
+		uint8* dataPtr  = nullptr;
+		uint32 dataSize = 0;
+		if (!FileManager::ReadFile(filename, dataPtr, dataSize)) {
+			return false;
+		}
+
+		uint64 hash = HashFileContent(dataPtr, dataSize);
+
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		s_FileHashes[filename] = hash;
+
+		// 内容相同的其它文件
+		ModuleEntry& entry = s_Modules[ModuleKey(device, hash)];
+		if (entry.handle != VK_NULL_HANDLE)
+		{
+			delete[] dataPtr;
+		}
+		else
+		{
+			VkShaderModuleCreateInfo moduleCreateInfo;
+			ZeroVulkanStruct(moduleCreateInfo, VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO);
+			moduleCreateInfo.codeSize = dataSize;
+			moduleCreateInfo.pCode    = (uint32_t*)dataPtr;
+			VERIFYVULKANRESULT(vkCreateShaderModule(device, &moduleCreateInfo, VULKAN_CPU_ALLOCATOR, &entry.handle));
+
+			entry.data = dataPtr;
+			entry.size = dataSize;
+		}
+
+		entry.refCount += 1;
+		shaderModule->hash   = hash;
+		shaderModule->handle = entry.handle;
+		shaderModule->data   = entry.data;
+		shaderModule->size   = entry.size;
+
+		return true;
+	}
+
+	void DVKShaderCache::ReleaseModule(DVKShaderModule* shaderModule)
+	{
+		std::lock_guard<std::mutex> lock(s_Mutex);
+
+		auto it = s_Modules.find(ModuleKey(shaderModule->device, shaderModule->hash));
+		if (it == s_Modules.end()) {
+			return;
+		}
+
+		ModuleEntry& entry = it->second;
+		entry.refCount -= 1;
+		if (entry.refCount > 0) {
+			return;
+		}
+
+		// 反射结果是CPU数据，一直保留
+		vkDestroyShaderModule(shaderModule->device, entry.handle, VULKAN_CPU_ALLOCATOR);
+		delete[] entry.data;
+		s_Modules.erase(it);
+	}
+
+	const DVKShaderReflection* DVKShaderCache::GetReflection(const DVKShaderModule* shaderModule)
+	{
+		ReflectionKey key(shaderModule->hash, (uint32)shaderModule->stage);
+
+		{
+			std::lock_guard<std::mutex> lock(s_Mutex);
+			auto it = s_Reflections.find(key);
+			if (it != s_Reflections.end()) {
+				return &(it->second);
+			}
+		}
+
+		DVKShaderReflection reflection;
+		DVKShader::Reflect(shaderModule, reflection);
+
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		auto result = s_Reflections.insert(std::make_pair(key, reflection));
+		if (result.second) {
+			s_Dirty = true;
+		}
+
+		return &(result.first->second);
+	}
+
+	bool DVKShaderCache::Load(const std::string& filename)
+	{
+		uint8* dataPtr  = nullptr;
+		uint32 dataSize = 0;
+		if (!FileManager::ReadCacheFile(filename, dataPtr, dataSize)) {
+			return false;
+		}
+
+		FileHeader header;
+		const char* error = nullptr;
+
+		if (dataSize < sizeof(FileHeader)) {
+			error = "file too small";
+		}
+		else
+		{
+			memcpy(&header, dataPtr, sizeof(FileHeader));
+			if (header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+				error = "unknown format";
+			}
+			else if (header.dataSize != dataSize - sizeof(FileHeader)) {
+				error = "size mismatch";
+			}
+			else if (Crc::MemCrc32(dataPtr + sizeof(FileHeader), header.dataSize) != header.dataCrc) {
+				error = "crc mismatch";
+			}
+		}
+
+		std::vector<std::pair<ReflectionKey, DVKShaderReflection>> reflections;
+
+		BinaryReader reader;
+		reader.data   = dataPtr + sizeof(FileHeader);
+		reader.size   = error ? 0 : header.dataSize;
+		reader.offset = 0;
+
+		for (uint32 i = 0; error == nullptr && i < header.count; ++i)
+		{
+			ReflectionKey key;
+			DVKShaderReflection reflection;
+			uint32 stage = 0;
+			uint32 numResources = 0;
+			uint32 numInputs = 0;
+
+			if (!reader.Read(key.first) || !reader.Read(stage) || !reader.Read(numResources)) {
+				error = "truncated";
+				break;
+			}
+
+			if (numResources > reader.Remaining()) {
+				error = "truncated";
+				break;
+			}
+
+			key.second = stage;
+			reflection.stage = (VkShaderStageFlagBits)stage;
+			reflection.resources.resize(numResources);
+
+			for (uint32 j = 0; j < numResources && error == nullptr; ++j)
+			{
+				DVKShaderReflection::Resource& resource = reflection.resources[j];
+				uint32 descriptorType = 0;
+
+				if (!reader.ReadString(resource.name) || !reader.Read(resource.set) || !reader.Read(resource.binding) || !reader.Read(descriptorType) || !reader.Read(resource.bufferSize)) {
+					error = "truncated";
+					break;
+				}
+				resource.descriptorType = (VkDescriptorType)descriptorType;
+			}
+
+			if (error || !reader.Read(numInputs) || numInputs > reader.Remaining() / (sizeof(int32) * 2)) {
+				error = "truncated";
+				break;
+			}
+
+			reflection.inputAttributes.resize(numInputs);
+			for (uint32 j = 0; j < numInputs; ++j)
+			{
+				int32 attribute = 0;
+				reader.Read(reflection.inputAttributes[j].location);
+				reader.Read(attribute);
+				reflection.inputAttributes[j].attribute = (VertexAttribute)attribute;
+			}
+
+			reflections.push_back(std::make_pair(key, reflection));
+		}
+
+		delete[] dataPtr;
+
+		if (error)
+		{
+			MLOG("Shader cache %s rejected: %s", filename.c_str(), error);
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		for (int32 i = 0; i < reflections.size(); ++i) {
+			s_Reflections.insert(reflections[i]);
+		}
+
+		MLOG("Shader cache %s loaded, %d shaders.", filename.c_str(), (int32)reflections.size());
+
+		return true;
+	}
+
+	bool DVKShaderCache::Save(const std::string& filename)
+	{
+		BinaryWriter writer;
+		FileHeader header = {};
+
+		{
+			std::lock_guard<std::mutex> lock(s_Mutex);
+			if (!s_Dirty) {
+				return false;
+			}
+
+			writer.Write(header);
+
+			for (auto it = s_Reflections.begin(); it != s_Reflections.end(); ++it)
+			{
+				const DVKShaderReflection& reflection = it->second;
+
+				writer.Write(it->first.first);
+				writer.Write(it->first.second);
+				writer.Write((uint32)reflection.resources.size());
+
+				for (int32 i = 0; i < reflection.resources.size(); ++i)
+				{
+					const DVKShaderReflection::Resource& resource = reflection.resources[i];
+					writer.WriteString(resource.name);
+					writer.Write(resource.set);
+					writer.Write(resource.binding);
+					writer.Write((uint32)resource.descriptorType);
+					writer.Write(resource.bufferSize);
+				}
+
+				writer.Write((uint32)reflection.inputAttributes.size());
+				for (int32 i = 0; i < reflection.inputAttributes.size(); ++i)
+				{
+					writer.Write(reflection.inputAttributes[i].location);
+					writer.Write((int32)reflection.inputAttributes[i].attribute);
+				}
+			}
+
+			header.count = (uint32)s_Reflections.size();
+			s_Dirty = false;
+		}
+
+		header.magic    = FILE_MAGIC;
+		header.version  = FILE_VERSION;
+		header.dataSize = (uint32)(writer.data.size() - sizeof(FileHeader));
+		header.dataCrc  = Crc::MemCrc32(writer.data.data() + sizeof(FileHeader), header.dataSize);
+		memcpy(writer.data.data(), &header, sizeof(FileHeader));
+
+		if (!FileManager::WriteCacheFile(filename, writer.data.data(), (uint32)writer.data.size())) {
+			return false;
+		}
+
+		MLOG("Shader cache %s saved, %d shaders.", filename.c_str(), (int32)header.count);
+
+		return true;
+	}
+
+};
@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include "Common/Common.h"
+#include "Vulkan/VulkanCommon.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+class VulkanDevice;
+
+namespace vk_demo
+{
+	class DVKShaderModule;
+	struct DVKShaderReflection;
+
+	// 按SPIR-V内容的hash缓存VkShaderModule以及spirv-cross反射的结果。
+	// 同一个spv文件重复加载时不再读取文件，也不再重新反射，只是一次查表。
+	// 反射结果可以通过Load/Save保存到磁盘，下次启动时直接使用。
+	class DVKShaderCache
+	{
+	private:
+		enum
+		{
+			FILE_MAGIC   = 0x43535644, // DVSC
+			FILE_VERSION = 1,
+		};
+
+		struct FileHeader
+		{
+			uint32	magic;
+			uint32	version;
+			uint32	count;
+			uint32	dataSize;
+			uint32	dataCrc;
+		};
+
+		struct ModuleEntry
+		{
+			VkShaderModule	handle = VK_NULL_HANDLE;
+			uint8*			data = nullptr;
+			uint32			size = 0;
+			int32			refCount = 0;
+		};
+
+		typedef std::pair<VkDevice, uint64>		ModuleKey;
+		typedef std::pair<uint64, uint32>		ReflectionKey;
+
+	public:
+		// 加载磁盘上的反射结果，已经存在的条目不会被覆盖
+		static bool Load(const std::string& filename);
+
+		// 只有产生了新的反射结果时才会写入
+		static bool Save(const std::string& filename);
+
+	private:
+		friend class DVKShaderModule;
+		friend class DVKShader;
+
+		static bool AcquireModule(std::shared_ptr<VulkanDevice> vulkanDevice, const char* filename, DVKShaderModule* shaderModule);
+
+		static void ReleaseModule(DVKShaderModule* shaderModule);
+
+		static const DVKShaderReflection* GetReflection(const DVKShaderModule* shaderModule);
+
+	private:
+		static std::mutex										s_Mutex;
+		static std::unordered_map<std::string, uint64>			s_FileHashes;
+		static std::map<ModuleKey, ModuleEntry>					s_Modules;
+		static std::map<ReflectionKey, DVKShaderReflection>		s_Reflections;
+		static bool												s_Dirty;
+	};
+
+};
@@ -1,6 +1,7 @@
 ﻿#include "DVKTexture.h"
 #include "DVKBuffer.h"
 #include "DVKUtils.h"
+#include "DVKUploadContext.h"
 #include "FileManager.h"
 
 #include "Math/Math.h"
@@ -8,21 +9,111 @@
 
 namespace vk_demo
 {
+	// 超过该尺寸的RenderTarget独占一块VkDeviceMemory，避免长期占用page造成碎片
+	static const VkDeviceSize DEDICATED_RENDER_TARGET_SIZE = 16 * 1024 * 1024;
+
+	static VulkanResourceAllocation* AllocateImageMemory(std::shared_ptr<VulkanDevice> vulkanDevice, const VkMemoryRequirements& memReqs, VkImageUsageFlags usage)
+	{
+		VulkanResourceHeapManager& heapManager = vulkanDevice->GetResourceHeapManager();
+		bool isRenderTarget = (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+		if (isRenderTarget && memReqs.size >= DEDICATED_RENDER_TARGET_SIZE) {
+			return heapManager.AllocateDedicatedImageMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, __FILE__, __LINE__);
+		}
+		return heapManager.AllocateImageMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, __FILE__, __LINE__);
+	}
+
     
+	void DVKTexture::DestroyResource(VulkanDeferredDeletionQueue::Type type, uint64 handle)
+	{
+		// 可能还在被in flight的帧使用，交给DeferredDeletionQueue等帧完成后释放
+		if (vulkanDevice) {
+			vulkanDevice->GetDeferredDeletionQueue().EnqueueResource(type, handle);
+			return;
+		}
+
+		switch (type)
+		{
+		case VulkanDeferredDeletionQueue::Type::ImageView:
+			vkDestroyImageView(device, (VkImageView)handle, VULKAN_CPU_ALLOCATOR);
+			break;
+		case VulkanDeferredDeletionQueue::Type::Image:
+			vkDestroyImage(device, (VkImage)handle, VULKAN_CPU_ALLOCATOR);
+			break;
+		case VulkanDeferredDeletionQueue::Type::Sampler:
+			vkDestroySampler(device, (VkSampler)handle, VULKAN_CPU_ALLOCATOR);
+			break;
+		case VulkanDeferredDeletionQueue::Type::DeviceMemory:
+			vkFreeMemory(device, (VkDeviceMemory)handle, VULKAN_CPU_ALLOCATOR);
+			break;
+		default:
+			break;
+		}
+	}
+
+	DVKTexture::~DVKTexture()
+	{
+		if (imageView != VK_NULL_HANDLE) 
+		{
+			DestroyResource(VulkanDeferredDeletionQueue::Type::ImageView, (uint64)imageView);
+			imageView = VK_NULL_HANDLE;
+		}
+
+		if (image != VK_NULL_HANDLE) 
+		{
+			DestroyResource(VulkanDeferredDeletionQueue::Type::Image, (uint64)image);
+			image = VK_NULL_HANDLE;
+		}
+
+		if (imageSampler != VK_NULL_HANDLE) 
+		{
+			DestroyResource(VulkanDeferredDeletionQueue::Type::Sampler, (uint64)imageSampler);
+			imageSampler = VK_NULL_HANDLE;
+		}
+
+		if (allocation != nullptr)
+		{
+			if (vulkanDevice) {
+				vulkanDevice->GetDeferredDeletionQueue().EnqueueResourceAllocation(allocation);
+			}
+			else {
+				delete allocation;
+			}
+			allocation  = nullptr;
+			imageMemory = VK_NULL_HANDLE;
+		}
+
+		if (imageMemory != VK_NULL_HANDLE) 
+		{
+			DestroyResource(VulkanDeferredDeletionQueue::Type::DeviceMemory, (uint64)imageMemory);
+			imageMemory = VK_NULL_HANDLE;
+		}
+
+		vulkanDevice = nullptr;
+	}
+
 	DVKTexture* DVKTexture::Create2D(const uint8* rgbaData, uint32 size, VkFormat format, int32 width, int32 height, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, VkImageUsageFlags imageUsageFlags, ImageLayoutBarrier imageLayout)
+	{
+		DVKUploadContext* uploader = DVKUploadContext::Create(vulkanDevice, cmdBuffer);
+		DVKTexture* texture = Create2D(rgbaData, size, format, width, height, vulkanDevice, uploader, imageUsageFlags, imageLayout);
+		uploader->Flush();
+		delete uploader;
+		return texture;
+	}
+
+	DVKTexture* DVKTexture::Create2D(const uint8* rgbaData, uint32 size, VkFormat format, int32 width, int32 height, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, VkImageUsageFlags imageUsageFlags, ImageLayoutBarrier imageLayout)
 	{
         int32 mipLevels = MMath::FloorToInt(MMath::Log2(MMath::Max(width, height))) + 1;
         VkDevice device = vulkanDevice->GetInstanceHandle();
         
         DVKBuffer* stagingBuffer = DVKBuffer::CreateBuffer(vulkanDevice, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size);
+        if (stagingBuffer == nullptr) {
+            return nullptr;
+        }
         stagingBuffer->Map();
         stagingBuffer->CopyFrom((void*)rgbaData, size);
 		stagingBuffer->UnMap();
         
-        uint32 memoryTypeIndex = 0;
         VkMemoryRequirements memReqs = {};
-        VkMemoryAllocateInfo memAllocInfo;
-        ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
         
         // image info
         VkImage                         image = VK_NULL_HANDLE;
@@ -56,14 +147,19 @@ namespace vk_demo
         
         // bind image buffer
         vkGetImageMemoryRequirements(device, image, &memReqs);
-        vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-        memAllocInfo.allocationSize  = memReqs.size;
-        memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-        VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-        VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+        VulkanResourceAllocation* allocation = AllocateImageMemory(vulkanDevice, memReqs, imageCreateInfo.usage);
+        if (allocation == nullptr)
+        {
+            MLOGE("Failed allocate image memory.");
+            vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+            delete stagingBuffer;
+            return nullptr;
+        }
+        allocation->BindImage(vulkanDevice.get(), image);
+        imageMemory = allocation->GetHandle();
         
 		// start record
-		cmdBuffer->Begin();
+		VkCommandBuffer transferCmd = uploader->GetTransferCommandBuffer();
 
         VkImageSubresourceRange subresourceRange = {};
         subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -73,7 +169,7 @@ namespace vk_demo
 		subresourceRange.baseMipLevel   = 0;
         
 		// undefined to TransferDest
-		vk_demo::ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, subresourceRange);
+		vk_demo::ImagePipelineBarrier(transferCmd, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, subresourceRange);
         
         VkBufferImageCopy bufferCopyRegion = {};
         bufferCopyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -85,10 +181,14 @@ namespace vk_demo
         bufferCopyRegion.imageExtent.depth  = 1;
         
 		// copy buffer to image
-        vkCmdCopyBufferToImage(cmdBuffer->cmdBuffer, stagingBuffer->buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+        vkCmdCopyBufferToImage(transferCmd, stagingBuffer->buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+
+        // 移交到graphics队列，mipmap与layout转换在graphics命令上录制
+        uploader->TransferImageOwnership(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        VkCommandBuffer graphicsCmd = uploader->GetGraphicsCommandBuffer();
         
 		// TransferDest to TransferSrc
-		vk_demo::ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, subresourceRange);
+		vk_demo::ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, subresourceRange);
         
         // Generate the mip chain
         for (uint32_t i = 1; i < mipLevels; i++)
@@ -122,24 +222,22 @@ namespace vk_demo
 			mipSubRange.baseArrayLayer = 0;
             
 			// undefined to dst
-			vk_demo::ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, mipSubRange);
+			vk_demo::ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, mipSubRange);
             
 			// blit image
-            vkCmdBlitImage(cmdBuffer->cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+            vkCmdBlitImage(graphicsCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
             
 			// dst to src
-			vk_demo::ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, mipSubRange);
+			vk_demo::ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, mipSubRange);
         }
 
 		subresourceRange.levelCount = mipLevels;
 
 		// dst to layout
-		vk_demo::ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferSource, imageLayout, subresourceRange);
+		vk_demo::ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::TransferSource, imageLayout, subresourceRange);
 		
-		cmdBuffer->End();
-		cmdBuffer->Submit();
-
-		delete stagingBuffer;
+		// staging由uploader在拷贝完成后释放
+		uploader->AddStagingBuffer(stagingBuffer);
 
 		VkSamplerCreateInfo samplerInfo;
 		ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
@@ -179,9 +277,11 @@ namespace vk_demo
 		texture->image          = image;
 		texture->imageLayout    = GetImageLayout(imageLayout);
 		texture->imageMemory    = imageMemory;
+		texture->allocation     = allocation;
 		texture->imageSampler   = imageSampler;
 		texture->imageView      = imageView;
 		texture->device			= device;
+		texture->vulkanDevice	= vulkanDevice;
 		texture->width          = width;
 		texture->mipLevels		= mipLevels;
 		texture->layerCount		= 1;
@@ -190,6 +290,15 @@ namespace vk_demo
 	}
 
     DVKTexture* DVKTexture::Create2D(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, VkImageUsageFlags imageUsageFlags, ImageLayoutBarrier imageLayout)
+    {
+        DVKUploadContext* uploader = DVKUploadContext::Create(vulkanDevice, cmdBuffer);
+        DVKTexture* texture = Create2D(filename, vulkanDevice, uploader, imageUsageFlags, imageLayout);
+        uploader->Flush();
+        delete uploader;
+        return texture;
+    }
+
+    DVKTexture* DVKTexture::Create2D(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, VkImageUsageFlags imageUsageFlags, ImageLayoutBarrier imageLayout)
     {
         uint32 dataSize = 0;
         uint8* dataPtr  = nullptr;
@@ -213,7 +322,7 @@ namespace vk_demo
             return nullptr;
         }
 
-        DVKTexture* texture = Create2D(rgbaData, width * height * 4, VK_FORMAT_R8G8B8A8_UNORM, width, height, vulkanDevice, cmdBuffer, imageUsageFlags, imageLayout);
+        DVKTexture* texture = Create2D(rgbaData, width * height * 4, VK_FORMAT_R8G8B8A8_UNORM, width, height, vulkanDevice, uploader, imageUsageFlags, imageLayout);
 
 		StbImage::Free(rgbaData);
 
@@ -236,10 +345,7 @@ namespace vk_demo
 			mipLevels = MMath::FloorToInt(MMath::Log2(MMath::Max(width, height))) + 1;
 		}
 
-		uint32 memoryTypeIndex = 0;
 		VkMemoryRequirements memReqs = {};
-		VkMemoryAllocateInfo memAllocInfo;
-		ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 
 		// image info
 		VkImage                         image = VK_NULL_HANDLE;
@@ -266,11 +372,15 @@ namespace vk_demo
 
 		// bind image buffer
 		vkGetImageMemoryRequirements(device, image, &memReqs);
-		vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-		memAllocInfo.allocationSize  = memReqs.size;
-		memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-		VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-		VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+		VulkanResourceAllocation* allocation = AllocateImageMemory(vulkanDevice, memReqs, imageCreateInfo.usage);
+		if (allocation == nullptr)
+		{
+			MLOGE("Failed allocate image memory.");
+			vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+			return nullptr;
+		}
+		allocation->BindImage(vulkanDevice.get(), image);
+		imageMemory = allocation->GetHandle();
 
 		VkSamplerCreateInfo samplerInfo;
 		ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
@@ -334,9 +444,11 @@ namespace vk_demo
 		texture->image          = image;
 		texture->imageLayout    = GetImageLayout(imageLayout);
 		texture->imageMemory    = imageMemory;
+		texture->allocation     = allocation;
 		texture->imageSampler   = imageSampler;
 		texture->imageView      = imageView;
 		texture->device			= device;
+		texture->vulkanDevice	= vulkanDevice;
 		texture->mipLevels		= mipLevels;
 		texture->layerCount		= 1;
 		texture->numSamples     = sampleCount;
@@ -377,10 +489,7 @@ namespace vk_demo
 	{
 		VkDevice device = vulkanDevice->GetInstanceHandle();
 
-		uint32 memoryTypeIndex = 0;
 		VkMemoryRequirements memReqs = {};
-		VkMemoryAllocateInfo memAllocInfo;
-		ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 
 		int32 mipLevels = 1;
 
@@ -408,11 +517,15 @@ namespace vk_demo
 
 		// bind image buffer
 		vkGetImageMemoryRequirements(device, image, &memReqs);
-		vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-		memAllocInfo.allocationSize  = memReqs.size;
-		memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-		VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-		VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+		VulkanResourceAllocation* allocation = AllocateImageMemory(vulkanDevice, memReqs, imageCreateInfo.usage);
+		if (allocation == nullptr)
+		{
+			MLOGE("Failed allocate image memory.");
+			vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+			return nullptr;
+		}
+		allocation->BindImage(vulkanDevice.get(), image);
+		imageMemory = allocation->GetHandle();
 
 		VkSamplerCreateInfo samplerInfo;
 		ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
@@ -476,9 +589,11 @@ namespace vk_demo
 		texture->image          = image;
 		texture->imageLayout    = GetImageLayout(imageLayout);
 		texture->imageMemory    = imageMemory;
+		texture->allocation     = allocation;
 		texture->imageSampler   = imageSampler;
 		texture->imageView      = imageView;
 		texture->device			= device;
+		texture->vulkanDevice	= vulkanDevice;
 		texture->mipLevels		= mipLevels;
 		texture->layerCount		= numArray;
 		texture->numSamples     = sampleCount;
@@ -490,10 +605,7 @@ namespace vk_demo
 	{
 		VkDevice device = vulkanDevice->GetInstanceHandle();
 
-		uint32 memoryTypeIndex = 0;
 		VkMemoryRequirements memReqs = {};
-		VkMemoryAllocateInfo memAllocInfo;
-		ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 
 		int32 mipLevels = 1;
 
@@ -521,11 +633,15 @@ namespace vk_demo
 
 		// bind image buffer
 		vkGetImageMemoryRequirements(device, image, &memReqs);
-		vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-		memAllocInfo.allocationSize  = memReqs.size;
-		memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-		VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-		VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+		VulkanResourceAllocation* allocation = AllocateImageMemory(vulkanDevice, memReqs, imageCreateInfo.usage);
+		if (allocation == nullptr)
+		{
+			MLOGE("Failed allocate image memory.");
+			vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+			return nullptr;
+		}
+		allocation->BindImage(vulkanDevice.get(), image);
+		imageMemory = allocation->GetHandle();
 
 		VkSamplerCreateInfo samplerInfo;
 		ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
@@ -589,9 +705,11 @@ namespace vk_demo
 		texture->image          = image;
 		texture->imageLayout    = GetImageLayout(imageLayout);
 		texture->imageMemory    = imageMemory;
+		texture->allocation     = allocation;
 		texture->imageSampler   = imageSampler;
 		texture->imageView      = imageView;
 		texture->device			= device;
+		texture->vulkanDevice	= vulkanDevice;
 		texture->mipLevels		= mipLevels;
 		texture->layerCount		= 1;
 		texture->numSamples     = sampleCount;
@@ -624,12 +742,21 @@ namespace vk_demo
 		VERIFYVULKANRESULT(vkCreateSampler(device, &samplerInfo, VULKAN_CPU_ALLOCATOR, &imageSampler));
 
 		if (descriptorInfo.sampler) {
-			vkDestroySampler(device, descriptorInfo.sampler, VULKAN_CPU_ALLOCATOR);
+			DestroyResource(VulkanDeferredDeletionQueue::Type::Sampler, (uint64)descriptorInfo.sampler);
 		}
 		descriptorInfo.sampler = imageSampler;
 	}
 
 	DVKTexture* DVKTexture::CreateCube(const std::vector<std::string> filenames, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, ImageLayoutBarrier imageLayout)
+	{
+		DVKUploadContext* uploader = DVKUploadContext::Create(vulkanDevice, cmdBuffer);
+		DVKTexture* texture = CreateCube(filenames, vulkanDevice, uploader, imageLayout);
+		uploader->Flush();
+		delete uploader;
+		return texture;
+	}
+
+	DVKTexture* DVKTexture::CreateCube(const std::vector<std::string> filenames, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, ImageLayoutBarrier imageLayout)
 	{
 		struct ImageInfo
 		{
@@ -675,10 +802,7 @@ namespace vk_demo
 		int32 mipLevels = MMath::FloorToInt(MMath::Log2(MMath::Max(width, height))) + 1;
 		VkDevice device = vulkanDevice->GetInstanceHandle();
 
-		uint32 memoryTypeIndex = 0;
 		VkMemoryRequirements memReqs = {};
-		VkMemoryAllocateInfo memAllocInfo;
-		ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 
 		// 准备stagingBuffer
 		DVKBuffer* stagingBuffer = DVKBuffer::CreateBuffer(
@@ -688,6 +812,14 @@ namespace vk_demo
 			images[0].size * 6
 		);
 
+		if (stagingBuffer == nullptr)
+		{
+			for (int32 i = 0; i < images.size(); ++i) {
+				StbImage::Free(images[i].data);
+			}
+			return nullptr;
+		}
+
 		for (int32 i = 0; i < images.size(); ++i) 
 		{
 			uint8* src  = images[i].data;
@@ -724,14 +856,19 @@ namespace vk_demo
 
 		// bind image buffer
 		vkGetImageMemoryRequirements(device, image, &memReqs);
-		vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-		memAllocInfo.allocationSize  = memReqs.size;
-		memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-		VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-		VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+		VulkanResourceAllocation* allocation = AllocateImageMemory(vulkanDevice, memReqs, imageCreateInfo.usage);
+		if (allocation == nullptr)
+		{
+			MLOGE("Failed allocate image memory.");
+			vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+			delete stagingBuffer;
+			return nullptr;
+		}
+		allocation->BindImage(vulkanDevice.get(), image);
+		imageMemory = allocation->GetHandle();
 
 		// start record
-		cmdBuffer->Begin();
+		VkCommandBuffer transferCmd = uploader->GetTransferCommandBuffer();
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -740,7 +877,7 @@ namespace vk_demo
 		subresourceRange.baseMipLevel   = 0;
 		subresourceRange.baseArrayLayer = 0;
 
-		ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, subresourceRange);
+		ImagePipelineBarrier(transferCmd, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, subresourceRange);
 
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
 		for (int32 i = 0; i < images.size(); ++i)
@@ -757,9 +894,13 @@ namespace vk_demo
 			bufferCopyRegions.push_back(bufferCopyRegion);
 		}
 
-		vkCmdCopyBufferToImage(cmdBuffer->cmdBuffer, stagingBuffer->buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, bufferCopyRegions.size(), bufferCopyRegions.data());
+		vkCmdCopyBufferToImage(transferCmd, stagingBuffer->buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, bufferCopyRegions.size(), bufferCopyRegions.data());
+
+		// 移交到graphics队列，mipmap与layout转换在graphics命令上录制
+		uploader->TransferImageOwnership(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		VkCommandBuffer graphicsCmd = uploader->GetGraphicsCommandBuffer();
 
-		ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, subresourceRange);
+		ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, subresourceRange);
 
 		// Generate the mip chain
 		for (uint32_t i = 1; i < mipLevels; i++) 
@@ -787,11 +928,11 @@ namespace vk_demo
 			mipSubRange.layerCount     = numArray;
 			mipSubRange.baseArrayLayer = 0;
 
-			ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, mipSubRange);
+			ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, mipSubRange);
 
-			vkCmdBlitImage(cmdBuffer->cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+			vkCmdBlitImage(graphicsCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
 
-			ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, mipSubRange);
+			ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, mipSubRange);
 		}
 
 		subresourceRange.aspectMask   = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -799,12 +940,10 @@ namespace vk_demo
 		subresourceRange.layerCount   = numArray;
 		subresourceRange.baseMipLevel = 0;
 
-		ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferSource, imageLayout, subresourceRange);
+		ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::TransferSource, imageLayout, subresourceRange);
 
-		cmdBuffer->End();
-		cmdBuffer->Submit();
-
-		delete stagingBuffer;
+		// staging由uploader在拷贝完成后释放
+		uploader->AddStagingBuffer(stagingBuffer);
 
 		VkSamplerCreateInfo samplerInfo;
 		ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
@@ -844,9 +983,11 @@ namespace vk_demo
 		texture->image          = image;
 		texture->imageLayout    = GetImageLayout(imageLayout);
 		texture->imageMemory    = imageMemory;
+		texture->allocation     = allocation;
 		texture->imageSampler   = imageSampler;
 		texture->imageView      = imageView;
 		texture->device			= device;
+		texture->vulkanDevice	= vulkanDevice;
 		texture->width          = width;
 		texture->mipLevels		= mipLevels;
 		texture->layerCount		= numArray;
@@ -855,6 +996,15 @@ namespace vk_demo
 	}
 
 	DVKTexture* DVKTexture::Create2DArray(const std::vector<std::string> filenames, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, ImageLayoutBarrier imageLayout)
+	{
+		DVKUploadContext* uploader = DVKUploadContext::Create(vulkanDevice, cmdBuffer);
+		DVKTexture* texture = Create2DArray(filenames, vulkanDevice, uploader, imageLayout);
+		uploader->Flush();
+		delete uploader;
+		return texture;
+	}
+
+	DVKTexture* DVKTexture::Create2DArray(const std::vector<std::string> filenames, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, ImageLayoutBarrier imageLayout)
 	{
 		struct ImageInfo
 		{
@@ -900,10 +1050,7 @@ namespace vk_demo
         int32 mipLevels = MMath::FloorToInt(MMath::Log2(MMath::Max(width, height))) + 1;
         VkDevice device = vulkanDevice->GetInstanceHandle();
         
-		uint32 memoryTypeIndex = 0;
 		VkMemoryRequirements memReqs = {};
-		VkMemoryAllocateInfo memAllocInfo;
-		ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
         
 		// 准备stagingBuffer
 		DVKBuffer* stagingBuffer = DVKBuffer::CreateBuffer(
@@ -912,6 +1059,14 @@ namespace vk_demo
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
 			width * height * 4 * numArray
 		);
+
+		if (stagingBuffer == nullptr)
+		{
+			for (int32 i = 0; i < images.size(); ++i) {
+				StbImage::Free(images[i].data);
+			}
+			return nullptr;
+		}
         
 		for (int32 i = 0; i < images.size(); ++i) 
 		{
@@ -948,14 +1103,19 @@ namespace vk_demo
 
 		// bind image buffer
 		vkGetImageMemoryRequirements(device, image, &memReqs);
-		vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-		memAllocInfo.allocationSize  = memReqs.size;
-		memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-		VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-		VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+		VulkanResourceAllocation* allocation = AllocateImageMemory(vulkanDevice, memReqs, imageCreateInfo.usage);
+		if (allocation == nullptr)
+		{
+			MLOGE("Failed allocate image memory.");
+			vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+			delete stagingBuffer;
+			return nullptr;
+		}
+		allocation->BindImage(vulkanDevice.get(), image);
+		imageMemory = allocation->GetHandle();
 
 		// start record
-		cmdBuffer->Begin();
+		VkCommandBuffer transferCmd = uploader->GetTransferCommandBuffer();
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -964,7 +1124,7 @@ namespace vk_demo
 		subresourceRange.baseMipLevel   = 0;
 		subresourceRange.baseArrayLayer = 0;
         
-		ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, subresourceRange);
+		ImagePipelineBarrier(transferCmd, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, subresourceRange);
         
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
 		for (int32 i = 0; i < images.size(); ++i)
@@ -981,9 +1141,13 @@ namespace vk_demo
 			bufferCopyRegions.push_back(bufferCopyRegion);
 		}
 		
-		vkCmdCopyBufferToImage(cmdBuffer->cmdBuffer, stagingBuffer->buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, bufferCopyRegions.size(), bufferCopyRegions.data());
+		vkCmdCopyBufferToImage(transferCmd, stagingBuffer->buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, bufferCopyRegions.size(), bufferCopyRegions.data());
+
+		// 移交到graphics队列，mipmap与layout转换在graphics命令上录制
+		uploader->TransferImageOwnership(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		VkCommandBuffer graphicsCmd = uploader->GetGraphicsCommandBuffer();
         
-		ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, subresourceRange);
+		ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, subresourceRange);
         
         // Generate the mip chain
         for (uint32_t i = 1; i < mipLevels; i++) 
@@ -1011,11 +1175,11 @@ namespace vk_demo
             mipSubRange.layerCount     = numArray;
 			mipSubRange.baseArrayLayer = 0;
             
-			ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, mipSubRange);
+			ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, mipSubRange);
             
-            vkCmdBlitImage(cmdBuffer->cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+            vkCmdBlitImage(graphicsCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
             
-			ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, mipSubRange);
+			ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, mipSubRange);
         }
         
         subresourceRange.aspectMask   = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1023,12 +1187,10 @@ namespace vk_demo
         subresourceRange.layerCount   = numArray;
         subresourceRange.baseMipLevel = 0;
         
-		ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferSource, imageLayout, subresourceRange);
+		ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::TransferSource, imageLayout, subresourceRange);
         
-		cmdBuffer->End();
-		cmdBuffer->Submit();
-
-		delete stagingBuffer;
+		// staging由uploader在拷贝完成后释放
+		uploader->AddStagingBuffer(stagingBuffer);
         
 		VkSamplerCreateInfo samplerInfo;
 		ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
@@ -1068,9 +1230,11 @@ namespace vk_demo
 		texture->image          = image;
 		texture->imageLayout    = GetImageLayout(imageLayout);
 		texture->imageMemory    = imageMemory;
+		texture->allocation     = allocation;
 		texture->imageSampler   = imageSampler;
 		texture->imageView      = imageView;
 		texture->device			= device;
+		texture->vulkanDevice	= vulkanDevice;
 		texture->width          = width;
 		texture->mipLevels		= mipLevels;
 		texture->layerCount		= numArray;
@@ -1079,18 +1243,27 @@ namespace vk_demo
 	}
     
 	DVKTexture* DVKTexture::Create3D(VkFormat format, const uint8* rgbaData, int32 size, int32 width, int32 height, int32 depth, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, ImageLayoutBarrier imageLayout)
+	{
+		DVKUploadContext* uploader = DVKUploadContext::Create(vulkanDevice, cmdBuffer);
+		DVKTexture* texture = Create3D(format, rgbaData, size, width, height, depth, vulkanDevice, uploader, imageLayout);
+		uploader->Flush();
+		delete uploader;
+		return texture;
+	}
+
+	DVKTexture* DVKTexture::Create3D(VkFormat format, const uint8* rgbaData, int32 size, int32 width, int32 height, int32 depth, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, ImageLayoutBarrier imageLayout)
 	{
 		VkDevice device = vulkanDevice->GetInstanceHandle();
 
 		DVKBuffer* stagingBuffer = DVKBuffer::CreateBuffer(vulkanDevice, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size);
+		if (stagingBuffer == nullptr) {
+			return nullptr;
+		}
         stagingBuffer->Map();
         stagingBuffer->CopyFrom((void*)rgbaData, size);
 		stagingBuffer->UnMap();
         
-        uint32 memoryTypeIndex = 0;
         VkMemoryRequirements memReqs = {};
-        VkMemoryAllocateInfo memAllocInfo;
-        ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 		
 		// image info
         VkImage                         image = VK_NULL_HANDLE;
@@ -1118,13 +1291,18 @@ namespace vk_demo
 		
 		// bind image buffer
         vkGetImageMemoryRequirements(device, image, &memReqs);
-        vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-        memAllocInfo.allocationSize  = memReqs.size;
-        memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-        VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-        VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+        VulkanResourceAllocation* allocation = AllocateImageMemory(vulkanDevice, memReqs, imageCreateInfo.usage);
+        if (allocation == nullptr)
+        {
+            MLOGE("Failed allocate image memory.");
+            vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+            delete stagingBuffer;
+            return nullptr;
+        }
+        allocation->BindImage(vulkanDevice.get(), image);
+        imageMemory = allocation->GetHandle();
         
-        cmdBuffer->Begin();
+        VkCommandBuffer transferCmd = uploader->GetTransferCommandBuffer();
         
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1133,7 +1311,7 @@ namespace vk_demo
 		subresourceRange.baseMipLevel   = 0;
 		subresourceRange.baseArrayLayer = 0;
         
-		ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, subresourceRange);
+		ImagePipelineBarrier(transferCmd, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, subresourceRange);
         
 		VkBufferImageCopy bufferCopyRegion = {};
 		bufferCopyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1144,14 +1322,16 @@ namespace vk_demo
 		bufferCopyRegion.imageExtent.height = height;
 		bufferCopyRegion.imageExtent.depth  = depth;
         
-		vkCmdCopyBufferToImage(cmdBuffer->cmdBuffer, stagingBuffer->buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+		vkCmdCopyBufferToImage(transferCmd, stagingBuffer->buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+
+		// 移交到graphics队列，layout转换在graphics命令上录制
+		uploader->TransferImageOwnership(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		VkCommandBuffer graphicsCmd = uploader->GetGraphicsCommandBuffer();
         
-		ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferDest, imageLayout, subresourceRange);
+		ImagePipelineBarrier(graphicsCmd, image, ImageLayoutBarrier::TransferDest, imageLayout, subresourceRange);
 		
-		cmdBuffer->End();
-		cmdBuffer->Submit();
-
-		delete stagingBuffer;
+		// staging由uploader在拷贝完成后释放
+		uploader->AddStagingBuffer(stagingBuffer);
 		
 		// Create sampler
 		VkSamplerCreateInfo samplerInfo;
@@ -1203,9 +1383,11 @@ namespace vk_demo
 		texture->image          = image;
 		texture->imageLayout    = GetImageLayout(imageLayout);
 		texture->imageMemory    = imageMemory;
+		texture->allocation     = allocation;
 		texture->imageSampler   = imageSampler;
 		texture->imageView      = imageView;
 		texture->device			= device;
+		texture->vulkanDevice	= vulkanDevice;
 		texture->mipLevels		= 1;
 		texture->layerCount		= 1;
 
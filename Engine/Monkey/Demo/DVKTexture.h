@@ -2,6 +2,7 @@
 
 #include "Engine.h"
 #include "DVKCommand.h"
+#include "DVKUploadContext.h"
 
 #include "Common/Common.h"
 #include "Math/Math.h"
@@ -21,32 +22,7 @@ namespace vk_demo
             
         }
         
-        ~DVKTexture()
-        {
-            if (imageView != VK_NULL_HANDLE) 
-			{
-                vkDestroyImageView(device, imageView, VULKAN_CPU_ALLOCATOR);
-                imageView = VK_NULL_HANDLE;
-            }
-            
-            if (image != VK_NULL_HANDLE) 
-			{
-                vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
-                image = VK_NULL_HANDLE;
-            }
-            
-            if (imageSampler != VK_NULL_HANDLE) 
-			{
-                vkDestroySampler(device, imageSampler, VULKAN_CPU_ALLOCATOR);
-                imageSampler = VK_NULL_HANDLE;
-            }
-            
-            if (imageMemory != VK_NULL_HANDLE) 
-			{
-                vkFreeMemory(device, imageMemory, VULKAN_CPU_ALLOCATOR);
-                imageMemory = VK_NULL_HANDLE;
-            }
-        }
+        ~DVKTexture();
 
 		void UpdateSampler(
 			VkFilter magFilter = VK_FILTER_LINEAR, 
@@ -64,15 +40,35 @@ namespace vk_demo
 			int32 width, 
 			int32 height, 
 			std::shared_ptr<VulkanDevice> vulkanDevice, 
+			DVKCommandBuffer* cmdBuffer,
+			VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
+		);
+
+		static DVKTexture* Create2D(
+			const uint8* rgbaData,
+			uint32 size,
+			VkFormat format,
+			int32 width,
+			int32 height,
+			std::shared_ptr<VulkanDevice> vulkanDevice,
+			DVKUploadContext* uploader,
+			VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
+		);
+
+        static DVKTexture* Create2D(
+			const std::string& filename,
+			std::shared_ptr<VulkanDevice> vulkanDevice, 
 			DVKCommandBuffer* cmdBuffer, 
 			VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, 
 			ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
-		); 
+		);
 
         static DVKTexture* Create2D(
 			const std::string& filename,
 			std::shared_ptr<VulkanDevice> vulkanDevice, 
-			DVKCommandBuffer* cmdBuffer, 
+			DVKUploadContext* uploader, 
 			VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, 
 			ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
 		);
@@ -127,6 +123,13 @@ namespace vk_demo
 			DVKCommandBuffer* cmdBuffer,
 			ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
 		);
+
+		static DVKTexture* CreateCube(
+			const std::vector<std::string> filenames,
+			std::shared_ptr<VulkanDevice> vulkanDevice, 
+			DVKUploadContext* uploader,
+			ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
+		);
         
         static DVKTexture* CreateCubeRenderTarget(
             std::shared_ptr<VulkanDevice> vulkanDevice,
@@ -145,6 +148,13 @@ namespace vk_demo
 			ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
 		);
 
+        static DVKTexture* Create2DArray(
+			const std::vector<std::string> filenames, 
+			std::shared_ptr<VulkanDevice> vulkanDevice, 
+			DVKUploadContext* uploader,
+			ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
+		);
+
 		static DVKTexture* Create2DArray(
 			std::shared_ptr<VulkanDevice> vulkanDevice,
 			DVKCommandBuffer* cmdBuffer,
@@ -169,13 +179,31 @@ namespace vk_demo
 			DVKCommandBuffer* cmdBuffer,
 			ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
 		);
+
+		static DVKTexture* Create3D(
+			VkFormat format, 
+			const uint8* rgbaData, 
+			int32 size, 
+			int32 width, 
+			int32 height, 
+			int32 depth, 
+			std::shared_ptr<VulkanDevice> vulkanDevice, 
+			DVKUploadContext* uploader,
+			ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
+		);
+
+	private:
+		// vulkanDevice为空时直接销毁，否则交给DeferredDeletionQueue
+		void DestroyResource(VulkanDeferredDeletionQueue::Type type, uint64 handle);
         
     public:
         VkDevice						device = nullptr;
+        std::shared_ptr<VulkanDevice>	vulkanDevice = nullptr;
         
         VkImage                         image = VK_NULL_HANDLE;
         VkImageLayout                   imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         VkDeviceMemory                  imageMemory = VK_NULL_HANDLE;
+        VulkanResourceAllocation*       allocation = nullptr;
         VkImageView                     imageView = VK_NULL_HANDLE;
         VkSampler                       imageSampler = VK_NULL_HANDLE;
         VkDescriptorImageInfo           descriptorInfo;
@@ -0,0 +1,413 @@
+﻿#include "DVKUploadContext.h"
+
+#include "Vulkan/VulkanCommon.h"
+
+namespace vk_demo
+{
+
+	DVKUploadContext::DVKUploadContext()
+	{
+
+	}
+
+	DVKUploadContext::~DVKUploadContext()
+	{
+		WaitAll();
+
+		VkDevice device = vulkanDevice->GetInstanceHandle();
+
+		if (immediateCmdBuffer)
+		{
+			delete currBatch;
+			currBatch = nullptr;
+			immediateCmdBuffer = nullptr;
+		}
+
+		for (int32 i = 0; i < freeBatches.size(); ++i)
+		{
+			UploadBatch* batch = freeBatches[i];
+			if (batch->fence != VK_NULL_HANDLE) {
+				vkDestroyFence(device, batch->fence, VULKAN_CPU_ALLOCATOR);
+			}
+			if (batch->semaphore != VK_NULL_HANDLE) {
+				vkDestroySemaphore(device, batch->semaphore, VULKAN_CPU_ALLOCATOR);
+			}
+			delete batch;
+		}
+		freeBatches.clear();
+
+		// command buffer随pool一起释放
+		if (transferPool != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(device, transferPool, VULKAN_CPU_ALLOCATOR);
+			transferPool = VK_NULL_HANDLE;
+		}
+
+		if (graphicsPool != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(device, graphicsPool, VULKAN_CPU_ALLOCATOR);
+			graphicsPool = VK_NULL_HANDLE;
+		}
+
+		transferQueue = nullptr;
+		graphicsQueue = nullptr;
+		vulkanDevice  = nullptr;
+	}
+
+	DVKUploadContext::UploadBatch* DVKUploadContext::AcquireBatch()
+	{
+		if (freeBatches.size() > 0)
+		{
+			UploadBatch* batch = freeBatches.back();
+			freeBatches.pop_back();
+			return batch;
+		}
+
+		VkDevice device = vulkanDevice->GetInstanceHandle();
+		UploadBatch* batch = new UploadBatch();
+
+		VkCommandBufferAllocateInfo cmdBufferAllocateInfo;
+		ZeroVulkanStruct(cmdBufferAllocateInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO);
+		cmdBufferAllocateInfo.commandPool        = transferPool;
+		cmdBufferAllocateInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cmdBufferAllocateInfo.commandBufferCount = 1;
+		VERIFYVULKANRESULT(vkAllocateCommandBuffers(device, &cmdBufferAllocateInfo, &(batch->transferCmd)));
+
+		if (separateQueue)
+		{
+			cmdBufferAllocateInfo.commandPool = graphicsPool;
+			VERIFYVULKANRESULT(vkAllocateCommandBuffers(device, &cmdBufferAllocateInfo, &(batch->graphicsCmd)));
+
+			VkSemaphoreCreateInfo semaphoreCreateInfo;
+			ZeroVulkanStruct(semaphoreCreateInfo, VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO);
+			VERIFYVULKANRESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, VULKAN_CPU_ALLOCATOR, &(batch->semaphore)));
+		}
+		else
+		{
+			batch->graphicsCmd = batch->transferCmd;
+		}
+
+		VkFenceCreateInfo fenceCreateInfo;
+		ZeroVulkanStruct(fenceCreateInfo, VK_STRUCTURE_TYPE_FENCE_CREATE_INFO);
+		fenceCreateInfo.flags = 0;
+		VERIFYVULKANRESULT(vkCreateFence(device, &fenceCreateInfo, VULKAN_CPU_ALLOCATOR, &(batch->fence)));
+
+		return batch;
+	}
+
+	void DVKUploadContext::BeginBatch()
+	{
+		if (currBatch && currBatch->isBegun) {
+			return;
+		}
+
+		if (!currBatch) {
+			currBatch = AcquireBatch();
+		}
+		currBatch->isBegun = true;
+
+		VkCommandBufferBeginInfo cmdBufBeginInfo;
+		ZeroVulkanStruct(cmdBufBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
+		cmdBufBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkBeginCommandBuffer(currBatch->transferCmd, &cmdBufBeginInfo);
+		if (separateQueue) {
+			vkBeginCommandBuffer(currBatch->graphicsCmd, &cmdBufBeginInfo);
+		}
+	}
+
+	VkCommandBuffer DVKUploadContext::GetTransferCommandBuffer()
+	{
+		if (immediateCmdBuffer)
+		{
+			immediateCmdBuffer->Begin();
+			return immediateCmdBuffer->cmdBuffer;
+		}
+
+		BeginBatch();
+		return currBatch->transferCmd;
+	}
+
+	VkCommandBuffer DVKUploadContext::GetGraphicsCommandBuffer()
+	{
+		if (immediateCmdBuffer)
+		{
+			immediateCmdBuffer->Begin();
+			return immediateCmdBuffer->cmdBuffer;
+		}
+
+		BeginBatch();
+		return currBatch->graphicsCmd;
+	}
+
+	void DVKUploadContext::AddStagingBuffer(DVKBuffer* stagingBuffer)
+	{
+		if (!currBatch) {
+			BeginBatch();
+		}
+
+		currBatch->stagingBuffers.push_back(stagingBuffer);
+		currBatch->stagingSize += stagingBuffer->size;
+
+		// 控制staging内存的峰值
+		if (!immediateCmdBuffer && maxStagingSize > 0 && currBatch->stagingSize >= maxStagingSize) {
+			Flush();
+		}
+	}
+
+	void DVKUploadContext::CopyBuffer(DVKBuffer* stagingBuffer, DVKBuffer* dstBuffer, VkDeviceSize size, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+	{
+		VkCommandBuffer transferCmd = GetTransferCommandBuffer();
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = size;
+		vkCmdCopyBuffer(transferCmd, stagingBuffer->buffer, dstBuffer->buffer, 1, &copyRegion);
+
+		VkBufferMemoryBarrier barrier;
+		ZeroVulkanStruct(barrier, VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER);
+		barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask       = dstAccessMask;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer              = dstBuffer->buffer;
+		barrier.offset              = 0;
+		barrier.size                = VK_WHOLE_SIZE;
+
+		if (separateQueue && !immediateCmdBuffer)
+		{
+			// release
+			barrier.dstAccessMask       = 0;
+			barrier.srcQueueFamilyIndex = transferQueue->GetFamilyIndex();
+			barrier.dstQueueFamilyIndex = graphicsQueue->GetFamilyIndex();
+			vkCmdPipelineBarrier(transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+			// acquire
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = dstAccessMask;
+			vkCmdPipelineBarrier(currBatch->graphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		}
+		else
+		{
+			vkCmdPipelineBarrier(transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		}
+
+		AddStagingBuffer(stagingBuffer);
+	}
+
+	void DVKUploadContext::TransferImageOwnership(VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout layout)
+	{
+		if (!separateQueue || immediateCmdBuffer) {
+			return;
+		}
+
+		VkImageMemoryBarrier barrier;
+		ZeroVulkanStruct(barrier, VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER);
+		barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask       = 0;
+		barrier.oldLayout           = layout;
+		barrier.newLayout           = layout;
+		barrier.srcQueueFamilyIndex = transferQueue->GetFamilyIndex();
+		barrier.dstQueueFamilyIndex = graphicsQueue->GetFamilyIndex();
+		barrier.image               = image;
+		barrier.subresourceRange    = subresourceRange;
+
+		// release
+		vkCmdPipelineBarrier(GetTransferCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		// acquire
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(GetGraphicsCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	uint64 DVKUploadContext::Flush()
+	{
+		if (immediateCmdBuffer)
+		{
+			if (!immediateCmdBuffer->isBegun && currBatch->stagingBuffers.size() == 0) {
+				return completedToken;
+			}
+
+			immediateCmdBuffer->Submit();
+			submitCount += 1;
+
+			currBatch->token = nextToken++;
+			ReleaseBatch(currBatch);
+			return completedToken;
+		}
+
+		if (!currBatch || !currBatch->isBegun) {
+			return nextToken - 1;
+		}
+
+		UploadBatch* batch = currBatch;
+		currBatch = nullptr;
+
+		batch->token = nextToken++;
+		vkEndCommandBuffer(batch->transferCmd);
+
+		if (separateQueue)
+		{
+			vkEndCommandBuffer(batch->graphicsCmd);
+
+			VkSubmitInfo submitInfo;
+			ZeroVulkanStruct(submitInfo, VK_STRUCTURE_TYPE_SUBMIT_INFO);
+			submitInfo.commandBufferCount   = 1;
+			submitInfo.pCommandBuffers      = &(batch->transferCmd);
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores    = &(batch->semaphore);
+			VERIFYVULKANRESULT(vkQueueSubmit(transferQueue->GetHandle(), 1, &submitInfo, VK_NULL_HANDLE));
+
+			VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			ZeroVulkanStruct(submitInfo, VK_STRUCTURE_TYPE_SUBMIT_INFO);
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores    = &(batch->semaphore);
+			submitInfo.pWaitDstStageMask  = &waitStageMask;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers    = &(batch->graphicsCmd);
+			VERIFYVULKANRESULT(vkQueueSubmit(graphicsQueue->GetHandle(), 1, &submitInfo, batch->fence));
+
+			submitCount += 2;
+		}
+		else
+		{
+			VkSubmitInfo submitInfo;
+			ZeroVulkanStruct(submitInfo, VK_STRUCTURE_TYPE_SUBMIT_INFO);
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers    = &(batch->transferCmd);
+			VERIFYVULKANRESULT(vkQueueSubmit(transferQueue->GetHandle(), 1, &submitInfo, batch->fence));
+
+			submitCount += 1;
+		}
+
+		inflightBatches.push_back(batch);
+
+		// 顺便回收已经完成的批次
+		RetireBatches(false);
+
+		return batch->token;
+	}
+
+	bool DVKUploadContext::IsComplete(uint64 token)
+	{
+		if (token <= completedToken) {
+			return true;
+		}
+
+		RetireBatches(false);
+
+		return token <= completedToken;
+	}
+
+	void DVKUploadContext::Wait(uint64 token)
+	{
+		if (token <= completedToken) {
+			return;
+		}
+
+		VkDevice device = vulkanDevice->GetInstanceHandle();
+
+		// 批次按提交顺序完成，等待最后一个满足条件的批次即可
+		UploadBatch* target = nullptr;
+		for (int32 i = 0; i < inflightBatches.size(); ++i)
+		{
+			if (inflightBatches[i]->token <= token) {
+				target = inflightBatches[i];
+			}
+		}
+
+		if (target) {
+			vkWaitForFences(device, 1, &(target->fence), VK_TRUE, MAX_uint64);
+		}
+
+		RetireBatches(false);
+	}
+
+	void DVKUploadContext::WaitAll()
+	{
+		Flush();
+		RetireBatches(true);
+	}
+
+	void DVKUploadContext::RetireBatches(bool wait)
+	{
+		VkDevice device = vulkanDevice->GetInstanceHandle();
+
+		int32 retired = 0;
+		for (int32 i = 0; i < inflightBatches.size(); ++i)
+		{
+			UploadBatch* batch = inflightBatches[i];
+
+			if (wait) {
+				vkWaitForFences(device, 1, &(batch->fence), VK_TRUE, MAX_uint64);
+			}
+			else if (vkGetFenceStatus(device, batch->fence) != VK_SUCCESS) {
+				break;
+			}
+
+			ReleaseBatch(batch);
+			retired += 1;
+		}
+
+		if (retired > 0) {
+			inflightBatches.erase(inflightBatches.begin(), inflightBatches.begin() + retired);
+		}
+	}
+
+	void DVKUploadContext::ReleaseBatch(UploadBatch* batch)
+	{
+		for (int32 i = 0; i < batch->stagingBuffers.size(); ++i) {
+			delete batch->stagingBuffers[i];
+		}
+		batch->stagingBuffers.clear();
+		batch->stagingSize = 0;
+		batch->isBegun     = false;
+
+		completedToken = batch->token;
+
+		if (immediateCmdBuffer) {
+			return;
+		}
+
+		vkResetFences(vulkanDevice->GetInstanceHandle(), 1, &(batch->fence));
+		freeBatches.push_back(batch);
+	}
+
+	DVKUploadContext* DVKUploadContext::Create(std::shared_ptr<VulkanDevice> vulkanDevice, VkDeviceSize maxStagingSize)
+	{
+		VkDevice device = vulkanDevice->GetInstanceHandle();
+
+		DVKUploadContext* context = new DVKUploadContext();
+		context->vulkanDevice   = vulkanDevice;
+		context->transferQueue  = vulkanDevice->GetTransferQueue();
+		context->graphicsQueue  = vulkanDevice->GetGraphicsQueue();
+		context->maxStagingSize = maxStagingSize;
+		context->separateQueue  = context->transferQueue->GetFamilyIndex() != context->graphicsQueue->GetFamilyIndex();
+
+		VkCommandPoolCreateInfo cmdPoolInfo;
+		ZeroVulkanStruct(cmdPoolInfo, VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO);
+		cmdPoolInfo.queueFamilyIndex = context->transferQueue->GetFamilyIndex();
+		cmdPoolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		VERIFYVULKANRESULT(vkCreateCommandPool(device, &cmdPoolInfo, VULKAN_CPU_ALLOCATOR, &(context->transferPool)));
+
+		if (context->separateQueue)
+		{
+			cmdPoolInfo.queueFamilyIndex = context->graphicsQueue->GetFamilyIndex();
+			VERIFYVULKANRESULT(vkCreateCommandPool(device, &cmdPoolInfo, VULKAN_CPU_ALLOCATOR, &(context->graphicsPool)));
+		}
+
+		return context;
+	}
+
+	DVKUploadContext* DVKUploadContext::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer)
+	{
+		DVKUploadContext* context = new DVKUploadContext();
+		context->vulkanDevice       = vulkanDevice;
+		context->transferQueue      = cmdBuffer->queue;
+		context->graphicsQueue      = cmdBuffer->queue;
+		context->immediateCmdBuffer = cmdBuffer;
+		context->separateQueue      = false;
+		context->currBatch          = new UploadBatch();
+		return context;
+	}
+
+}
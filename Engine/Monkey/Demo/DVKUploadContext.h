@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include "Engine.h"
+#include "DVKBuffer.h"
+#include "DVKCommand.h"
+
+#include "Common/Common.h"
+#include "Vulkan/VulkanCommon.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+
+class VulkanDevice;
+
+namespace vk_demo
+{
+
+	// 把多个资源的staging拷贝合并到一个command buffer里提交，通过token查询或等待完成。
+	// 拷贝录制在transfer队列上，mipmap生成、layout转换这些只能在graphics队列上做的录制在graphics命令里，
+	// 两个队列族不同时会自动插入queue family ownership转移。
+	class DVKUploadContext
+	{
+	private:
+		struct UploadBatch
+		{
+			VkCommandBuffer				transferCmd = VK_NULL_HANDLE;
+			VkCommandBuffer				graphicsCmd = VK_NULL_HANDLE;
+			VkSemaphore					semaphore = VK_NULL_HANDLE;
+			VkFence						fence = VK_NULL_HANDLE;
+			std::vector<DVKBuffer*>		stagingBuffers;
+			VkDeviceSize				stagingSize = 0;
+			uint64						token = 0;
+			bool						isBegun = false;
+		};
+
+	public:
+		~DVKUploadContext();
+
+	private:
+		DVKUploadContext();
+
+	public:
+
+		VkCommandBuffer GetTransferCommandBuffer();
+
+		VkCommandBuffer GetGraphicsCommandBuffer();
+
+		// staging buffer由UploadContext接管，批次完成后释放
+		void AddStagingBuffer(DVKBuffer* stagingBuffer);
+
+		void CopyBuffer(DVKBuffer* stagingBuffer, DVKBuffer* dstBuffer, VkDeviceSize size, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+
+		// image在transfer队列上写完之后移交给graphics队列，layout保持不变
+		void TransferImageOwnership(VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout layout);
+
+		// 提交当前批次，返回该批次的token；没有待提交内容时返回最近一次的token
+		uint64 Flush();
+
+		bool IsComplete(uint64 token);
+
+		void Wait(uint64 token);
+
+		void WaitAll();
+
+		inline uint64 GetCompletedToken() const
+		{
+			return completedToken;
+		}
+
+		inline int32 GetSubmitCount() const
+		{
+			return submitCount;
+		}
+
+		// 异步上传，默认使用device的transfer队列
+		static DVKUploadContext* Create(std::shared_ptr<VulkanDevice> vulkanDevice, VkDeviceSize maxStagingSize = 64 * 1024 * 1024);
+
+		// 包装已有的command buffer，Flush时直接Submit并等待完成，兼容旧的接口
+		static DVKUploadContext* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer);
+
+	private:
+
+		UploadBatch* AcquireBatch();
+
+		void BeginBatch();
+
+		void RetireBatches(bool wait);
+
+		void ReleaseBatch(UploadBatch* batch);
+
+	public:
+		std::shared_ptr<VulkanDevice>	vulkanDevice = nullptr;
+		std::shared_ptr<VulkanQueue>	transferQueue = nullptr;
+		std::shared_ptr<VulkanQueue>	graphicsQueue = nullptr;
+
+		VkCommandPool					transferPool = VK_NULL_HANDLE;
+		VkCommandPool					graphicsPool = VK_NULL_HANDLE;
+
+		DVKCommandBuffer*				immediateCmdBuffer = nullptr;
+
+		VkDeviceSize					maxStagingSize = 0;
+
+	private:
+		bool							separateQueue = false;
+
+		UploadBatch*					currBatch = nullptr;
+		std::vector<UploadBatch*>		inflightBatches;
+		std::vector<UploadBatch*>		freeBatches;
+
+		uint64							nextToken = 1;
+		uint64							completedToken = 0;
+		int32							submitCount = 0;
+	};
+
+};
@@ -4,6 +4,20 @@ namespace vk_demo
 {
 	
 	DVKVertexBuffer* DVKVertexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, std::vector<float> vertices, const std::vector<VertexAttribute>& attributes)
+	{
+		DVKUploadContext* uploader = DVKUploadContext::Create(vulkanDevice, cmdBuffer);
+		DVKVertexBuffer* vertexBuffer = Create(vulkanDevice, uploader, vertices, attributes);
+		uploader->Flush();
+		delete uploader;
+		return vertexBuffer;
+	}
+
+	DVKVertexBuffer* DVKVertexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, const std::vector<float>& vertices, const std::vector<VertexAttribute>& attributes)
+	{
+		return Create(vulkanDevice, uploader, vertices.data(), vertices.size(), attributes);
+	}
+
+	DVKVertexBuffer* DVKVertexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadContext* uploader, const float* vertices, int32 count, const std::vector<VertexAttribute>& attributes)
 	{
 		VkDevice device = vulkanDevice->GetInstanceHandle();
 
@@ -15,27 +29,19 @@ namespace vk_demo
 			vulkanDevice, 
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-			vertices.size() * sizeof(float), 
-			vertices.data()
+			count * sizeof(float), 
+			(void*)vertices
 		);
 
 		vertexBuffer->dvkBuffer = vk_demo::DVKBuffer::CreateBuffer(
 			vulkanDevice, 
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-			vertices.size() * sizeof(float)
+			count * sizeof(float)
 		);
 
-		cmdBuffer->Begin();
-
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = vertices.size() * sizeof(float);
-		vkCmdCopyBuffer(cmdBuffer->cmdBuffer, vertexStaging->buffer, vertexBuffer->dvkBuffer->buffer, 1, &copyRegion);
-
-		cmdBuffer->End();
-		cmdBuffer->Submit();
-
-		delete vertexStaging;
+		// staging由uploader在拷贝完成后释放
+		uploader->CopyBuffer(vertexStaging, vertexBuffer->dvkBuffer, count * sizeof(float), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
 
 		return vertexBuffer;
 	}
@@ -3,6 +3,7 @@
 #include "Engine.h"
 #include "DVKCommand.h"
 #include "DVKBuffer.h"
+#include "DVKUploadContext.h"
 
 #include "Common/Common.h"
 #include "Math/Math.h"
@@ -153,6 +154,11 @@ namespace vk_demo
 
 		static DVKVertexBuffer* Create(std::shared_ptr<VulkanDevice> device, DVKCommandBuffer* cmdBuffer, std::vector<float> vertices, const std::vector<VertexAttribute>& attributes);
 
+		static DVKVertexBuffer* Create(std::shared_ptr<VulkanDevice> device, DVKUploadContext* uploader, const std::vector<float>& vertices, const std::vector<VertexAttribute>& attributes);
+
+		// 直接从内存(例如映射的缓存文件)上传，数据只需要在调用期间有效
+		static DVKVertexBuffer* Create(std::shared_ptr<VulkanDevice> device, DVKUploadContext* uploader, const float* vertices, int32 count, const std::vector<VertexAttribute>& attributes);
+
 	public:
 		VkDevice						device = VK_NULL_HANDLE;
 		DVKBuffer*						dvkBuffer = nullptr;
@@ -1,6 +1,13 @@
 ﻿#include "DemoBase.h"
 #include "DVKDefaultRes.h"
 #include "DVKCommand.h"
+#include "DVKMaterial.h"
+#include "DVKPipelineCache.h"
+#include "DVKShaderCache.h"
+
+#include "Math/Math.h"
+#include "Core/Profiler.h"
+#include "GenericPlatform/GenericPlatformTime.h"
 
 void DemoBase::Setup()
 {
@@ -20,29 +27,83 @@ void DemoBase::Setup()
 
 int32 DemoBase::AcquireBackbufferIndex()
 {
+	PROFILE_FUNCTION();
+
+	// 等待该frame slot上一次的提交完成
+	VkFence frameFence = m_Fences[m_FrameIndex];
+	vkWaitForFences(m_Device, 1, &frameFence, true, MAX_uint64);
+
+	// 已经完成的帧不再引用延迟释放的资源
+	m_VulkanDevice->GetDeferredDeletionQueue().ReleaseResources();
+
+	// 交换链重建之后backbuffer的数量可能变化，旧image对应的fence也不再有意义
+	if (m_SwapChain != GetVulkanRHI()->GetSwapChain())
+	{
+		m_SwapChain = GetVulkanRHI()->GetSwapChain();
+		ResizeImageResources(m_SwapChain->GetBackBufferCount());
+	}
+
 	int32 backBufferIndex = m_SwapChain->AcquireImageIndex(&m_PresentComplete);
+	if (backBufferIndex < 0) {
+		return backBufferIndex;
+	}
+
+	// backbuffer可能还在被其它frame slot使用
+	VkFence imageFence = m_ImageFences[backBufferIndex];
+	if (imageFence != VK_NULL_HANDLE && imageFence != frameFence) {
+		vkWaitForFences(m_Device, 1, &imageFence, true, MAX_uint64);
+	}
+	m_ImageFences[backBufferIndex] = frameFence;
+
 	return backBufferIndex;
 }
 
 void DemoBase::Present(int backBufferIndex)
 {
+	PROFILE_FUNCTION();
+
+	VkFence frameFence = m_Fences[m_FrameIndex];
+
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType 				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.pWaitDstStageMask 	= &m_WaitStageMask;									
 	submitInfo.pWaitSemaphores 		= &m_PresentComplete;
 	submitInfo.waitSemaphoreCount 	= 1;
-	submitInfo.pSignalSemaphores 	= &m_RenderComplete;
+	submitInfo.pSignalSemaphores 	= &(m_RenderComplete[backBufferIndex]);
 	submitInfo.signalSemaphoreCount = 1;											
 	submitInfo.pCommandBuffers 		= &(m_CommandBuffers[backBufferIndex]);
 	submitInfo.commandBufferCount 	= 1;												
 	
-    vkResetFences(m_Device, 1, &(m_Fences[backBufferIndex]));
+    vkResetFences(m_Device, 1, &frameFence);
+
+	VERIFYVULKANRESULT(vkQueueSubmit(m_GfxQueue, 1, &submitInfo, frameFence));
+	if (m_FramesInFlight <= 1) {
+		vkWaitForFences(m_Device, 1, &frameFence, true, MAX_uint64);
+	}
 
-	VERIFYVULKANRESULT(vkQueueSubmit(m_GfxQueue, 1, &submitInfo, m_Fences[backBufferIndex]));
-    vkWaitForFences(m_Device, 1, &(m_Fences[backBufferIndex]), true, MAX_uint64);
+	// RingBuffer中本帧的uniform数据在frameFence完成后才能复用
+	vk_demo::DVKRingBuffer::SubmitFrameAll(frameFence);
+	m_VulkanDevice->GetDeferredDeletionQueue().SubmitFrame(frameFence);
+    
+	// 从创建PipelineCache到第一帧提交的时间，用来对比冷启动和使用磁盘缓存的启动
+	if (m_StartupTime > 0.0)
+	{
+		MLOG("Startup %.2fms with %s pipeline cache.", (GenericPlatformTime::Seconds() - m_StartupTime) * 1000.0, m_PipelineCacheWarm ? "warm" : "cold");
+		m_StartupTime = 0.0;
+	}
     
     // present
-    m_SwapChain->Present(m_VulkanDevice->GetGraphicsQueue(), m_VulkanDevice->GetPresentQueue(), &m_RenderComplete);
+    m_SwapChain->Present(m_VulkanDevice->GetGraphicsQueue(), m_VulkanDevice->GetPresentQueue(), &(m_RenderComplete[backBufferIndex]));
+
+	m_FrameIndex = (m_FrameIndex + 1) % m_Fences.size();
+}
+
+void DemoBase::WaitFrames()
+{
+	if (m_Fences.size() > 0) {
+		vkWaitForFences(m_Device, m_Fences.size(), m_Fences.data(), true, MAX_uint64);
+		m_VulkanDevice->GetDeferredDeletionQueue().ReleaseResources();
+	}
 }
 
 uint32 DemoBase::GetMemoryTypeFromProperties(uint32 typeBits, VkMemoryPropertyFlags properties)
@@ -55,36 +116,60 @@ uint32 DemoBase::GetMemoryTypeFromProperties(uint32 typeBits, VkMemoryPropertyFl
 void DemoBase::DestroyPipelineCache()
 {
 	VkDevice device = GetVulkanRHI()->GetDevice()->GetInstanceHandle();
+	vk_demo::DVKPipelineCache::Save(GetVulkanRHI()->GetDevice(), m_PipelineCache, GetPipelineCacheFilename());
+	vk_demo::DVKShaderCache::Save(GetTitle() + ".shadercache");
 	vkDestroyPipelineCache(device, m_PipelineCache, VULKAN_CPU_ALLOCATOR);
 	m_PipelineCache = VK_NULL_HANDLE;
 }
 
 void DemoBase::CreatePipelineCache()
 {
-	VkDevice device = GetVulkanRHI()->GetDevice()->GetInstanceHandle();
+	m_StartupTime   = GenericPlatformTime::Seconds();
+	m_PipelineCache = vk_demo::DVKPipelineCache::Create(GetVulkanRHI()->GetDevice(), GetPipelineCacheFilename(), &m_PipelineCacheWarm);
+	vk_demo::DVKShaderCache::Load(GetTitle() + ".shadercache");
+}
 
-	VkPipelineCacheCreateInfo createInfo;
-    ZeroVulkanStruct(createInfo, VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO);
-    VERIFYVULKANRESULT(vkCreatePipelineCache(device, &createInfo, VULKAN_CPU_ALLOCATOR, &m_PipelineCache));
+std::string DemoBase::GetPipelineCacheFilename()
+{
+	return GetTitle() + ".pipelinecache";
 }
 
 void DemoBase::CreateFences()
 {
 	VkDevice device  = GetVulkanRHI()->GetDevice()->GetInstanceHandle();
     int32 frameCount = GetVulkanRHI()->GetSwapChain()->GetBackBufferCount();
+
+	m_FramesInFlight = MMath::Clamp(m_FramesInFlight, 1, frameCount);
+	m_FrameIndex     = 0;
         
 	VkFenceCreateInfo fenceCreateInfo;
 	ZeroVulkanStruct(fenceCreateInfo, VK_STRUCTURE_TYPE_FENCE_CREATE_INFO);
 	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
         
-    m_Fences.resize(frameCount);
+    m_Fences.resize(m_FramesInFlight);
 	for (int32 i = 0; i < m_Fences.size(); ++i) {
 		VERIFYVULKANRESULT(vkCreateFence(device, &fenceCreateInfo, VULKAN_CPU_ALLOCATOR, &m_Fences[i]));
 	}
 
+	ResizeImageResources(frameCount);
+}
+
+void DemoBase::ResizeImageResources(int32 frameCount)
+{
+	VkDevice device = GetVulkanRHI()->GetDevice()->GetInstanceHandle();
+
+	m_ImageFences.assign(frameCount, VK_NULL_HANDLE);
+
 	VkSemaphoreCreateInfo createInfo;
 	ZeroVulkanStruct(createInfo, VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO);
-	vkCreateSemaphore(device, &createInfo, VULKAN_CPU_ALLOCATOR, &m_RenderComplete);
+
+	// 只增不减，多出来的semaphore可能还在被之前的present等待
+	for (int32 i = m_RenderComplete.size(); i < frameCount; ++i)
+	{
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		VERIFYVULKANRESULT(vkCreateSemaphore(device, &createInfo, VULKAN_CPU_ALLOCATOR, &semaphore));
+		m_RenderComplete.push_back(semaphore);
+	}
 }
 
 void DemoBase::DestroyFences()
@@ -95,7 +180,13 @@ void DemoBase::DestroyFences()
 		vkDestroyFence(device, m_Fences[i], VULKAN_CPU_ALLOCATOR);
 	}
 
-	vkDestroySemaphore(device, m_RenderComplete, VULKAN_CPU_ALLOCATOR);
+	for (int32 i = 0; i < m_RenderComplete.size(); ++i) {
+		vkDestroySemaphore(device, m_RenderComplete[i], VULKAN_CPU_ALLOCATOR);
+	}
+
+	m_Fences.clear();
+	m_ImageFences.clear();
+	m_RenderComplete.clear();
 }
 
 void DemoBase::CreateDefaultRes()
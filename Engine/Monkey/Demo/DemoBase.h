@@ -25,8 +25,11 @@ public:
 		, m_FrameWidth(0)
 		, m_FrameHeight(0)
 		, m_PipelineCache(VK_NULL_HANDLE)
+		, m_PipelineCacheWarm(false)
+		, m_StartupTime(0.0)
 		, m_PresentComplete(VK_NULL_HANDLE)
-		, m_RenderComplete(VK_NULL_HANDLE)
+		, m_FramesInFlight(1)
+		, m_FrameIndex(0)
 		, m_CommandPool(VK_NULL_HANDLE)
 		, m_WaitStageMask(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT)
 		, m_SwapChain(VK_NULL_HANDLE)
@@ -91,6 +94,7 @@ public:
 
 	void Release() override
 	{
+		WaitFrames();
         AppModuleBase::Release();
 		DestroyDefaultRes();
 		DestroyFences();
@@ -102,6 +106,19 @@ public:
 
 	int32 AcquireBackbufferIndex();
 
+	// 等待所有in flight的帧执行完毕
+	void WaitFrames();
+
+	inline int32 GetFrameIndex() const
+	{
+		return m_FrameIndex;
+	}
+
+	inline int32 GetFramesInFlight() const
+	{
+		return m_FramesInFlight;
+	}
+
 	uint32 GetMemoryTypeFromProperties(uint32 typeBits, VkMemoryPropertyFlags properties);
 
 private:
@@ -118,9 +135,14 @@ private:
 
 	void DestroyFences();
 
+	// 按backbuffer数量调整m_ImageFences以及m_RenderComplete
+	void ResizeImageResources(int32 frameCount);
+
 	void DestroyPipelineCache();
 
 	void CreatePipelineCache();
+
+	std::string GetPipelineCacheFilename();
     
 protected:
 
@@ -135,10 +157,19 @@ protected:
 	int32							m_FrameHeight;
     
 	VkPipelineCache                 m_PipelineCache;
+	bool							m_PipelineCacheWarm;
+	double							m_StartupTime;
     
+	// 每个frame slot一个fence，每个backbuffer一个render complete
 	std::vector<VkFence> 			m_Fences;
+	std::vector<VkFence>			m_ImageFences;
 	VkSemaphore 					m_PresentComplete;
-	VkSemaphore 					m_RenderComplete;
+	std::vector<VkSemaphore>		m_RenderComplete;
+
+	// 同时in flight的帧数，需要在Prepare之前设置，为1时每帧提交后立即等待。
+	// 默认为1，只有每帧写入的数据都按frame slot区分(例如DVKMaterial的RingBuffer)的demo才能设置为2
+	int32							m_FramesInFlight;
+	int32							m_FrameIndex;
 
 	VkCommandPool					m_CommandPool;
 	VkCommandPool					m_ComputeCommandPool;
@@ -4,15 +4,30 @@
 #include "FileManager.h"
 
 #if PLATFORM_WINDOWS
-
+	#include <Windows.h>
 #elif PLATFORM_MAC
-
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <stdlib.h>
 #elif PLATFORM_IOS
-
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <stdlib.h>
 #elif PLATFORM_LINUX
-
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
 #elif PLATFORM_ANDROID
 	#include "Application/Android/AndroidWindow.h"
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
 #endif
 
 std::string FileManager::GetFilePath(const std::string& filepath)
@@ -62,3 +77,167 @@ bool FileManager::ReadFile(const std::string& filepath, uint8*& dataPtr, uint32&
 
 	return true;
 }
+
+#if PLATFORM_MAC || PLATFORM_IOS
+
+// 应用包是只读的，缓存放到Library/Caches(NSCachesDirectory)，HOME在沙盒中指向应用自己的容器
+static std::string GetAppleCacheDirectory()
+{
+	const char* home = getenv("HOME");
+	if (!home) {
+		return "";
+	}
+
+	std::string directory = std::string(home) + "/Library/Caches/";
+#if PLATFORM_MAC
+	// 非沙盒的应用共用~/Library/Caches，单独使用一个子目录
+	directory += "VulkanDemos/";
+	mkdir(directory.c_str(), 0755);
+#endif
+	return directory;
+}
+
+#endif
+
+std::string FileManager::GetCachePath(const std::string& filename)
+{
+#if PLATFORM_ANDROID
+	return std::string(g_AndroidApp->activity->internalDataPath) + "/" + filename;
+#elif PLATFORM_MAC || PLATFORM_IOS
+	static const std::string directory = GetAppleCacheDirectory();
+	if (directory.empty()) {
+		return FileManager::GetFilePath(filename);
+	}
+	return directory + filename;
+#else
+	return FileManager::GetFilePath(filename);
+#endif
+}
+
+bool FileManager::ReadCacheFile(const std::string& filename, uint8*& dataPtr, uint32& dataSize)
+{
+	std::string finalPath = FileManager::GetCachePath(filename);
+
+	// 缓存不存在是正常情况，不输出错误
+	FILE* file = fopen(finalPath.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	dataSize = (uint32)ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	if (dataSize <= 0) {
+		fclose(file);
+		return false;
+	}
+
+	dataPtr = new uint8[dataSize];
+	if (fread(dataPtr, 1, dataSize, file) != dataSize)
+	{
+		fclose(file);
+		delete[] dataPtr;
+		dataPtr = nullptr;
+		return false;
+	}
+	fclose(file);
+
+	return true;
+}
+
+bool FileManager::WriteCacheFile(const std::string& filename, const uint8* dataPtr, uint32 dataSize)
+{
+	std::string finalPath = FileManager::GetCachePath(filename);
+
+	FILE* file = fopen(finalPath.c_str(), "wb");
+	if (!file) {
+		MLOGE("Can't write file :%s", finalPath.c_str());
+		return false;
+	}
+
+	bool success = fwrite(dataPtr, 1, dataSize, file) == dataSize;
+	fclose(file);
+
+	if (!success) {
+		MLOGE("Failed to write file :%s", finalPath.c_str());
+	}
+
+	return success;
+}
+
+bool FileManager::MapCacheFile(const std::string& filename, const uint8*& dataPtr, uint32& dataSize)
+{
+	std::string finalPath = FileManager::GetCachePath(filename);
+
+	dataPtr  = nullptr;
+	dataSize = 0;
+
+#if PLATFORM_WINDOWS
+
+	HANDLE file = CreateFileA(finalPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	DWORD fileSize = GetFileSize(file, nullptr);
+	if (fileSize == 0 || fileSize == INVALID_FILE_SIZE) {
+		CloseHandle(file);
+		return false;
+	}
+
+	// view会持有mapping，两个handle都可以直接关闭
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping) {
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!view) {
+		return false;
+	}
+
+	dataPtr  = (const uint8*)view;
+	dataSize = fileSize;
+
+#else
+
+	int fd = open(finalPath.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+
+	dataPtr  = (const uint8*)view;
+	dataSize = (uint32)fileStat.st_size;
+
+#endif
+
+	return true;
+}
+
+void FileManager::UnmapCacheFile(const uint8* dataPtr, uint32 dataSize)
+{
+	if (!dataPtr) {
+		return;
+	}
+
+#if PLATFORM_WINDOWS
+	UnmapViewOfFile(dataPtr);
+#else
+	munmap((void*)dataPtr, dataSize);
+#endif
+}
@@ -10,4 +10,16 @@ public:
 	static bool ReadFile(const std::string& filepath, uint8*& dataPtr, uint32& dataSize);
 
 	static std::string GetFilePath(const std::string& filepath);
+
+	// 缓存文件位于可写目录，Android上为应用的内部存储，iOS/macOS上为Library/Caches
+	static std::string GetCachePath(const std::string& filename);
+
+	static bool ReadCacheFile(const std::string& filename, uint8*& dataPtr, uint32& dataSize);
+
+	static bool WriteCacheFile(const std::string& filename, const uint8* dataPtr, uint32 dataSize);
+
+	// 只读映射缓存文件，数据在UnmapCacheFile之前有效
+	static bool MapCacheFile(const std::string& filename, const uint8*& dataPtr, uint32& dataSize);
+
+	static void UnmapCacheFile(const uint8* dataPtr, uint32 dataSize);
 };
\ No newline at end of file
@@ -1,6 +1,9 @@
 ﻿#include "Engine.h"
 #include "ImageGUIContext.h"
 #include "Demo/FileManager.h"
+#include "Demo/DVKPipelineCache.h"
+#include "Vulkan/VulkanDeferredDeletion.h"
+#include "Core/Profiler.h"
 
 #include "Application/GenericWindow.h"
 #include "Application/GenericApplication.h"
@@ -81,8 +84,7 @@ static uint32_t g__glsl_shader_frag_spv[] =
 
 ImageGUIContext::ImageGUIContext()
     : m_VulkanDevice(nullptr)
-    , m_VertexCount(0)
-    , m_IndexCount(0)
+    , m_CurrentFrame(-1)
     , m_Subpass(0)
     , m_DescriptorPool(VK_NULL_HANDLE)
     , m_DescriptorSetLayout(VK_NULL_HANDLE)
@@ -267,9 +269,8 @@ void ImageGUIContext::PreparePipelineResources()
 {
 	VkDevice device = m_VulkanDevice->GetInstanceHandle();
 
-	VkPipelineCacheCreateInfo createInfo;
-    ZeroVulkanStruct(createInfo, VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO);
-    VERIFYVULKANRESULT(vkCreatePipelineCache(device, &createInfo, VULKAN_CPU_ALLOCATOR, &m_PipelineCache));
+	// 所有Demo共用一份GUI的PipelineCache
+	m_PipelineCache = vk_demo::DVKPipelineCache::Create(m_VulkanDevice, "ImageGUI.pipelinecache");
 
 	VkDescriptorPoolSize poolSize = {};
 	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -335,12 +336,20 @@ void ImageGUIContext::Destroy()
 {
 	VkDevice device = m_VulkanDevice->GetInstanceHandle();
     ImGui::DestroyContext();
-	m_VertexBuffer.Destroy();
-	m_IndexBuffer.Destroy();
+	for (int32 i = 0; i < m_FrameBuffers.size(); ++i)
+	{
+		ReleaseBuffer(m_FrameBuffers[i].vertexBuffer);
+		ReleaseBuffer(m_FrameBuffers[i].indexBuffer);
+	}
+	m_FrameBuffers.clear();
+	m_CurrentFrame = -1;
+	m_LastGeometry.clear();
+	m_LastDrawCommands.clear();
 	vkDestroyDescriptorPool(device, m_DescriptorPool, VULKAN_CPU_ALLOCATOR);
 	vkDestroyDescriptorSetLayout(device, m_DescriptorSetLayout, VULKAN_CPU_ALLOCATOR);
 	vkDestroyPipelineLayout(device, m_PipelineLayout, VULKAN_CPU_ALLOCATOR);
 	vkDestroyPipeline(device, m_Pipeline, VULKAN_CPU_ALLOCATOR);
+	vk_demo::DVKPipelineCache::Save(m_VulkanDevice, m_PipelineCache, "ImageGUI.pipelinecache");
 	vkDestroyPipelineCache(device, m_PipelineCache, VULKAN_CPU_ALLOCATOR);
 	vkFreeMemory(device, m_FontMemory, VULKAN_CPU_ALLOCATOR);
 	vkDestroyImage(device, m_FontImage, VULKAN_CPU_ALLOCATOR);
@@ -633,6 +642,8 @@ void ImageGUIContext::EndFrame()
 
 bool ImageGUIContext::Update()
 {
+	PROFILE_FUNCTION();
+
     ImDrawData* imDrawData = ImGui::GetDrawData();
 	bool updateCmdBuffers  = false;
 
@@ -649,44 +660,152 @@ bool ImageGUIContext::Update()
 		return false;
 	}
 	
-	// Vertex buffer
-	if ((m_VertexBuffer.buffer == VK_NULL_HANDLE) || (m_VertexCount != imDrawData->TotalVtxCount)) {
-		m_VertexCount = imDrawData->TotalVtxCount;
-		m_VertexBuffer.Unmap();
-		m_VertexBuffer.Destroy();
-		CreateBuffer(m_VertexBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vertexBufferSize);
-		m_VertexBuffer.Map();
+	VulkanDeferredDeletionQueue& deletionQueue = m_VulkanDevice->GetDeferredDeletionQueue();
+
+	if (UpdateDrawCommands(imDrawData)) {
+		updateCmdBuffers = true;
+	}
+	else if (m_CurrentFrame >= 0 && IsGeometryEqual(imDrawData))
+	{
+		// 内容没有变化，GPU只会读取当前的buffer，更新帧号防止被当作空闲的buffer覆盖
+		m_FrameBuffers[m_CurrentFrame].frameNumber = deletionQueue.GetFrameNumber();
+		return m_Updated;
+	}
+
+	// 优先复用当前的buffer，其它情况找一组GPU已经用完的buffer，都还在使用时新建一组，数量最终稳定在in flight的帧数加一
+	int32 frameIndex = -1;
+	if (m_CurrentFrame >= 0 && deletionQueue.IsFrameComplete(m_FrameBuffers[m_CurrentFrame].frameNumber)) {
+		frameIndex = m_CurrentFrame;
+	}
+
+	for (int32 i = 0; i < m_FrameBuffers.size() && frameIndex == -1; ++i)
+	{
+		if (deletionQueue.IsFrameComplete(m_FrameBuffers[i].frameNumber)) {
+			frameIndex = i;
+		}
+	}
+
+	if (frameIndex == -1) {
+		frameIndex = m_FrameBuffers.size();
+		m_FrameBuffers.push_back(FrameBuffers());
+	}
+
+	// 绑定的buffer变了，引用旧buffer的command buffer需要重新录制
+	if (frameIndex != m_CurrentFrame) {
+		m_CurrentFrame   = frameIndex;
+		updateCmdBuffers = true;
+	}
+
+	FrameBuffers& frameBuffers = m_FrameBuffers[frameIndex];
+	frameBuffers.frameNumber   = deletionQueue.GetFrameNumber();
+
+	// buffer只增不减，文字等内容变化时不需要重新创建
+	if (frameBuffers.vertexBuffer.size < vertexBufferSize) {
+		ReleaseBuffer(frameBuffers.vertexBuffer);
+		CreateBuffer(frameBuffers.vertexBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vertexBufferSize + vertexBufferSize / 2);
+		frameBuffers.vertexBuffer.Map();
 		updateCmdBuffers = true;
 	}
     
-	// Index buffer
-	if ((m_IndexBuffer.buffer == VK_NULL_HANDLE) || (m_IndexCount < imDrawData->TotalIdxCount)) {
-		m_IndexCount = imDrawData->TotalIdxCount;
-		m_IndexBuffer.Unmap();
-		m_IndexBuffer.Destroy();
-		CreateBuffer(m_IndexBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, indexBufferSize);
-		m_IndexBuffer.Map();
+	if (frameBuffers.indexBuffer.size < indexBufferSize) {
+		ReleaseBuffer(frameBuffers.indexBuffer);
+		CreateBuffer(frameBuffers.indexBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, indexBufferSize + indexBufferSize / 2);
+		frameBuffers.indexBuffer.Map();
 		updateCmdBuffers = true;
 	}
 
-	// Upload data
-	ImDrawVert* vtxDst = (ImDrawVert*)m_VertexBuffer.mapped;
-	ImDrawIdx* idxDst  = (ImDrawIdx*)m_IndexBuffer.mapped;
+	// Upload data，同时保留一份用于下一帧的对比
+	ImDrawVert* vtxDst = (ImDrawVert*)frameBuffers.vertexBuffer.mapped;
+	ImDrawIdx* idxDst  = (ImDrawIdx*)frameBuffers.indexBuffer.mapped;
+
+	m_LastGeometry.resize(vertexBufferSize + indexBufferSize);
+	uint8* vtxLast = m_LastGeometry.data();
+	uint8* idxLast = m_LastGeometry.data() + vertexBufferSize;
 
 	for (int n = 0; n < imDrawData->CmdListsCount; n++) {
 		const ImDrawList* cmdList = imDrawData->CmdLists[n];
-		memcpy(vtxDst, cmdList->VtxBuffer.Data, cmdList->VtxBuffer.Size * sizeof(ImDrawVert));
-		memcpy(idxDst, cmdList->IdxBuffer.Data, cmdList->IdxBuffer.Size * sizeof(ImDrawIdx));
-		vtxDst += cmdList->VtxBuffer.Size;
-		idxDst += cmdList->IdxBuffer.Size;
+		const size_t vtxSize = cmdList->VtxBuffer.Size * sizeof(ImDrawVert);
+		const size_t idxSize = cmdList->IdxBuffer.Size * sizeof(ImDrawIdx);
+		memcpy(vtxDst, cmdList->VtxBuffer.Data, vtxSize);
+		memcpy(idxDst, cmdList->IdxBuffer.Data, idxSize);
+		memcpy(vtxLast, cmdList->VtxBuffer.Data, vtxSize);
+		memcpy(idxLast, cmdList->IdxBuffer.Data, idxSize);
+		vtxDst  += cmdList->VtxBuffer.Size;
+		idxDst  += cmdList->IdxBuffer.Size;
+		vtxLast += vtxSize;
+		idxLast += idxSize;
 	}
 
-	m_VertexBuffer.Flush();
-	m_IndexBuffer.Flush();
+	frameBuffers.vertexBuffer.Flush();
+	frameBuffers.indexBuffer.Flush();
 
 	return updateCmdBuffers || m_Updated;
 }
 
+bool ImageGUIContext::UpdateDrawCommands(ImDrawData* imDrawData)
+{
+	// 只记录录制command buffer时用到的数据
+	std::vector<uint8> drawCommands;
+	auto append = [&drawCommands](const void* data, size_t size) {
+		const uint8* bytes = (const uint8*)data;
+		drawCommands.insert(drawCommands.end(), bytes, bytes + size);
+	};
+
+	ImGuiIO& io = ImGui::GetIO();
+	append(&io.DisplaySize, sizeof(io.DisplaySize));
+	append(&imDrawData->DisplayPos,  sizeof(imDrawData->DisplayPos));
+	append(&imDrawData->DisplaySize, sizeof(imDrawData->DisplaySize));
+	append(&imDrawData->CmdListsCount, sizeof(imDrawData->CmdListsCount));
+
+	for (int32 i = 0; i < imDrawData->CmdListsCount; ++i)
+	{
+		const ImDrawList* cmdList = imDrawData->CmdLists[i];
+		append(&cmdList->VtxBuffer.Size, sizeof(cmdList->VtxBuffer.Size));
+		append(&cmdList->CmdBuffer.Size, sizeof(cmdList->CmdBuffer.Size));
+		for (int32 j = 0; j < cmdList->CmdBuffer.Size; ++j)
+		{
+			const ImDrawCmd& cmd = cmdList->CmdBuffer[j];
+			append(&cmd.ElemCount, sizeof(cmd.ElemCount));
+			append(&cmd.ClipRect,  sizeof(cmd.ClipRect));
+			append(&cmd.TextureId, sizeof(cmd.TextureId));
+			append(&cmd.UserCallback, sizeof(cmd.UserCallback));
+		}
+	}
+
+	if (drawCommands == m_LastDrawCommands) {
+		return false;
+	}
+
+	m_LastDrawCommands.swap(drawCommands);
+	return true;
+}
+
+bool ImageGUIContext::IsGeometryEqual(ImDrawData* imDrawData) const
+{
+	const size_t vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
+	const size_t indexBufferSize  = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
+	if (m_LastGeometry.size() != vertexBufferSize + indexBufferSize) {
+		return false;
+	}
+
+	const uint8* vtxLast = m_LastGeometry.data();
+	const uint8* idxLast = m_LastGeometry.data() + vertexBufferSize;
+
+	for (int32 i = 0; i < imDrawData->CmdListsCount; ++i)
+	{
+		const ImDrawList* cmdList = imDrawData->CmdLists[i];
+		const size_t vtxSize = cmdList->VtxBuffer.Size * sizeof(ImDrawVert);
+		const size_t idxSize = cmdList->IdxBuffer.Size * sizeof(ImDrawIdx);
+		if (memcmp(vtxLast, cmdList->VtxBuffer.Data, vtxSize) != 0 || memcmp(idxLast, cmdList->IdxBuffer.Data, idxSize) != 0) {
+			return false;
+		}
+		vtxLast += vtxSize;
+		idxLast += idxSize;
+	}
+
+	return true;
+}
+
 void ImageGUIContext::CreateBuffer(UIBuffer& buffer, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size)
 {
 	VkDevice device = m_VulkanDevice->GetInstanceHandle();
@@ -716,6 +835,24 @@ void ImageGUIContext::CreateBuffer(UIBuffer& buffer, VkBufferUsageFlags usageFla
 	buffer.alignment = memReqs.alignment;
 }
 
+void ImageGUIContext::ReleaseBuffer(UIBuffer& buffer)
+{
+	buffer.Unmap();
+
+	VulkanDeferredDeletionQueue& deletionQueue = m_VulkanDevice->GetDeferredDeletionQueue();
+	if (buffer.buffer != VK_NULL_HANDLE) {
+		deletionQueue.EnqueueResource(VulkanDeferredDeletionQueue::Type::Buffer, buffer.buffer);
+	}
+	if (buffer.memory != VK_NULL_HANDLE) {
+		deletionQueue.EnqueueResource(VulkanDeferredDeletionQueue::Type::DeviceMemory, buffer.memory);
+	}
+
+	buffer.buffer = VK_NULL_HANDLE;
+	buffer.memory = VK_NULL_HANDLE;
+	buffer.device = VK_NULL_HANDLE;
+	buffer.size   = 0;
+}
+
 void ImageGUIContext::BindDrawCmd(const VkCommandBuffer& commandBuffer, const VkRenderPass& renderPass, int32 subpass, VkSampleCountFlagBits sampleCount)
 {
     ImDrawData* imDrawData = ImGui::GetDrawData();
@@ -728,7 +865,7 @@ void ImageGUIContext::BindDrawCmd(const VkCommandBuffer& commandBuffer, const Vk
 
 	VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
 	VkDeviceSize indexBufferSize  = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
-	if (vertexBufferSize == 0 || indexBufferSize == 0) {
+	if (vertexBufferSize == 0 || indexBufferSize == 0 || m_CurrentFrame < 0) {
 		return;
 	}
 
@@ -757,8 +894,9 @@ void ImageGUIContext::BindDrawCmd(const VkCommandBuffer& commandBuffer, const Vk
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline);
 	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &m_DescriptorSet, 0, nullptr);
 	vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &m_PushData);
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_VertexBuffer.buffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+	const FrameBuffers& frameBuffers = m_FrameBuffers[m_CurrentFrame];
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &frameBuffers.vertexBuffer.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, frameBuffers.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
 	for (int32_t i = 0; i < imDrawData->CmdListsCount; ++i)
 	{
@@ -82,6 +82,14 @@ protected:
 			device = VK_NULL_HANDLE;
 		}
     };
+
+	// 每个in flight的帧使用自己的一组buffer，frameNumber为最后一次写入时DeferredDeletionQueue的帧号
+	struct FrameBuffers
+	{
+		UIBuffer		vertexBuffer;
+		UIBuffer		indexBuffer;
+		uint64			frameNumber = 0;
+	};
     
     struct PushConstBlock
     {
@@ -120,16 +128,27 @@ protected:
 
 	void CreateBuffer(UIBuffer& buffer, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size);
 
+	// buffer可能还在被in flight的帧使用，交给DeferredDeletionQueue释放
+	void ReleaseBuffer(UIBuffer& buffer);
+
+	// 绘制命令(数量、裁剪区域、纹理等)与上一次相比是否变化，变化时需要重新录制
+	bool UpdateDrawCommands(ImDrawData* imDrawData);
+
+	// 顶点以及索引数据与上一次上传的是否相同
+	bool IsGeometryEqual(ImDrawData* imDrawData) const;
+
 protected:
 
 	typedef std::shared_ptr<VulkanDevice> VulkanDeviceRef;
     
 	VulkanDeviceRef			m_VulkanDevice;
     
-    UIBuffer                m_VertexBuffer;
-    UIBuffer                m_IndexBuffer;
-    int32                   m_VertexCount;
-    int32                   m_IndexCount;
+    std::vector<FrameBuffers>	m_FrameBuffers;
+    int32                   m_CurrentFrame;
+
+	// 上一次上传的顶点、索引数据以及绘制命令，内容没有变化时继续使用当前的buffer
+	std::vector<uint8>		m_LastGeometry;
+	std::vector<uint8>		m_LastDrawCommands;
     
     int32                   m_Subpass;
     
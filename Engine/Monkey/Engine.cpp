@@ -2,6 +2,8 @@
 
 #include "Application/Application.h"
 #include "GenericPlatform/GenericPlatformTime.h"
+#include "Core/JobSystem.h"
+#include "Core/Profiler.h"
 
 #include "Vulkan/VulkanDevice.h"
 
@@ -78,6 +80,7 @@ int32 Engine::PreInit(const std::vector<std::string>& cmdLine, int32 width, int3
 
     InputManager::Init();
 	GenericPlatformTime::InitTiming();
+	JobSystem::Init();
     
 	return 0;
 }
@@ -118,6 +121,9 @@ int32 Engine::Init()
 
 void Engine::Exist()
 {
+	JobSystem::Destroy();
+	CPUProfiler::Destroy();
+
 	m_VulkanRHI->Shutdown();
 	m_VulkanRHI = nullptr;
 
@@ -2,7 +2,7 @@
 
 #include "Common/Common.h"
 
-#include <sys/time.h>
+#include <time.h>
 
 class AndroidPlatformTime
 {
@@ -12,9 +12,10 @@ public:
 
 	static FORCEINLINE double Seconds()
 	{
-		struct timeval tv;
-		gettimeofday(&tv, 0);
-		return ((double)tv.tv_sec) + (((double)tv.tv_usec) / 1000000.0);
+		// 单调时钟，纳秒精度，CPU/GPU profiler共用这个时间轴
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ((double)ts.tv_sec) + (((double)ts.tv_nsec) / 1000000000.0);
 	}
 
     static double GetSecondsPerCycle()
@@ -1 +1,10 @@
-﻿
\ No newline at end of file
+﻿
+#include "IOSPlatformTime.h"
+
+double IOSPlatformTime::s_SecondsPerCycle = 0.0;
+
+double IOSPlatformTime::InitTiming()
+{
+    s_SecondsPerCycle = 1.0 / 1000000000.0;
+    return Seconds();
+}
@@ -1,3 +1,32 @@
 ﻿# pragma once
 
-#include "Common/Common.h"
\ No newline at end of file
+#include "Common/Common.h"
+
+#include <time.h>
+
+class IOSPlatformTime
+{
+public:
+    
+    static double InitTiming();
+    
+    static FORCEINLINE double Seconds()
+    {
+        // 和Mac一样使用单调时钟
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((double)ts.tv_sec) + (((double)ts.tv_nsec) / 1000000000.0);
+    }
+    
+    static double GetSecondsPerCycle()
+    {
+        return s_SecondsPerCycle;
+    }
+    
+protected:
+    
+    static double s_SecondsPerCycle;
+    
+};
+
+typedef IOSPlatformTime GenericPlatformTime;
@@ -4,6 +4,6 @@ double LinuxPlatformTime::s_SecondsPerCycle = 0.0;
 
 double LinuxPlatformTime::InitTiming()
 {
-    s_SecondsPerCycle = 1.0f / 1000000.0f;
+    s_SecondsPerCycle = 1.0 / 1000000000.0;
     return Seconds();
 }
\ No newline at end of file
@@ -5,6 +5,6 @@ double MacPlatformTime::s_SecondsPerCycle = 0.0;
 
 double MacPlatformTime::InitTiming()
 {
-    s_SecondsPerCycle = 1.0f / 1000000.0f;
+    s_SecondsPerCycle = 1.0 / 1000000000.0;
     return Seconds();
 }
@@ -1,5 +1,6 @@
 ﻿#include "Configuration/Platform.h"
 #include "GenericPlatform/GenericPlatformTime.h"
+#include "Core/Profiler.h"
 
 #include "Engine.h"
 #include "Launch.h"
@@ -74,12 +75,20 @@ void EngineLoop()
 	double nowT  = GenericPlatformTime::Seconds();
 	double delta = nowT - g_LastTime;
 	
-	g_AppModule->Loop(g_CurrTime, delta);
+	{
+		PROFILE_ZONE("AppModule::Loop");
+		g_AppModule->Loop(g_CurrTime, delta);
+	}
 
 	// reset between module and engine
 	InputManager::Reset();
 
-	g_GameEngine->Tick(g_CurrTime, delta);
+	{
+		PROFILE_ZONE("Engine::Tick");
+		g_GameEngine->Tick(g_CurrTime, delta);
+	}
+
+	CPUProfiler::EndFrame();
 	
 	g_LastTime = nowT;
 	g_CurrTime = g_CurrTime + delta;
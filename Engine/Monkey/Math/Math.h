@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "Math/PlatformMath.h"
+#include "Math/VectorRegister.h"
 #include "Common/Common.h"
 
 #include <string>
@@ -327,6 +328,9 @@ public:
     
     static FORCEINLINE void VectorMatrixMultiply(void* result, const void* matrix1, const void* matrix2)
     {
+#if MONKEY_SIMD
+        VectorMatrixMultiplySIMD(result, matrix1, matrix2);
+#else
         typedef float Float4x4[4][4];
         const Float4x4& a = *((const Float4x4*) matrix1);
         const Float4x4& b = *((const Float4x4*) matrix2);
@@ -353,6 +357,7 @@ public:
         temp[3][3] = a[3][0] * b[0][3] + a[3][1] * b[1][3] + a[3][2] * b[2][3] + a[3][3] * b[3][3];
         
         memcpy(result, &temp, 16 * sizeof(float));
+#endif
     }
     
     static FORCEINLINE void VectorMatrixInverse(void* dstMatrix, const void* srcMatrix)
@@ -441,6 +446,9 @@ public:
     
     static FORCEINLINE void VectorTransformVector(void* result, const void* vec,  const void* matrix)
     {
+#if MONKEY_SIMD
+        VectorTransformVectorSIMD(result, vec, matrix);
+#else
         typedef float Float4[4];
         typedef float Float4x4[4][4];
         
@@ -452,10 +460,42 @@ public:
         rVec4[1] = vec4[0] * m44[0][1] + vec4[1] * m44[1][1] + vec4[2] * m44[2][1] + vec4[3] * m44[3][1];
         rVec4[2] = vec4[0] * m44[0][2] + vec4[1] * m44[1][2] + vec4[2] * m44[2][2] + vec4[3] * m44[3][2];
         rVec4[3] = vec4[0] * m44[0][3] + vec4[1] * m44[1][3] + vec4[2] * m44[2][3] + vec4[3] * m44[3][3];
+#endif
+    }
+
+    // 批量变换count个位置(w = 1)，positions为紧密排列的xyz，outStride为输出每个元素的float数量(3或4)
+    static FORCEINLINE void VectorTransformPositions(float* outPositions, int32 outStride, const float* positions, int32 count, const void* matrix)
+    {
+#if MONKEY_SIMD
+        VectorTransformPositionsSIMD(outPositions, outStride, positions, count, matrix);
+#else
+        typedef float Float4x4[4][4];
+        // 拷贝一份，避免输出与矩阵可能重叠导致每次都重新读取
+        Float4x4 m44;
+        memcpy(&m44, matrix, 16 * sizeof(float));
+        
+        for (int32 i = 0; i < count; ++i)
+        {
+            const float* src = positions + i * 3;
+            float* dst = outPositions + i * outStride;
+            const float x = src[0];
+            const float y = src[1];
+            const float z = src[2];
+            dst[0] = x * m44[0][0] + y * m44[1][0] + z * m44[2][0] + m44[3][0];
+            dst[1] = x * m44[0][1] + y * m44[1][1] + z * m44[2][1] + m44[3][1];
+            dst[2] = x * m44[0][2] + y * m44[1][2] + z * m44[2][2] + m44[3][2];
+            if (outStride == 4) {
+                dst[3] = x * m44[0][3] + y * m44[1][3] + z * m44[2][3] + m44[3][3];
+            }
+        }
+#endif
     }
     
 	static FORCEINLINE void VectorQuaternionMultiply(void* result, const void* quat1, const void* quat2)
 	{
+#if MONKEY_SIMD
+		VectorQuaternionMultiplySIMD(result, quat1, quat2);
+#else
 		typedef float Float4[4];
 		const Float4& a = *((const Float4*)quat1);
 		const Float4& b = *((const Float4*)quat2);
@@ -476,6 +516,7 @@ public:
 		r[1] = t2 + t9 - t7;
 		r[2] = t3 + t9 - t6;
 		r[3] = t0 + t9 - t5;
+#endif
 	}
 
 	static FORCEINLINE float FindDeltaAngleDegrees(float a1, float a2)
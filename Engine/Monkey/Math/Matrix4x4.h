@@ -123,6 +123,10 @@ public:
 
 	FORCEINLINE Vector4 TransformPosition(const Vector3 &v) const;
 
+	FORCEINLINE void TransformPositions(const Vector3* positions, Vector4* outPositions, int32 count) const;
+
+	FORCEINLINE void TransformPositions(const Vector3* positions, Vector3* outPositions, int32 count) const;
+
 	FORCEINLINE Vector3 InverseTransformPosition(const Vector3 &v) const;
 
 	FORCEINLINE Vector4 TransformVector(const Vector3& v) const;
@@ -915,6 +919,16 @@ FORCEINLINE Vector4 Matrix4x4::TransformPosition(const Vector3 &v) const
 	return TransformVector4(Vector4(v.x, v.y, v.z, 1.0f));
 }
 
+FORCEINLINE void Matrix4x4::TransformPositions(const Vector3* positions, Vector4* outPositions, int32 count) const
+{
+	MMath::VectorTransformPositions((float*)outPositions, 4, (const float*)positions, count, this);
+}
+
+FORCEINLINE void Matrix4x4::TransformPositions(const Vector3* positions, Vector3* outPositions, int32 count) const
+{
+	MMath::VectorTransformPositions((float*)outPositions, 3, (const float*)positions, count, this);
+}
+
 FORCEINLINE Vector3 Matrix4x4::InverseTransformPosition(const Vector3 &v) const
 {
 	Matrix4x4 invSelf = this->InverseFast();
@@ -0,0 +1,443 @@
+﻿#pragma once
+
+#include "Configuration/Platform.h"
+#include "Common/Common.h"
+
+// 编译期选择SIMD实现，定义MONKEY_DISABLE_SIMD可以强制使用标量实现
+#if !defined(MONKEY_DISABLE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define MONKEY_SIMD_SSE		1
+#elif !defined(MONKEY_DISABLE_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+	#define MONKEY_SIMD_NEON	1
+#endif
+
+#ifndef MONKEY_SIMD_SSE
+	#define MONKEY_SIMD_SSE		0
+#endif
+
+#ifndef MONKEY_SIMD_NEON
+	#define MONKEY_SIMD_NEON	0
+#endif
+
+#define MONKEY_SIMD (MONKEY_SIMD_SSE || MONKEY_SIMD_NEON)
+
+// AVX只在SSE的基础上用于矩阵乘法以及批量变换，一次处理两行/两个顶点
+#if MONKEY_SIMD_SSE && defined(__AVX__)
+	#define MONKEY_SIMD_AVX		1
+#else
+	#define MONKEY_SIMD_AVX		0
+#endif
+
+#if MONKEY_SIMD_SSE
+
+#include <emmintrin.h>
+#if defined(__FMA__) || defined(__AVX2__) || MONKEY_SIMD_AVX
+	#include <immintrin.h>
+#endif
+
+typedef __m128 VectorRegister;
+
+#define VectorSwizzle(vec, x, y, z, w)	_mm_shuffle_ps(vec, vec, _MM_SHUFFLE(w, z, y, x))
+#define VectorReplicate(vec, index)		_mm_shuffle_ps(vec, vec, _MM_SHUFFLE(index, index, index, index))
+
+FORCEINLINE VectorRegister VectorLoad(const float* ptr)
+{
+	return _mm_loadu_ps(ptr);
+}
+
+FORCEINLINE VectorRegister VectorLoadFloat1(const float* ptr)
+{
+	return _mm_load1_ps(ptr);
+}
+
+FORCEINLINE VectorRegister VectorSetFloat1(float value)
+{
+	return _mm_set1_ps(value);
+}
+
+FORCEINLINE VectorRegister MakeVectorRegister(float x, float y, float z, float w)
+{
+	return _mm_setr_ps(x, y, z, w);
+}
+
+FORCEINLINE void VectorStore(const VectorRegister& vec, float* ptr)
+{
+	_mm_storeu_ps(ptr, vec);
+}
+
+FORCEINLINE VectorRegister VectorAdd(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_add_ps(a, b);
+}
+
+FORCEINLINE VectorRegister VectorSubtract(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_sub_ps(a, b);
+}
+
+FORCEINLINE VectorRegister VectorMultiply(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_mul_ps(a, b);
+}
+
+// a * b + c
+FORCEINLINE VectorRegister VectorMultiplyAdd(const VectorRegister& a, const VectorRegister& b, const VectorRegister& c)
+{
+#if defined(__FMA__) || defined(__AVX2__)
+	return _mm_fmadd_ps(a, b, c);
+#else
+	return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+FORCEINLINE VectorRegister VectorDivide(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_div_ps(a, b);
+}
+
+FORCEINLINE VectorRegister VectorMin(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_min_ps(a, b);
+}
+
+FORCEINLINE VectorRegister VectorMax(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_max_ps(a, b);
+}
+
+// 比较结果为每个分量全1或者全0的掩码
+FORCEINLINE VectorRegister VectorCompareGT(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_cmpgt_ps(a, b);
+}
+
+FORCEINLINE VectorRegister VectorCompareGE(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_cmpge_ps(a, b);
+}
+
+FORCEINLINE VectorRegister VectorBitwiseAnd(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_and_ps(a, b);
+}
+
+// mask为1的分量取a，否则取b
+FORCEINLINE VectorRegister VectorSelect(const VectorRegister& mask, const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// 掩码每个分量的最高位组成的4bit整数
+FORCEINLINE int32 VectorMaskBits(const VectorRegister& mask)
+{
+	return _mm_movemask_ps(mask);
+}
+
+#if MONKEY_SIMD_AVX
+
+// 低128位和高128位各存放一个VectorRegister
+typedef __m256 VectorRegister2;
+
+#define VectorReplicate2(vec, index)	_mm256_shuffle_ps(vec, vec, _MM_SHUFFLE(index, index, index, index))
+
+FORCEINLINE VectorRegister2 VectorLoad2(const float* ptr)
+{
+	return _mm256_loadu_ps(ptr);
+}
+
+// 同样的4个float放到高低两部分
+FORCEINLINE VectorRegister2 VectorLoadDup2(const float* ptr)
+{
+	return _mm256_broadcast_ps((const __m128*)ptr);
+}
+
+FORCEINLINE VectorRegister2 MakeVectorRegister2(const VectorRegister& low, const VectorRegister& high)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+}
+
+FORCEINLINE void VectorStore2(const VectorRegister2& vec, float* ptr)
+{
+	_mm256_storeu_ps(ptr, vec);
+}
+
+FORCEINLINE VectorRegister2 VectorMultiply2(const VectorRegister2& a, const VectorRegister2& b)
+{
+	return _mm256_mul_ps(a, b);
+}
+
+// a * b + c，与VectorMultiplyAdd保持相同的舍入方式
+FORCEINLINE VectorRegister2 VectorMultiplyAdd2(const VectorRegister2& a, const VectorRegister2& b, const VectorRegister2& c)
+{
+#if defined(__FMA__) || defined(__AVX2__)
+	return _mm256_fmadd_ps(a, b, c);
+#else
+	return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+#endif
+
+#elif MONKEY_SIMD_NEON
+
+#include <arm_neon.h>
+
+typedef float32x4_t VectorRegister;
+
+#if defined(__clang__)
+	#define VectorSwizzle(vec, x, y, z, w)	__builtin_shufflevector(vec, vec, x, y, z, w)
+#else
+	#define VectorSwizzle(vec, x, y, z, w)	__builtin_shuffle(vec, (uint32x4_t){ x, y, z, w })
+#endif
+
+#define VectorReplicate(vec, index)		vdupq_n_f32(vgetq_lane_f32(vec, index))
+
+FORCEINLINE VectorRegister VectorLoad(const float* ptr)
+{
+	return vld1q_f32(ptr);
+}
+
+FORCEINLINE VectorRegister VectorLoadFloat1(const float* ptr)
+{
+	return vld1q_dup_f32(ptr);
+}
+
+FORCEINLINE VectorRegister VectorSetFloat1(float value)
+{
+	return vdupq_n_f32(value);
+}
+
+FORCEINLINE VectorRegister MakeVectorRegister(float x, float y, float z, float w)
+{
+	float data[4] = { x, y, z, w };
+	return vld1q_f32(data);
+}
+
+FORCEINLINE void VectorStore(const VectorRegister& vec, float* ptr)
+{
+	vst1q_f32(ptr, vec);
+}
+
+FORCEINLINE VectorRegister VectorAdd(const VectorRegister& a, const VectorRegister& b)
+{
+	return vaddq_f32(a, b);
+}
+
+FORCEINLINE VectorRegister VectorSubtract(const VectorRegister& a, const VectorRegister& b)
+{
+	return vsubq_f32(a, b);
+}
+
+FORCEINLINE VectorRegister VectorMultiply(const VectorRegister& a, const VectorRegister& b)
+{
+	return vmulq_f32(a, b);
+}
+
+// a * b + c
+FORCEINLINE VectorRegister VectorMultiplyAdd(const VectorRegister& a, const VectorRegister& b, const VectorRegister& c)
+{
+	return vmlaq_f32(c, a, b);
+}
+
+FORCEINLINE VectorRegister VectorDivide(const VectorRegister& a, const VectorRegister& b)
+{
+#if defined(__aarch64__)
+	return vdivq_f32(a, b);
+#else
+	// 倒数估计值再做两次牛顿迭代
+	float32x4_t reciprocal = vrecpeq_f32(b);
+	reciprocal = vmulq_f32(vrecpsq_f32(b, reciprocal), reciprocal);
+	reciprocal = vmulq_f32(vrecpsq_f32(b, reciprocal), reciprocal);
+	return vmulq_f32(a, reciprocal);
+#endif
+}
+
+FORCEINLINE VectorRegister VectorMin(const VectorRegister& a, const VectorRegister& b)
+{
+	return vminq_f32(a, b);
+}
+
+FORCEINLINE VectorRegister VectorMax(const VectorRegister& a, const VectorRegister& b)
+{
+	return vmaxq_f32(a, b);
+}
+
+// 比较结果为每个分量全1或者全0的掩码
+FORCEINLINE VectorRegister VectorCompareGT(const VectorRegister& a, const VectorRegister& b)
+{
+	return vreinterpretq_f32_u32(vcgtq_f32(a, b));
+}
+
+FORCEINLINE VectorRegister VectorCompareGE(const VectorRegister& a, const VectorRegister& b)
+{
+	return vreinterpretq_f32_u32(vcgeq_f32(a, b));
+}
+
+FORCEINLINE VectorRegister VectorBitwiseAnd(const VectorRegister& a, const VectorRegister& b)
+{
+	return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+
+// mask为1的分量取a，否则取b
+FORCEINLINE VectorRegister VectorSelect(const VectorRegister& mask, const VectorRegister& a, const VectorRegister& b)
+{
+	return vbslq_f32(vreinterpretq_u32_f32(mask), a, b);
+}
+
+// 掩码每个分量的最高位组成的4bit整数
+FORCEINLINE int32 VectorMaskBits(const VectorRegister& mask)
+{
+	uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(mask), 31);
+	return vgetq_lane_u32(bits, 0) | (vgetq_lane_u32(bits, 1) << 1) | (vgetq_lane_u32(bits, 2) << 2) | (vgetq_lane_u32(bits, 3) << 3);
+}
+
+#endif
+
+#if MONKEY_SIMD
+
+// 行向量约定：result = matrix1 * matrix2，每一行是matrix2四行的线性组合
+FORCEINLINE void VectorMatrixMultiplySIMD(void* result, const void* matrix1, const void* matrix2)
+{
+	const float* a = (const float*)matrix1;
+	const float* b = (const float*)matrix2;
+	float* r = (float*)result;
+
+#if MONKEY_SIMD_AVX
+	const VectorRegister2 b0 = VectorLoadDup2(b + 0);
+	const VectorRegister2 b1 = VectorLoadDup2(b + 4);
+	const VectorRegister2 b2 = VectorLoadDup2(b + 8);
+	const VectorRegister2 b3 = VectorLoadDup2(b + 12);
+
+	// 一次计算两行，result可能与matrix1相同，先全部算完再写回
+	VectorRegister2 rows[2];
+	for (int32 i = 0; i < 2; ++i)
+	{
+		const VectorRegister2 row = VectorLoad2(a + i * 8);
+		VectorRegister2 temp = VectorMultiply2(VectorReplicate2(row, 0), b0);
+		temp = VectorMultiplyAdd2(VectorReplicate2(row, 1), b1, temp);
+		temp = VectorMultiplyAdd2(VectorReplicate2(row, 2), b2, temp);
+		temp = VectorMultiplyAdd2(VectorReplicate2(row, 3), b3, temp);
+		rows[i] = temp;
+	}
+
+	VectorStore2(rows[0], r + 0);
+	VectorStore2(rows[1], r + 8);
+#else
+	const VectorRegister b0 = VectorLoad(b + 0);
+	const VectorRegister b1 = VectorLoad(b + 4);
+	const VectorRegister b2 = VectorLoad(b + 8);
+	const VectorRegister b3 = VectorLoad(b + 12);
+
+	// result可能与matrix1相同，先全部算完再写回
+	VectorRegister rows[4];
+	for (int32 i = 0; i < 4; ++i)
+	{
+		const VectorRegister row = VectorLoad(a + i * 4);
+		VectorRegister temp = VectorMultiply(VectorReplicate(row, 0), b0);
+		temp = VectorMultiplyAdd(VectorReplicate(row, 1), b1, temp);
+		temp = VectorMultiplyAdd(VectorReplicate(row, 2), b2, temp);
+		temp = VectorMultiplyAdd(VectorReplicate(row, 3), b3, temp);
+		rows[i] = temp;
+	}
+
+	VectorStore(rows[0], r + 0);
+	VectorStore(rows[1], r + 4);
+	VectorStore(rows[2], r + 8);
+	VectorStore(rows[3], r + 12);
+#endif
+}
+
+FORCEINLINE void VectorTransformVectorSIMD(void* result, const void* vec, const void* matrix)
+{
+	const float* v = (const float*)vec;
+	const float* m = (const float*)matrix;
+
+	VectorRegister temp = VectorMultiply(VectorLoadFloat1(v + 0), VectorLoad(m + 0));
+	temp = VectorMultiplyAdd(VectorLoadFloat1(v + 1), VectorLoad(m + 4),  temp);
+	temp = VectorMultiplyAdd(VectorLoadFloat1(v + 2), VectorLoad(m + 8),  temp);
+	temp = VectorMultiplyAdd(VectorLoadFloat1(v + 3), VectorLoad(m + 12), temp);
+
+	VectorStore(temp, (float*)result);
+}
+
+// positions为紧密排列的xyz，w视为1。outPositions每个元素的步长为outStride个float(3或者4)
+FORCEINLINE void VectorTransformPositionsSIMD(float* outPositions, int32 outStride, const float* positions, int32 count, const void* matrix)
+{
+	const float* m = (const float*)matrix;
+	const VectorRegister m0 = VectorLoad(m + 0);
+	const VectorRegister m1 = VectorLoad(m + 4);
+	const VectorRegister m2 = VectorLoad(m + 8);
+	const VectorRegister m3 = VectorLoad(m + 12);
+
+	int32 i = 0;
+
+#if MONKEY_SIMD_AVX
+	const VectorRegister2 m02 = MakeVectorRegister2(m0, m0);
+	const VectorRegister2 m12 = MakeVectorRegister2(m1, m1);
+	const VectorRegister2 m22 = MakeVectorRegister2(m2, m2);
+	const VectorRegister2 m32 = MakeVectorRegister2(m3, m3);
+
+	// 一次变换两个顶点，剩下的一个走下面的逻辑
+	for (; i + 1 < count; i += 2)
+	{
+		const float* src = positions + i * 3;
+		VectorRegister2 temp = VectorMultiplyAdd2(MakeVectorRegister2(VectorLoadFloat1(src + 0), VectorLoadFloat1(src + 3)), m02, m32);
+		temp = VectorMultiplyAdd2(MakeVectorRegister2(VectorLoadFloat1(src + 1), VectorLoadFloat1(src + 4)), m12, temp);
+		temp = VectorMultiplyAdd2(MakeVectorRegister2(VectorLoadFloat1(src + 2), VectorLoadFloat1(src + 5)), m22, temp);
+
+		float* dst = outPositions + i * outStride;
+		if (outStride == 4) {
+			VectorStore2(temp, dst);
+		}
+		else {
+			float data[8];
+			VectorStore2(temp, data);
+			dst[0] = data[0];
+			dst[1] = data[1];
+			dst[2] = data[2];
+			dst[3] = data[4];
+			dst[4] = data[5];
+			dst[5] = data[6];
+		}
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		const float* src = positions + i * 3;
+		VectorRegister temp = VectorMultiplyAdd(VectorLoadFloat1(src + 0), m0, m3);
+		temp = VectorMultiplyAdd(VectorLoadFloat1(src + 1), m1, temp);
+		temp = VectorMultiplyAdd(VectorLoadFloat1(src + 2), m2, temp);
+
+		float* dst = outPositions + i * outStride;
+		if (outStride == 4) {
+			VectorStore(temp, dst);
+		}
+		else {
+			float data[4];
+			VectorStore(temp, data);
+			dst[0] = data[0];
+			dst[1] = data[1];
+			dst[2] = data[2];
+		}
+	}
+}
+
+// 四元数按(x, y, z, w)存储，result = quat1 * quat2
+FORCEINLINE void VectorQuaternionMultiplySIMD(void* result, const void* quat1, const void* quat2)
+{
+	const float* a = (const float*)quat1;
+	const VectorRegister b = VectorLoad((const float*)quat2);
+
+	const VectorRegister signX = MakeVectorRegister( 1.0f, -1.0f,  1.0f, -1.0f);
+	const VectorRegister signY = MakeVectorRegister( 1.0f,  1.0f, -1.0f, -1.0f);
+	const VectorRegister signZ = MakeVectorRegister(-1.0f,  1.0f,  1.0f, -1.0f);
+
+	VectorRegister temp = VectorMultiply(VectorLoadFloat1(a + 3), b);
+	temp = VectorMultiplyAdd(VectorMultiply(VectorLoadFloat1(a + 0), signX), VectorSwizzle(b, 3, 2, 1, 0), temp);
+	temp = VectorMultiplyAdd(VectorMultiply(VectorLoadFloat1(a + 1), signY), VectorSwizzle(b, 2, 3, 0, 1), temp);
+	temp = VectorMultiplyAdd(VectorMultiply(VectorLoadFloat1(a + 2), signZ), VectorSwizzle(b, 1, 0, 3, 2), temp);
+
+	VectorStore(temp, (float*)result);
+}
+
+#endif
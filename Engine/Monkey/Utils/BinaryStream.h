@@ -0,0 +1,143 @@
+﻿#pragma once
+
+#include "Common/Common.h"
+#include "Utils/Crc.h"
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+// 数组数据的对齐，读取时可以直接使用映射内存中的指针
+#define BINARY_ARRAY_ALIGNMENT 4
+
+// 缓存文件的写入，数据按内存布局直接追加
+struct BinaryWriter
+{
+	std::vector<uint8> data;
+
+	// 用0填充到alignment的整数倍
+	void Align(uint32 alignment)
+	{
+		data.resize((data.size() + alignment - 1) / alignment * alignment, 0);
+	}
+
+	void Write(const void* src, uint32 size)
+	{
+		const uint8* bytes = (const uint8*)src;
+		data.insert(data.end(), bytes, bytes + size);
+	}
+
+	template<typename T>
+	void Write(const T& value)
+	{
+		Write(&value, sizeof(T));
+	}
+
+	void WriteString(const std::string& value)
+	{
+		Write((uint32)value.size());
+		Write(value.data(), (uint32)value.size());
+	}
+
+	template<typename T>
+	void WriteArray(const std::vector<T>& values)
+	{
+		static_assert(alignof(T) <= BINARY_ARRAY_ALIGNMENT, "Array element alignment too large.");
+		Write((uint32)values.size());
+		Align(BINARY_ARRAY_ALIGNMENT);
+		Write(values.data(), (uint32)(values.size() * sizeof(T)));
+	}
+};
+
+// 缓存文件的读取，所有读取都做边界检查，文件损坏时返回false
+struct BinaryReader
+{
+	const uint8*	data;
+	uint32			size;
+	uint32			offset;
+
+	inline uint32 Remaining() const
+	{
+		return size - offset;
+	}
+
+	bool Read(void* dst, uint32 count)
+	{
+		if (count > size - offset) {
+			return false;
+		}
+		memcpy(dst, data + offset, count);
+		offset += count;
+		return true;
+	}
+
+	template<typename T>
+	bool Read(T& value)
+	{
+		return Read(&value, sizeof(T));
+	}
+
+	// 跳过BinaryWriter::Align写入的填充，offset相对于data计算，data本身需要满足对齐
+	bool Align(uint32 alignment)
+	{
+		uint32 aligned = (offset + alignment - 1) / alignment * alignment;
+		if (aligned < offset || aligned > size) {
+			return false;
+		}
+		offset = aligned;
+		return true;
+	}
+
+	// 返回原始内存中的指针，不拷贝
+	const uint8* Skip(uint32 count)
+	{
+		if (count > size - offset) {
+			return nullptr;
+		}
+		const uint8* ptr = data + offset;
+		offset += count;
+		return ptr;
+	}
+
+	bool ReadString(std::string& value)
+	{
+		uint32 length = 0;
+		if (!Read(length) || length > size - offset) {
+			return false;
+		}
+		value.assign((const char*)(data + offset), length);
+		offset += length;
+		return true;
+	}
+
+	// 读取WriteArray写入的数组，values指向原始内存，已经按BINARY_ARRAY_ALIGNMENT对齐
+	template<typename T>
+	bool SkipArray(const T*& values, uint32& count)
+	{
+		static_assert(alignof(T) <= BINARY_ARRAY_ALIGNMENT, "Array element alignment too large.");
+		if (!Read(count) || !Align(BINARY_ARRAY_ALIGNMENT) || count > (size - offset) / sizeof(T)) {
+			return false;
+		}
+		values = (const T*)Skip(count * sizeof(T));
+		return true;
+	}
+
+	template<typename T>
+	bool ReadArray(std::vector<T>& values)
+	{
+		const T* src = nullptr;
+		uint32 count = 0;
+		if (!SkipArray(src, count)) {
+			return false;
+		}
+		values.resize(count);
+		memcpy(values.data(), src, count * sizeof(T));
+		return true;
+	}
+};
+
+// 源文件内容的hash，高32位为大小，低32位为CRC
+FORCEINLINE uint64 HashFileContent(const uint8* dataPtr, uint32 dataSize)
+{
+	return ((uint64)dataSize << 32) | (uint64)Crc::MemCrc32(dataPtr, dataSize);
+}
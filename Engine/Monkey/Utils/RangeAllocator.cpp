@@ -0,0 +1,286 @@
+﻿#include "RangeAllocator.h"
+#include "Alignment.h"
+
+#include "Math/Math.h"
+
+RangeAllocator::RangeAllocator()
+{
+	Reset(0);
+}
+
+RangeAllocator::RangeAllocator(uint32 capacity)
+{
+	Reset(capacity);
+}
+
+void RangeAllocator::Reset(uint32 capacity)
+{
+	m_Blocks.clear();
+	m_UnusedBlocks.clear();
+
+	m_FLBitmap = 0;
+	for (int32 fl = 0; fl < FL_COUNT; ++fl)
+	{
+		m_SLBitmap[fl] = 0;
+		for (int32 sl = 0; sl < SL_COUNT; ++sl) {
+			m_FreeHeads[fl][sl] = InvalidHandle;
+		}
+	}
+
+	m_Capacity       = capacity;
+	m_UsedSize       = 0;
+	m_NumAllocations = 0;
+	m_NumFreeBlocks  = 0;
+
+	if (capacity > 0)
+	{
+		uint32 index = NewBlock();
+		m_Blocks[index].offset = 0;
+		m_Blocks[index].size   = capacity;
+		InsertFreeBlock(index);
+	}
+}
+
+void RangeAllocator::Mapping(uint32 size, uint32& outFL, uint32& outSL)
+{
+	if (size < SMALL_SIZE)
+	{
+		outFL = 0;
+		outSL = size;
+	}
+	else
+	{
+		uint32 log2 = 31 - MMath::CountLeadingZeros(size);
+		outSL = (size >> (log2 - SL_LOG2)) ^ SL_COUNT;
+		outFL = log2 - SL_LOG2 + 1;
+	}
+}
+
+uint32 RangeAllocator::FindFreeBlock(uint32 size, uint32 alignment) const
+{
+	uint32 fl = 0;
+	uint32 sl = 0;
+
+	// 先在size所在的SL链表中找一个对齐后放得下的块，最多查看MAX_SEARCH个，避免大块被过早拆分
+	Mapping(size, fl, sl);
+	uint32 index = m_FreeHeads[fl][sl];
+	for (int32 i = 0; i < MAX_SEARCH && index != InvalidHandle; ++i)
+	{
+		const Block& block = m_Blocks[index];
+		uint64 padding = Align((uint64)block.offset, alignment) - block.offset;
+		if (padding + size <= block.size) {
+			return index;
+		}
+		index = block.nextFree;
+	}
+
+	// 向上取到下一个SL区间，保证找到的链表里任意一块都足够大
+	if (size > 0xFFFFFFFF - (alignment - 1)) {
+		return InvalidHandle;
+	}
+	size += alignment - 1;
+
+	if (size >= SMALL_SIZE)
+	{
+		uint32 round = (1u << (31 - MMath::CountLeadingZeros(size) - SL_LOG2)) - 1;
+		if (size > 0xFFFFFFFF - round) {
+			return InvalidHandle;
+		}
+		size += round;
+	}
+
+	Mapping(size, fl, sl);
+
+	uint32 slMap = m_SLBitmap[fl] & (~0u << sl);
+	if (slMap == 0)
+	{
+		uint32 flMap = m_FLBitmap & (~0u << (fl + 1));
+		if (flMap == 0) {
+			return InvalidHandle;
+		}
+		fl    = MMath::CountTrailingZeros(flMap);
+		slMap = m_SLBitmap[fl];
+	}
+	sl = MMath::CountTrailingZeros(slMap);
+
+	return m_FreeHeads[fl][sl];
+}
+
+void RangeAllocator::InsertFreeBlock(uint32 index)
+{
+	Block& block = m_Blocks[index];
+
+	uint32 fl = 0;
+	uint32 sl = 0;
+	Mapping(block.size, fl, sl);
+
+	block.free     = true;
+	block.prevFree = InvalidHandle;
+	block.nextFree = m_FreeHeads[fl][sl];
+	if (block.nextFree != InvalidHandle) {
+		m_Blocks[block.nextFree].prevFree = index;
+	}
+	m_FreeHeads[fl][sl] = index;
+
+	m_FLBitmap     |= 1u << fl;
+	m_SLBitmap[fl] |= 1u << sl;
+	m_NumFreeBlocks += 1;
+}
+
+void RangeAllocator::RemoveFreeBlock(uint32 index)
+{
+	Block& block = m_Blocks[index];
+
+	uint32 fl = 0;
+	uint32 sl = 0;
+	Mapping(block.size, fl, sl);
+
+	if (block.prevFree != InvalidHandle) {
+		m_Blocks[block.prevFree].nextFree = block.nextFree;
+	}
+	else {
+		m_FreeHeads[fl][sl] = block.nextFree;
+	}
+
+	if (block.nextFree != InvalidHandle) {
+		m_Blocks[block.nextFree].prevFree = block.prevFree;
+	}
+
+	if (m_FreeHeads[fl][sl] == InvalidHandle)
+	{
+		m_SLBitmap[fl] &= ~(1u << sl);
+		if (m_SLBitmap[fl] == 0) {
+			m_FLBitmap &= ~(1u << fl);
+		}
+	}
+
+	block.free     = false;
+	block.prevFree = InvalidHandle;
+	block.nextFree = InvalidHandle;
+	m_NumFreeBlocks -= 1;
+}
+
+uint32 RangeAllocator::NewBlock()
+{
+	if (m_UnusedBlocks.size() > 0)
+	{
+		uint32 index = m_UnusedBlocks.back();
+		m_UnusedBlocks.pop_back();
+		m_Blocks[index] = Block();
+		return index;
+	}
+
+	m_Blocks.push_back(Block());
+	return (uint32)m_Blocks.size() - 1;
+}
+
+void RangeAllocator::ReleaseBlock(uint32 index)
+{
+	m_Blocks[index].size = 0;
+	m_UnusedBlocks.push_back(index);
+}
+
+bool RangeAllocator::Allocate(uint32 size, uint32 alignment, Range& outRange)
+{
+	if (size == 0) {
+		size = 1;
+	}
+	alignment = MMath::Max(alignment, 1u);
+
+	uint32 index = FindFreeBlock(size, alignment);
+	if (index == InvalidHandle) {
+		return false;
+	}
+	RemoveFreeBlock(index);
+
+	// 对齐产生的空隙并入本次分配，不单独拆成空闲块，否则会留下大量无法合并的小碎片
+	uint32 padding = Align(m_Blocks[index].offset, alignment) - m_Blocks[index].offset;
+	size += padding;
+
+	// 剩余部分拆成新的空闲块，后一个物理块一定不是空闲的
+	if (m_Blocks[index].size > size)
+	{
+		uint32 back  = NewBlock();
+		Block& block = m_Blocks[index];
+		Block& tail  = m_Blocks[back];
+
+		tail.offset   = block.offset + size;
+		tail.size     = block.size - size;
+		tail.prevPhys = index;
+		tail.nextPhys = block.nextPhys;
+		if (tail.nextPhys != InvalidHandle) {
+			m_Blocks[tail.nextPhys].prevPhys = back;
+		}
+
+		block.size     = size;
+		block.nextPhys = back;
+
+		InsertFreeBlock(back);
+	}
+
+	m_UsedSize       += m_Blocks[index].size;
+	m_NumAllocations += 1;
+
+	outRange.handle = index;
+	outRange.offset = m_Blocks[index].offset + padding;
+	outRange.size   = size - padding;
+
+	return true;
+}
+
+void RangeAllocator::Free(uint32 handle)
+{
+	if (handle >= m_Blocks.size() || m_Blocks[handle].free || m_Blocks[handle].size == 0)
+	{
+		MLOGE("Invalid range handle %u.", handle);
+		return;
+	}
+
+	m_UsedSize       -= m_Blocks[handle].size;
+	m_NumAllocations -= 1;
+
+	uint32 index = handle;
+
+	uint32 prev = m_Blocks[index].prevPhys;
+	if (prev != InvalidHandle && m_Blocks[prev].free)
+	{
+		RemoveFreeBlock(prev);
+		m_Blocks[prev].size    += m_Blocks[index].size;
+		m_Blocks[prev].nextPhys = m_Blocks[index].nextPhys;
+		if (m_Blocks[prev].nextPhys != InvalidHandle) {
+			m_Blocks[m_Blocks[prev].nextPhys].prevPhys = prev;
+		}
+		ReleaseBlock(index);
+		index = prev;
+	}
+
+	uint32 next = m_Blocks[index].nextPhys;
+	if (next != InvalidHandle && m_Blocks[next].free)
+	{
+		RemoveFreeBlock(next);
+		m_Blocks[index].size    += m_Blocks[next].size;
+		m_Blocks[index].nextPhys = m_Blocks[next].nextPhys;
+		if (m_Blocks[index].nextPhys != InvalidHandle) {
+			m_Blocks[m_Blocks[index].nextPhys].prevPhys = index;
+		}
+		ReleaseBlock(next);
+	}
+
+	InsertFreeBlock(index);
+}
+
+uint32 RangeAllocator::GetLargestFreeBlock() const
+{
+	if (m_FLBitmap == 0) {
+		return 0;
+	}
+
+	uint32 fl = 31 - MMath::CountLeadingZeros(m_FLBitmap);
+	uint32 sl = 31 - MMath::CountLeadingZeros(m_SLBitmap[fl]);
+
+	uint32 largest = 0;
+	for (uint32 index = m_FreeHeads[fl][sl]; index != InvalidHandle; index = m_Blocks[index].nextFree) {
+		largest = MMath::Max(largest, m_Blocks[index].size);
+	}
+	return largest;
+}
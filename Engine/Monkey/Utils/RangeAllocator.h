@@ -0,0 +1,115 @@
+﻿#pragma once
+
+#include "Common/Common.h"
+
+#include <vector>
+
+// 基于TLSF(Two-Level Segregated Fit)的区间分配器，只管理offset/size，不访问实际内存。
+// 空闲块按大小分到FL(2的幂)和SL(每个FL再细分SL_COUNT份)两级链表中，用bitmap查找，
+// Allocate/Free均为O(1)，释放时立即与相邻空闲块合并。
+// 非线程安全，由使用者加锁。
+class RangeAllocator
+{
+public:
+	enum
+	{
+		InvalidHandle = 0xFFFFFFFF,
+	};
+
+	struct Range
+	{
+		uint32 handle = InvalidHandle;
+		uint32 offset = 0;
+		uint32 size   = 0;
+	};
+
+	RangeAllocator();
+
+	explicit RangeAllocator(uint32 capacity);
+
+	void Reset(uint32 capacity);
+
+	// alignment必须是2的幂
+	bool Allocate(uint32 size, uint32 alignment, Range& outRange);
+
+	void Free(uint32 handle);
+
+	// 遍历空闲块，仅用于统计
+	uint32 GetLargestFreeBlock() const;
+
+	inline uint32 GetCapacity() const
+	{
+		return m_Capacity;
+	}
+
+	inline uint32 GetUsedSize() const
+	{
+		return m_UsedSize;
+	}
+
+	inline uint32 GetFreeSize() const
+	{
+		return m_Capacity - m_UsedSize;
+	}
+
+	inline uint32 GetNumAllocations() const
+	{
+		return m_NumAllocations;
+	}
+
+	inline uint32 GetNumFreeBlocks() const
+	{
+		return m_NumFreeBlocks;
+	}
+
+	inline bool IsEmpty() const
+	{
+		return m_NumAllocations == 0;
+	}
+
+private:
+	enum
+	{
+		SL_LOG2    = 4,
+		SL_COUNT   = 1 << SL_LOG2,
+		FL_COUNT   = 32 - SL_LOG2 + 1,
+		SMALL_SIZE = SL_COUNT,
+		MAX_SEARCH = 8,
+	};
+
+	struct Block
+	{
+		uint32	offset = 0;
+		uint32	size = 0;
+		uint32	prevPhys = InvalidHandle;
+		uint32	nextPhys = InvalidHandle;
+		uint32	prevFree = InvalidHandle;
+		uint32	nextFree = InvalidHandle;
+		bool	free = false;
+	};
+
+	static void Mapping(uint32 size, uint32& outFL, uint32& outSL);
+
+	uint32 FindFreeBlock(uint32 size, uint32 alignment) const;
+
+	void InsertFreeBlock(uint32 index);
+
+	void RemoveFreeBlock(uint32 index);
+
+	uint32 NewBlock();
+
+	void ReleaseBlock(uint32 index);
+
+private:
+	std::vector<Block>	m_Blocks;
+	std::vector<uint32>	m_UnusedBlocks;
+
+	uint32				m_FLBitmap;
+	uint32				m_SLBitmap[FL_COUNT];
+	uint32				m_FreeHeads[FL_COUNT][SL_COUNT];
+
+	uint32				m_Capacity;
+	uint32				m_UsedSize;
+	uint32				m_NumAllocations;
+	uint32				m_NumFreeBlocks;
+};
@@ -5,6 +5,8 @@
 #include "VulkanDevice.h"
 #include "VulkanFence.h"
 #include "VulkanMemory.h"
+#include "VulkanDeferredDeletion.h"
+#include "VulkanLayoutCache.h"
 #include "VulkanQueue.h"
 #include "VulkanSwapChain.h"
 #include "VulkanGlobals.h"
\ No newline at end of file
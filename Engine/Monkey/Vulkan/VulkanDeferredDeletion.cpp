@@ -0,0 +1,166 @@
+﻿#include "VulkanDeferredDeletion.h"
+#include "VulkanDevice.h"
+#include "VulkanMemory.h"
+
+VulkanDeferredDeletionQueue::VulkanDeferredDeletionQueue(VulkanDevice* device)
+	: m_Device(device)
+	, m_FrameNumber(0)
+	, m_CompletedFrame(0)
+	, m_NumPending(0)
+{
+
+}
+
+VulkanDeferredDeletionQueue::~VulkanDeferredDeletionQueue()
+{
+	if (m_Entries.size() > 0) {
+		MLOGE("%d resources are still pending for deletion!", (int32)m_Entries.size());
+	}
+}
+
+void VulkanDeferredDeletionQueue::EnqueueGenericResource(Type type, uint64 handle, VulkanResourceAllocation* allocation)
+{
+	Entry entry;
+	entry.type        = type;
+	entry.handle      = handle;
+	entry.allocation  = allocation;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		RetireFrames();
+
+		// 有帧还在GPU上执行，需要等到当前帧完成
+		if (m_Frames.size() > 0)
+		{
+			entry.frameNumber = m_FrameNumber;
+			m_Entries.push_back(entry);
+			m_NumPending = (uint32)m_Entries.size();
+			return;
+		}
+	}
+
+	DestroyEntry(entry);
+}
+
+void VulkanDeferredDeletionQueue::SubmitFrame(VkFence fence)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	Frame frame;
+	frame.frameNumber = m_FrameNumber;
+	frame.fence       = fence;
+	m_Frames.push_back(frame);
+
+	m_FrameNumber += 1;
+}
+
+void VulkanDeferredDeletionQueue::RetireFrames()
+{
+	// 帧按顺序提交到同一个队列，前面的帧没完成后面的也一定没完成。
+	// fence被复用时reset后会变成未完成状态，这里只会推迟释放，不会提前释放。
+	VkDevice device = m_Device->GetInstanceHandle();
+	while (m_Frames.size() > 0)
+	{
+		const Frame& frame = m_Frames.front();
+		if (vkGetFenceStatus(device, frame.fence) != VK_SUCCESS) {
+			break;
+		}
+		m_CompletedFrame = frame.frameNumber + 1;
+		m_Frames.pop_front();
+	}
+}
+
+bool VulkanDeferredDeletionQueue::IsFrameComplete(uint64 frameNumber)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	RetireFrames();
+
+	// 当前帧还没有提交，命令可能还在录制，不能算作完成
+	return frameNumber < m_CompletedFrame;
+}
+
+void VulkanDeferredDeletionQueue::ReleaseResources(bool deleteImmediately)
+{
+	std::vector<Entry> entries;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		if (deleteImmediately)
+		{
+			m_Frames.clear();
+			m_CompletedFrame = m_FrameNumber;
+		}
+		else {
+			RetireFrames();
+		}
+
+		int32 count = 0;
+		for (int32 i = 0; i < m_Entries.size(); ++i)
+		{
+			if (m_Entries[i].frameNumber < m_CompletedFrame) {
+				entries.push_back(m_Entries[i]);
+			}
+			else {
+				m_Entries[count++] = m_Entries[i];
+			}
+		}
+		m_Entries.resize(count);
+		m_NumPending = count;
+	}
+
+	for (int32 i = 0; i < entries.size(); ++i) {
+		DestroyEntry(entries[i]);
+	}
+}
+
+void VulkanDeferredDeletionQueue::DestroyEntry(const Entry& entry)
+{
+	VkDevice device = m_Device->GetInstanceHandle();
+
+	switch (entry.type)
+	{
+	case Type::Buffer:
+		vkDestroyBuffer(device, (VkBuffer)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::BufferView:
+		vkDestroyBufferView(device, (VkBufferView)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::Image:
+		vkDestroyImage(device, (VkImage)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::ImageView:
+		vkDestroyImageView(device, (VkImageView)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::Sampler:
+		vkDestroySampler(device, (VkSampler)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::Pipeline:
+		vkDestroyPipeline(device, (VkPipeline)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::PipelineLayout:
+		vkDestroyPipelineLayout(device, (VkPipelineLayout)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::DescriptorSetLayout:
+		vkDestroyDescriptorSetLayout(device, (VkDescriptorSetLayout)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::DescriptorPool:
+		vkDestroyDescriptorPool(device, (VkDescriptorPool)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::Framebuffer:
+		vkDestroyFramebuffer(device, (VkFramebuffer)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::RenderPass:
+		vkDestroyRenderPass(device, (VkRenderPass)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::DeviceMemory:
+		vkFreeMemory(device, (VkDeviceMemory)entry.handle, VULKAN_CPU_ALLOCATOR);
+		break;
+	case Type::ResourceAllocation:
+		delete entry.allocation;
+		break;
+	default:
+		MLOGE("Unknown deferred deletion type %d.", (int32)entry.type);
+		break;
+	}
+}
@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include "Common/Common.h"
+
+#include "VulkanPlatform.h"
+
+#include <mutex>
+#include <deque>
+#include <vector>
+
+class VulkanDevice;
+class VulkanResourceAllocation;
+
+// 延迟释放队列，资源入队时记录当前帧号，等该帧的fence完成后才真正销毁，避免渲染循环中为了删除资源而等待GPU。
+// 只追踪通过SubmitFrame提交的帧，没有in flight的帧时入队的资源会被立即销毁。
+class VulkanDeferredDeletionQueue
+{
+public:
+	enum class Type
+	{
+		Buffer,
+		BufferView,
+		Image,
+		ImageView,
+		Sampler,
+		Pipeline,
+		PipelineLayout,
+		DescriptorSetLayout,
+		DescriptorPool,
+		Framebuffer,
+		RenderPass,
+		DeviceMemory,
+		ResourceAllocation,
+	};
+
+	VulkanDeferredDeletionQueue(VulkanDevice* device);
+
+	virtual ~VulkanDeferredDeletionQueue();
+
+	template<typename T>
+	inline void EnqueueResource(Type type, T handle)
+	{
+		static_assert(sizeof(T) <= sizeof(uint64), "Vulkan handle too large.");
+		EnqueueGenericResource(type, (uint64)handle, nullptr);
+	}
+
+	inline void EnqueueResourceAllocation(VulkanResourceAllocation* allocation)
+	{
+		EnqueueGenericResource(Type::ResourceAllocation, 0, allocation);
+	}
+
+	// 当前帧已经用fence提交，fence完成后当前帧以及之前入队的资源都可以释放
+	void SubmitFrame(VkFence fence);
+
+	// deleteImmediately为true时销毁所有资源，调用者需要保证GPU已经空闲
+	void ReleaseResources(bool deleteImmediately = false);
+
+	inline uint32 GetNumPendingResources() const
+	{
+		return m_NumPending;
+	}
+
+	inline uint64 GetFrameNumber() const
+	{
+		return m_FrameNumber;
+	}
+
+	// frameNumber以及之前提交的帧是否都已经在GPU上执行完毕
+	bool IsFrameComplete(uint64 frameNumber);
+
+private:
+	struct Entry
+	{
+		Type						type = Type::Buffer;
+		uint64						handle = 0;
+		VulkanResourceAllocation*	allocation = nullptr;
+		uint64						frameNumber = 0;
+	};
+
+	struct Frame
+	{
+		uint64		frameNumber = 0;
+		VkFence		fence = VK_NULL_HANDLE;
+	};
+
+	void EnqueueGenericResource(Type type, uint64 handle, VulkanResourceAllocation* allocation);
+
+	void RetireFrames();
+
+	void DestroyEntry(const Entry& entry);
+
+private:
+	VulkanDevice*		m_Device;
+
+	std::mutex			m_Mutex;
+	std::vector<Entry>	m_Entries;
+	std::deque<Frame>	m_Frames;
+
+	uint64				m_FrameNumber;
+	uint64				m_CompletedFrame;
+	uint32				m_NumPending;
+};
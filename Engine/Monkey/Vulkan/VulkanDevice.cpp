@@ -2,6 +2,8 @@
 #include "VulkanPlatform.h"
 #include "VulkanGlobals.h"
 #include "VulkanFence.h"
+#include "VulkanDeferredDeletion.h"
+#include "VulkanLayoutCache.h"
 #include "Application/Application.h"
 
 VulkanDevice::VulkanDevice(VkPhysicalDevice physicalDevice)
@@ -13,6 +15,9 @@ VulkanDevice::VulkanDevice(VkPhysicalDevice physicalDevice)
     , m_PresentQueue(nullptr)
     , m_FenceManager(nullptr)
     , m_MemoryManager(nullptr)
+    , m_ResourceHeapManager(nullptr)
+    , m_DeferredDeletionQueue(nullptr)
+    , m_LayoutCache(nullptr)
 	, m_PhysicalDeviceFeatures2(nullptr)
 {
     
@@ -43,6 +48,8 @@ void VulkanDevice::CreateDevice()
 			MLOG("* %s", m_AppDeviceExtensions[i]);
 		}
 	}
+
+	m_EnabledExtensions.assign(deviceExtensions.begin(), deviceExtensions.end());
 	
     VkDeviceCreateInfo deviceInfo;
     ZeroVulkanStruct(deviceInfo, VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO);
@@ -416,6 +423,13 @@ void VulkanDevice::InitGPU(int32 deviceIndex)
     m_MemoryManager = new VulkanDeviceMemoryManager();
     m_MemoryManager->Init(this);
     
+    m_ResourceHeapManager = new VulkanResourceHeapManager(this);
+    m_ResourceHeapManager->Init();
+    
+    m_DeferredDeletionQueue = new VulkanDeferredDeletionQueue(this);
+    
+    m_LayoutCache = new VulkanLayoutCache(this);
+    
     m_FenceManager = new VulkanFenceManager();
 	m_FenceManager->Init(this);
 }
@@ -425,6 +439,17 @@ void VulkanDevice::Destroy()
 	m_FenceManager->Destory();
 	delete m_FenceManager;
 
+	// 资源的内存来自ResourceHeap，需要在它之前释放
+	m_DeferredDeletionQueue->ReleaseResources(true);
+	delete m_DeferredDeletionQueue;
+	m_DeferredDeletionQueue = nullptr;
+
+	delete m_LayoutCache;
+	m_LayoutCache = nullptr;
+
+	delete m_ResourceHeapManager;
+	m_ResourceHeapManager = nullptr;
+
 	m_MemoryManager->Destory();
 	delete m_MemoryManager;
 
@@ -432,6 +457,17 @@ void VulkanDevice::Destroy()
 	m_Device = VK_NULL_HANDLE;
 }
 
+bool VulkanDevice::IsExtensionEnabled(const char* name) const
+{
+	for (int32 i = 0; i < m_EnabledExtensions.size(); ++i)
+	{
+		if (m_EnabledExtensions[i] == name) {
+			return true;
+		}
+	}
+	return false;
+}
+
 bool VulkanDevice::IsFormatSupported(VkFormat format)
 {
 	auto ArePropertiesSupported = [](const VkFormatProperties& prop) -> bool 
@@ -10,9 +10,13 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <string>
 
 class VulkanFenceManager;
+class VulkanDeferredDeletionQueue;
+class VulkanLayoutCache;
 class VulkanDeviceMemoryManager;
+class VulkanResourceHeapManager;
 
 class VulkanDevice
 {
@@ -95,6 +99,21 @@ public:
         return *m_MemoryManager;
     }
     
+    inline VulkanResourceHeapManager& GetResourceHeapManager()
+    {
+        return *m_ResourceHeapManager;
+    }
+    
+    inline VulkanDeferredDeletionQueue& GetDeferredDeletionQueue()
+    {
+        return *m_DeferredDeletionQueue;
+    }
+
+    inline VulkanLayoutCache& GetLayoutCache()
+    {
+        return *m_LayoutCache;
+    }
+    
 	inline void AddAppDeviceExtensions(const char* name)
 	{
 		m_AppDeviceExtensions.push_back(name);
@@ -105,6 +124,9 @@ public:
 		m_PhysicalDeviceFeatures2 = deviceFeatures;
 	}
 
+	// CreateDevice时实际启用的设备扩展
+	bool IsExtensionEnabled(const char* name) const;
+
 private:
     
     void MapFormatSupport(PixelFormat format, VkFormat vkFormat);
@@ -138,7 +160,11 @@ private:
 
     VulkanFenceManager*                     m_FenceManager;
     VulkanDeviceMemoryManager*              m_MemoryManager;
+    VulkanResourceHeapManager*              m_ResourceHeapManager;
+    VulkanDeferredDeletionQueue*            m_DeferredDeletionQueue;
+    VulkanLayoutCache*                      m_LayoutCache;
 
 	std::vector<const char*>				m_AppDeviceExtensions;
+	std::vector<std::string>				m_EnabledExtensions;
 	VkPhysicalDeviceFeatures2*				m_PhysicalDeviceFeatures2;
 };
@@ -107,15 +107,15 @@ static const char* G_DeviceExtensions[] =
 	"VK_KHR_maintenance1",
 
 #if PLATFORM_WINDOWS
-
+	"VK_EXT_calibrated_timestamps",
 #elif PLATFORM_MAC
 
 #elif PLATFORM_IOS
 
 #elif PLATFORM_LINUX
-
+	"VK_EXT_calibrated_timestamps",
 #elif PLATFORM_ANDROID
-	
+	"VK_EXT_calibrated_timestamps",
 #endif
 
 	nullptr
@@ -0,0 +1,139 @@
+﻿#include "VulkanLayoutCache.h"
+#include "VulkanDevice.h"
+#include "VulkanGlobals.h"
+
+#include "Utils/Crc.h"
+
+VulkanLayoutCache::VulkanLayoutCache(VulkanDevice* device)
+	: m_Device(device)
+	, m_NumSetLayouts(0)
+	, m_NumPipelineLayouts(0)
+{
+
+}
+
+VulkanLayoutCache::~VulkanLayoutCache()
+{
+	Destroy();
+}
+
+void VulkanLayoutCache::Destroy()
+{
+	VkDevice device = m_Device->GetInstanceHandle();
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	for (auto it = m_PipelineLayouts.begin(); it != m_PipelineLayouts.end(); ++it)
+	{
+		for (int32 i = 0; i < it->second.size(); ++i) {
+			vkDestroyPipelineLayout(device, it->second[i].handle, VULKAN_CPU_ALLOCATOR);
+		}
+	}
+	m_PipelineLayouts.clear();
+
+	for (auto it = m_SetLayouts.begin(); it != m_SetLayouts.end(); ++it)
+	{
+		for (int32 i = 0; i < it->second.size(); ++i) {
+			vkDestroyDescriptorSetLayout(device, it->second[i].handle, VULKAN_CPU_ALLOCATOR);
+		}
+	}
+	m_SetLayouts.clear();
+
+	m_NumSetLayouts      = 0;
+	m_NumPipelineLayouts = 0;
+}
+
+uint32 VulkanLayoutCache::HashBindings(const BindingsArray& bindings)
+{
+	uint32 seed = 0;
+	for (int32 i = 0; i < bindings.size(); ++i)
+	{
+		const VkDescriptorSetLayoutBinding& binding = bindings[i];
+		Crc::HashCombine(seed, Crc::MakeHashCode(binding.binding, (uint32)binding.descriptorType, binding.descriptorCount, (uint32)binding.stageFlags));
+	}
+	return seed;
+}
+
+uint32 VulkanLayoutCache::HashSetLayouts(const SetLayoutsArray& setLayouts)
+{
+	uint32 seed = 0;
+	for (int32 i = 0; i < setLayouts.size(); ++i) {
+		Crc::HashCombine(seed, (uint64)setLayouts[i]);
+	}
+	return seed;
+}
+
+bool VulkanLayoutCache::IsEqual(const BindingsArray& a, const BindingsArray& b)
+{
+	if (a.size() != b.size()) {
+		return false;
+	}
+
+	for (int32 i = 0; i < a.size(); ++i)
+	{
+		if (a[i].binding != b[i].binding || a[i].descriptorType != b[i].descriptorType || a[i].descriptorCount != b[i].descriptorCount || a[i].stageFlags != b[i].stageFlags || a[i].pImmutableSamplers != b[i].pImmutableSamplers) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+VkDescriptorSetLayout VulkanLayoutCache::GetDescriptorSetLayout(const BindingsArray& bindings)
+{
+	uint32 hash = HashBindings(bindings);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	std::vector<SetLayoutEntry>& entries = m_SetLayouts[hash];
+	for (int32 i = 0; i < entries.size(); ++i)
+	{
+		if (IsEqual(entries[i].bindings, bindings)) {
+			return entries[i].handle;
+		}
+	}
+
+	SetLayoutEntry entry;
+	entry.bindings = bindings;
+
+	VkDescriptorSetLayoutCreateInfo descSetLayoutInfo;
+	ZeroVulkanStruct(descSetLayoutInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO);
+	descSetLayoutInfo.bindingCount = bindings.size();
+	descSetLayoutInfo.pBindings    = bindings.data();
+	VERIFYVULKANRESULT(vkCreateDescriptorSetLayout(m_Device->GetInstanceHandle(), &descSetLayoutInfo, VULKAN_CPU_ALLOCATOR, &entry.handle));
+
+	entries.push_back(entry);
+	m_NumSetLayouts += 1;
+
+	return entry.handle;
+}
+
+VkPipelineLayout VulkanLayoutCache::GetPipelineLayout(const SetLayoutsArray& setLayouts)
+{
+	// set layout已经去重，直接比较handle即可
+	uint32 hash = HashSetLayouts(setLayouts);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	std::vector<PipelineLayoutEntry>& entries = m_PipelineLayouts[hash];
+	for (int32 i = 0; i < entries.size(); ++i)
+	{
+		if (entries[i].setLayouts == setLayouts) {
+			return entries[i].handle;
+		}
+	}
+
+	PipelineLayoutEntry entry;
+	entry.setLayouts = setLayouts;
+
+	VkPipelineLayoutCreateInfo pipeLayoutInfo;
+	ZeroVulkanStruct(pipeLayoutInfo, VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO);
+	pipeLayoutInfo.setLayoutCount = setLayouts.size();
+	pipeLayoutInfo.pSetLayouts    = setLayouts.data();
+	VERIFYVULKANRESULT(vkCreatePipelineLayout(m_Device->GetInstanceHandle(), &pipeLayoutInfo, VULKAN_CPU_ALLOCATOR, &entry.handle));
+
+	entries.push_back(entry);
+	m_NumPipelineLayouts += 1;
+
+	return entry.handle;
+}
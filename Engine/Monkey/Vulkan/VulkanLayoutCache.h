@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include "Common/Common.h"
+
+#include "VulkanPlatform.h"
+
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+class VulkanDevice;
+
+// 设备级的DescriptorSetLayout和PipelineLayout缓存，按binding内容的hash去重。
+// 相同布局的shader拿到的是同一个handle，handle一直存活到设备销毁，使用者不需要释放。
+class VulkanLayoutCache
+{
+public:
+	typedef std::vector<VkDescriptorSetLayoutBinding>	BindingsArray;
+	typedef std::vector<VkDescriptorSetLayout>			SetLayoutsArray;
+
+	VulkanLayoutCache(VulkanDevice* device);
+
+	virtual ~VulkanLayoutCache();
+
+	void Destroy();
+
+	VkDescriptorSetLayout GetDescriptorSetLayout(const BindingsArray& bindings);
+
+	VkPipelineLayout GetPipelineLayout(const SetLayoutsArray& setLayouts);
+
+	inline uint32 GetNumDescriptorSetLayouts() const
+	{
+		return m_NumSetLayouts;
+	}
+
+	inline uint32 GetNumPipelineLayouts() const
+	{
+		return m_NumPipelineLayouts;
+	}
+
+private:
+	struct SetLayoutEntry
+	{
+		BindingsArray			bindings;
+		VkDescriptorSetLayout	handle = VK_NULL_HANDLE;
+	};
+
+	struct PipelineLayoutEntry
+	{
+		SetLayoutsArray			setLayouts;
+		VkPipelineLayout		handle = VK_NULL_HANDLE;
+	};
+
+	static uint32 HashBindings(const BindingsArray& bindings);
+
+	static uint32 HashSetLayouts(const SetLayoutsArray& setLayouts);
+
+	static bool IsEqual(const BindingsArray& a, const BindingsArray& b);
+
+private:
+	VulkanDevice*		m_Device;
+
+	std::mutex			m_Mutex;
+
+	// hash冲突时同一个key下保存多个条目
+	std::unordered_map<uint32, std::vector<SetLayoutEntry>>			m_SetLayouts;
+	std::unordered_map<uint32, std::vector<PipelineLayoutEntry>>	m_PipelineLayouts;
+
+	uint32				m_NumSetLayouts;
+	uint32				m_NumPipelineLayouts;
+};
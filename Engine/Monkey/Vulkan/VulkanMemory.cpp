@@ -7,7 +7,7 @@
 
 enum
 {
-    GPU_ONLY_HEAP_PAGE_SIZE     = 256 * 1024 * 1024,
+    GPU_ONLY_HEAP_PAGE_SIZE     = 64 * 1024 * 1024,
     STAGING_HEAP_PAGE_SIZE      = 32 * 1024 * 1024,
     ANDROID_MAX_HEAP_PAGE_SIZE  = 16 * 1024 * 1024,
 };
@@ -15,37 +15,6 @@ enum
 constexpr uint32 VulkanResourceHeapManager::m_PoolSizes[(int32)VulkanResourceHeapManager::PoolSizes::SizesCount];
 constexpr uint32 VulkanResourceHeapManager::m_BufferSizes[(int32)VulkanResourceHeapManager::PoolSizes::SizesCount + 1];
 
-// VulkanRange
-void VulkanRange::JoinConsecutiveRanges(std::vector<VulkanRange>& ranges)
-{
-    if (ranges.size() == 0) {
-        return;
-    }
-    
-    std::sort(ranges.begin(), ranges.end(), [](const VulkanRange& a, const VulkanRange& b) {
-        if (a.offset > b.offset) {
-            return 1;
-        }
-        else if (a.offset == b.offset) {
-            return 0;
-        }
-        else {
-            return -1;
-        }
-    });
-    
-    for (int32 index = (int32)ranges.size() - 1; index > 0; --index)
-    {
-        VulkanRange& current = ranges[index + 0];
-        VulkanRange& prev    = ranges[index - 1];
-        if (prev.offset + prev.size == current.offset)
-        {
-            prev.size += current.size;
-            ranges.erase(ranges.begin() + index);
-        }
-    }
-}
-
 // VulkanDeviceMemoryAllocation
 VulkanDeviceMemoryAllocation::VulkanDeviceMemoryAllocation()
 	: m_Size(0)
@@ -205,6 +174,8 @@ VulkanDeviceMemoryAllocation* VulkanDeviceMemoryManager::Alloc(bool canFail, VkD
         VERIFYVULKANRESULT(result);
     }
     
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    
     m_NumAllocations     += 1;
     m_PeakNumAllocations = MMath::Max(m_NumAllocations, m_PeakNumAllocations);
     if (m_NumAllocations == m_Device->GetLimits().maxMemoryAllocationCount) {
@@ -221,9 +192,11 @@ VulkanDeviceMemoryAllocation* VulkanDeviceMemoryManager::Alloc(bool canFail, VkD
 
 void VulkanDeviceMemoryManager::Free(VulkanDeviceMemoryAllocation*& allocation)
 {
-    m_NumAllocations -= 1;
-
     vkFreeMemory(m_DeviceHandle, allocation->m_Handle, VULKAN_CPU_ALLOCATOR);
+    
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    
+    m_NumAllocations -= 1;
     uint32 heapIndex = m_MemoryProperties.memoryTypes[allocation->m_MemoryTypeIndex].heapIndex;
     m_HeapInfos[heapIndex].usedSize -= allocation->m_Size;
     
@@ -339,6 +312,7 @@ VulkanResourceAllocation::VulkanResourceAllocation(VulkanResourceHeapPage* owner
     , m_AllocationOffset(allocationOffset)
     , m_RequestedSize(requestedSize)
     , m_AlignedOffset(alignedOffset)
+    , m_RangeHandle(RangeAllocator::InvalidHandle)
     , m_DeviceMemoryAllocation(deviceMemoryAllocation)
 {
 
@@ -373,22 +347,55 @@ void VulkanResourceAllocation::BindImage(VulkanDevice* device, VkImage image)
     VERIFYVULKANRESULT(result);
 }
 
+void VulkanResourceAllocation::GetAtomRange(VkDeviceSize offset, VkDeviceSize size, VkDeviceSize& outOffset, VkDeviceSize& outSize) const
+{
+    VkDeviceSize atomSize = m_Owner->GetOwner()->GetOwner()->GetVulkanDevice()->GetLimits().nonCoherentAtomSize;
+    VkDeviceSize begin    = m_AlignedOffset + offset;
+    VkDeviceSize end      = size == VK_WHOLE_SIZE ? m_AllocationOffset + m_AllocationSize : begin + size;
+    
+    begin = AlignDown(begin, atomSize);
+    end   = MMath::Min(Align(end, atomSize), m_DeviceMemoryAllocation->GetSize());
+    
+    outOffset = begin;
+    outSize   = end - begin;
+}
+
+void VulkanResourceAllocation::FlushMappedMemory(VkDeviceSize offset, VkDeviceSize size)
+{
+    if (m_DeviceMemoryAllocation->IsCoherent()) {
+        return;
+    }
+    
+    VkDeviceSize rangeOffset = 0;
+    VkDeviceSize rangeSize   = 0;
+    GetAtomRange(offset, size, rangeOffset, rangeSize);
+    m_DeviceMemoryAllocation->FlushMappedMemory(rangeOffset, rangeSize);
+}
+
+void VulkanResourceAllocation::InvalidateMappedMemory(VkDeviceSize offset, VkDeviceSize size)
+{
+    if (m_DeviceMemoryAllocation->IsCoherent()) {
+        return;
+    }
+    
+    VkDeviceSize rangeOffset = 0;
+    VkDeviceSize rangeSize   = 0;
+    GetAtomRange(offset, size, rangeOffset, rangeSize);
+    m_DeviceMemoryAllocation->InvalidateMappedMemory(rangeOffset, rangeSize);
+}
+
 // VulkanResourceHeapPage
 VulkanResourceHeapPage::VulkanResourceHeapPage(VulkanResourceHeap* owner, VulkanDeviceMemoryAllocation* deviceMemoryAllocation, uint32 id)
     : m_Owner(owner)
     , m_DeviceMemoryAllocation(deviceMemoryAllocation)
     , m_MaxSize(0)
-    , m_UsedSize(0)
     , m_PeakNumAllocations(0)
     , m_FrameFreed(0)
     , m_ID(id)
+    , m_IsDedicated(false)
 {
     m_MaxSize = (uint32)m_DeviceMemoryAllocation->GetSize();
-
-    VulkanRange fullRange;
-    fullRange.offset = 0;
-    fullRange.size   = m_MaxSize;
-    m_FreeList.push_back(fullRange);
+    m_Allocator.Reset(m_MaxSize);
 }
 
 VulkanResourceHeapPage::~VulkanResourceHeapPage()
@@ -400,75 +407,38 @@ VulkanResourceHeapPage::~VulkanResourceHeapPage()
 
 void VulkanResourceHeapPage::ReleaseAllocation(VulkanResourceAllocation* allocation)
 {
-    auto it = std::find(m_ResourceAllocations.begin(), m_ResourceAllocations.end(), allocation);
-    if (it != m_ResourceAllocations.end())
-    {
-        m_ResourceAllocations.erase(it);
-        VulkanRange newFree;
-        newFree.offset = allocation->m_AllocationOffset;
-        newFree.size   = allocation->m_AllocationSize;
-        m_FreeList.push_back(newFree);
-    }
+    std::lock_guard<std::mutex> lock(m_Owner->m_Mutex);
     
-    m_UsedSize -= allocation->m_AllocationSize;
-    if (m_UsedSize < 0) {
-        MLOGE("Used size less than zero.");
-    }
+    m_Allocator.Free(allocation->m_RangeHandle);
     
-    if (JoinFreeBlocks()) {
+    if (m_Allocator.IsEmpty()) {
         m_Owner->FreePage(this);
     }
 }
 
 VulkanResourceAllocation* VulkanResourceHeapPage::TryAllocate(uint32 size, uint32 alignment, const char* file, uint32 line)
 {
-    for (int32 index = 0; index < m_FreeList.size(); ++index)
-    {
-        VulkanRange& entry         = m_FreeList[index];
-        uint32 allocatedOffset     = entry.offset;
-        uint32 alignedOffset       = Align(entry.offset, alignment);
-        uint32 alignmentAdjustment = alignedOffset - entry.offset;
-        uint32 allocatedSize       = alignmentAdjustment + size;
-
-        if (allocatedSize <= entry.size)
-        {
-            if (allocatedSize < entry.size) {
-                entry.size   -= allocatedSize;
-                entry.offset += allocatedSize;
-            }
-            else {
-                m_FreeList.erase(m_FreeList.begin() + index);
-            }
-            m_UsedSize += allocatedSize;
-            VulkanResourceAllocation* newResourceAllocation = new VulkanResourceAllocation(this, m_DeviceMemoryAllocation, size, alignedOffset, allocatedSize, allocatedOffset, file, line);
-            m_ResourceAllocations.push_back(newResourceAllocation);
-            m_PeakNumAllocations = MMath::Max((uint32)m_PeakNumAllocations, (uint32)m_ResourceAllocations.size());
-            
-            return newResourceAllocation;
-        }
+    RangeAllocator::Range range;
+    if (!m_Allocator.Allocate(size, alignment, range)) {
+        return nullptr;
     }
     
-    return nullptr;
+    VulkanResourceAllocation* newResourceAllocation = new VulkanResourceAllocation(this, m_DeviceMemoryAllocation, size, range.offset, range.size, range.offset, file, line);
+    newResourceAllocation->m_RangeHandle = range.handle;
+    m_PeakNumAllocations = MMath::Max((uint32)m_PeakNumAllocations, m_Allocator.GetNumAllocations());
+    
+    return newResourceAllocation;
 }
 
-bool VulkanResourceHeapPage::JoinFreeBlocks()
+bool VulkanResourceHeapPage::IsEmpty() const
 {
-    VulkanRange::JoinConsecutiveRanges(m_FreeList);
-    if (m_FreeList.size() == 1)
-    {
-        if (m_ResourceAllocations.size() == 0)
-        {
-            if (m_UsedSize > 0) {
-                MLOGE("Memory leak, used size = %d", (int32)m_UsedSize);
-            }
-            if (m_FreeList[0].offset != 0 || m_FreeList[0].size != m_MaxSize) {
-                MLOGE("Memory leak, should have %d free, only have %d; missing %d bytes", m_MaxSize, m_FreeList[0].size, m_MaxSize - m_FreeList[0].size);
-            }
-            return true;
-        }
+    if (!m_Allocator.IsEmpty()) {
+        return false;
     }
-    
-    return false;
+    if (m_Allocator.GetUsedSize() > 0 || m_Allocator.GetNumFreeBlocks() != 1) {
+        MLOGE("Memory leak, should have %d free, only have %d; missing %d bytes", m_MaxSize, m_Allocator.GetFreeSize(), m_Allocator.GetUsedSize());
+    }
+    return true;
 }
 
 // VulkanResourceHeap
@@ -481,6 +451,7 @@ VulkanResourceHeap::VulkanResourceHeap(VulkanResourceHeapManager* owner, uint32
     , m_DefaultPageSize(pageSize)
     , m_PeakPageSize(0)
     , m_UsedMemory(0)
+    , m_PeakUsedMemory(0)
     , m_PageIDCounter(0)
 {
     
@@ -496,7 +467,7 @@ VulkanResourceHeap::~VulkanResourceHeap()
         for (int32 index = (int32)usedPages.size() - 1; index >= 0; --index)
         {
             VulkanResourceHeapPage* page = usedPages[index];
-            if (!page->JoinFreeBlocks())
+            if (!page->IsEmpty())
             {
                 MLOG("Page allocation %p has unfreed %s resources", (void*)page->m_DeviceMemoryAllocation->GetHandle(), name);
                 leak = true;
@@ -511,6 +482,7 @@ VulkanResourceHeap::~VulkanResourceHeap()
     bool dump = false;
     dump = dump || DeletePages(m_UsedBufferPages,   "Buffer");
     dump = dump || DeletePages(m_UsedImagePages,    "Image");
+    dump = dump || DeletePages(m_DedicatedPages,    "Dedicated");
     dump = dump || DeletePages(m_FreePages,         "Free");
     
     if (dump)
@@ -523,7 +495,19 @@ VulkanResourceHeap::~VulkanResourceHeap()
 
 void VulkanResourceHeap::FreePage(VulkanResourceHeapPage* page)
 {
-    page->JoinFreeBlocks();
+    // 独占的page不复用，直接释放
+    if (page->m_IsDedicated)
+    {
+        auto it = std::find(m_DedicatedPages.begin(), m_DedicatedPages.end(), page);
+        if (it != m_DedicatedPages.end())
+        {
+            m_DedicatedPages.erase(it);
+            m_UsedMemory -= page->m_MaxSize;
+            m_Owner->GetVulkanDevice()->GetMemoryManager().Free(page->m_DeviceMemoryAllocation);
+            delete page;
+        }
+        return;
+    }
     
     bool removed = false;
     for (int32 i = 0; i < m_UsedBufferPages.size(); ++i)
@@ -555,6 +539,8 @@ void VulkanResourceHeap::FreePage(VulkanResourceHeapPage* page)
 
 void VulkanResourceHeap::ReleaseFreedPages(bool immediately)
 {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    
     for (int32 index = 0; index < m_FreePages.size(); ++index)
     {
         VulkanResourceHeapPage* page = m_FreePages[index];
@@ -569,6 +555,8 @@ void VulkanResourceHeap::ReleaseFreedPages(bool immediately)
 #if MONKEY_DEBUG
 void VulkanResourceHeap::DumpMemory()
 {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    
     MLOG("%d Free Pages", (int32)m_FreePages.size());
     
     auto DumpPages = [&](std::vector<VulkanResourceHeapPage*>& usedPages, const char* typeName)
@@ -579,10 +567,11 @@ void VulkanResourceHeap::DumpMemory()
         uint32 numSubAllocations       = 0;
         for (int32 index = 0; index < usedPages.size(); ++index)
         {
-            subAllocUsedMemory      += usedPages[index]->m_UsedSize;
+            const RangeAllocator& allocator = usedPages[index]->m_Allocator;
+            subAllocUsedMemory      += allocator.GetUsedSize();
             subAllocAllocatedMemory += usedPages[index]->m_MaxSize;
-            numSubAllocations       += (uint32)usedPages[index]->m_ResourceAllocations.size();
-            MLOG("\t\t%d: ID %4d %4d suballocs, %4d free chunks (%d used/%d free/%d max) DeviceMemory %p", index, usedPages[index]->GetID(), (int32)usedPages[index]->m_ResourceAllocations.size(), (int32)usedPages[index]->m_FreeList.size(), usedPages[index]->m_UsedSize, usedPages[index]->m_MaxSize - usedPages[index]->m_UsedSize, usedPages[index]->m_MaxSize, (void*)usedPages[index]->m_DeviceMemoryAllocation->GetHandle());
+            numSubAllocations       += allocator.GetNumAllocations();
+            MLOG("\t\t%d: ID %4d %4d suballocs, %4d free chunks (%d used/%d free/%d max/%d largest free) DeviceMemory %p", index, usedPages[index]->GetID(), (int32)allocator.GetNumAllocations(), (int32)allocator.GetNumFreeBlocks(), allocator.GetUsedSize(), allocator.GetFreeSize(), usedPages[index]->m_MaxSize, allocator.GetLargestFreeBlock(), (void*)usedPages[index]->m_DeviceMemoryAllocation->GetHandle());
         }
         
         MLOG("%d Suballocations for Used/Total: %d/%d = %.2f%%", numSubAllocations, (int32)subAllocUsedMemory, (int32)subAllocAllocatedMemory, subAllocAllocatedMemory > 0 ? 100.0f * (float)subAllocUsedMemory / (float)subAllocAllocatedMemory : 0.0f);
@@ -595,9 +584,13 @@ void VulkanResourceHeap::DumpMemory()
 
 VulkanResourceAllocation* VulkanResourceHeap::AllocateResource(Type type, uint32 size, uint32 alignment, bool mapAllocation, const char* file, uint32 line)
 {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    
     std::vector<VulkanResourceHeapPage*>& usedPages = type == Type::Image ? m_UsedImagePages : m_UsedBufferPages;
     uint32 targetDefaultPageSize = m_DefaultPageSize;
     
+    AlignForNonCoherentAtom(size, alignment);
+    
     if (size < targetDefaultPageSize)
     {
         for (int32 index = 0; index < usedPages.size(); ++index)
@@ -638,16 +631,94 @@ VulkanResourceAllocation* VulkanResourceHeap::AllocateResource(Type type, uint32
     usedPages.push_back(newPage);
 
     m_PageIDCounter += 1;
-    m_UsedMemory    += allocationSize;
+    m_UsedMemory    += deviceMemoryAllocation->GetSize();
+    m_PeakUsedMemory = MMath::Max(m_PeakUsedMemory, m_UsedMemory);
     m_PeakPageSize   = MMath::Max(m_PeakPageSize, allocationSize);
     
     if (mapAllocation) {
-        deviceMemoryAllocation->Map(allocationSize, 0);
+        deviceMemoryAllocation->Map(deviceMemoryAllocation->GetSize(), 0);
+    }
+    
+    return newPage->Allocate(size, alignment, file, line);
+}
+
+VulkanResourceAllocation* VulkanResourceHeap::AllocateDedicatedResource(uint32 size, uint32 alignment, bool mapAllocation, const char* file, uint32 line)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    
+    AlignForNonCoherentAtom(size, alignment);
+    
+    VulkanDeviceMemoryAllocation* deviceMemoryAllocation = m_Owner->GetVulkanDevice()->GetMemoryManager().Alloc(false, size, m_MemoryTypeIndex, nullptr, file, line);
+    
+    VulkanResourceHeapPage* newPage = new VulkanResourceHeapPage(this, deviceMemoryAllocation, m_PageIDCounter);
+    newPage->m_IsDedicated = true;
+    m_DedicatedPages.push_back(newPage);
+    
+    m_PageIDCounter += 1;
+    m_UsedMemory    += size;
+    m_PeakUsedMemory = MMath::Max(m_PeakUsedMemory, m_UsedMemory);
+    
+    if (mapAllocation) {
+        deviceMemoryAllocation->Map(size, 0);
     }
     
     return newPage->Allocate(size, alignment, file, line);
 }
 
+void VulkanResourceHeap::AlignForNonCoherentAtom(uint32& size, uint32& alignment) const
+{
+    // 非Coherent内存Flush/Invalidate的范围需要按nonCoherentAtomSize对齐
+    const VkPhysicalDeviceMemoryProperties& memoryProperties = m_Owner->GetVulkanDevice()->GetMemoryManager().GetMemoryProperties();
+    VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[m_MemoryTypeIndex].propertyFlags;
+    if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0 || (propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0) {
+        return;
+    }
+    
+    uint32 atomSize = (uint32)m_Owner->GetVulkanDevice()->GetLimits().nonCoherentAtomSize;
+    alignment = MMath::Max(alignment, atomSize);
+    size      = Align(size, atomSize);
+}
+
+void VulkanResourceHeap::GetStats(VulkanResourceHeapStats& outStats) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    
+    const VkPhysicalDeviceMemoryProperties& memoryProperties = m_Owner->GetVulkanDevice()->GetMemoryManager().GetMemoryProperties();
+    
+    outStats = VulkanResourceHeapStats();
+    outStats.memoryTypeIndex     = m_MemoryTypeIndex;
+    outStats.heapIndex           = memoryProperties.memoryTypes[m_MemoryTypeIndex].heapIndex;
+    outStats.memoryPropertyFlags = memoryProperties.memoryTypes[m_MemoryTypeIndex].propertyFlags;
+    outStats.pageSize            = m_DefaultPageSize;
+    outStats.numBufferPages      = (uint32)m_UsedBufferPages.size();
+    outStats.numImagePages       = (uint32)m_UsedImagePages.size();
+    outStats.numDedicatedPages   = (uint32)m_DedicatedPages.size();
+    outStats.numFreePages        = (uint32)m_FreePages.size();
+    outStats.peakAllocatedSize   = m_PeakUsedMemory;
+    
+    auto CollectPages = [&](const std::vector<VulkanResourceHeapPage*>& pages)
+    {
+        for (int32 index = 0; index < pages.size(); ++index)
+        {
+            const RangeAllocator& allocator = pages[index]->m_Allocator;
+            outStats.numAllocations  += allocator.GetNumAllocations();
+            outStats.numFreeBlocks   += allocator.GetNumFreeBlocks();
+            outStats.usedSize        += allocator.GetUsedSize();
+            outStats.allocatedSize   += pages[index]->m_MaxSize;
+            outStats.largestFreeBlock = MMath::Max<uint64>(outStats.largestFreeBlock, allocator.GetLargestFreeBlock());
+        }
+    };
+    
+    CollectPages(m_UsedBufferPages);
+    CollectPages(m_UsedImagePages);
+    CollectPages(m_DedicatedPages);
+    CollectPages(m_FreePages);
+    
+    for (int32 index = 0; index < m_DedicatedPages.size(); ++index) {
+        outStats.dedicatedSize += m_DedicatedPages[index]->m_MaxSize;
+    }
+}
+
 // VulkanResourceSubAllocation
 VulkanResourceSubAllocation::VulkanResourceSubAllocation(uint32 requestedSize, uint32 alignedOffset, uint32 allocationSize, uint32 allocationOffset)
     : m_RequestedSize(requestedSize)
@@ -690,14 +761,9 @@ VulkanSubResourceAllocator::VulkanSubResourceAllocator(VulkanResourceHeapManager
     , m_DeviceMemoryAllocation(deviceMemoryAllocation)
     , m_Alignment(alignment)
     , m_FrameFreed(0)
-    , m_UsedSize(0)
 {
     m_MaxSize = (uint32)deviceMemoryAllocation->GetSize();
-
-    VulkanRange fullRange;
-    fullRange.offset = 0;
-    fullRange.size   = m_MaxSize;
-    m_FreeList.push_back(fullRange);
+    m_Allocator.Reset(m_MaxSize);
 }
 
 VulkanSubResourceAllocator::~VulkanSubResourceAllocator()
@@ -708,49 +774,32 @@ VulkanSubResourceAllocator::~VulkanSubResourceAllocator()
 VulkanResourceSubAllocation* VulkanSubResourceAllocator::TryAllocateNoLocking(uint32 size, uint32 alignment, const char* file, uint32 line)
 {
     m_Alignment = MMath::Max(m_Alignment, alignment);
-    for (int32 index = 0; index < m_FreeList.size(); ++index)
-    {
-        VulkanRange& entry         = m_FreeList[index];
-        uint32 allocatedOffset     = entry.offset;
-        uint32 alignedOffset       = Align(entry.offset, m_Alignment);
-        uint32 alignmentAdjustment = alignedOffset - entry.offset;
-        uint32 allocatedSize       = alignmentAdjustment + size;
-
-        if (allocatedSize <= entry.size)
-        {
-            if (allocatedSize < entry.size)
-            {
-                entry.size   -= allocatedSize;
-                entry.offset += allocatedSize;
-            }
-            else {
-                m_FreeList.erase(m_FreeList.begin() + index);
-            }
-            m_UsedSize += allocatedSize;
-            VulkanResourceSubAllocation* newSubAllocation = CreateSubAllocation(size, alignedOffset, allocatedSize, allocatedOffset);
-            m_SubAllocations.push_back(newSubAllocation);
-            return newSubAllocation;
-        }
+    
+    RangeAllocator::Range range;
+    if (!m_Allocator.Allocate(size, m_Alignment, range)) {
+        return nullptr;
     }
     
-    return nullptr;
+    VulkanResourceSubAllocation* newSubAllocation = CreateSubAllocation(size, range.offset, range.size, range.offset);
+    newSubAllocation->m_RangeHandle = range.handle;
+    return newSubAllocation;
 }
 
-bool VulkanSubResourceAllocator::JoinFreeBlocks()
+VulkanResourceSubAllocation* VulkanSubResourceAllocator::TryAllocateLocking(uint32 size, uint32 alignment, const char* file, uint32 line)
 {
-    VulkanRange::JoinConsecutiveRanges(m_FreeList);
-    if (m_FreeList.size() == 1)
-    {
-        if (m_SubAllocations.size() == 0)
-        {
-            if (m_UsedSize != 0 || m_FreeList[0].offset != 0 || m_FreeList[0].size != m_MaxSize) {
-                MLOG("Resource Suballocation leak, should have %d free, only have %d; missing %d bytes", m_MaxSize, m_FreeList[0].size, m_MaxSize - m_FreeList[0].size);
-            }
-            return true;
-        }
+    std::lock_guard<std::mutex> lock(m_Owner->m_BufferMutex);
+    return TryAllocateNoLocking(size, alignment, file, line);
+}
+
+bool VulkanSubResourceAllocator::IsEmpty() const
+{
+    if (!m_Allocator.IsEmpty()) {
+        return false;
     }
-    
-    return false;
+    if (m_Allocator.GetUsedSize() > 0 || m_Allocator.GetNumFreeBlocks() != 1) {
+        MLOG("Resource Suballocation leak, should have %d free, only have %d; missing %d bytes", m_MaxSize, m_Allocator.GetFreeSize(), m_Allocator.GetUsedSize());
+    }
+    return true;
 }
 
 // VulkanSubBufferAllocator
@@ -783,27 +832,11 @@ VulkanResourceSubAllocation* VulkanSubBufferAllocator::CreateSubAllocation(uint3
 
 void VulkanSubBufferAllocator::Release(VulkanBufferSubAllocation* subAllocation)
 {
-    bool released = false;
-    for (int32 index = 0; index < m_SubAllocations.size(); ++index)
-    {
-        if (m_SubAllocations[index] == subAllocation)
-        {
-            released = true;
-            m_SubAllocations.erase(m_SubAllocations.begin() + index);
-            break;
-        }
-    }
+    std::lock_guard<std::mutex> lock(m_Owner->m_BufferMutex);
     
-    if (released)
-    {
-        VulkanRange newFree;
-        newFree.offset = subAllocation->m_AllocationOffset;
-        newFree.size   = subAllocation->m_AllocationSize;
-        m_FreeList.push_back(newFree);
-        m_UsedSize -= subAllocation->m_AllocationSize;
-    }
+    m_Allocator.Free(subAllocation->m_RangeHandle);
     
-    if (JoinFreeBlocks()) {
+    if (IsEmpty()) {
         m_Owner->ReleaseBuffer(this);
     }
 }
@@ -846,7 +879,7 @@ void VulkanResourceHeapManager::Init()
         
         for (int32 index = (int32)outTypeIndices.size() - 1; index >= 1; --index)
         {
-            if (memoryProperties.memoryTypes[index].propertyFlags != memoryProperties.memoryTypes[0].propertyFlags) {
+            if (memoryProperties.memoryTypes[outTypeIndices[index]].propertyFlags != memoryProperties.memoryTypes[outTypeIndices[0]].propertyFlags) {
                 outTypeIndices.erase(outTypeIndices.begin() + index);
             }
         }
@@ -863,15 +896,17 @@ void VulkanResourceHeapManager::Init()
             VkDeviceSize heapSize = memoryProperties.memoryHeaps[heapIndex].size;
             VkDeviceSize pageSize = MMath::Min<VkDeviceSize>(heapSize / 8, GPU_ONLY_HEAP_PAGE_SIZE);
             m_ResourceTypeHeaps[typeIndices[index]] = new VulkanResourceHeap(this, typeIndices[index], uint32(pageSize));
-            m_ResourceTypeHeaps[typeIndices[index]]->m_IsHostCachedSupported      = ((memoryProperties.memoryTypes[index].propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)      == VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
-            m_ResourceTypeHeaps[typeIndices[index]]->m_IsLazilyAllocatedSupported = ((memoryProperties.memoryTypes[index].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) == VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+            m_ResourceTypeHeaps[typeIndices[index]]->m_IsHostCachedSupported      = ((memoryProperties.memoryTypes[typeIndices[index]].propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)      == VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+            m_ResourceTypeHeaps[typeIndices[index]]->m_IsLazilyAllocatedSupported = ((memoryProperties.memoryTypes[typeIndices[index]].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) == VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
         }
     }
     
     {
         uint32 typeIndex = 0;
         VERIFYVULKANRESULT(memoryManager.GetMemoryTypeFromProperties(typeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &typeIndex));
-        m_ResourceTypeHeaps[typeIndex] = new VulkanResourceHeap(this, typeIndex, STAGING_HEAP_PAGE_SIZE);
+        if (!m_ResourceTypeHeaps[typeIndex]) {
+            m_ResourceTypeHeaps[typeIndex] = new VulkanResourceHeap(this, typeIndex, STAGING_HEAP_PAGE_SIZE);
+        }
     }
     
     {
@@ -889,7 +924,9 @@ void VulkanResourceHeapManager::Init()
         else {
             MLOG("No Memory Type found supporting VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT!");
         }
-        m_ResourceTypeHeaps[typeIndex] = new VulkanResourceHeap(this, typeIndex, STAGING_HEAP_PAGE_SIZE);
+        if (!m_ResourceTypeHeaps[typeIndex]) {
+            m_ResourceTypeHeaps[typeIndex] = new VulkanResourceHeap(this, typeIndex, STAGING_HEAP_PAGE_SIZE);
+        }
     }
 }
 
@@ -927,10 +964,14 @@ VulkanResourceAllocation* VulkanResourceHeapManager::AllocateBufferMemory(const
             MLOG("Unable to find alternate type for index %d, MemSize %d, MemPropTypeBits %u, MemPropertyFlags %u, %s(%d)", originalTypeIndex, (uint32)memoryReqs.size, (uint32)memoryReqs.memoryTypeBits, (uint32)memoryPropertyFlags, file, line);
         }
         
+        if (!m_ResourceTypeHeaps[typeIndex])
+        {
 #if MONKEY_DEBUG
-        DumpMemory();
+            DumpMemory();
 #endif
-        MLOG("Missing memory type index %d (originally requested %d), MemSize %d, MemPropTypeBits %u, MemPropertyFlags %u, %s(%d)", typeIndex, originalTypeIndex, (uint32)memoryReqs.size, (uint32)memoryReqs.memoryTypeBits, (uint32)memoryPropertyFlags, file, line);
+            MLOG("Missing memory type index %d (originally requested %d), MemSize %d, MemPropTypeBits %u, MemPropertyFlags %u, %s(%d)", typeIndex, originalTypeIndex, (uint32)memoryReqs.size, (uint32)memoryReqs.memoryTypeBits, (uint32)memoryPropertyFlags, file, line);
+            return nullptr;
+        }
     }
     
     VulkanResourceAllocation* allocation = m_ResourceTypeHeaps[typeIndex]->AllocateResource(VulkanResourceHeap::Type::Buffer, uint32(memoryReqs.size), uint32(memoryReqs.alignment), canMapped, file, line);
@@ -939,8 +980,10 @@ VulkanResourceAllocation* VulkanResourceHeapManager::AllocateBufferMemory(const
     {
         VERIFYVULKANRESULT(m_DeviceMemoryManager->GetMemoryTypeFromPropertiesExcluding(memoryReqs.memoryTypeBits, memoryPropertyFlags, typeIndex, &typeIndex));
         canMapped = (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
-        if (!m_ResourceTypeHeaps[typeIndex]) {
+        if (!m_ResourceTypeHeaps[typeIndex])
+        {
             MLOG("Missing memory type index %d, MemSize %d, MemPropTypeBits %u, MemPropertyFlags %u, %s(%d)", typeIndex, (uint32)memoryReqs.size, (uint32)memoryReqs.memoryTypeBits, (uint32)memoryPropertyFlags, file, line);
+            return nullptr;
         }
         allocation = m_ResourceTypeHeaps[typeIndex]->AllocateResource(VulkanResourceHeap::Type::Buffer, uint32(memoryReqs.size), uint32(memoryReqs.alignment), canMapped, file, line);
     }
@@ -955,8 +998,10 @@ VulkanResourceAllocation* VulkanResourceHeapManager::AllocateImageMemory(const V
     
     bool canMapped = (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
     
-    if (!m_ResourceTypeHeaps[typeIndex]) {
+    if (!m_ResourceTypeHeaps[typeIndex])
+    {
         MLOG("Missing memory type index %d, MemSize %d, MemPropTypeBits %u, MemPropertyFlags %u, %s(%d)", typeIndex, (uint32)memoryReqs.size, (uint32)memoryReqs.memoryTypeBits, (uint32)memoryPropertyFlags, file, line);
+        return nullptr;
     }
     
     VulkanResourceAllocation* allocation = m_ResourceTypeHeaps[typeIndex]->AllocateResource(VulkanResourceHeap::Type::Image, uint32(memoryReqs.size), uint32(memoryReqs.alignment), canMapped, file, line);
@@ -965,14 +1010,81 @@ VulkanResourceAllocation* VulkanResourceHeapManager::AllocateImageMemory(const V
     {
         VERIFYVULKANRESULT(m_DeviceMemoryManager->GetMemoryTypeFromPropertiesExcluding(memoryReqs.memoryTypeBits, memoryPropertyFlags, typeIndex, &typeIndex));
         canMapped  = (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        if (!m_ResourceTypeHeaps[typeIndex])
+        {
+            MLOG("Missing memory type index %d, MemSize %d, MemPropTypeBits %u, MemPropertyFlags %u, %s(%d)", typeIndex, (uint32)memoryReqs.size, (uint32)memoryReqs.memoryTypeBits, (uint32)memoryPropertyFlags, file, line);
+            return nullptr;
+        }
         allocation = m_ResourceTypeHeaps[typeIndex]->AllocateResource(VulkanResourceHeap::Type::Image, uint32(memoryReqs.size), uint32(memoryReqs.alignment), canMapped, file, line);
     }
     
     return allocation;
 }
 
+VulkanResourceAllocation* VulkanResourceHeapManager::AllocateDedicatedImageMemory(const VkMemoryRequirements& memoryReqs, VkMemoryPropertyFlags memoryPropertyFlags, const char* file, uint32 line)
+{
+    uint32 typeIndex = 0;
+    VERIFYVULKANRESULT(m_DeviceMemoryManager->GetMemoryTypeFromProperties(memoryReqs.memoryTypeBits, memoryPropertyFlags, &typeIndex));
+    
+    bool canMapped = (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    
+    if (!m_ResourceTypeHeaps[typeIndex])
+    {
+        MLOG("Missing memory type index %d, MemSize %d, MemPropTypeBits %u, MemPropertyFlags %u, %s(%d)", typeIndex, (uint32)memoryReqs.size, (uint32)memoryReqs.memoryTypeBits, (uint32)memoryPropertyFlags, file, line);
+        return nullptr;
+    }
+    
+    return m_ResourceTypeHeaps[typeIndex]->AllocateDedicatedResource(uint32(memoryReqs.size), uint32(memoryReqs.alignment), canMapped, file, line);
+}
+
+void VulkanResourceHeapManager::GetStats(std::vector<VulkanResourceHeapStats>& outStats) const
+{
+    outStats.clear();
+    for (int32 index = 0; index < m_ResourceTypeHeaps.size(); ++index)
+    {
+        if (m_ResourceTypeHeaps[index])
+        {
+            VulkanResourceHeapStats stats;
+            m_ResourceTypeHeaps[index]->GetStats(stats);
+            outStats.push_back(stats);
+        }
+    }
+}
+
+void VulkanResourceHeapManager::PrintStats() const
+{
+    std::vector<VulkanResourceHeapStats> heapStats;
+    GetStats(heapStats);
+    
+    MLOG("Resource Heaps: %d", (int32)heapStats.size());
+    for (int32 index = 0; index < heapStats.size(); ++index)
+    {
+        const VulkanResourceHeapStats& stats = heapStats[index];
+        MLOG(
+            "\tType %d Heap %d Flags 0x%x : %d allocs, Pages %d Buffer/%d Image/%d Dedicated/%d Free, Used/Allocated %.2f/%.2f MB (%.2f%%), Dedicated %.2f MB, Peak %.2f MB, %d free blocks (largest %.2f MB)",
+            stats.memoryTypeIndex,
+            stats.heapIndex,
+            stats.memoryPropertyFlags,
+            stats.numAllocations,
+            stats.numBufferPages,
+            stats.numImagePages,
+            stats.numDedicatedPages,
+            stats.numFreePages,
+            stats.usedSize / 1024.0f / 1024.0f,
+            stats.allocatedSize / 1024.0f / 1024.0f,
+            stats.allocatedSize > 0 ? 100.0f * (float)stats.usedSize / (float)stats.allocatedSize : 0.0f,
+            stats.dedicatedSize / 1024.0f / 1024.0f,
+            stats.peakAllocatedSize / 1024.0f / 1024.0f,
+            stats.numFreeBlocks,
+            stats.largestFreeBlock / 1024.0f / 1024.0f
+        );
+    }
+}
+
 VulkanBufferSubAllocation* VulkanResourceHeapManager::AllocateBuffer(uint32 size, VkBufferUsageFlags bufferUsageFlags, VkMemoryPropertyFlags memoryPropertyFlags, const char* file, uint32 line)
 {
+    std::lock_guard<std::mutex> lock(m_BufferMutex);
+    
     const VkPhysicalDeviceLimits& limits = m_VulkanDevice->GetLimits();
     uint32 alignment = 1;
     
@@ -1052,7 +1164,6 @@ VulkanBufferSubAllocation* VulkanResourceHeapManager::AllocateBuffer(uint32 size
 
 void VulkanResourceHeapManager::ReleaseBuffer(VulkanSubBufferAllocator* bufferAllocator)
 {
-    bufferAllocator->JoinFreeBlocks();
     for (int32 index = 0; index < m_UsedBufferAllocations[bufferAllocator->m_PoolSizeIndex].size(); ++index)
     {
         if (m_UsedBufferAllocations[bufferAllocator->m_PoolSizeIndex][index] == bufferAllocator) {
@@ -1072,6 +1183,8 @@ void VulkanResourceHeapManager::ReleaseFreedPages()
             heap->ReleaseFreedPages(true);
         }
     }
+    
+    std::lock_guard<std::mutex> lock(m_BufferMutex);
     ReleaseFreedResources(false);
 }
 
@@ -1116,20 +1229,20 @@ void VulkanResourceHeapManager::DumpMemory()
             for (int32 index = 0; index < usedAllocations.size(); ++index)
             {
                 VulkanSubBufferAllocator* bufferAllocation = usedAllocations[index];
-                MLOG("%6d %p %p 0x%06x 0x%08x %6d   %6d    %d/%d", index, (void*)bufferAllocation->m_Buffer, (void*)bufferAllocation->m_DeviceMemoryAllocation->GetHandle(), bufferAllocation->m_MemoryPropertyFlags, bufferAllocation->m_BufferUsageFlags, (int32)bufferAllocation->m_SubAllocations.size(), (int32)bufferAllocation->m_FreeList.size(), (int32)bufferAllocation->m_UsedSize, bufferAllocation->m_MaxSize);
+                MLOG("%6d %p %p 0x%06x 0x%08x %6d   %6d    %d/%d", index, (void*)bufferAllocation->m_Buffer, (void*)bufferAllocation->m_DeviceMemoryAllocation->GetHandle(), bufferAllocation->m_MemoryPropertyFlags, bufferAllocation->m_BufferUsageFlags, (int32)bufferAllocation->m_Allocator.GetNumAllocations(), (int32)bufferAllocation->m_Allocator.GetNumFreeBlocks(), (int32)bufferAllocation->m_Allocator.GetUsedSize(), bufferAllocation->m_MaxSize);
                 
                 if (poolSizeIndex == (int32)PoolSizes::SizesCount)
                 {
-                    _UsedLargeTotal  += bufferAllocation->m_UsedSize;
+                    _UsedLargeTotal  += bufferAllocation->m_Allocator.GetUsedSize();
                     _AllocLargeTotal += bufferAllocation->m_MaxSize;
-                    usedLargeTotal   += bufferAllocation->m_UsedSize;
+                    usedLargeTotal   += bufferAllocation->m_Allocator.GetUsedSize();
                     allocLargeTotal  += bufferAllocation->m_MaxSize;
                 }
                 else
                 {
-                    _UsedBinnedTotal  += bufferAllocation->m_UsedSize;
+                    _UsedBinnedTotal  += bufferAllocation->m_Allocator.GetUsedSize();
                     _AllocBinnedTotal += bufferAllocation->m_MaxSize;
-                    usedBinnedTotal   += bufferAllocation->m_UsedSize;
+                    usedBinnedTotal   += bufferAllocation->m_Allocator.GetUsedSize();
                     allocBinnedTotal  += bufferAllocation->m_MaxSize;
                 }
             }
@@ -1172,7 +1285,7 @@ void VulkanResourceHeapManager::DestroyResourceAllocations()
         for (int32 index = (int32)usedAllocations.size() - 1; index >= 0; --index)
         {
             VulkanSubBufferAllocator* bufferAllocation = usedAllocations[index];
-            if (!bufferAllocation->JoinFreeBlocks()) {
+            if (!bufferAllocation->IsEmpty()) {
                 MLOG("Suballocation(s) for Buffer %p were not released.", (void*)bufferAllocation->m_Buffer);
             }
             bufferAllocation->Destroy(m_VulkanDevice);
@@ -2,11 +2,13 @@
 
 #include "Common/Common.h"
 #include "HAL/ThreadSafeCounter.h"
+#include "Utils/RangeAllocator.h"
 
 #include "VulkanPlatform.h"
 
 #include <memory>
 #include <vector>
+#include <mutex>
 
 class VulkanDevice;
 class VulkanDeviceMemoryManager;
@@ -57,19 +59,6 @@ private:
 	ThreadSafeCounter m_Counter;
 };
 
-struct VulkanRange
-{
-    uint32 offset;
-    uint32 size;
-    
-    static void JoinConsecutiveRanges(std::vector<VulkanRange>& ranges);
-    
-    inline bool operator<(const VulkanRange& vulkanRange) const
-    {
-        return offset < vulkanRange.offset;
-    }
-};
-
 class VulkanDeviceMemoryAllocation
 {
 public:
@@ -243,6 +232,7 @@ protected:
     uint32                           m_NumAllocations;
     uint32                           m_PeakNumAllocations;
     std::vector<HeapInfo>            m_HeapInfos;
+    std::mutex                       m_Mutex;
 };
 
 class VulkanResourceAllocation : public RefCount
@@ -286,17 +276,19 @@ public:
         return m_DeviceMemoryAllocation->GetMemoryTypeIndex();
     }
     
-    inline void FlushMappedMemory()
+    inline bool IsCoherent() const
     {
-        m_DeviceMemoryAllocation->FlushMappedMemory(m_AllocationOffset, m_AllocationSize);
+        return m_DeviceMemoryAllocation->IsCoherent();
     }
     
-    inline void InvalidateMappedMemory()
-    {
-        m_DeviceMemoryAllocation->InvalidateMappedMemory(m_AllocationOffset, m_AllocationSize);
-    }
+    // offset相对于GetOffset()，范围会被扩展到nonCoherentAtomSize对齐
+    void FlushMappedMemory(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+    
+    void InvalidateMappedMemory(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
 
 private:
+    void GetAtomRange(VkDeviceSize offset, VkDeviceSize size, VkDeviceSize& outOffset, VkDeviceSize& outSize) const;
+    
     friend class VulkanResourceHeapPage;
     
 private:
@@ -305,6 +297,7 @@ private:
     uint32                          m_AllocationOffset;
     uint32                          m_RequestedSize;
     uint32                          m_AlignedOffset;
+    uint32                          m_RangeHandle;
     VulkanDeviceMemoryAllocation*   m_DeviceMemoryAllocation;
 };
 
@@ -335,22 +328,26 @@ public:
         return m_ID;
     }
     
+    inline bool IsDedicated() const
+    {
+        return m_IsDedicated;
+    }
+    
 protected:
-    bool JoinFreeBlocks();
+    bool IsEmpty() const;
     
     friend class VulkanResourceHeap;
 protected:
 
     VulkanResourceHeap*                     m_Owner;
     VulkanDeviceMemoryAllocation*           m_DeviceMemoryAllocation;
-    std::vector<VulkanResourceAllocation*>  m_ResourceAllocations;
-    std::vector<VulkanRange>                m_FreeList;
+    RangeAllocator                          m_Allocator;
     
     uint32                                  m_MaxSize;
-    uint32                                  m_UsedSize;
     int32                                   m_PeakNumAllocations;
     uint32                                  m_FrameFreed;
     uint32                                  m_ID;
+    bool                                    m_IsDedicated;
 };
 
 class VulkanResourceSubAllocation : public RefCount
@@ -370,11 +367,15 @@ public:
         return m_RequestedSize;
     }
     
+protected:
+    friend class VulkanSubResourceAllocator;
+    
 protected:
     uint32 m_RequestedSize;
     uint32 m_AlignedOffset;
     uint32 m_AllocationSize;
     uint32 m_AllocationOffset;
+    uint32 m_RangeHandle;
 };
 
 class VulkanBufferSubAllocation : public VulkanResourceSubAllocation
@@ -417,10 +418,7 @@ public:
     
     VulkanResourceSubAllocation* TryAllocateNoLocking(uint32 size, uint32 alignment, const char* file, uint32 line);
     
-    inline VulkanResourceSubAllocation* TryAllocateLocking(uint32 size, uint32 alignment, const char* file, uint32 line)
-    {
-        return TryAllocateNoLocking(size, alignment, file, line);
-    }
+    VulkanResourceSubAllocation* TryAllocateLocking(uint32 size, uint32 alignment, const char* file, uint32 line);
     
     inline uint32 GetAlignment() const
     {
@@ -433,7 +431,7 @@ public:
     }
     
 protected:
-    bool JoinFreeBlocks();
+    bool IsEmpty() const;
     
 protected:
     VulkanResourceHeapManager*                  m_Owner;
@@ -443,9 +441,7 @@ protected:
     uint32                                      m_MaxSize;
     uint32                                      m_Alignment;
     uint32                                      m_FrameFreed;
-    int64                                       m_UsedSize;
-    std::vector<VulkanRange>                    m_FreeList;
-    std::vector<VulkanResourceSubAllocation*>   m_SubAllocations;
+    RangeAllocator                              m_Allocator;
 };
 
 class VulkanSubBufferAllocator : public VulkanSubResourceAllocator
@@ -475,6 +471,29 @@ protected:
     int32               m_PoolSizeIndex;
 };
 
+struct VulkanResourceHeapStats
+{
+    uint32                  memoryTypeIndex = 0;
+    uint32                  heapIndex = 0;
+    VkMemoryPropertyFlags   memoryPropertyFlags = 0;
+    uint32                  pageSize = 0;
+    
+    uint32                  numBufferPages = 0;
+    uint32                  numImagePages = 0;
+    uint32                  numDedicatedPages = 0;
+    uint32                  numFreePages = 0;
+    
+    uint32                  numAllocations = 0;
+    uint32                  numFreeBlocks = 0;
+    
+    // usedSize为已分配给资源的字节数(包含对齐浪费)，allocatedSize为所有page占用的显存
+    uint64                  usedSize = 0;
+    uint64                  allocatedSize = 0;
+    uint64                  dedicatedSize = 0;
+    uint64                  peakAllocatedSize = 0;
+    uint64                  largestFreeBlock = 0;
+};
+
 class VulkanResourceHeap
 {
 public:
@@ -488,6 +507,7 @@ public:
     
     virtual ~VulkanResourceHeap();
     
+    // 调用者需要持有m_Mutex
     void FreePage(VulkanResourceHeapPage* page);
     
     void ReleaseFreedPages(bool immediately);
@@ -512,6 +532,8 @@ public:
         return m_MemoryTypeIndex;
     }
     
+    void GetStats(VulkanResourceHeapStats& outStats) const;
+    
 #if MONKEY_DEBUG
     void DumpMemory();
 #endif
@@ -519,9 +541,16 @@ public:
 protected:
     VulkanResourceAllocation* AllocateResource(Type type, uint32 size, uint32 alignment, bool mapAllocation, const char* file, uint32 line);
     
+    VulkanResourceAllocation* AllocateDedicatedResource(uint32 size, uint32 alignment, bool mapAllocation, const char* file, uint32 line);
+    
+    void AlignForNonCoherentAtom(uint32& size, uint32& alignment) const;
+    
     friend class VulkanResourceHeapManager;
+    friend class VulkanResourceHeapPage;
     
 protected:
+    // 同一个Heap的分配与释放可能来自不同线程
+    mutable std::mutex                      m_Mutex;
     VulkanResourceHeapManager*              m_Owner;
     uint32                                  m_MemoryTypeIndex;
     bool                                    m_IsHostCachedSupported;
@@ -529,9 +558,11 @@ protected:
     uint32                                  m_DefaultPageSize;
     uint32                                  m_PeakPageSize;
     uint64                                  m_UsedMemory;
+    uint64                                  m_PeakUsedMemory;
     uint32                                  m_PageIDCounter;
     std::vector<VulkanResourceHeapPage*>    m_UsedBufferPages;
     std::vector<VulkanResourceHeapPage*>    m_UsedImagePages;
+    std::vector<VulkanResourceHeapPage*>    m_DedicatedPages;
     std::vector<VulkanResourceHeapPage*>    m_FreePages;
 };
 
@@ -548,6 +579,7 @@ public:
     
     VulkanBufferSubAllocation* AllocateBuffer(uint32 size, VkBufferUsageFlags bufferUsageFlags, VkMemoryPropertyFlags memoryPropertyFlags, const char* file, uint32 line);
     
+    // 调用者需要持有m_BufferMutex
     void ReleaseBuffer(VulkanSubBufferAllocator* bufferAllocator);
     
     void ReleaseFreedPages();
@@ -556,10 +588,18 @@ public:
     void DumpMemory();
 #endif
     
+    // 找不到可用的内存类型时返回nullptr
     VulkanResourceAllocation* AllocateImageMemory(const VkMemoryRequirements& memoryReqs, VkMemoryPropertyFlags memoryPropertyFlags, const char* file, uint32 line);
     
     VulkanResourceAllocation* AllocateBufferMemory(const VkMemoryRequirements& memoryReqs, VkMemoryPropertyFlags memoryPropertyFlags, const char* file, uint32 line);
     
+    // 独占一块VkDeviceMemory，释放时直接归还给驱动，用于大尺寸的RenderTarget
+    VulkanResourceAllocation* AllocateDedicatedImageMemory(const VkMemoryRequirements& memoryReqs, VkMemoryPropertyFlags memoryPropertyFlags, const char* file, uint32 line);
+    
+    void GetStats(std::vector<VulkanResourceHeapStats>& outStats) const;
+    
+    void PrintStats() const;
+    
     VulkanDevice* GetVulkanDevice()
     {
         return m_VulkanDevice;
@@ -633,9 +673,13 @@ protected:
         return poolSize;
     }
     
+    friend class VulkanSubResourceAllocator;
+    friend class VulkanSubBufferAllocator;
+    
 protected:
     VulkanDevice*							m_VulkanDevice;
     VulkanDeviceMemoryManager*              m_DeviceMemoryManager;
+    std::mutex                              m_BufferMutex;
     std::vector<VulkanResourceHeap*>        m_ResourceTypeHeaps;
     std::vector<VulkanSubBufferAllocator*>  m_UsedBufferAllocations[(int32)PoolSizes::SizesCount + 1];
     std::vector<VulkanSubBufferAllocator*>  m_FreeBufferAllocations[(int32)PoolSizes::SizesCount + 1];
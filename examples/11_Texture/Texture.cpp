@@ -145,11 +145,17 @@ private:
 	{
 		vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice, m_CommandPool);
 
+		// 所有mesh共用一套MVP和材质，合并到一个Buffer里用一次indirect绘制
+		vk_demo::DVKModelLoadOptions options;
+		options.index32      = true;
+		options.packGeometry = true;
+
 		m_Model = vk_demo::DVKModel::LoadFromFile(
 			"assets/models/head.obj",
 			m_VulkanDevice,
 			cmdBuffer,
-			{ VertexAttribute::VA_Position, VertexAttribute::VA_UV0, VertexAttribute::VA_Normal, VertexAttribute::VA_Tangent }
+			{ VertexAttribute::VA_Position, VertexAttribute::VA_UV0, VertexAttribute::VA_Normal, VertexAttribute::VA_Tangent },
+			options
 		);
 
 		m_TexDiffuse       = vk_demo::DVKTexture::Create2D("assets/textures/head_diffuse.jpg", m_VulkanDevice, cmdBuffer);
@@ -216,9 +222,7 @@ private:
             vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->pipeline);
             vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->pipelineLayout, 0, 1, &m_DescriptorSet, 0, nullptr);
             
-            for (int32 meshIndex = 0; meshIndex < m_Model->meshes.size(); ++meshIndex) {
-                m_Model->meshes[meshIndex]->BindDrawCmd(m_CommandBuffers[i]);
-            }
+            m_Model->DrawPackedIndirect(m_CommandBuffers[i]);
 			
 			m_GUI->BindDrawCmd(m_CommandBuffers[i], m_RenderPass);
 
@@ -361,8 +361,8 @@ private:
 		m_Material0->BeginFrame();
 		for (int32 i = 0; i < m_Model->meshes.size(); ++i) {
 			m_Material0->BeginObject();
-			m_Material0->SetLocalUniform("uboModel",    &(m_Model->meshes[i]->linkNode->GetGlobalMatrix()), sizeof(Matrix4x4));
-			m_Material0->SetLocalUniform("uboViewProj", &m_ViewProjData,                                    sizeof(m_ViewProjData));
+			m_Material0->SetLocalUniform(m_ModelHandle,    &(m_Model->meshes[i]->linkNode->GetGlobalMatrix()), sizeof(Matrix4x4));
+			m_Material0->SetLocalUniform(m_ViewProjHandle, &m_ViewProjData,                                    sizeof(m_ViewProjData));
 			m_Material0->EndObject();
 		}
 		m_Material0->EndFrame();
@@ -370,11 +370,14 @@ private:
 		// 设置postprocess的参数
 		m_Material1->BeginFrame();
 		m_Material1->BeginObject();
-		m_Material1->SetLocalUniform("paramData", &m_VertFragParam, sizeof(AttachmentParamBlock));
-		m_Material1->SetLocalUniform("lightDatas",  &m_LightDatas,    sizeof(LightDataBlock));
-		m_Material1->SetInputAttachment("inputColor",  m_AttachsColor[bufferIndex]);
-		m_Material1->SetInputAttachment("inputNormal", m_AttachsNormal[bufferIndex]);
-		m_Material1->SetInputAttachment("inputDepth",  m_AttachsDepth[bufferIndex]);
+		m_Material1->SetLocalUniform(m_ParamHandle, &m_VertFragParam, sizeof(AttachmentParamBlock));
+		m_Material1->SetLocalUniform(m_LightHandle, &m_LightDatas,    sizeof(LightDataBlock));
+		// 三个attachment合并为一次descriptor更新
+		m_Material1->BeginUpdate();
+		m_Material1->SetTexture(m_ColorHandle,  m_AttachsColor[bufferIndex]);
+		m_Material1->SetTexture(m_NormalHandle, m_AttachsNormal[bufferIndex]);
+		m_Material1->SetTexture(m_DepthHandle,  m_AttachsDepth[bufferIndex]);
+		m_Material1->EndUpdate();
 		m_Material1->EndObject();
 		m_Material1->EndFrame();
 
@@ -480,6 +483,8 @@ private:
 		// 这里还需要手动指定，以后封装了renderpass之后，可以在内部自动获取
 		m_Material0->pipelineInfo.colorAttachmentCount = 2;
 		m_Material0->PreparePipeline();
+		m_ModelHandle    = m_Material0->GetUniformHandle("uboModel");
+		m_ViewProjHandle = m_Material0->GetUniformHandle("uboViewProj");
 
 		// shader1
 		m_Shader1 = vk_demo::DVKShader::Create(
@@ -501,6 +506,11 @@ private:
 		m_Material1->pipelineInfo.shader  = m_Shader1;
 		m_Material1->pipelineInfo.subpass = 1;
 		m_Material1->PreparePipeline();
+		m_ParamHandle  = m_Material1->GetUniformHandle("paramData");
+		m_LightHandle  = m_Material1->GetUniformHandle("lightDatas");
+		m_ColorHandle  = m_Material1->GetTextureHandle("inputColor");
+		m_NormalHandle = m_Material1->GetTextureHandle("inputNormal");
+		m_DepthHandle  = m_Material1->GetTextureHandle("inputDepth");
 	}
     
 	void DestroyAssets()
@@ -653,9 +663,16 @@ private:
 
 	vk_demo::DVKShader*				m_Shader0 = nullptr;
 	vk_demo::DVKMaterial*			m_Material0 = nullptr;
+	int32							m_ModelHandle = -1;
+	int32							m_ViewProjHandle = -1;
 	
 	vk_demo::DVKShader*				m_Shader1 = nullptr;
 	vk_demo::DVKMaterial*			m_Material1 = nullptr;
+	int32							m_ParamHandle = -1;
+	int32							m_LightHandle = -1;
+	int32							m_ColorHandle = -1;
+	int32							m_NormalHandle = -1;
+	int32							m_DepthHandle = -1;
 
 	DVKTextureArray					m_AttachsDepth;
 	DVKTextureArray					m_AttachsColor;
@@ -2,6 +2,9 @@
 #include "Common/Log.h"
 
 #include "Demo/DVKCommon.h"
+#include "Demo/DVKAnimator.h"
+
+#include "GenericPlatform/GenericPlatformTime.h"
 
 #include "Math/Vector4.h"
 #include "Math/Matrix4x4.h"
@@ -10,6 +13,7 @@
 #include <vector>
 
 #define INSTANCE_COUNT 8000
+#define PALETTE_WIDTH  1024
 
 class SkinInTextureDemo : public DemoBase
 {
@@ -17,7 +21,7 @@ public:
 	SkinInTextureDemo(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
 		: DemoBase(width, height, title, cmdLine)
 	{
-
+		m_FramesInFlight = 2;
 	}
 
 	virtual ~SkinInTextureDemo()
@@ -102,6 +106,61 @@ private:
 		m_ParamData.animIndex.w = m_Keys.size() * mesh->bones.size() * 2;
 	}
 
+	void UpdateCPUAnimation(float time, float delta)
+	{
+		vk_demo::DVKPrimitive* primitive = m_RoleModel->meshes[0]->primitives[0];
+		int32 count = primitive->indexBuffer->instanceCount;
+
+		// 多线程计算每个实例的骨骼数据，然后拷贝到当前帧的staging buffer
+		double beginTime = GenericPlatformTime::Seconds();
+		m_Animator->Update(m_AutoAnimation ? delta : 0.0f, count);
+		m_CPUAnimTime = (GenericPlatformTime::Seconds() - beginTime) * 1000.0;
+
+		vk_demo::DVKBuffer* staging = m_PaletteStagings[GetFrameIndex()];
+		memcpy(staging->mapped, m_Animator->palettes.data(), count * m_Animator->GetPaletteStride() * sizeof(float));
+
+		// 每个实例的骨骼数据在贴图中连续存放，实例数据中记录了起始位置
+		m_ParamData.animIndex.x = m_CPUAnimTexture->width;
+		m_ParamData.animIndex.y = m_CPUAnimTexture->height;
+		m_ParamData.animIndex.z = 0;
+		m_ParamData.animIndex.w = m_CPUAnimTexture->width * m_CPUAnimTexture->height;
+	}
+
+	void RecordPaletteUpload(VkCommandBuffer commandBuffer)
+	{
+		vk_demo::DVKPrimitive* primitive = m_RoleModel->meshes[0]->primitives[0];
+		int32 texels = primitive->indexBuffer->instanceCount * m_Animator->GetBoneCount() * 2;
+		int32 rows   = (texels + m_CPUAnimTexture->width - 1) / m_CPUAnimTexture->width;
+
+		VkImageMemoryBarrier barrier;
+		ZeroVulkanStruct(barrier, VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER);
+		barrier.srcAccessMask       = VK_ACCESS_SHADER_READ_BIT;
+		barrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image               = m_CPUAnimTexture->image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.layerCount = 1;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkBufferImageCopy copyRegion = {};
+		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageExtent.width  = m_CPUAnimTexture->width;
+		copyRegion.imageExtent.height = rows;
+		copyRegion.imageExtent.depth  = 1;
+		vkCmdCopyBufferToImage(commandBuffer, m_PaletteStagings[GetFrameIndex()]->buffer, m_CPUAnimTexture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
 	void Draw(float time, float delta)
 	{
 		int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
@@ -114,17 +173,24 @@ private:
 		m_ParamData.view = m_ViewCamera.GetView();
 		m_ParamData.projection = m_ViewCamera.GetProjection();
 
-		UpdateAnimation(time, delta);
+		if (m_CPUAnimation) {
+			UpdateCPUAnimation(time, delta);
+		}
+		else {
+			UpdateAnimation(time, delta);
+		}
+
+		vk_demo::DVKMaterial* material = m_CPUAnimation ? m_CPURoleMaterial : m_RoleMaterial;
         
-        m_RoleMaterial->BeginFrame();
+        material->BeginFrame();
 
 		vk_demo::DVKMesh* mesh = m_RoleModel->meshes[0];
 		m_ParamData.model = mesh->linkNode->GetGlobalMatrix();
 
-		m_RoleMaterial->BeginObject();
-		m_RoleMaterial->SetLocalUniform("paramData", &m_ParamData, sizeof(ParamDataBlock));
-		m_RoleMaterial->EndObject();
-        m_RoleMaterial->EndFrame();
+		material->BeginObject();
+		material->SetLocalUniform("paramData", &m_ParamData, sizeof(ParamDataBlock));
+		material->EndObject();
+        material->EndFrame();
         
 		SetupCommandBuffers(bufferIndex);
         
@@ -154,9 +220,15 @@ private:
 
             ImGui::Checkbox("AutoPlay", &m_AutoAnimation);
             
-            if (!m_AutoAnimation) {
+            if (!m_AutoAnimation && !m_CPUAnimation) {
                 ImGui::SliderFloat("Time", &m_AnimTime, 0.0f, m_AnimDuration);
             }
+
+			ImGui::Checkbox("CPUAnimation", &m_CPUAnimation);
+
+			if (m_CPUAnimation) {
+				ImGui::Text("Animator:%.3fms %d Threads", m_CPUAnimTime, m_Animator->GetThreadCount());
+			}
             
 			ImGui::Text("DrawCall:1");
 			ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / m_LastFPS, m_LastFPS);
@@ -261,6 +333,71 @@ private:
 			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE
 		);
 	}
+
+	void CreateCPUAnimation(vk_demo::DVKCommandBuffer* cmdBuffer)
+	{
+		vk_demo::DVKMesh* mesh = m_RoleModel->meshes[0];
+		vk_demo::DVKPrimitive* primitive = mesh->primitives[0];
+
+		// 每个实例都有自己的播放时间和速度
+		m_Animator = vk_demo::DVKAnimator::Create(m_RoleModel, mesh);
+		m_Animator->postTransform.AppendRotation(180, Vector3::ForwardVector);
+		for (int32 i = 0; i < INSTANCE_COUNT; ++i) {
+			m_Animator->AddInstance(0, MMath::RandRange(0.0f, m_AnimDuration), MMath::RandRange(0.5f, 1.5f));
+		}
+
+		int32 texels = INSTANCE_COUNT * mesh->bones.size() * 2;
+		int32 height = (texels + PALETTE_WIDTH - 1) / PALETTE_WIDTH;
+
+		m_CPUAnimTexture = vk_demo::DVKTexture::Create2D(
+			m_VulkanDevice,
+			cmdBuffer,
+			VK_FORMAT_R32G32B32A32_SFLOAT,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			PALETTE_WIDTH, height,
+			VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			ImageLayoutBarrier::PixelShaderRead
+		);
+		m_CPUAnimTexture->UpdateSampler(
+			VK_FILTER_NEAREST, 
+			VK_FILTER_NEAREST,
+			VK_SAMPLER_MIPMAP_MODE_NEAREST,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE
+		);
+
+		// 每个飞行中的帧一个staging buffer
+		for (int32 i = 0; i < GetFramesInFlight(); ++i)
+		{
+			vk_demo::DVKBuffer* staging = vk_demo::DVKBuffer::CreateBuffer(
+				m_VulkanDevice,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				PALETTE_WIDTH * height * 4 * sizeof(float)
+			);
+			staging->Map();
+			m_PaletteStagings.push_back(staging);
+		}
+
+		// 实例数据中的动画索引改为实例骨骼数据的起始位置
+		std::vector<float> instanceDatas = primitive->instanceDatas;
+		for (int32 i = 0; i < INSTANCE_COUNT; ++i) {
+			instanceDatas[i * 9 + 8] = i * mesh->bones.size() * 2;
+		}
+		m_CPUInstanceBuffer = vk_demo::DVKVertexBuffer::Create(m_VulkanDevice, cmdBuffer, instanceDatas, m_RoleShader->instancesAttributes);
+
+		m_CPURoleMaterial = vk_demo::DVKMaterial::Create(
+			m_VulkanDevice,
+			m_RenderPass,
+			m_PipelineCache,
+			m_RoleShader
+		);
+		m_CPURoleMaterial->PreparePipeline();
+		m_CPURoleMaterial->SetTexture("diffuseMap", m_RoleDiffuse);
+		m_CPURoleMaterial->SetTexture("animMap", m_CPUAnimTexture);
+	}
     
 	void LoadAssets()
 	{
@@ -347,6 +484,8 @@ private:
         m_RoleMaterial->PreparePipeline();
         m_RoleMaterial->SetTexture("diffuseMap", m_RoleDiffuse);
 		m_RoleMaterial->SetTexture("animMap", m_AnimTexture);
+
+		CreateCPUAnimation(cmdBuffer);
         
         delete cmdBuffer;
 	}
@@ -356,8 +495,17 @@ private:
 		delete m_RoleShader;
         delete m_RoleDiffuse;
         delete m_RoleMaterial;
+		delete m_Animator;
 		delete m_RoleModel;
         delete m_AnimTexture;
+
+		delete m_CPURoleMaterial;
+		delete m_CPUAnimTexture;
+		delete m_CPUInstanceBuffer;
+		for (int32 i = 0; i < m_PaletteStagings.size(); ++i) {
+			delete m_PaletteStagings[i];
+		}
+		m_PaletteStagings.clear();
 	}
 
 	void SetupCommandBuffers(int32 backBufferIndex)
@@ -381,6 +529,10 @@ private:
 		VkCommandBufferBeginInfo cmdBeginInfo;
 		ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
 		VERIFYVULKANRESULT(vkBeginCommandBuffer(commandBuffer, &cmdBeginInfo));
+
+		if (m_CPUAnimation) {
+			RecordPaletteUpload(commandBuffer);
+		}
         
         VkClearValue clearValues[2];
         clearValues[0].color        = { { 0.2f, 0.2f, 0.2f, 1.0f } };
@@ -401,9 +553,21 @@ private:
         vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
         vkCmdSetScissor(commandBuffer,  0, 1, &scissor);
         
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_RoleMaterial->GetPipeline());
-		m_RoleMaterial->BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 0);
-		m_RoleModel->meshes[0]->BindDrawCmd(commandBuffer);
+		if (m_CPUAnimation)
+		{
+			vk_demo::DVKPrimitive* primitive = m_RoleModel->meshes[0]->primitives[0];
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_CPURoleMaterial->GetPipeline());
+			m_CPURoleMaterial->BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 0);
+			primitive->BindOnly(commandBuffer);
+			vkCmdBindVertexBuffers(commandBuffer, 1, 1, &(m_CPUInstanceBuffer->dvkBuffer->buffer), &(m_CPUInstanceBuffer->offset));
+			primitive->DrawOnly(commandBuffer);
+		}
+		else
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_RoleMaterial->GetPipeline());
+			m_RoleMaterial->BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 0);
+			m_RoleModel->meshes[0]->BindDrawCmd(commandBuffer);
+		}
         
         m_GUI->BindDrawCmd(commandBuffer, m_RenderPass);
         
@@ -455,6 +619,14 @@ private:
     float                       m_AnimTime = 0.0f;
     int32                       m_AnimIndex = 0;
 
+	vk_demo::DVKAnimator*		m_Animator = nullptr;
+	vk_demo::DVKTexture*		m_CPUAnimTexture = nullptr;
+	vk_demo::DVKMaterial*		m_CPURoleMaterial = nullptr;
+	vk_demo::DVKVertexBuffer*	m_CPUInstanceBuffer = nullptr;
+	std::vector<vk_demo::DVKBuffer*> m_PaletteStagings;
+	bool						m_CPUAnimation = false;
+	float						m_CPUAnimTime = 0.0f;
+
 	int32						m_FrameCounter = 0;
 	float						m_LastFrameTime = 0.0f;
 	float						m_LastFPS = 0.0f;
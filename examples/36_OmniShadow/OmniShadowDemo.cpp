@@ -16,6 +16,7 @@ public:
 	{
 		deviceExtensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
 		instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		m_FramesInFlight = 2;
 	}
 
 	virtual ~OmniShadowDemo()
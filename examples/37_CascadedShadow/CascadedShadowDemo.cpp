@@ -16,7 +16,7 @@ public:
 	CascadedShadowDemo(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
 		: DemoBase(width, height, title, cmdLine)
 	{
-
+		m_FramesInFlight = 2;
 	}
 
 	virtual ~CascadedShadowDemo()
@@ -611,6 +611,9 @@ private:
 
 			ImGui::Text("ShadowMap:%dx%d", m_ShadowMap->width, m_ShadowMap->height);
 			ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / m_LastFPS, m_LastFPS);
+
+			m_GPUProfiler->DrawGUI();
+
 			ImGui::End();
 		}
 
@@ -915,8 +918,13 @@ private:
 		ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
 		VERIFYVULKANRESULT(vkBeginCommandBuffer(commandBuffer, &cmdBeginInfo));
 
+		m_GPUProfiler->BeginFrame(commandBuffer);
+
 		// render target pass
-		RenderDepthScene(commandBuffer);
+		{
+			DVK_GPU_ZONE(m_GPUProfiler, commandBuffer, "Shadow");
+			RenderDepthScene(commandBuffer);
+		}
 
 		// second pass
 		BeginMainPass(commandBuffer, backBufferIndex);
@@ -925,7 +933,10 @@ private:
 		vkCmdSetScissor(commandBuffer,  0, 1, &scissor);
 
 		// shade
-		RenderScene(commandBuffer);
+		{
+			DVK_GPU_ZONE(m_GPUProfiler, commandBuffer, "Lighting");
+			RenderScene(commandBuffer);
+		}
 
 		// debug
 		viewport.x = m_FrameWidth * 0.75f;
@@ -945,10 +956,15 @@ private:
 		m_DebugMaterial->BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 0);
 		m_Quad->meshes[0]->BindDrawCmd(commandBuffer);
 
-		m_GUI->BindDrawCmd(commandBuffer, m_RenderPass);
+		{
+			DVK_GPU_ZONE(m_GPUProfiler, commandBuffer, "GUI");
+			m_GUI->BindDrawCmd(commandBuffer, m_RenderPass);
+		}
 
 		vkCmdEndRenderPass(commandBuffer);
 
+		m_GPUProfiler->EndFrame(commandBuffer);
+
 		VERIFYVULKANRESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
@@ -987,12 +1003,16 @@ private:
 	{
 		m_GUI = new ImageGUIContext();
 		m_GUI->Init("assets/fonts/Ubuntu-Regular.ttf");
+
+		m_GPUProfiler = vk_demo::DVKGPUProfiler::Create(m_VulkanDevice, GetFramesInFlight() + 1);
 	}
 
 	void DestroyGUI()
 	{
 		m_GUI->Destroy();
 		delete m_GUI;
+
+		delete m_GPUProfiler;
 	}
 
 private:
@@ -1048,6 +1068,7 @@ private:
 	int32						m_CameraIndex = 0;
 
 	ImageGUIContext*			m_GUI = nullptr;
+	vk_demo::DVKGPUProfiler*	m_GPUProfiler = nullptr;
 };
 
 std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
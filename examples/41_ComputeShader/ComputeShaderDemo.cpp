@@ -14,7 +14,7 @@ public:
 	ComputeShaderDemo(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
 		: DemoBase(width, height, title, cmdLine)
 	{
-
+		m_FramesInFlight = 2;
 	}
 
 	virtual ~ComputeShaderDemo()
@@ -119,16 +119,8 @@ private:
 			ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiSetCond_FirstUseEver);
 			ImGui::Begin("ComputeShaderDemo", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
 
-			if (ImGui::Combo("Filter", &m_FilterIndex, m_FilterNames.data(), m_FilterNames.size()))
-			{
-				if (m_FilterIndex == 0) {
-					m_Material->SetTexture("diffuseMap", m_Texture);
-				}
-				else
-				{
-					m_Material->SetTexture("diffuseMap", m_ComputeRes.targets[m_FilterIndex - 1]);
-				}
-			}
+			// 切换的贴图在录制命令时写入当前帧的DescriptorSet，不会改动GPU还在使用的Set
+			ImGui::Combo("Filter", &m_FilterIndex, m_FilterNames.data(), m_FilterNames.size());
 
 			ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / m_LastFPS, m_LastFPS);
 			ImGui::End();
@@ -336,20 +328,36 @@ private:
 
 		m_Shader = vk_demo::DVKShader::Create(
 			m_VulkanDevice,
-			true,
 			"assets/shaders/41_ComputeShader/Texture.vert.spv",
 			"assets/shaders/41_ComputeShader/Texture.frag.spv"
 		);
-		
-		m_Material = vk_demo::DVKMaterial::Create(
-			m_VulkanDevice,
-			m_RenderPass,
-			m_PipelineCache,
-			m_Shader
+
+		vk_demo::DVKGfxPipelineInfo pipelineInfo;
+		pipelineInfo.shader = m_Shader;
+		pipelineInfo.rasterizationState.cullMode = VK_CULL_MODE_NONE;
+		m_Pipeline = vk_demo::DVKGfxPipeline::Create(
+			m_VulkanDevice, 
+			m_PipelineCache, 
+			pipelineInfo, 
+			{ m_ModelPlane->GetInputBinding() }, 
+			m_ModelPlane->GetInputAttributes(), 
+			m_Shader->pipelineLayout, 
+			m_RenderPass
 		);
-		m_Material->pipelineInfo.rasterizationState.cullMode = VK_CULL_MODE_NONE;
-		m_Material->PreparePipeline();
-		m_Material->SetTexture("diffuseMap", m_Texture);
+
+		// 每个飞行中的帧一个uniform buffer，每个mesh占一段
+		m_MVPAlignedSize = Align<uint32>(sizeof(ModelViewProjectionBlock), m_VulkanDevice->GetLimits().minUniformBufferOffsetAlignment);
+		for (int32 i = 0; i < GetFramesInFlight(); ++i)
+		{
+			vk_demo::DVKBuffer* buffer = vk_demo::DVKBuffer::CreateBuffer(
+				m_VulkanDevice,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				m_MVPAlignedSize * m_ModelPlane->meshes.size()
+			);
+			buffer->Map();
+			m_MVPBuffers.push_back(buffer);
+		}
 
 		delete cmdBuffer;
 	}
@@ -361,7 +369,14 @@ private:
 		delete m_ModelPlane;
 		delete m_Texture;
 
-		delete m_Material;
+		for (int32 i = 0; i < m_MVPBuffers.size(); ++i)
+		{
+			m_MVPBuffers[i]->UnMap();
+			delete m_MVPBuffers[i];
+		}
+		m_MVPBuffers.clear();
+
+		delete m_Pipeline;
 		delete m_Shader;
 	}
 
@@ -406,23 +421,33 @@ private:
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		vkCmdSetScissor(commandBuffer,  0, 1, &scissor);
 
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Material->GetPipeline());
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->pipeline);
+
+		vk_demo::DVKTexture* texture = m_FilterIndex == 0 ? m_Texture : m_ComputeRes.targets[m_FilterIndex - 1];
+		vk_demo::DVKBuffer* mvpBuffer = m_MVPBuffers[GetFrameIndex()];
 
-		m_Material->BeginFrame();
 		for (int32 i = 0; i < m_ModelPlane->meshes.size(); ++i)
 		{
 			m_MVPParam.model = m_ModelPlane->meshes[i]->linkNode->GetGlobalMatrix();
 			m_MVPParam.view  = m_ViewCamera.GetView();
 			m_MVPParam.proj  = m_ViewCamera.GetProjection();
 
-			m_Material->BeginObject();
-			m_Material->SetLocalUniform("uboMVP",      &m_MVPParam,         sizeof(ModelViewProjectionBlock));
-			m_Material->EndObject();
+			VkDescriptorBufferInfo bufferInfo;
+			bufferInfo.buffer = mvpBuffer->buffer;
+			bufferInfo.offset = m_MVPAlignedSize * i;
+			bufferInfo.range  = sizeof(ModelViewProjectionBlock);
+			memcpy((uint8*)mvpBuffer->mapped + bufferInfo.offset, &m_MVPParam, sizeof(ModelViewProjectionBlock));
+
+			// 每帧重新分配，帧完成之后由allocator整体回收
+			vk_demo::DVKDescriptorSet* descriptorSet = m_Shader->AllocateTransientDescriptorSet();
+			descriptorSet->BeginUpdate();
+			descriptorSet->WriteBuffer("uboMVP", &bufferInfo);
+			descriptorSet->WriteImage("diffuseMap", texture);
+			descriptorSet->EndUpdate();
 
-			m_Material->BindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, i);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->pipelineLayout, 0, descriptorSet->descriptorSets.size(), descriptorSet->descriptorSets.data(), 0, nullptr);
 			m_ModelPlane->meshes[i]->BindDrawCmd(commandBuffer);
 		}
-		m_Material->EndFrame();
 
 		m_GUI->BindDrawCmd(commandBuffer, m_RenderPass);
 		vkCmdEndRenderPass(commandBuffer);
@@ -453,12 +478,14 @@ private:
 	bool 						m_Ready = false;
 
 	vk_demo::DVKModel*			m_ModelPlane = nullptr;
-	vk_demo::DVKMaterial*		m_Material = nullptr;
+	vk_demo::DVKGfxPipeline*	m_Pipeline = nullptr;
 	vk_demo::DVKShader*			m_Shader = nullptr;
 	vk_demo::DVKTexture*		m_Texture = nullptr;
 
 	vk_demo::DVKCamera		    m_ViewCamera;
 	ModelViewProjectionBlock	m_MVPParam;
+	std::vector<vk_demo::DVKBuffer*>	m_MVPBuffers;
+	uint32						m_MVPAlignedSize = 0;
 
 	ComputeResource				m_ComputeRes;
 
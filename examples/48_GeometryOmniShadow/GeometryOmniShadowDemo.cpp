@@ -13,7 +13,7 @@ public:
 	GeometryOmniShadowDemo(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
 		: DemoBase(width, height, title, cmdLine)
 	{
-
+		m_FramesInFlight = 2;
 	}
 
 	virtual ~GeometryOmniShadowDemo()
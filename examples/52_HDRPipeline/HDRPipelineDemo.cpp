@@ -14,7 +14,7 @@ public:
 	HDRPipelineDemo(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
 		: DemoBase(width, height, title, cmdLine)
 	{
-
+		m_FramesInFlight = 2;
 	}
 
 	virtual ~HDRPipelineDemo()
@@ -38,7 +38,11 @@ public:
 		CreateBrightRT();
 		CreateBlurRT();
 		CreateLuminanceRT();
+
+		// 后处理的pipeline在后台线程创建，同时加载场景资源
+		vk_demo::DVKMaterial::BuildPendingPipelines(false);
 		LoadAssets();
+		vk_demo::DVKMaterial::BuildPendingPipelines();
 		
 		m_Ready = true;
 		return true;
@@ -169,7 +173,7 @@ private:
 			m_PipelineCache,
 			m_LuminanceDowmSampleShader
 		);
-		m_LuminanceMaterials[6]->PreparePipeline();
+		m_LuminanceMaterials[6]->RequestPipeline();
 		m_LuminanceMaterials[6]->SetTexture("originTexture", m_TexSourceColor);
         
         // luminance shader
@@ -188,7 +192,7 @@ private:
                 m_PipelineCache,
                 m_LuminanceShader
             );
-            m_LuminanceMaterials[i]->PreparePipeline();
+            m_LuminanceMaterials[i]->RequestPipeline();
             m_LuminanceMaterials[i]->SetTexture("originTexture", m_TexLuminances[i + 1]);
         }
 	}
@@ -222,7 +226,7 @@ private:
 			m_PipelineCache,
 			m_BlurHShader
 		);
-		m_BlurHMaterial->PreparePipeline();
+		m_BlurHMaterial->RequestPipeline();
 		m_BlurHMaterial->SetTexture("originTexture", m_TexBright);
 
 		// blurV
@@ -252,7 +256,7 @@ private:
 			m_PipelineCache,
 			m_BlurVShader
 		);
-		m_BlurVMaterial->PreparePipeline();
+		m_BlurVMaterial->RequestPipeline();
 		m_BlurVMaterial->SetTexture("originTexture", m_TexBlurH);
 	}
 
@@ -284,7 +288,7 @@ private:
 			m_PipelineCache,
 			m_BrightShader
 		);
-		m_BrightMaterial->PreparePipeline();
+		m_BrightMaterial->RequestPipeline();
 		m_BrightMaterial->SetTexture("originTexture", m_TexSourceColor);
 	}
 
@@ -358,7 +362,7 @@ private:
 				m_PipelineCache,
 				m_SceneShader
 			);
-			m_SceneMaterials[i]->PreparePipeline();
+			m_SceneMaterials[i]->RequestPipeline();
 			m_SceneMaterials[i]->SetTexture("diffuseMap", m_SceneTextures[i]);
 		}
 
@@ -376,7 +380,7 @@ private:
 			m_PipelineCache,
 			m_FinalShader
 		);
-		m_FinalMaterial->PreparePipeline();
+		m_FinalMaterial->RequestPipeline();
 		m_FinalMaterial->SetTexture("originTexture",    m_TexSourceColor);
 		m_FinalMaterial->SetTexture("bloomTexture",     m_TexBlurV);
 		m_FinalMaterial->SetTexture("luminanceTexture", m_TexLuminances[0]);
@@ -395,7 +399,7 @@ private:
 			m_PipelineCache,
 			m_DebugShader
 		);
-		m_DebugBright->PreparePipeline();
+		m_DebugBright->RequestPipeline();
 		m_DebugBright->SetTexture("originTexture", m_TexBright);
 
 		m_DebugBlurH = vk_demo::DVKMaterial::Create(
@@ -404,7 +408,7 @@ private:
 			m_PipelineCache,
 			m_DebugShader
 		);
-		m_DebugBlurH->PreparePipeline();
+		m_DebugBlurH->RequestPipeline();
 		m_DebugBlurH->SetTexture("originTexture", m_TexBlurH);
 
 		m_DebugBlurV = vk_demo::DVKMaterial::Create(
@@ -413,7 +417,7 @@ private:
 			m_PipelineCache,
 			m_DebugShader
 		);
-		m_DebugBlurV->PreparePipeline();
+		m_DebugBlurV->RequestPipeline();
 		m_DebugBlurV->SetTexture("originTexture", m_TexBlurV);
 
 		m_DebugLumDownsample = vk_demo::DVKMaterial::Create(
@@ -422,7 +426,7 @@ private:
 			m_PipelineCache,
 			m_DebugShader
 		);
-		m_DebugLumDownsample->PreparePipeline();
+		m_DebugLumDownsample->RequestPipeline();
 		m_DebugLumDownsample->SetTexture("originTexture", m_TexLuminances[6]);
 
 		m_DebugLum1x1 = vk_demo::DVKMaterial::Create(
@@ -431,7 +435,7 @@ private:
 			m_PipelineCache,
 			m_DebugShader
 		);
-		m_DebugLum1x1->PreparePipeline();
+		m_DebugLum1x1->RequestPipeline();
 		m_DebugLum1x1->SetTexture("originTexture", m_TexLuminances[0]);
 
 		m_DebugLum3x3 = vk_demo::DVKMaterial::Create(
@@ -440,7 +444,7 @@ private:
 			m_PipelineCache,
 			m_DebugShader
 		);
-		m_DebugLum3x3->PreparePipeline();
+		m_DebugLum3x3->RequestPipeline();
 		m_DebugLum3x3->SetTexture("originTexture", m_TexLuminances[1]);
 
 		m_DebugLum9x9 = vk_demo::DVKMaterial::Create(
@@ -449,7 +453,7 @@ private:
 			m_PipelineCache,
 			m_DebugShader
 		);
-		m_DebugLum9x9->PreparePipeline();
+		m_DebugLum9x9->RequestPipeline();
 		m_DebugLum9x9->SetTexture("originTexture", m_TexLuminances[2]);
 
 		m_DebugLum27x27 = vk_demo::DVKMaterial::Create(
@@ -458,7 +462,7 @@ private:
 			m_PipelineCache,
 			m_DebugShader
 		);
-		m_DebugLum27x27->PreparePipeline();
+		m_DebugLum27x27->RequestPipeline();
 		m_DebugLum27x27->SetTexture("originTexture", m_TexLuminances[3]);
 
 		m_DebugLum81x81 = vk_demo::DVKMaterial::Create(
@@ -467,7 +471,7 @@ private:
 			m_PipelineCache,
 			m_DebugShader
 		);
-		m_DebugLum81x81->PreparePipeline();
+		m_DebugLum81x81->RequestPipeline();
 		m_DebugLum81x81->SetTexture("originTexture", m_TexLuminances[4]);
 
 		m_DebugLum243x243 = vk_demo::DVKMaterial::Create(
@@ -476,7 +480,7 @@ private:
 			m_PipelineCache,
 			m_DebugShader
 		);
-		m_DebugLum243x243->PreparePipeline();
+		m_DebugLum243x243->RequestPipeline();
 		m_DebugLum243x243->SetTexture("originTexture", m_TexLuminances[5]);
 
 		delete cmdBuffer;
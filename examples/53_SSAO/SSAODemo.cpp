@@ -16,7 +16,7 @@ public:
 	SSAODemo(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
 		: DemoBase(width, height, title, cmdLine)
 	{
-
+		m_FramesInFlight = 2;
 	}
 
 	virtual ~SSAODemo()
@@ -112,6 +112,9 @@ private:
 			ImGui::SliderFloat("Accentuation",				&m_Accentuation,			0.0f,   1.0f);
 
 			ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / m_LastFPS, m_LastFPS);
+
+			m_GPUProfiler->DrawGUI();
+
 			ImGui::End();
 		}
 
@@ -468,6 +471,8 @@ private:
 
 		// combine pass
 		{
+			DVK_GPU_ZONE(m_GPUProfiler, commandBuffer, "Combine");
+
 			VkViewport viewport = {};
 			viewport.x        = 0;
 			viewport.y        = m_FrameHeight;
@@ -498,7 +503,10 @@ private:
 		}
 
 		// ui pass
-		m_GUI->BindDrawCmd(commandBuffer, m_RenderPass);
+		{
+			DVK_GPU_ZONE(m_GPUProfiler, commandBuffer, "GUI");
+			m_GUI->BindDrawCmd(commandBuffer, m_RenderPass);
+		}
 
 		vkCmdEndRenderPass(commandBuffer);
 	}
@@ -511,12 +519,33 @@ private:
 		ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
 		VERIFYVULKANRESULT(vkBeginCommandBuffer(commandBuffer, &cmdBeginInfo));
 
-		ScenePass(commandBuffer);
-		PrepareDepthPass(commandBuffer);
-		ComputeAoPass(commandBuffer);
-		BlurAndUpsamplePass(commandBuffer);
+		m_GPUProfiler->BeginFrame(commandBuffer);
+
+		{
+			DVK_GPU_ZONE(m_GPUProfiler, commandBuffer, "GBuffer");
+			ScenePass(commandBuffer);
+		}
+
+		{
+			DVK_GPU_ZONE(m_GPUProfiler, commandBuffer, "SSAO");
+			{
+				DVK_GPU_ZONE(m_GPUProfiler, commandBuffer, "PrepareDepth");
+				PrepareDepthPass(commandBuffer);
+			}
+			{
+				DVK_GPU_ZONE(m_GPUProfiler, commandBuffer, "ComputeAO");
+				ComputeAoPass(commandBuffer);
+			}
+			{
+				DVK_GPU_ZONE(m_GPUProfiler, commandBuffer, "BlurAndUpsample");
+				BlurAndUpsamplePass(commandBuffer);
+			}
+		}
+
 		CombinePass(commandBuffer, backBufferIndex);
 
+		m_GPUProfiler->EndFrame(commandBuffer);
+
 		VERIFYVULKANRESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
@@ -646,12 +675,16 @@ private:
 	{
 		m_GUI = new ImageGUIContext();
 		m_GUI->Init("assets/fonts/Ubuntu-Regular.ttf");
+
+		m_GPUProfiler = vk_demo::DVKGPUProfiler::Create(m_VulkanDevice, GetFramesInFlight() + 1);
 	}
 
 	void DestroyGUI()
 	{
 		m_GUI->Destroy();
 		delete m_GUI;
+
+		delete m_GPUProfiler;
 	}
 
 private:
@@ -707,6 +740,7 @@ private:
 	float						m_Accentuation		   = 0.10f;
 
 	ImageGUIContext*			m_GUI = nullptr;
+	vk_demo::DVKGPUProfiler*	m_GPUProfiler = nullptr;
 };
 
 std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
@@ -7,9 +7,7 @@
 #include "Math/Matrix4x4.h"
 
 #include <vector>
-#include <thread>
 #include <mutex>
-#include <condition_variable>
 
 // less than m_VulkanDevice->GetLimits().maxUniformBufferRange
 #define INSTANCE_COUNT 512
@@ -178,50 +176,13 @@ private:
 	ModelViewProjectionBlock	m_MVPParam;
 };
 
-struct ThreadData
-{
-	int32 index;
-	int32 frameID;
-	VkCommandPool commandPool;
-	std::vector<ParticleModel*> particles;
-	std::vector<vk_demo::DVKCommandBuffer*> threadCommandBuffers;
-};
-
-class MyThread
-{
-public:
-	typedef std::function<void ()> ThreadFunc;
-
-	explicit MyThread(ThreadFunc func)
-		: m_ThreadFunc(func)
-		, m_Thread(func)
-	{
-
-	}
-
-	~MyThread()
-	{
-		if (m_Thread.joinable()) {
-			m_Thread.join();
-		}
-	}
-
-	MyThread(MyThread const&)=delete;
-
-	MyThread& operator=(MyThread const&)=delete;
-
-private:
-	std::thread m_Thread;
-	ThreadFunc  m_ThreadFunc;
-};
-
 class ThreadedRenderingDemo : public DemoBase
 {
 public:
 	ThreadedRenderingDemo(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
 		: DemoBase(width, height, title, cmdLine)
 	{
-		
+		m_FramesInFlight = 2;
 	}
 
 	virtual ~ThreadedRenderingDemo()
@@ -243,7 +204,7 @@ public:
 		LoadAnimModel();
 		LoadAssets();
 		InitParmas();
-		InitThreads();
+		InitParticles();
 
 		m_Ready = true;
 		return true;
@@ -283,22 +244,6 @@ private:
 
 		UpdateAnimation(time, delta);
 
-		// notify fram start
-		{
-			std::lock_guard<std::mutex> lockGuard(m_FrameStartLock);
-			m_ThreadDoneCount  = 0;
-			m_MainFrameID     += 1;
-			m_FrameStartCV.notify_all();
-		}
-
-		// wait for thread done
-		{
-			std::unique_lock<std::mutex> lockGuard(m_ThreadDoneLock);
-			while (m_ThreadDoneCount != m_Threads.size()) {
-				m_ThreadDoneCV.wait(lockGuard);
-			}
-		}
-
 		SetupCommandBuffers(bufferIndex);
 
 		DemoBase::Present(bufferIndex);
@@ -434,10 +379,9 @@ private:
 
 	void DestroyAssets()
 	{
-		m_ThreadRunning = false;
 		vkQueueWaitIdle(m_VulkanDevice->GetPresentQueue()->GetHandle());
-		m_FrameStartCV.notify_all();
 
+		delete m_Recorder;
 		delete m_RoleModel;
 		delete m_ParticleModel;
 		delete m_ParticleShader;
@@ -449,56 +393,28 @@ private:
 		}
 		m_Particles.clear();
 
-		for (int32 i = 0; i < m_UICommandBuffers.size(); ++i) {
-			delete m_UICommandBuffers[i];
-		}
-
-		for (int32 i = 0; i < m_ThreadDatas.size(); ++i) 
-		{
-			for (int32 j = 0; j < m_ThreadDatas[i]->threadCommandBuffers.size(); ++j)
-			{
-				delete m_ThreadDatas[i]->threadCommandBuffers[j];
-			}
-
-			vkDestroyCommandPool(m_VulkanDevice->GetInstanceHandle(), m_ThreadDatas[i]->commandPool, VULKAN_CPU_ALLOCATOR);
-			delete m_ThreadDatas[i];
-		}
-		m_ThreadDatas.clear();
-
-		for (int32 i = 0; i < m_Threads.size(); ++i) {
-			delete m_Threads[i];
-		}
-		m_Threads.clear();
+		m_ParticleGroups.clear();
 	}
 
 	void SetupCommandBuffers(int32 backBufferIndex)
 	{
-		float w  = m_FrameWidth;
-		float h  = m_FrameHeight;
-		float tx = 0;
-		float ty = 0;
+		// 每组粒子一个录制任务，UI最后执行
+		m_Recorder->BeginFrame(backBufferIndex, m_RenderPass, m_FrameBuffers[backBufferIndex]);
 
-		VkViewport viewport = {};
-		viewport.x        = tx;
-		viewport.y        = m_FrameHeight - ty;
-		viewport.width    = w;
-		viewport.height   = -h;    // flip y axis
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
+		for (int32 i = 0; i < m_ParticleGroups.size(); ++i)
+		{
+			const std::vector<ParticleModel*>& particles = m_ParticleGroups[i];
+			m_Recorder->Record([this, &particles](VkCommandBuffer commandBuffer) {
+				RenderParticles(commandBuffer, particles);
+			});
+		}
 
-		VkRect2D scissor = {};
-		scissor.extent.width  = w;
-		scissor.extent.height = h;
-		scissor.offset.x = tx;
-		scissor.offset.y = ty;
+		m_Recorder->Record([this](VkCommandBuffer commandBuffer) {
+			RenderUI(commandBuffer);
+		});
 
 		VkCommandBuffer commandBuffer = m_CommandBuffers[backBufferIndex];
 
-		VkCommandBufferInheritanceInfo cmdBufferInheritanceInfo;
-		ZeroVulkanStruct(cmdBufferInheritanceInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO);
-		cmdBufferInheritanceInfo.renderPass  = m_RenderPass;
-		cmdBufferInheritanceInfo.framebuffer = m_FrameBuffers[backBufferIndex];
-
 		VkCommandBufferBeginInfo cmdBeginInfo;
 		ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
 		VERIFYVULKANRESULT(vkBeginCommandBuffer(commandBuffer, &cmdBeginInfo));
@@ -520,29 +436,15 @@ private:
 
 		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-		RenderUI(cmdBufferInheritanceInfo, backBufferIndex);
-
-		for (int32 i = 0; i < m_ThreadDatas.size(); ++i) {
-			vkCmdExecuteCommands(commandBuffer, 1, &(m_ThreadDatas[i]->threadCommandBuffers[backBufferIndex]->cmdBuffer));
-		}
-		vkCmdExecuteCommands(commandBuffer, 1, &(m_UICommandBuffers[backBufferIndex]->cmdBuffer));
+		m_Recorder->ExecuteCommands(commandBuffer);
 
 		vkCmdEndRenderPass(commandBuffer);
 
 		VERIFYVULKANRESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
-	void RenderUI(VkCommandBufferInheritanceInfo inheritanceInfo, int32 backBufferIndex)
+	void SetViewport(VkCommandBuffer commandBuffer)
 	{
-		VkCommandBuffer commandBuffer = m_UICommandBuffers[backBufferIndex]->cmdBuffer;
-
-		VkCommandBufferBeginInfo cmdBufferBeginInfo;
-		ZeroVulkanStruct(cmdBufferBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
-		cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
-		cmdBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
-
-		VERIFYVULKANRESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufferBeginInfo));
-
 		float w  = m_FrameWidth;
 		float h  = m_FrameHeight;
 		float tx = 0;
@@ -564,11 +466,28 @@ private:
 
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	void RenderUI(VkCommandBuffer commandBuffer)
+	{
+		SetViewport(commandBuffer);
 
 		// ui pass
 		m_GUI->BindDrawCmd(commandBuffer, m_RenderPass);
+	}
 
-		VERIFYVULKANRESULT(vkEndCommandBuffer(commandBuffer));
+	void RenderParticles(VkCommandBuffer commandBuffer, const std::vector<ParticleModel*>& particles)
+	{
+		// update particles
+		for (int32 i = 0; i < particles.size(); ++i) {
+			particles[i]->Update(m_BonesData, m_ViewCamera, m_FrameTime, m_FrameDelta);
+		}
+
+		SetViewport(commandBuffer);
+
+		for (int32 i = 0; i < particles.size(); ++i) {
+			particles[i]->Draw(commandBuffer, m_ViewCamera);
+		}
 	}
 
 	void InitParmas()
@@ -581,22 +500,12 @@ private:
 		m_ViewCamera.SetPosition(boundCenter);
 		m_ViewCamera.Perspective(PI / 4, (float)GetWidth(), (float)GetHeight(), 1.0f, 1500.0f);
 
-		m_UICommandBuffers.resize(GetVulkanRHI()->GetSwapChain()->GetBackBufferCount());
-		for (int32 i = 0; i < m_UICommandBuffers.size(); ++i) {
-			m_UICommandBuffers[i] = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice, m_CommandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
-		}
+		m_Recorder = vk_demo::DVKParallelCommandRecorder::Create(m_VulkanDevice, GetVulkanRHI()->GetSwapChain()->GetBackBufferCount());
 	}
 
-	void InitThreads()
+	void InitParticles()
 	{
-		int32 numThreads = std::thread::hardware_concurrency();
-		if (numThreads == 0) {
-			numThreads = 8;
-		}
-
-		if (numThreads > 8) {
-			numThreads = 8;
-		}
+		int32 numThreads = MMath::Min(JobSystem::GetNumThreads(), 8);
 
 		vk_demo::DVKPrimitive* primitive = m_RoleModel->meshes[0]->primitives[0];
 
@@ -616,132 +525,23 @@ private:
 			dataIndex += count;
 		}
 
-		// thread task
-		m_MainFrameID      = 0;
-		m_ThreadRunning    = true;
-
+		// 每组粒子作为一个录制任务
 		perThread = m_Particles.size() / numThreads;
 		remainNum = m_Particles.size() - perThread * numThreads;
 		dataIndex = 0;
 
-		m_ThreadDatas.resize(numThreads);
-		m_Threads.resize(numThreads);
+		m_ParticleGroups.resize(numThreads);
 
 		for (int32 i = 0; i < numThreads; ++i)
 		{
-			// prepare thread data
-			m_ThreadDatas[i] = new ThreadData();
-
-			// thread particles
 			int32 count = remainNum > 0 ? perThread + 1 : perThread;
 			remainNum -= 1;
 
 			for (int32 index = dataIndex; index < dataIndex + count; ++index) {
-				m_ThreadDatas[i]->particles.push_back(m_Particles[index]);
+				m_ParticleGroups[i].push_back(m_Particles[index]);
 			}
 
 			dataIndex += count;
-
-			// command pool per thread
-			VkCommandPoolCreateInfo cmdPoolInfo;
-			ZeroVulkanStruct(cmdPoolInfo, VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO);
-			cmdPoolInfo.queueFamilyIndex = GetVulkanRHI()->GetDevice()->GetPresentQueue()->GetFamilyIndex();
-			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-			VERIFYVULKANRESULT(vkCreateCommandPool(m_VulkanDevice->GetInstanceHandle(), &cmdPoolInfo, VULKAN_CPU_ALLOCATOR, &(m_ThreadDatas[i]->commandPool)));
-
-			// command buffers per frame
-			m_ThreadDatas[i]->threadCommandBuffers.resize(GetVulkanRHI()->GetSwapChain()->GetBackBufferCount());
-			for (int32 index = 0; index < m_ThreadDatas[i]->threadCommandBuffers.size(); ++index) {
-				m_ThreadDatas[i]->threadCommandBuffers[index] = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice, m_ThreadDatas[i]->commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
-			}
-
-			// start thread
-			m_ThreadDatas[i]->index = i;
-			m_Threads[i] = new MyThread([=] {
-				ThreadRendering(m_ThreadDatas[i]);
-			});
-		}
-	}
-
-	void ThreadRendering(void* param)
-	{
-		ThreadData* threadData = (ThreadData*)param;
-		threadData->frameID = 0;
-
-		while (true)
-		{
-			{
-				std::unique_lock<std::mutex> guardLock(m_FrameStartLock);
-				if (threadData->frameID == m_MainFrameID) {
-					m_FrameStartCV.wait(guardLock);
-				}
-			}
-
-			threadData->frameID = m_MainFrameID;
-
-			if (!m_ThreadRunning) {
-				break;
-			}
-
-			// update particles
-			for (int32 i = 0; i < threadData->particles.size(); ++i) {
-				threadData->particles[i]->Update(m_BonesData, m_ViewCamera, m_FrameTime, m_FrameDelta);
-			}
-
-			// record commands
-			VkCommandBuffer commandBuffer = threadData->threadCommandBuffers[m_bufferIndex]->cmdBuffer;
-
-			VkCommandBufferInheritanceInfo cmdBufferInheritanceInfo;
-			ZeroVulkanStruct(cmdBufferInheritanceInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO);
-			cmdBufferInheritanceInfo.renderPass  = m_RenderPass;
-			cmdBufferInheritanceInfo.framebuffer = m_FrameBuffers[m_bufferIndex];
-
-			VkCommandBufferBeginInfo cmdBufferBeginInfo;
-			ZeroVulkanStruct(cmdBufferBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
-			cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
-			cmdBufferBeginInfo.pInheritanceInfo = &cmdBufferInheritanceInfo;
-
-			VERIFYVULKANRESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufferBeginInfo));
-
-			float w  = m_FrameWidth;
-			float h  = m_FrameHeight;
-			float tx = 0;
-			float ty = 0;
-
-			VkViewport viewport = {};
-			viewport.x        = tx;
-			viewport.y        = m_FrameHeight - ty;
-			viewport.width    = w;
-			viewport.height   = -h;    // flip y axis
-			viewport.minDepth = 0.0f;
-			viewport.maxDepth = 1.0f;
-
-			VkRect2D scissor = {};
-			scissor.extent.width  = w;
-			scissor.extent.height = h;
-			scissor.offset.x = tx;
-			scissor.offset.y = ty;
-
-			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-			for (int32 i = 0; i < threadData->particles.size(); ++i) {
-				threadData->particles[i]->Draw(commandBuffer, m_ViewCamera);
-			}
-
-			VERIFYVULKANRESULT(vkEndCommandBuffer(commandBuffer));
-
-			// notify thread done
-			{
-				std::lock_guard<std::mutex> lockGuard(m_ThreadDoneLock);
-				m_ThreadDoneCount  += 1;
-				m_ThreadDoneCV.notify_one();
-			}
-		}
-
-		{
-			std::lock_guard<std::mutex> lockGuard(writeMutex);
-			MLOG("Thread exist -> index = %d", threadData->index);
 		}
 	}
 
@@ -759,8 +559,6 @@ private:
 
 private:
 
-	typedef std::vector<vk_demo::DVKCommandBuffer*> CommandBufferArray;
-
 	bool 						m_Ready = false;
 
 	vk_demo::DVKModel*			m_Quad = nullptr;
@@ -771,25 +569,15 @@ private:
 	vk_demo::DVKTexture*		m_ParticleTexture = nullptr;
 	vk_demo::DVKMaterial*		m_ParticleMaterial = nullptr;
 
-	CommandBufferArray			m_UICommandBuffers;
+	vk_demo::DVKParallelCommandRecorder*	m_Recorder = nullptr;
 	
 	vk_demo::DVKCamera		    m_ViewCamera;
 
-	std::mutex					m_FrameStartLock;
-	std::condition_variable		m_FrameStartCV;
-
-	std::mutex					m_ThreadDoneLock;
-	std::condition_variable		m_ThreadDoneCV;
-	int32						m_ThreadDoneCount;
-
 	ModelViewProjectionBlock	m_MVPParam;
 	std::vector<Matrix4x4>		m_BonesData;
 
 	std::vector<ParticleModel*> m_Particles;
-	std::vector<ThreadData*>	m_ThreadDatas;
-	std::vector<MyThread*>		m_Threads;
-	bool						m_ThreadRunning;
-	int32						m_MainFrameID;
+	std::vector<std::vector<ParticleModel*>>	m_ParticleGroups;
 
 	float						m_FrameTime;
 	float						m_FrameDelta;
@@ -0,0 +1,516 @@
+﻿#include "BVH.h"
+#include "RayTracing.h"
+#include "Math/VectorRegister.h"
+
+#include <algorithm>
+
+#define BVH_NUM_BINS	16
+#define BVH_MAX_DEPTH	64
+
+static FORCEINLINE float SurfaceArea(const Vector3& boundsMin, const Vector3& boundsMax)
+{
+	Vector3 extent = boundsMax - boundsMin;
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+static FORCEINLINE bool IntersectBounds(const BVH::Node& node, const Vector3& start, const Vector3& invDir, float tMax, float& tNear)
+{
+	float tx0 = (node.boundsMin.x - start.x) * invDir.x;
+	float tx1 = (node.boundsMax.x - start.x) * invDir.x;
+	float ty0 = (node.boundsMin.y - start.y) * invDir.y;
+	float ty1 = (node.boundsMax.y - start.y) * invDir.y;
+	float tz0 = (node.boundsMin.z - start.z) * invDir.z;
+	float tz1 = (node.boundsMax.z - start.z) * invDir.z;
+
+	float t0 = MMath::Max(MMath::Max(MMath::Min(tx0, tx1), MMath::Min(ty0, ty1)), MMath::Max(MMath::Min(tz0, tz1), 0.0f));
+	float t1 = MMath::Min(MMath::Min(MMath::Max(tx0, tx1), MMath::Max(ty0, ty1)), MMath::Min(MMath::Max(tz0, tz1), tMax));
+
+	tNear = t0;
+	return t0 <= t1;
+}
+
+void BVH::Build(const Scene& scene)
+{
+	nodes.clear();
+	leaves.clear();
+	packets.clear();
+	spheres.clear();
+	primitives.clear();
+	depth = 0;
+
+	for (int32 i = 0; i < scene.spheres.size(); ++i)
+	{
+		const Sphere& sphere = scene.spheres[i];
+		Vector3 radius(sphere.radius, sphere.radius, sphere.radius);
+
+		Primitive primitive;
+		primitive.boundsMin = sphere.center - radius;
+		primitive.boundsMax = sphere.center + radius;
+		primitive.centroid  = sphere.center;
+		primitive.index     = i;
+		primitive.sphere    = true;
+		primitives.push_back(primitive);
+	}
+
+	for (int32 i = 0; i < scene.triangles.size(); ++i)
+	{
+		const Triangle& triangle = scene.triangles[i];
+
+		Primitive primitive;
+		primitive.boundsMin = Vector3::Min(triangle.v0, Vector3::Min(triangle.v1, triangle.v2));
+		primitive.boundsMax = Vector3::Max(triangle.v0, Vector3::Max(triangle.v1, triangle.v2));
+		primitive.centroid  = (triangle.v0 + triangle.v1 + triangle.v2) / 3.0f;
+		primitive.index     = i;
+		primitive.sphere    = false;
+		primitives.push_back(primitive);
+	}
+
+	if (primitives.size() == 0) {
+		return;
+	}
+
+	nodes.reserve(primitives.size() * 2);
+	nodes.push_back(Node());
+	BuildNode(scene, 0, 0, (int32)primitives.size(), 1);
+
+	primitives.clear();
+	primitives.shrink_to_fit();
+}
+
+void BVH::BuildNode(const Scene& scene, int32 nodeIndex, int32 begin, int32 end, int32 level)
+{
+	depth = MMath::Max(depth, level);
+
+	Vector3 boundsMin( MAX_flt,  MAX_flt,  MAX_flt);
+	Vector3 boundsMax(-MAX_flt, -MAX_flt, -MAX_flt);
+	Vector3 centroidMin( MAX_flt,  MAX_flt,  MAX_flt);
+	Vector3 centroidMax(-MAX_flt, -MAX_flt, -MAX_flt);
+
+	for (int32 i = begin; i < end; ++i)
+	{
+		boundsMin   = Vector3::Min(boundsMin, primitives[i].boundsMin);
+		boundsMax   = Vector3::Max(boundsMax, primitives[i].boundsMax);
+		centroidMin = Vector3::Min(centroidMin, primitives[i].centroid);
+		centroidMax = Vector3::Max(centroidMax, primitives[i].centroid);
+	}
+
+	nodes[nodeIndex].boundsMin = boundsMin;
+	nodes[nodeIndex].boundsMax = boundsMax;
+
+	int32 count = end - begin;
+	if (count <= 4 || level >= BVH_MAX_DEPTH)
+	{
+		CreateLeaf(scene, nodeIndex, begin, end);
+		return;
+	}
+
+	// 分桶计算SAH，遍历一个节点与求交一个图元的代价都视为1
+	int32 bestAxis  = -1;
+	int32 bestSplit = 0;
+	float bestCost  = MAX_flt;
+
+	for (int32 axis = 0; axis < 3; ++axis)
+	{
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+
+		int32   binCounts[BVH_NUM_BINS] = { 0 };
+		Vector3 binMins[BVH_NUM_BINS];
+		Vector3 binMaxs[BVH_NUM_BINS];
+		for (int32 i = 0; i < BVH_NUM_BINS; ++i)
+		{
+			binMins[i].Set( MAX_flt,  MAX_flt,  MAX_flt);
+			binMaxs[i].Set(-MAX_flt, -MAX_flt, -MAX_flt);
+		}
+
+		float scale = BVH_NUM_BINS / extent;
+		for (int32 i = begin; i < end; ++i)
+		{
+			int32 bin = MMath::Min((int32)((primitives[i].centroid[axis] - centroidMin[axis]) * scale), BVH_NUM_BINS - 1);
+			binCounts[bin] += 1;
+			binMins[bin] = Vector3::Min(binMins[bin], primitives[i].boundsMin);
+			binMaxs[bin] = Vector3::Max(binMaxs[bin], primitives[i].boundsMax);
+		}
+
+		// 从右往左累加得到每个划分位置右侧的面积与数量
+		float rightAreas[BVH_NUM_BINS];
+		int32 rightCounts[BVH_NUM_BINS];
+		Vector3 rightMin( MAX_flt,  MAX_flt,  MAX_flt);
+		Vector3 rightMax(-MAX_flt, -MAX_flt, -MAX_flt);
+		int32 rightCount = 0;
+		for (int32 i = BVH_NUM_BINS - 1; i > 0; --i)
+		{
+			rightMin    = Vector3::Min(rightMin, binMins[i]);
+			rightMax    = Vector3::Max(rightMax, binMaxs[i]);
+			rightCount += binCounts[i];
+			rightAreas[i]  = rightCount > 0 ? SurfaceArea(rightMin, rightMax) : 0.0f;
+			rightCounts[i] = rightCount;
+		}
+
+		Vector3 leftMin( MAX_flt,  MAX_flt,  MAX_flt);
+		Vector3 leftMax(-MAX_flt, -MAX_flt, -MAX_flt);
+		int32 leftCount = 0;
+		for (int32 i = 1; i < BVH_NUM_BINS; ++i)
+		{
+			leftMin    = Vector3::Min(leftMin, binMins[i - 1]);
+			leftMax    = Vector3::Max(leftMax, binMaxs[i - 1]);
+			leftCount += binCounts[i - 1];
+
+			if (leftCount == 0 || rightCounts[i] == 0) {
+				continue;
+			}
+
+			float cost = SurfaceArea(leftMin, leftMax) * leftCount + rightAreas[i] * rightCounts[i];
+			if (cost < bestCost)
+			{
+				bestCost  = cost;
+				bestAxis  = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	// 所有图元中心重合，无法划分
+	if (bestAxis == -1)
+	{
+		CreateLeaf(scene, nodeIndex, begin, end);
+		return;
+	}
+
+	float area = SurfaceArea(boundsMin, boundsMax);
+	if (count <= maxLeafSize && 1.0f + bestCost / area >= count)
+	{
+		CreateLeaf(scene, nodeIndex, begin, end);
+		return;
+	}
+
+	float minCentroid = centroidMin[bestAxis];
+	float scale = BVH_NUM_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+	Primitive* middle = std::partition(primitives.data() + begin, primitives.data() + end, [=](const Primitive& primitive) {
+		int32 bin = MMath::Min((int32)((primitive.centroid[bestAxis] - minCentroid) * scale), BVH_NUM_BINS - 1);
+		return bin < bestSplit;
+	});
+
+	int32 mid = (int32)(middle - primitives.data());
+	if (mid == begin || mid == end)
+	{
+		mid = (begin + end) / 2;
+		std::nth_element(primitives.data() + begin, primitives.data() + mid, primitives.data() + end, [=](const Primitive& a, const Primitive& b) {
+			return a.centroid[bestAxis] < b.centroid[bestAxis];
+		});
+	}
+
+	int32 left = (int32)nodes.size();
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+	nodes[nodeIndex].left = left;
+
+	BuildNode(scene, left + 0, begin, mid, level + 1);
+	BuildNode(scene, left + 1, mid,   end, level + 1);
+}
+
+void BVH::CreateLeaf(const Scene& scene, int32 nodeIndex, int32 begin, int32 end)
+{
+	Leaf leaf;
+	leaf.firstPacket = (int32)packets.size();
+	leaf.firstSphere = (int32)spheres.size();
+
+	int32 lane = 4;
+	for (int32 i = begin; i < end; ++i)
+	{
+		if (primitives[i].sphere)
+		{
+			spheres.push_back(primitives[i].index);
+			continue;
+		}
+
+		if (lane == 4)
+		{
+			TrianglePacket packet;
+			memset(&packet, 0, sizeof(TrianglePacket));
+			for (int32 j = 0; j < 4; ++j) {
+				packet.triangle[j] = -1;
+			}
+			packets.push_back(packet);
+			lane = 0;
+		}
+
+		const Triangle& triangle = scene.triangles[primitives[i].index];
+		Vector3 e1 = triangle.v1 - triangle.v0;
+		Vector3 e2 = triangle.v2 - triangle.v0;
+
+		TrianglePacket& packet = packets.back();
+		packet.v0x[lane] = triangle.v0.x;
+		packet.v0y[lane] = triangle.v0.y;
+		packet.v0z[lane] = triangle.v0.z;
+		packet.e1x[lane] = e1.x;
+		packet.e1y[lane] = e1.y;
+		packet.e1z[lane] = e1.z;
+		packet.e2x[lane] = e2.x;
+		packet.e2y[lane] = e2.y;
+		packet.e2z[lane] = e2.z;
+		packet.triangle[lane] = primitives[i].index;
+		lane += 1;
+	}
+
+	leaf.numPackets = (int32)packets.size() - leaf.firstPacket;
+	leaf.numSpheres = (int32)spheres.size() - leaf.firstSphere;
+
+	nodes[nodeIndex].leaf = (int32)leaves.size();
+	leaves.push_back(leaf);
+}
+
+bool BVH::IntersectPackets(const Leaf& leaf, const Ray& ray, float& tMax, int32& hitTriangle, float& hitU, float& hitV) const
+{
+	bool hit = false;
+
+#if MONKEY_SIMD
+	const VectorRegister ox = VectorSetFloat1(ray.start.x);
+	const VectorRegister oy = VectorSetFloat1(ray.start.y);
+	const VectorRegister oz = VectorSetFloat1(ray.start.z);
+	const VectorRegister dx = VectorSetFloat1(ray.direction.x);
+	const VectorRegister dy = VectorSetFloat1(ray.direction.y);
+	const VectorRegister dz = VectorSetFloat1(ray.direction.z);
+	const VectorRegister one     = VectorSetFloat1(1.0f);
+	const VectorRegister zero    = VectorSetFloat1(0.0f);
+	const VectorRegister epsilon = VectorSetFloat1(EPSILON);
+	const VectorRegister detMin  = VectorSetFloat1(1e-16f);
+
+	for (int32 i = 0; i < leaf.numPackets; ++i)
+	{
+		const TrianglePacket& packet = packets[leaf.firstPacket + i];
+
+		const VectorRegister e1x = VectorLoad(packet.e1x);
+		const VectorRegister e1y = VectorLoad(packet.e1y);
+		const VectorRegister e1z = VectorLoad(packet.e1z);
+		const VectorRegister e2x = VectorLoad(packet.e2x);
+		const VectorRegister e2y = VectorLoad(packet.e2y);
+		const VectorRegister e2z = VectorLoad(packet.e2z);
+
+		// p = d x e2
+		VectorRegister px = VectorSubtract(VectorMultiply(dy, e2z), VectorMultiply(dz, e2y));
+		VectorRegister py = VectorSubtract(VectorMultiply(dz, e2x), VectorMultiply(dx, e2z));
+		VectorRegister pz = VectorSubtract(VectorMultiply(dx, e2y), VectorMultiply(dy, e2x));
+
+		VectorRegister det = VectorMultiplyAdd(e1x, px, VectorMultiplyAdd(e1y, py, VectorMultiply(e1z, pz)));
+		VectorRegister invDet = VectorDivide(one, det);
+
+		// s = o - v0
+		VectorRegister sx = VectorSubtract(ox, VectorLoad(packet.v0x));
+		VectorRegister sy = VectorSubtract(oy, VectorLoad(packet.v0y));
+		VectorRegister sz = VectorSubtract(oz, VectorLoad(packet.v0z));
+
+		VectorRegister u = VectorMultiply(VectorMultiplyAdd(sx, px, VectorMultiplyAdd(sy, py, VectorMultiply(sz, pz))), invDet);
+
+		// q = s x e1
+		VectorRegister qx = VectorSubtract(VectorMultiply(sy, e1z), VectorMultiply(sz, e1y));
+		VectorRegister qy = VectorSubtract(VectorMultiply(sz, e1x), VectorMultiply(sx, e1z));
+		VectorRegister qz = VectorSubtract(VectorMultiply(sx, e1y), VectorMultiply(sy, e1x));
+
+		VectorRegister v = VectorMultiply(VectorMultiplyAdd(dx, qx, VectorMultiplyAdd(dy, qy, VectorMultiply(dz, qz))), invDet);
+		VectorRegister t = VectorMultiply(VectorMultiplyAdd(e2x, qx, VectorMultiplyAdd(e2y, qy, VectorMultiply(e2z, qz))), invDet);
+
+		// 空余位置的三角形边长为0，det为0不会命中
+		VectorRegister mask = VectorCompareGT(VectorMultiply(det, det), detMin);
+		mask = VectorBitwiseAnd(mask, VectorCompareGE(u, zero));
+		mask = VectorBitwiseAnd(mask, VectorCompareGE(v, zero));
+		mask = VectorBitwiseAnd(mask, VectorCompareGE(one, VectorAdd(u, v)));
+		mask = VectorBitwiseAnd(mask, VectorCompareGT(t, epsilon));
+		mask = VectorBitwiseAnd(mask, VectorCompareGT(VectorSetFloat1(tMax), t));
+
+		int32 bits = VectorMaskBits(mask);
+		if (bits == 0) {
+			continue;
+		}
+
+		float ts[4];
+		float us[4];
+		float vs[4];
+		VectorStore(t, ts);
+		VectorStore(u, us);
+		VectorStore(v, vs);
+
+		for (int32 lane = 0; lane < 4; ++lane)
+		{
+			if ((bits & (1 << lane)) && ts[lane] < tMax)
+			{
+				tMax        = ts[lane];
+				hitU        = us[lane];
+				hitV        = vs[lane];
+				hitTriangle = packet.triangle[lane];
+				hit         = true;
+			}
+		}
+	}
+#else
+	for (int32 i = 0; i < leaf.numPackets; ++i)
+	{
+		const TrianglePacket& packet = packets[leaf.firstPacket + i];
+
+		for (int32 lane = 0; lane < 4; ++lane)
+		{
+			if (packet.triangle[lane] == -1) {
+				break;
+			}
+
+			Vector3 e1(packet.e1x[lane], packet.e1y[lane], packet.e1z[lane]);
+			Vector3 e2(packet.e2x[lane], packet.e2y[lane], packet.e2z[lane]);
+			Vector3 p = Vector3::CrossProduct(ray.direction, e2);
+
+			float det = Vector3::DotProduct(e1, p);
+			if (det * det <= 1e-16f) {
+				continue;
+			}
+
+			float invDet = 1.0f / det;
+			Vector3 s = ray.start - Vector3(packet.v0x[lane], packet.v0y[lane], packet.v0z[lane]);
+			float u = Vector3::DotProduct(s, p) * invDet;
+			if (u < 0.0f || u > 1.0f) {
+				continue;
+			}
+
+			Vector3 q = Vector3::CrossProduct(s, e1);
+			float v = Vector3::DotProduct(ray.direction, q) * invDet;
+			if (v < 0.0f || u + v > 1.0f) {
+				continue;
+			}
+
+			float t = Vector3::DotProduct(e2, q) * invDet;
+			if (t > EPSILON && t < tMax)
+			{
+				tMax        = t;
+				hitU        = u;
+				hitV        = v;
+				hitTriangle = packet.triangle[lane];
+				hit         = true;
+			}
+		}
+	}
+#endif
+
+	return hit;
+}
+
+bool BVH::Intersect(const Scene& scene, const Ray& ray, HitInfo& hitInfo) const
+{
+	hitInfo.hit = false;
+
+	if (nodes.size() == 0) {
+		return false;
+	}
+
+	Vector3 invDir;
+	for (int32 i = 0; i < 3; ++i)
+	{
+		float dir  = ray.direction[i];
+		invDir[i] = MMath::Abs(dir) > 1e-8f ? 1.0f / dir : (dir < 0.0f ? -1e8f : 1e8f);
+	}
+
+	float tMax = MAX_flt;
+	float hitU = 0.0f;
+	float hitV = 0.0f;
+	int32 hitTriangle = -1;
+
+	// 树的深度不超过BVH_MAX_DEPTH，栈中最多保存每一层的另一个子节点
+	int32 stackNodes[BVH_MAX_DEPTH];
+	float stackNears[BVH_MAX_DEPTH];
+	int32 stackSize = 0;
+
+	float tNear = 0.0f;
+	if (!IntersectBounds(nodes[0], ray.start, invDir, tMax, tNear)) {
+		return false;
+	}
+
+	int32 nodeIndex = 0;
+	while (true)
+	{
+		const Node& node = nodes[nodeIndex];
+
+		if (node.leaf != -1)
+		{
+			const Leaf& leaf = leaves[node.leaf];
+
+			IntersectPackets(leaf, ray, tMax, hitTriangle, hitU, hitV);
+
+			for (int32 i = 0; i < leaf.numSpheres; ++i)
+			{
+				HitInfo sphereHit = scene.spheres[spheres[leaf.firstSphere + i]].HitTest(ray);
+				if (sphereHit.hit && sphereHit.dist < tMax)
+				{
+					tMax        = sphereHit.dist;
+					hitTriangle = -1;
+					hitInfo     = sphereHit;
+				}
+			}
+		}
+		else
+		{
+			float near0 = 0.0f;
+			float near1 = 0.0f;
+			bool hit0 = IntersectBounds(nodes[node.left + 0], ray.start, invDir, tMax, near0);
+			bool hit1 = IntersectBounds(nodes[node.left + 1], ray.start, invDir, tMax, near1);
+
+			if (hit0 && hit1)
+			{
+				// 先遍历较近的子节点
+				int32 first  = near0 <= near1 ? node.left : node.left + 1;
+				int32 second = near0 <= near1 ? node.left + 1 : node.left;
+				stackNodes[stackSize] = second;
+				stackNears[stackSize] = MMath::Max(near0, near1);
+				stackSize += 1;
+				nodeIndex = first;
+				continue;
+			}
+			else if (hit0 || hit1)
+			{
+				nodeIndex = hit0 ? node.left : node.left + 1;
+				continue;
+			}
+		}
+
+		// 出栈时跳过比当前交点更远的节点
+		nodeIndex = -1;
+		while (stackSize > 0)
+		{
+			stackSize -= 1;
+			if (stackNears[stackSize] < tMax)
+			{
+				nodeIndex = stackNodes[stackSize];
+				break;
+			}
+		}
+
+		if (nodeIndex == -1) {
+			break;
+		}
+	}
+
+	if (hitTriangle != -1)
+	{
+		const Triangle& triangle = scene.triangles[hitTriangle];
+
+		Vector3 normal = triangle.n0 * (1.0f - hitU - hitV) + triangle.n1 * hitU + triangle.n2 * hitV;
+		if (normal.SizeSquared() < KINDA_SMALL_NUMBER) {
+			normal = Vector3::CrossProduct(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+		}
+		normal.Normalize();
+
+		hitInfo.hit      = true;
+		hitInfo.dist     = tMax;
+		hitInfo.pos      = ray.start + ray.direction * tMax;
+		hitInfo.normal   = normal;
+		hitInfo.inside   = false;
+		hitInfo.material = triangle.material;
+
+		// 法线始终朝向射线来的一侧
+		if (Vector3::DotProduct(normal, ray.direction) > 0.0f)
+		{
+			hitInfo.normal = -normal;
+			hitInfo.inside = true;
+		}
+	}
+
+	return hitInfo.hit;
+}
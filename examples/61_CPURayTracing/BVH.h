@@ -0,0 +1,96 @@
+﻿#pragma once
+
+#include "Common/Common.h"
+#include "Math/Math.h"
+#include "Math/Vector3.h"
+
+#include <vector>
+
+struct Ray;
+struct HitInfo;
+struct Scene;
+
+// 场景中所有球体和三角形的BVH，使用分桶SAH构建。
+// 叶子中的三角形每4个打包成SoA格式，一次SIMD指令同时与4个三角形求交。
+class BVH
+{
+public:
+
+	struct Node
+	{
+		Vector3		boundsMin;
+		int32		left = -1;		// 内部节点的左子节点，右子节点为left + 1
+		Vector3		boundsMax;
+		int32		leaf = -1;		// 叶子节点在leaves中的索引，内部节点为-1
+	};
+
+	struct Leaf
+	{
+		int32		firstPacket = 0;
+		int32		numPackets = 0;
+		int32		firstSphere = 0;
+		int32		numSpheres = 0;
+	};
+
+	// v0以及两条边e1 = v1 - v0，e2 = v2 - v0，空余位置的triangle为-1
+	struct TrianglePacket
+	{
+		float		v0x[4];
+		float		v0y[4];
+		float		v0z[4];
+		float		e1x[4];
+		float		e1y[4];
+		float		e1z[4];
+		float		e2x[4];
+		float		e2y[4];
+		float		e2z[4];
+		int32		triangle[4];
+	};
+
+	void Build(const Scene& scene);
+
+	// 返回最近的交点
+	bool Intersect(const Scene& scene, const Ray& ray, HitInfo& hitInfo) const;
+
+	int32 GetNumNodes() const
+	{
+		return (int32)nodes.size();
+	}
+
+	int32 GetDepth() const
+	{
+		return depth;
+	}
+
+private:
+
+	struct Primitive
+	{
+		Vector3		boundsMin;
+		Vector3		boundsMax;
+		Vector3		centroid;
+		int32		index = 0;
+		bool		sphere = false;
+	};
+
+	void BuildNode(const Scene& scene, int32 nodeIndex, int32 begin, int32 end, int32 level);
+
+	void CreateLeaf(const Scene& scene, int32 nodeIndex, int32 begin, int32 end);
+
+	bool IntersectPackets(const Leaf& leaf, const Ray& ray, float& tMax, int32& hitTriangle, float& hitU, float& hitV) const;
+
+public:
+
+	std::vector<Node>				nodes;
+	std::vector<Leaf>				leaves;
+	std::vector<TrianglePacket>		packets;
+	std::vector<int32>				spheres;
+
+	// 叶子中允许的最大图元数量
+	int32							maxLeafSize = 8;
+
+private:
+
+	std::vector<Primitive>			primitives;
+	int32							depth = 0;
+};
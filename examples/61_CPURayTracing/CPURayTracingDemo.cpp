@@ -7,10 +7,9 @@
 #include "Math/Matrix4x4.h"
 
 #include "Loader/ImageLoader.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Core/JobSystem.h"
 
-#include "TaskThread.h"
-#include "ThreadTask.h"
-#include "TaskThreadPool.h"
 #include "RayTracing.h"
 
 #include <vector>
@@ -18,6 +17,7 @@
 
 #define WIDTH   1400
 #define HEIGHT  900
+#define TILE_SIZE 16
 #define EPSILON 0.0001
 
 class CPURayTracingDemo : public DemoBase
@@ -26,7 +26,7 @@ public:
 	CPURayTracingDemo(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
 		: DemoBase(width, height, title, cmdLine)
 	{
-
+		m_FramesInFlight = 2;
 	}
 
 	virtual ~CPURayTracingDemo()
@@ -96,56 +96,91 @@ private:
 
 		// camera
 		vk_demo::DVKCamera camera;
-		camera.Perspective(PI / 4, WIDTH, HEIGHT, 0.01f, 100.0f);
-		
-		// tracing
-		std::vector<Raytracing*> raytracings;
-		raytracings.resize(WIDTH * HEIGHT);
+		camera.SetPosition(0, 4.0f, -4.8f);
+		camera.LookAt(0, 2.5f, 0);
+		camera.Perspective(PI / 2.5f, WIDTH, HEIGHT, 0.01f, 100.0f);
 		
 		// scene
-		Scene scene;
-		scene.spheres.push_back(Sphere(Vector3(0, 0, 5), 0.5f, new DiffuseMaterial(Vector4(0.8f, 0.3f, 0.3f, 1.0f))));
-		scene.spheres.push_back(Sphere(Vector3(0, -100.5f, 5), 100.0f, new MetalMaterial(Vector4(0.8f, 0.8f, 0.0f, 1.0f), 0.0f)));
-		scene.spheres.push_back(Sphere(Vector3(-1, 0, 5), 0.5f, new MetalMaterial(Vector4(0.8f, 0.8f, 0.8f, 1.0f), 0.2f)));
-		scene.spheres.push_back(Sphere(Vector3(1, 0, 5), 0.5f, new MetalMaterial(Vector4(0.8f, 0.6f, 0.2f, 1.0f), 0.2f)));
+		m_SceneModel = vk_demo::DVKModel::LoadFromFile(
+			"assets/models/simplescene.obj",
+			m_VulkanDevice,
+			nullptr,
+			{ 
+				VertexAttribute::VA_Position,
+				VertexAttribute::VA_Normal
+			}
+		);
+
+		DiffuseMaterial* wallMaterial    = new DiffuseMaterial(Vector4(0.7f, 0.7f, 0.7f, 1.0f));
+		MetalMaterial*   diamondMaterial = new MetalMaterial(Vector4(0.8f, 0.6f, 0.2f, 1.0f), 0.1f);
+		LightMaterial*   lightMaterial   = new LightMaterial(Vector4(1.5f, 1.5f, 1.5f, 1.0f));
 
-		// prepare work
-		for (int32 h = 0; h < HEIGHT; ++h)
+		Scene scene;
+		for (int32 i = 0; i < m_SceneModel->meshes.size(); ++i)
 		{
-			for (int32 w = 0; w < WIDTH; ++w)
-			{
-				int32 index = (h * WIDTH + w);
-				raytracings[index] = new Raytracing(&scene, &camera, w, h, index * 4, WIDTH, HEIGHT);
+			vk_demo::DVKMesh* mesh = m_SceneModel->meshes[i];
+			const std::string& name = mesh->linkNode->name;
+			// 天花板作为面光源
+			if (name == "Plane (5)") {
+				scene.AddMesh(m_SceneModel, mesh, lightMaterial);
+			}
+			else if (name.find("diamond") != std::string::npos) {
+				scene.AddMesh(m_SceneModel, mesh, diamondMaterial);
+			}
+			else {
+				scene.AddMesh(m_SceneModel, mesh, wallMaterial);
 			}
 		}
+		scene.spheres.push_back(Sphere(Vector3(-2.5f, 1.0f, 2.5f), 1.0f, new MetalMaterial(Vector4(0.8f, 0.8f, 0.8f, 1.0f), 0.05f)));
+		scene.spheres.push_back(Sphere(Vector3( 2.5f, 1.0f, 2.5f), 1.0f, new DiffuseMaterial(Vector4(0.8f, 0.3f, 0.3f, 1.0f))));
 
-		// start work
-		TaskThreadPool* taskPool = new TaskThreadPool();
-		taskPool->Create(MMath::Max<int32>(std::thread::hardware_concurrency(), 8));
-		
-		for (int32 i = 0; i < raytracings.size(); ++i) {
-			taskPool->AddTask(raytracings[i]);
-		}
+		double beginTime = GenericPlatformTime::Seconds();
+		scene.BuildBVH();
+		MLOG("BVH : %d triangles, %d spheres, %d nodes, depth %d, %fs.", (int32)scene.triangles.size(), (int32)scene.spheres.size(), scene.bvh.GetNumNodes(), scene.bvh.GetDepth(), GenericPlatformTime::Seconds() - beginTime);
 
-		while (taskPool->GetNumQueuedJobs() != 0) {
-			// wait
-		}
+		// tracing
+		Raytracing raytracing(&scene, &camera, WIDTH, HEIGHT);
 
 		// output color
 		uint8* rgba = new uint8[WIDTH * HEIGHT * 4];
 
-		for (int32 i = 0; i < raytracings.size(); ++i)
-		{
-			Raytracing* tracing = raytracings[i];
-			tracing->color = ToGammaSpace(tracing->color);
+		// 以tile为单位分配任务
+		int32 tilesX = (WIDTH  + TILE_SIZE - 1) / TILE_SIZE;
+		int32 tilesY = (HEIGHT + TILE_SIZE - 1) / TILE_SIZE;
+
+		beginTime = GenericPlatformTime::Seconds();
+
+		JobSystem::ParallelFor(tilesX * tilesY, 1, [&](int32 begin, int32 end) {
+			for (int32 tile = begin; tile < end; ++tile)
+			{
+				int32 minX = (tile % tilesX) * TILE_SIZE;
+				int32 minY = (tile / tilesX) * TILE_SIZE;
+				int32 maxX = MMath::Min(minX + TILE_SIZE, WIDTH);
+				int32 maxY = MMath::Min(minY + TILE_SIZE, HEIGHT);
+
+				for (int32 h = minY; h < maxY; ++h)
+				{
+					for (int32 w = minX; w < maxX; ++w)
+					{
+						Vector4 color = ToGammaSpace(raytracing.HitScene(w, h));
+						int32 index   = (h * WIDTH + w) * 4;
+						rgba[index + 0] = ToUint8(color.x);
+						rgba[index + 1] = ToUint8(color.y);
+						rgba[index + 2] = ToUint8(color.z);
+						rgba[index + 3] = ToUint8(color.w);
+					}
+				}
+			}
+		});
 
-			rgba[tracing->index + 0] = ToUint8(tracing->color.x);
-			rgba[tracing->index + 1] = ToUint8(tracing->color.y);
-			rgba[tracing->index + 2] = ToUint8(tracing->color.z);
-			rgba[tracing->index + 3] = ToUint8(tracing->color.w);
+		MLOG("CPURayTracing : %d tiles, %d threads, %fs.", tilesX * tilesY, JobSystem::GetNumThreads(), GenericPlatformTime::Seconds() - beginTime);
 
-			delete tracing;
+		for (int32 i = 0; i < scene.spheres.size(); ++i) {
+			delete scene.spheres[i].material;
 		}
+		delete wallMaterial;
+		delete diamondMaterial;
+		delete lightMaterial;
 
 		m_Texture = vk_demo::DVKTexture::Create2D(rgba, WIDTH * HEIGHT * 4, VK_FORMAT_R8G8B8A8_UNORM, WIDTH, HEIGHT, m_VulkanDevice, cmdBuffer);
 		m_Texture->UpdateSampler(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
@@ -184,15 +219,6 @@ private:
 		);
 		m_Material->pipelineInfo.rasterizationState.cullMode = VK_CULL_MODE_NONE;
 		m_Material->PreparePipeline();
-		
-		m_SceneModel = vk_demo::DVKModel::LoadFromFile(
-			"assets/models/simplescene.obj",
-			m_VulkanDevice,
-			nullptr,
-			{ 
-				VertexAttribute::VA_Position
-			}
-		);
         
 		m_Material->SetTexture("diffuseMap", m_Texture);
 
@@ -1,6 +1,13 @@
 #include "Material.h"
 #include "RayTracing.h"
 
+const Vector3 Material::RandomUnit() const
+{
+	Vector3 vec3(RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f));
+	vec3 = vec3.GetSafeNormal();
+	return vec3;
+}
+
 bool DiffuseMaterial::Scatter(const Ray& ray, const HitInfo& hitInfo, Vector4& attenuation, Ray& reflect) const
 {
 	attenuation = albedo;
@@ -13,15 +13,16 @@ public:
 
 	virtual bool Scatter(const Ray& ray, const HitInfo& hitInfo, Vector4& attenuation, Ray& reflect) const = 0;
 
-protected:
-
-	const Vector3 RandomUnit() const
+	// 光线不再散射时返回的颜色
+	virtual Vector4 Emitted() const
 	{
-		Vector3 vec3(MMath::FRandRange(-1.0f, 1.0f), MMath::FRandRange(-1.0f, 1.0f), MMath::FRandRange(-1.0f, 1.0f));
-		vec3 = vec3.GetSafeNormal();
-		return vec3;
+		return Vector4(0.1f, 0.1f, 0.1f, 1.0f);
 	}
 
+protected:
+
+	const Vector3 RandomUnit() const;
+
 };
 
 class DiffuseMaterial : public Material
@@ -62,4 +63,30 @@ public:
 
 protected:
 
+};
+
+class LightMaterial : public Material
+{
+public:
+
+	LightMaterial(const Vector4& inEmission)
+		: emission(inEmission)
+	{
+
+	}
+
+	bool Scatter(const Ray& ray, const HitInfo& hitInfo, Vector4& attenuation, Ray& reflect) const override
+	{
+		return false;
+	}
+
+	Vector4 Emitted() const override
+	{
+		return emission;
+	}
+
+	Vector4 emission;
+
+protected:
+
 };
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "RayTracing.h"
 
-HitInfo Sphere::HitTest(const Ray& ray)
+#include <thread>
+#include <functional>
+
+HitInfo Sphere::HitTest(const Ray& ray) const
 {
 	Vector3 oc = ray.start - center;
 	float b = 2.0f * Vector3::DotProduct(oc, ray.direction);
@@ -26,22 +29,93 @@ HitInfo Sphere::HitTest(const Ray& ray)
 	return hitInfo;
 }
 
-Vector4 Raytracing::HitScene()
+void Scene::AddModel(vk_demo::DVKModel* model, Material* material)
+{
+	for (int32 i = 0; i < model->meshes.size(); ++i) {
+		AddMesh(model, model->meshes[i], material);
+	}
+}
+
+void Scene::AddMesh(vk_demo::DVKModel* model, vk_demo::DVKMesh* mesh, Material* material)
+{
+	int32 normalOffset = -1;
+	int32 offset = 0;
+	for (int32 i = 0; i < model->attributes.size(); ++i)
+	{
+		if (model->attributes[i] == VertexAttribute::VA_Normal) {
+			normalOffset = offset;
+		}
+		offset += vk_demo::VertexAttributeToSize(model->attributes[i]) / sizeof(float);
+	}
+
+	Matrix4x4 transform = mesh->linkNode ? mesh->linkNode->GetGlobalMatrix() : Matrix4x4::Identity;
+	// 非均匀缩放时法线需要用逆矩阵的转置变换，只取3x3部分
+	Matrix4x4 normalTransform = transform.Inverse().GetTransposed();
+
+	for (int32 primitiveID = 0; primitiveID < mesh->primitives.size(); ++primitiveID)
+	{
+		vk_demo::DVKPrimitive* primitive = mesh->primitives[primitiveID];
+		if (primitive->vertexCount == 0) {
+			continue;
+		}
+
+		int32 stride = primitive->vertices.size() / primitive->vertexCount;
+		const float* vertices = primitive->vertices.data();
+
+		for (int32 idx = 0; idx + 2 < primitive->indices.size(); idx += 3)
+		{
+			Vector3 positions[3];
+			Vector3 normals[3];
+			for (int32 i = 0; i < 3; ++i)
+			{
+				const float* vertex = vertices + primitive->indices[idx + i] * stride;
+				positions[i] = transform.TransformPosition(Vector3(vertex[0], vertex[1], vertex[2]));
+				if (normalOffset != -1) {
+					normals[i] = Vector3(normalTransform.TransformVector(Vector3(vertex[normalOffset + 0], vertex[normalOffset + 1], vertex[normalOffset + 2]))).GetSafeNormal();
+				}
+				else {
+					normals[i].Set(0, 0, 0);
+				}
+			}
+
+			Triangle triangle;
+			triangle.v0 = positions[0];
+			triangle.v1 = positions[1];
+			triangle.v2 = positions[2];
+			triangle.n0 = normals[0];
+			triangle.n1 = normals[1];
+			triangle.n2 = normals[2];
+			triangle.material = material;
+			triangles.push_back(triangle);
+		}
+	}
+}
+
+float RandomRange(float min, float max)
 {
-	color.Set(0, 0, 0, 0);
+	// xorshift32
+	static thread_local uint32 state = 0;
+	if (state == 0) {
+		state = (uint32)std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+	}
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	return min + (max - min) * ((state >> 8) * (1.0f / 16777216.0f));
+}
 
-	// inv transform
-	Matrix4x4 invProj = camera->GetProjection();
-	invProj.SetInverse();
-	Matrix4x4 invView = camera->GetView();
-	invView.SetInverse();
+Vector4 Raytracing::HitScene(int32 w, int32 h) const
+{
+	Vector4 color(0, 0, 0, 0);
 
 	int32 sample = 10;
 
 	for (int32 i = 0; i < sample; ++i)
 	{
 		// clip space
-		Vector2 clip = Vector2((w + MMath::FRandRange(0.0f, 1.0f)) / width, (h + MMath::FRandRange(0.0f, 1.0f)) / height);
+		Vector2 clip = Vector2((w + RandomRange(0.0f, 1.0f)) / width, (h + RandomRange(0.0f, 1.0f)) / height);
 		// camera position
 		Vector3 pos  = camera->GetTransform().GetOrigin();
 		// clip space ray
@@ -50,8 +124,8 @@ Vector4 Raytracing::HitScene()
 		dir = invProj.TransformPosition(dir);
 		dir.x = dir.x * dir.z;
 		dir.y = dir.y * dir.z;
-		// view space to world space
-		dir = invView.TransformVector(dir);
+		// view space to world space, TransformVector包含了平移，相机不在原点时需要减去相机位置
+		dir = Vector3(invView.TransformPosition(dir)) - pos;
 		dir.Normalize();
 
 		Ray ray;
@@ -66,27 +140,14 @@ Vector4 Raytracing::HitScene()
 	return color;
 }
 
-HitInfo Raytracing::IntersectScene(Scene* scene, const Ray& ray)
+HitInfo Raytracing::IntersectScene(Scene* scene, const Ray& ray) const
 {
 	HitInfo info;
-	info.dist = MAX_int32;
-	info.hit  = false;
-
-	for (int32 i = 0; i < scene->spheres.size(); ++i)
-	{
-		Sphere& sphere  = scene->spheres[i];
-		HitInfo tempHit = sphere.HitTest(ray);
-
-		if (tempHit.hit && tempHit.dist < info.dist)
-		{
-			info = tempHit;
-		}
-	}
-
+	scene->bvh.Intersect(*scene, ray, info);
 	return info;
 }
 
-Vector4 Raytracing::RayHitScene(const Ray& ray, int32 depth)
+Vector4 Raytracing::RayHitScene(const Ray& ray, int32 depth) const
 {
 	HitInfo hitInfo = IntersectScene(scene, ray);
 
@@ -103,7 +164,7 @@ Vector4 Raytracing::RayHitScene(const Ray& ray, int32 depth)
 			return attenuation * RayHitScene(reflect, depth - 1);
 		}
 		else {
-			return Vector4(0.1, 0.1, 0.1, 1.0);
+			return hitInfo.material->Emitted();
 		}
 	}
 	else 
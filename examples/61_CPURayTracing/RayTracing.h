@@ -3,8 +3,9 @@
 #include "Common/Common.h"
 #include "Math/Vector3.h"
 #include "Demo/DVKCamera.h"
-#include "ThreadTask.h"
+#include "Demo/DVKModel.h"
 #include "Material.h"
+#include "BVH.h"
 
 #define EPSILON 0.0001
 
@@ -41,28 +42,56 @@ struct Sphere
 
 	}
 
-	HitInfo HitTest(const Ray& ray);
+	HitInfo HitTest(const Ray& ray) const;
+};
+
+struct Triangle
+{
+	Vector3		v0;
+	Vector3		v1;
+	Vector3		v2;
+	Vector3		n0;
+	Vector3		n1;
+	Vector3		n2;
+	Material*	material = nullptr;
 };
 
 struct Scene
 {
-	std::vector<Sphere> spheres;
+	std::vector<Sphere>		spheres;
+	std::vector<Triangle>	triangles;
+	BVH						bvh;
+
+	// 模型需要包含Position，Normal可选
+	void AddModel(vk_demo::DVKModel* model, Material* material);
+
+	void AddMesh(vk_demo::DVKModel* model, vk_demo::DVKMesh* mesh, Material* material);
+
+	// 修改spheres或者triangles之后需要重新构建
+	void BuildBVH()
+	{
+		bvh.Build(*this);
+	}
 };
 
-class Raytracing : public ThreadTask
+// 每个线程独立的随机数，避免rand()内部的锁导致线程之间互相等待
+float RandomRange(float min, float max);
+
+// 同一个场景的所有像素共享一个Raytracing，可以被多个线程同时调用
+class Raytracing
 {
 public:
 
-	Raytracing(Scene* inScene, vk_demo::DVKCamera* inCamera, float iw, float ih, int32 idx, int32 inWidth, int32 inHeight)
+	Raytracing(Scene* inScene, vk_demo::DVKCamera* inCamera, int32 inWidth, int32 inHeight)
 		: scene(inScene)
-		, w(iw)
-		, h(ih)
-		, index(idx)
 		, camera(inCamera)
 		, width(inWidth)
 		, height(inHeight)
 	{
-
+		invProj = camera->GetProjection();
+		invProj.SetInverse();
+		invView = camera->GetView();
+		invView.SetInverse();
 	}
 
 	~Raytracing()
@@ -70,32 +99,20 @@ public:
 
 	}
 
-	Vector4 HitScene();
-
-	virtual void DoThreadedWork() override
-	{
-		HitScene();
-	}
-
-	virtual void Abandon() override
-	{
-
-	}
+	Vector4 HitScene(int32 w, int32 h) const;
 
 private:
 
-	HitInfo IntersectScene(Scene* scene, const Ray& ray);
+	HitInfo IntersectScene(Scene* scene, const Ray& ray) const;
 
-	Vector4 RayHitScene(const Ray& ray, int32 depth);
+	Vector4 RayHitScene(const Ray& ray, int32 depth) const;
 
 public:
 
 	Scene* scene;
-	float w;
-	float h;
-	int32 index;
 	vk_demo::DVKCamera* camera;
 	int32 width;
 	int32 height;
-	Vector4 color;
+	Matrix4x4 invProj;
+	Matrix4x4 invView;
 };
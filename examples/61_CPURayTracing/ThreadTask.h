@@ -1,21 +0,0 @@
-﻿#pragma once
-
-class ThreadTask
-{
-public:
-
-	ThreadTask()
-	{
-
-	}
-
-	virtual ~ThreadTask() 
-	{
-
-	}
-
-	virtual void DoThreadedWork() = 0;
-
-	virtual void Abandon() = 0;
-
-};
\ No newline at end of file
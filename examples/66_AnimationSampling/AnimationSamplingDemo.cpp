@@ -0,0 +1,378 @@
+﻿#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Demo/DVKCommon.h"
+
+#include "Math/Vector3.h"
+#include "Math/Quat.h"
+
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+// 对比几种关键帧采样方式的耗时：
+// Linear : 旧的线性查找
+// Binary : 每次都二分查找
+// Cursor : DVKAnimChannel默认方式，缓存上一次的区间，失败时二分查找
+// Baked  : 重采样为固定帧率，直接计算帧索引
+class AnimationSamplingDemo : public DemoBase
+{
+public:
+	AnimationSamplingDemo(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
+		: DemoBase(width, height, title, cmdLine)
+	{
+		m_FramesInFlight = 2;
+	}
+
+	virtual ~AnimationSamplingDemo()
+	{
+
+	}
+
+	virtual bool PreInit() override
+	{
+		return true;
+	}
+
+	virtual bool Init() override
+	{
+		DemoBase::Setup();
+		DemoBase::Prepare();
+
+		LoadAssets();
+		CreateGUI();
+		RunBenchmark();
+
+		m_Ready = true;
+
+		return true;
+	}
+
+	virtual void Exist() override
+	{
+		DemoBase::Release();
+		DestroyAssets();
+		DestroyGUI();
+	}
+
+	virtual void Loop(float time, float delta) override
+	{
+		if (!m_Ready) {
+			return;
+		}
+		Draw(time, delta);
+	}
+
+private:
+
+	enum SampleMode
+	{
+		Linear = 0,
+		Binary,
+		Cursor,
+		Baked,
+		Count
+	};
+
+	struct BenchmarkResult
+	{
+		std::string name;
+		int32		channels = 0;
+		int32		keys = 0;
+		double		playback[SampleMode::Count];
+		double		seek[SampleMode::Count];
+	};
+
+	void Draw(float time, float delta)
+	{
+		int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
+
+		UpdateUI(time, delta);
+		SetupCommandBuffers(bufferIndex);
+
+		DemoBase::Present(bufferIndex);
+	}
+
+	bool UpdateUI(float time, float delta)
+	{
+		static const char* modeNames[SampleMode::Count] = { "Linear", "Binary", "Cursor", "Baked" };
+
+		m_GUI->StartFrame();
+
+		{
+			ImGui::SetNextWindowPos(ImVec2(0, 0));
+			ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiSetCond_FirstUseEver);
+			ImGui::Begin("AnimationSamplingDemo", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
+
+			ImGui::SliderInt("Loops", &m_Loops, 1, 64);
+			ImGui::SliderFloat("BakeRate", &m_BakeRate, 10.0f, 120.0f);
+
+			if (ImGui::Button("Run")) {
+				RunBenchmark();
+			}
+
+			for (int32 i = 0; i < m_Results.size(); ++i)
+			{
+				const BenchmarkResult& result = m_Results[i];
+
+				ImGui::Separator();
+				ImGui::Text("%s Channels:%d Keys:%d", result.name.c_str(), result.channels, result.keys);
+
+				for (int32 mode = 0; mode < SampleMode::Count; ++mode) {
+					ImGui::Text("%-8s Playback:%8.3fms Seek:%8.3fms", modeNames[mode], result.playback[mode], result.seek[mode]);
+				}
+			}
+
+			ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+			ImGui::End();
+		}
+
+		bool hovered = ImGui::IsAnyWindowHovered() || ImGui::IsAnyItemHovered() || ImGui::IsRootWindowOrAnyChildHovered();
+
+		m_GUI->EndFrame();
+		m_GUI->Update();
+
+		return hovered;
+	}
+
+	template<class ValueType>
+	static float SampleLinear(vk_demo::DVKAnimChannel<ValueType>& channel, float key)
+	{
+		if (channel.keys.size() == 0 || key <= channel.keys.front() || key >= channel.keys.back()) {
+			return 0.0f;
+		}
+
+		int32 frameIndex = 0;
+		for (int32 i = 0; i < channel.keys.size() - 1; ++i) {
+			if (key <= channel.keys[i + 1])
+			{
+				frameIndex = i;
+				break;
+			}
+		}
+
+		return (key - channel.keys[frameIndex]) / (channel.keys[frameIndex + 1] - channel.keys[frameIndex]);
+	}
+
+	template<class ValueType>
+	static float SampleBinary(vk_demo::DVKAnimChannel<ValueType>& channel, float key)
+	{
+		if (channel.keys.size() == 0 || key <= channel.keys.front() || key >= channel.keys.back()) {
+			return 0.0f;
+		}
+
+		int32 frameIndex = (int32)(std::lower_bound(channel.keys.begin() + 1, channel.keys.end(), key) - channel.keys.begin()) - 1;
+
+		return (key - channel.keys[frameIndex]) / (channel.keys[frameIndex + 1] - channel.keys[frameIndex]);
+	}
+
+	template<class ValueType>
+	static float SampleChannel(vk_demo::DVKAnimChannel<ValueType>& channel, float key, int32 mode)
+	{
+		if (mode == SampleMode::Linear) {
+			return SampleLinear(channel, key);
+		}
+		else if (mode == SampleMode::Binary) {
+			return SampleBinary(channel, key);
+		}
+
+		ValueType prevValue;
+		ValueType nextValue;
+		float alpha = 0.0f;
+		channel.GetValue(key, prevValue, nextValue, alpha);
+
+		return alpha;
+	}
+
+	// 采样一次所有clip，返回alpha之和防止被优化掉
+	float SampleAnimation(vk_demo::DVKAnimation& animation, float time, int32 mode)
+	{
+		float sum = 0.0f;
+		for (auto it = animation.clips.begin(); it != animation.clips.end(); ++it)
+		{
+			vk_demo::DVKAnimationClip& clip = it->second;
+			sum += SampleChannel(clip.positions, time, mode);
+			sum += SampleChannel(clip.rotations, time, mode);
+			sum += SampleChannel(clip.scales,    time, mode);
+		}
+		return sum;
+	}
+
+	void BakeAnimation(vk_demo::DVKAnimation& animation, float sampleRate)
+	{
+		for (auto it = animation.clips.begin(); it != animation.clips.end(); ++it)
+		{
+			vk_demo::DVKAnimationClip& clip = it->second;
+			clip.positions.Bake(sampleRate);
+			clip.rotations.Bake(sampleRate);
+			clip.scales.Bake(sampleRate);
+		}
+	}
+
+	void RunBenchmark()
+	{
+		m_Results.clear();
+
+		for (int32 i = 0; i < m_Models.size(); ++i)
+		{
+			vk_demo::DVKModel* model = m_Models[i];
+
+			for (int32 animIndex = 0; animIndex < model->animations.size(); ++animIndex)
+			{
+				vk_demo::DVKAnimation& animation = model->animations[animIndex];
+
+				BenchmarkResult result;
+				result.name = m_ModelNames[i] + " " + animation.name;
+
+				for (auto it = animation.clips.begin(); it != animation.clips.end(); ++it)
+				{
+					result.channels += 3;
+					result.keys     += it->second.positions.keys.size();
+					result.keys     += it->second.rotations.keys.size();
+					result.keys     += it->second.scales.keys.size();
+				}
+
+				// 以60帧顺序播放以及随机跳转
+				int32 frameCount = MMath::Max(MMath::CeilToInt(animation.duration * 60.0f), 1);
+				std::vector<float> seekTimes(frameCount);
+				for (int32 frame = 0; frame < frameCount; ++frame) {
+					seekTimes[frame] = MMath::FRandRange(0.0f, animation.duration);
+				}
+
+				float checksum = 0.0f;
+				for (int32 mode = 0; mode < SampleMode::Count; ++mode)
+				{
+					BakeAnimation(animation, mode == SampleMode::Baked ? m_BakeRate : 0.0f);
+
+					double startTime = GenericPlatformTime::Seconds();
+					for (int32 loop = 0; loop < m_Loops; ++loop) {
+						for (int32 frame = 0; frame < frameCount; ++frame) {
+							checksum += SampleAnimation(animation, frame / 60.0f, mode);
+						}
+					}
+					result.playback[mode] = (GenericPlatformTime::Seconds() - startTime) * 1000.0;
+
+					startTime = GenericPlatformTime::Seconds();
+					for (int32 loop = 0; loop < m_Loops; ++loop) {
+						for (int32 frame = 0; frame < frameCount; ++frame) {
+							checksum += SampleAnimation(animation, seekTimes[frame], mode);
+						}
+					}
+					result.seek[mode] = (GenericPlatformTime::Seconds() - startTime) * 1000.0;
+				}
+
+				BakeAnimation(animation, 0.0f);
+
+				MLOG(
+					"%s Channels:%d Keys:%d Frames:%d Checksum:%f",
+					result.name.c_str(), result.channels, result.keys, frameCount * m_Loops, checksum
+				);
+				MLOG(
+					"Playback Linear:%.3fms Binary:%.3fms Cursor:%.3fms Baked:%.3fms",
+					result.playback[SampleMode::Linear], result.playback[SampleMode::Binary], result.playback[SampleMode::Cursor], result.playback[SampleMode::Baked]
+				);
+				MLOG(
+					"Seek     Linear:%.3fms Binary:%.3fms Cursor:%.3fms Baked:%.3fms",
+					result.seek[SampleMode::Linear], result.seek[SampleMode::Binary], result.seek[SampleMode::Cursor], result.seek[SampleMode::Baked]
+				);
+
+				m_Results.push_back(result);
+			}
+		}
+	}
+
+	void LoadAssets()
+	{
+		vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice, m_CommandPool);
+
+		m_ModelNames.push_back("nvhai.fbx");
+		m_ModelNames.push_back("Hip Hop Dancing.fbx");
+
+		m_Models.push_back(vk_demo::DVKModel::LoadFromFile(
+			"assets/models/xiaonan/nvhai.fbx",
+			m_VulkanDevice,
+			cmdBuffer,
+			{ VertexAttribute::VA_Position }
+		));
+
+		m_Models.push_back(vk_demo::DVKModel::LoadFromFile(
+			"assets/models/Hip Hop Dancing.fbx",
+			m_VulkanDevice,
+			cmdBuffer,
+			{ VertexAttribute::VA_Position }
+		));
+
+		delete cmdBuffer;
+	}
+
+	void DestroyAssets()
+	{
+		for (int32 i = 0; i < m_Models.size(); ++i) {
+			delete m_Models[i];
+		}
+		m_Models.clear();
+	}
+
+	void SetupCommandBuffers(int32 backBufferIndex)
+	{
+		VkCommandBuffer commandBuffer = m_CommandBuffers[backBufferIndex];
+
+		VkCommandBufferBeginInfo cmdBeginInfo;
+		ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
+		VERIFYVULKANRESULT(vkBeginCommandBuffer(commandBuffer, &cmdBeginInfo));
+
+		VkClearValue clearValues[2];
+		clearValues[0].color        = { { 0.2f, 0.2f, 0.2f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo;
+		ZeroVulkanStruct(renderPassBeginInfo, VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO);
+		renderPassBeginInfo.renderPass               = m_RenderPass;
+		renderPassBeginInfo.framebuffer              = m_FrameBuffers[backBufferIndex];
+		renderPassBeginInfo.clearValueCount          = 2;
+		renderPassBeginInfo.pClearValues             = clearValues;
+		renderPassBeginInfo.renderArea.offset.x      = 0;
+		renderPassBeginInfo.renderArea.offset.y      = 0;
+		renderPassBeginInfo.renderArea.extent.width  = m_FrameWidth;
+		renderPassBeginInfo.renderArea.extent.height = m_FrameHeight;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		m_GUI->BindDrawCmd(commandBuffer, m_RenderPass);
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		VERIFYVULKANRESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	void CreateGUI()
+	{
+		m_GUI = new ImageGUIContext();
+		m_GUI->Init("assets/fonts/Ubuntu-Regular.ttf");
+	}
+
+	void DestroyGUI()
+	{
+		m_GUI->Destroy();
+		delete m_GUI;
+	}
+
+private:
+
+	bool 								m_Ready = false;
+
+	std::vector<vk_demo::DVKModel*>		m_Models;
+	std::vector<std::string>			m_ModelNames;
+	std::vector<BenchmarkResult>		m_Results;
+
+	int32								m_Loops = 16;
+	float								m_BakeRate = 30.0f;
+
+	ImageGUIContext*					m_GUI = nullptr;
+};
+
+std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
+{
+	return std::make_shared<AnimationSamplingDemo>(1400, 900, "AnimationSamplingDemo", cmdLine);
+}
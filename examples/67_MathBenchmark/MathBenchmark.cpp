@@ -0,0 +1,539 @@
+﻿#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Math/Math.h"
+#include "Math/Vector3.h"
+#include "Math/Vector4.h"
+#include "Math/Plane.h"
+#include "Math/Quat.h"
+#include "Math/Matrix4x4.h"
+
+#include "Demo/DVKModel.h"
+
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+
+// 不依赖窗口和GPU的数学库性能测试，可以输出json/csv，并与保存的baseline对比。
+// 67_MathBenchmark [--json file] [--csv file] [--baseline file] [--threshold 10] [--repeat 7] [--filter name] [--tolerance 1e-6]
+// 与baseline相比变慢超过threshold(百分比)时返回1。
+// 运行前先用double计算的标量结果校验矩阵乘法以及变换，相对误差超过tolerance时返回3。
+
+#if MONKEY_SIMD_AVX
+	#define SIMD_NAME "AVX"
+#elif MONKEY_SIMD_SSE
+	#define SIMD_NAME "SSE"
+#elif MONKEY_SIMD_NEON
+	#define SIMD_NAME "NEON"
+#else
+	#define SIMD_NAME "Scalar"
+#endif
+
+struct BenchmarkResult
+{
+	std::string name;
+	int32		ops = 0;
+	double		best = 0.0;		// ns/op
+	double		median = 0.0;	// ns/op
+	double		baseline = 0.0;	// ns/op，0表示baseline中没有
+};
+
+struct BenchmarkData
+{
+	std::vector<Matrix4x4>	matrices;
+	std::vector<Quat>		quats;
+	std::vector<Vector3>	positions;
+	std::vector<Vector4>	outputs;
+	std::vector<Plane>		planes;
+	std::vector<vk_demo::DVKBoundingBox> bounds;
+};
+
+// 防止结果被编译器优化掉
+static volatile float g_Sink = 0.0f;
+
+static float RandFloat()
+{
+	return MMath::FRandRange(-10.0f, 10.0f);
+}
+
+static void PrepareData(BenchmarkData& data, int32 count)
+{
+	MMath::RandInit(1024);
+
+	data.matrices.resize(count);
+	data.quats.resize(count);
+	data.positions.resize(count);
+	data.outputs.resize(count);
+	data.planes.resize(count);
+	data.bounds.resize(count);
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		Matrix4x4& matrix = data.matrices[i];
+		matrix.SetIdentity();
+		matrix.AppendScale(Vector3(MMath::FRandRange(0.5f, 2.0f), MMath::FRandRange(0.5f, 2.0f), MMath::FRandRange(0.5f, 2.0f)));
+		matrix.AppendRotation(MMath::FRandRange(0.0f, 360.0f), Vector3(RandFloat(), RandFloat(), RandFloat()));
+		matrix.AppendTranslation(Vector3(RandFloat(), RandFloat(), RandFloat()));
+
+		data.quats[i] = Quat(Vector3(RandFloat(), RandFloat(), RandFloat()).GetSafeNormal(), MMath::FRandRange(-PI, PI));
+		data.positions[i] = Vector3(RandFloat(), RandFloat(), RandFloat());
+		data.planes[i] = Plane(Vector3(RandFloat(), RandFloat(), RandFloat()).GetSafeNormal(), RandFloat());
+
+		Vector3 center(RandFloat(), RandFloat(), RandFloat());
+		Vector3 extent(MMath::FRandRange(0.1f, 5.0f), MMath::FRandRange(0.1f, 5.0f), MMath::FRandRange(0.1f, 5.0f));
+		data.bounds[i] = vk_demo::DVKBoundingBox(center - extent, center + extent);
+	}
+}
+
+// 误差按各项绝对值之和归一化，小于1时视为绝对误差
+static double ComputeError(float value, double expected, double magnitude)
+{
+	return fabs(value - expected) / MMath::Max(magnitude, 1.0);
+}
+
+static double VerifyMatrixMultiply(const Matrix4x4& a, const Matrix4x4& b, const Matrix4x4& result)
+{
+	double error = 0.0;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		for (int32 j = 0; j < 4; ++j)
+		{
+			double expected  = 0.0;
+			double magnitude = 0.0;
+			for (int32 k = 0; k < 4; ++k)
+			{
+				double term = (double)a.m[i][k] * b.m[k][j];
+				expected  += term;
+				magnitude += fabs(term);
+			}
+			error = MMath::Max(error, ComputeError(result.m[i][j], expected, magnitude));
+		}
+	}
+	return error;
+}
+
+static double VerifyTransform(const float* vec, const Matrix4x4& matrix, const float* result, int32 components)
+{
+	double error = 0.0;
+	for (int32 j = 0; j < components; ++j)
+	{
+		double expected  = 0.0;
+		double magnitude = 0.0;
+		for (int32 k = 0; k < 4; ++k)
+		{
+			double term = (double)vec[k] * matrix.m[k][j];
+			expected  += term;
+			magnitude += fabs(term);
+		}
+		error = MMath::Max(error, ComputeError(result[j], expected, magnitude));
+	}
+	return error;
+}
+
+static int32 VerifyAll(BenchmarkData& data, double tolerance)
+{
+	const int32 count = (int32)data.matrices.size();
+	// 奇数个顶点，覆盖批量变换一次处理多个之后剩余的部分
+	const int32 batch = count - 1;
+
+	double errors[5] = { 0.0 };
+	const char* names[5] = { "Matrix4x4.Multiply", "Matrix4x4.Append", "Vector4.TransformVector4", "Vector3.TransformPositions4", "Vector3.TransformPositions3" };
+
+	std::vector<Vector3> outputs3(count);
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		const Matrix4x4& a = data.matrices[i];
+		const Matrix4x4& b = data.matrices[(i * 7 + 1) % count];
+
+		errors[0] = MMath::Max(errors[0], VerifyMatrixMultiply(a, b, a * b));
+
+		// result与matrix1相同
+		Matrix4x4 append = a;
+		append.Append(b);
+		errors[1] = MMath::Max(errors[1], VerifyMatrixMultiply(a, b, append));
+
+		const Vector4 vec(data.positions[i], MMath::FRandRange(-1.0f, 1.0f));
+		const Vector4 result = b.TransformVector4(vec);
+		errors[2] = MMath::Max(errors[2], VerifyTransform(&vec.x, b, &result.x, 4));
+	}
+
+	for (int32 r = 0; r < 8; ++r)
+	{
+		const Matrix4x4& matrix = data.matrices[r];
+		matrix.TransformPositions(data.positions.data(), data.outputs.data(), batch);
+		matrix.TransformPositions(data.positions.data(), outputs3.data(), batch);
+		for (int32 i = 0; i < batch; ++i)
+		{
+			const Vector3& position = data.positions[i];
+			const float vec[4] = { position.x, position.y, position.z, 1.0f };
+			errors[3] = MMath::Max(errors[3], VerifyTransform(vec, matrix, &data.outputs[i].x, 4));
+			errors[4] = MMath::Max(errors[4], VerifyTransform(vec, matrix, &outputs3[i].x, 3));
+		}
+	}
+
+	int32 failures = 0;
+	printf("%-28s %12s\n", "verify", "max error");
+	for (int32 i = 0; i < 5; ++i)
+	{
+		bool failed = !(errors[i] <= tolerance);
+		failures += failed ? 1 : 0;
+		printf("%-28s %12.3e%s\n", names[i], errors[i], failed ? " FAILED" : "");
+	}
+
+	return failures;
+}
+
+static BenchmarkResult RunBenchmark(const std::string& name, int32 ops, int32 repeat, const std::function<void()>& func)
+{
+	// 预热一次
+	func();
+
+	std::vector<double> samples(repeat);
+	for (int32 i = 0; i < repeat; ++i)
+	{
+		double startTime = GenericPlatformTime::Seconds();
+		func();
+		samples[i] = (GenericPlatformTime::Seconds() - startTime) * 1000000000.0 / ops;
+	}
+	std::sort(samples.begin(), samples.end());
+
+	BenchmarkResult result;
+	result.name   = name;
+	result.ops    = ops;
+	result.best   = samples.front();
+	result.median = samples[samples.size() / 2];
+	return result;
+}
+
+static void RunAll(std::vector<BenchmarkResult>& results, BenchmarkData& data, int32 repeat, const std::string& filter)
+{
+	const int32 count  = (int32)data.matrices.size();
+	const int32 rounds = 64;
+
+	struct BenchmarkCase
+	{
+		std::string				name;
+		int32					ops;
+		std::function<void()>	func;
+	};
+
+	std::vector<BenchmarkCase> cases;
+
+	cases.push_back({ "Matrix4x4.Multiply", count * rounds, [&]() {
+		Matrix4x4 result = Matrix4x4::Identity;
+		for (int32 r = 0; r < rounds; ++r) {
+			for (int32 i = 0; i < count; ++i) {
+				result = data.matrices[i] * data.matrices[(i + r) % count];
+				g_Sink += result.m[3][0];
+			}
+		}
+	}});
+
+	cases.push_back({ "Matrix4x4.Append", count * rounds, [&]() {
+		for (int32 r = 0; r < rounds; ++r) {
+			Matrix4x4 result = Matrix4x4::Identity;
+			for (int32 i = 0; i < count; ++i) {
+				result.Append(data.matrices[i]);
+				result.m[3][0] = result.m[3][1] = result.m[3][2] = 0.0f;
+			}
+			g_Sink += result.m[0][0];
+		}
+	}});
+
+	cases.push_back({ "Matrix4x4.Inverse", count * rounds / 4, [&]() {
+		for (int32 r = 0; r < rounds / 4; ++r) {
+			for (int32 i = 0; i < count; ++i) {
+				g_Sink += data.matrices[i].Inverse().m[3][1];
+			}
+		}
+	}});
+
+	cases.push_back({ "Matrix4x4.InverseFast", count * rounds / 4, [&]() {
+		for (int32 r = 0; r < rounds / 4; ++r) {
+			for (int32 i = 0; i < count; ++i) {
+				g_Sink += data.matrices[i].InverseFast().m[3][1];
+			}
+		}
+	}});
+
+	cases.push_back({ "Quat.Slerp", count * rounds / 4, [&]() {
+		for (int32 r = 0; r < rounds / 4; ++r) {
+			float alpha = (r + 0.5f) / (rounds / 4);
+			for (int32 i = 0; i + 1 < count; ++i) {
+				g_Sink += Quat::slerp(data.quats[i], data.quats[i + 1], alpha).w;
+			}
+		}
+	}});
+
+	cases.push_back({ "Quat.Multiply", count * rounds, [&]() {
+		for (int32 r = 0; r < rounds; ++r) {
+			Quat result = Quat::Identity;
+			for (int32 i = 0; i < count; ++i) {
+				result = data.quats[i] * data.quats[(i + r) % count];
+				g_Sink += result.x;
+			}
+		}
+	}});
+
+	cases.push_back({ "Quat.ToMatrix", count * rounds, [&]() {
+		Matrix4x4 result;
+		for (int32 r = 0; r < rounds; ++r) {
+			for (int32 i = 0; i < count; ++i) {
+				data.quats[i].ToMatrix(result);
+				g_Sink += result.m[1][2];
+			}
+		}
+	}});
+
+	cases.push_back({ "Vector3.TransformPosition", count * rounds, [&]() {
+		for (int32 r = 0; r < rounds; ++r) {
+			const Matrix4x4& matrix = data.matrices[r];
+			for (int32 i = 0; i < count; ++i) {
+				data.outputs[i] = matrix.TransformPosition(data.positions[i]);
+			}
+			g_Sink += data.outputs[r].x;
+		}
+	}});
+
+	cases.push_back({ "Vector3.TransformPositions", count * rounds, [&]() {
+		for (int32 r = 0; r < rounds; ++r) {
+			data.matrices[r].TransformPositions(data.positions.data(), data.outputs.data(), count);
+			g_Sink += data.outputs[r].x;
+		}
+	}});
+
+	cases.push_back({ "Plane.PlaneDot", count * rounds, [&]() {
+		for (int32 r = 0; r < rounds; ++r) {
+			const Vector3& point = data.positions[r];
+			int32 inside = 0;
+			for (int32 i = 0; i < count; ++i) {
+				inside += data.planes[i].PlaneDot(point) >= 0.0f ? 1 : 0;
+			}
+			g_Sink += inside;
+		}
+	}});
+
+	cases.push_back({ "DVKBoundingBox.Transform", count * rounds / 4, [&]() {
+		for (int32 r = 0; r < rounds / 4; ++r) {
+			const Matrix4x4& matrix = data.matrices[r];
+			for (int32 i = 0; i < count; ++i) {
+				vk_demo::DVKBoundingBox& bounds = data.bounds[i];
+				bounds.UpdateCorners();
+				Vector3 corners[8];
+				matrix.TransformPositions(bounds.corners, corners, 8);
+				Vector3 mmin = corners[0];
+				Vector3 mmax = corners[0];
+				for (int32 j = 1; j < 8; ++j) {
+					mmin = Vector3::Min(mmin, corners[j]);
+					mmax = Vector3::Max(mmax, corners[j]);
+				}
+				g_Sink += mmin.x + mmax.y;
+			}
+		}
+	}});
+
+	for (int32 i = 0; i < cases.size(); ++i)
+	{
+		if (!filter.empty() && cases[i].name.find(filter) == std::string::npos) {
+			continue;
+		}
+		results.push_back(RunBenchmark(cases[i].name, cases[i].ops, repeat, cases[i].func));
+	}
+}
+
+static bool WriteJson(const std::string& filename, const std::vector<BenchmarkResult>& results)
+{
+	FILE* file = fopen(filename.c_str(), "w");
+	if (!file)
+	{
+		MLOGE("Failed write %s", filename.c_str());
+		return false;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"simd\": \"%s\",\n", SIMD_NAME);
+	fprintf(file, "\t\"results\": [\n");
+	for (int32 i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& result = results[i];
+		fprintf(file, "\t\t{ \"name\": \"%s\", \"ops\": %d, \"ns_per_op\": %.4f, \"median_ns_per_op\": %.4f }%s\n",
+			result.name.c_str(), result.ops, result.best, result.median, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "\t]\n");
+	fprintf(file, "}\n");
+	fclose(file);
+
+	return true;
+}
+
+static bool WriteCsv(const std::string& filename, const std::vector<BenchmarkResult>& results)
+{
+	FILE* file = fopen(filename.c_str(), "w");
+	if (!file)
+	{
+		MLOGE("Failed write %s", filename.c_str());
+		return false;
+	}
+
+	fprintf(file, "name,simd,ops,ns_per_op,median_ns_per_op,baseline_ns_per_op\n");
+	for (int32 i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& result = results[i];
+		fprintf(file, "%s,%s,%d,%.4f,%.4f,%.4f\n", result.name.c_str(), SIMD_NAME, result.ops, result.best, result.median, result.baseline);
+	}
+	fclose(file);
+
+	return true;
+}
+
+// 只解析WriteJson写出的格式：每个结果中的name以及ns_per_op
+static bool LoadBaseline(const std::string& filename, std::vector<BenchmarkResult>& results)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+	{
+		MLOGE("Failed load baseline %s", filename.c_str());
+		return false;
+	}
+
+	std::string content;
+	char buffer[1024];
+	size_t size = 0;
+	while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		content.append(buffer, size);
+	}
+	fclose(file);
+
+	const std::string nameKey  = "\"name\"";
+	const std::string valueKey = "\"ns_per_op\"";
+
+	size_t pos = content.find(nameKey);
+	while (pos != std::string::npos)
+	{
+		size_t nameBegin = content.find('"', content.find(':', pos) + 1);
+		size_t nameEnd   = content.find('"', nameBegin + 1);
+		size_t valuePos  = content.find(valueKey, nameEnd);
+		if (nameBegin == std::string::npos || nameEnd == std::string::npos || valuePos == std::string::npos) {
+			break;
+		}
+
+		std::string name = content.substr(nameBegin + 1, nameEnd - nameBegin - 1);
+		double value = atof(content.c_str() + content.find(':', valuePos) + 1);
+
+		for (int32 i = 0; i < results.size(); ++i)
+		{
+			if (results[i].name == name) {
+				results[i].baseline = value;
+			}
+		}
+
+		pos = content.find(nameKey, valuePos);
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::string jsonFile;
+	std::string csvFile;
+	std::string baselineFile;
+	std::string filter;
+	float threshold = 10.0f;
+	double tolerance = 1e-6;
+	int32 repeat    = 7;
+	int32 count     = 4096;
+
+	for (int32 i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--json" && hasValue) {
+			jsonFile = argv[++i];
+		}
+		else if (arg == "--csv" && hasValue) {
+			csvFile = argv[++i];
+		}
+		else if (arg == "--baseline" && hasValue) {
+			baselineFile = argv[++i];
+		}
+		else if (arg == "--threshold" && hasValue) {
+			threshold = (float)atof(argv[++i]);
+		}
+		else if (arg == "--repeat" && hasValue) {
+			repeat = MMath::Max(atoi(argv[++i]), 1);
+		}
+		else if (arg == "--count" && hasValue) {
+			count = MMath::Max(atoi(argv[++i]), 64);
+		}
+		else if (arg == "--filter" && hasValue) {
+			filter = argv[++i];
+		}
+		else if (arg == "--tolerance" && hasValue) {
+			tolerance = atof(argv[++i]);
+		}
+		else
+		{
+			printf("Usage: %s [--json file] [--csv file] [--baseline file] [--threshold percent] [--repeat n] [--count n] [--filter name] [--tolerance error]\n", argv[0]);
+			return arg == "--help" ? 0 : 2;
+		}
+	}
+
+	BenchmarkData data;
+	PrepareData(data, count);
+
+	printf("MathBenchmark (%s) count=%d repeat=%d\n", SIMD_NAME, count, repeat);
+
+	int32 failures = VerifyAll(data, tolerance);
+	if (failures > 0)
+	{
+		printf("%d result(s) differ from scalar by more than %.1e\n", failures, tolerance);
+		return 3;
+	}
+
+	std::vector<BenchmarkResult> results;
+	RunAll(results, data, repeat, filter);
+
+	bool hasBaseline = !baselineFile.empty() && LoadBaseline(baselineFile, results);
+	int32 regressions = 0;
+
+	printf("%-28s %12s %12s %12s %9s\n", "name", "ns/op", "median", "baseline", "delta");
+	for (int32 i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& result = results[i];
+		if (result.baseline > 0.0)
+		{
+			double delta = (result.best - result.baseline) / result.baseline * 100.0;
+			bool regressed = delta > threshold;
+			regressions += regressed ? 1 : 0;
+			printf("%-28s %12.3f %12.3f %12.3f %+8.1f%%%s\n", result.name.c_str(), result.best, result.median, result.baseline, delta, regressed ? " REGRESSION" : "");
+		}
+		else
+		{
+			printf("%-28s %12.3f %12.3f %12s %9s\n", result.name.c_str(), result.best, result.median, "-", "-");
+		}
+	}
+
+	if (!jsonFile.empty()) {
+		WriteJson(jsonFile, results);
+	}
+
+	if (!csvFile.empty()) {
+		WriteCsv(csvFile, results);
+	}
+
+	if (hasBaseline && regressions > 0)
+	{
+		printf("%d benchmark(s) slower than baseline by more than %.1f%%\n", regressions, threshold);
+		return 1;
+	}
+
+	return 0;
+}
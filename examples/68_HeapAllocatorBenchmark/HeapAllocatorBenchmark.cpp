@@ -0,0 +1,545 @@
+﻿#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Math/Math.h"
+#include "Utils/Alignment.h"
+#include "Utils/RangeAllocator.h"
+
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+// 不依赖GPU的显存子分配器测试，用一块模拟的DeviceMemory驱动RangeAllocator。
+// 1. 单线程随机分配/释放，用shadow记录每个字节块的归属，检查越界与重叠。
+// 2. 碎片测试：填充到一定比例后反复随机释放/分配，与旧的线性FreeList比较耗时、失败次数与碎片率。
+// 3. 多线程压力：多个线程同时在带锁的模拟Heap上分配/释放。
+// 68_HeapAllocatorBenchmark [--ops n] [--threads n] [--seed n]
+// 任意检查失败时返回1。
+
+static const uint32 GRANULE     = 16;
+static const uint32 PAGE_SIZE   = 16 * 1024 * 1024;
+
+struct Random
+{
+	uint32 state;
+
+	explicit Random(uint32 seed)
+		: state(seed ? seed : 0x9E3779B9)
+	{
+
+	}
+
+	inline uint32 Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	inline uint32 Range(uint32 minValue, uint32 maxValue)
+	{
+		return minValue + Next() % (maxValue - minValue + 1);
+	}
+
+	// 大部分是小块，偶尔有大块，接近buffer/texture的分布
+	inline uint32 Size()
+	{
+		uint32 bucket = Next() % 100;
+		if (bucket < 70) {
+			return Range(16, 4 * 1024);
+		}
+		else if (bucket < 95) {
+			return Range(4 * 1024, 256 * 1024);
+		}
+		return Range(256 * 1024, 2 * 1024 * 1024);
+	}
+
+	inline uint32 Alignment()
+	{
+		static const uint32 alignments[] = { 16, 64, 256, 4096, 65536 };
+		return alignments[Next() % 5];
+	}
+};
+
+// 模拟的DeviceMemory，每GRANULE字节记录一个owner，用来检查分配结果是否重叠。
+class MockDeviceMemory
+{
+public:
+	explicit MockDeviceMemory(uint32 size)
+		: m_Size(size)
+		, m_Shadow(new std::atomic<uint32>[size / GRANULE])
+	{
+		for (uint32 i = 0; i < size / GRANULE; ++i) {
+			m_Shadow[i].store(0);
+		}
+	}
+
+	bool Claim(uint32 offset, uint32 size, uint32 owner)
+	{
+		if (offset + size > m_Size || offset % GRANULE != 0) {
+			return false;
+		}
+		for (uint32 i = offset / GRANULE; i < (offset + size + GRANULE - 1) / GRANULE; ++i)
+		{
+			uint32 expected = 0;
+			if (!m_Shadow[i].compare_exchange_strong(expected, owner)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Release(uint32 offset, uint32 size, uint32 owner)
+	{
+		for (uint32 i = offset / GRANULE; i < (offset + size + GRANULE - 1) / GRANULE; ++i)
+		{
+			uint32 expected = owner;
+			if (!m_Shadow[i].compare_exchange_strong(expected, 0)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	uint32									m_Size;
+	std::unique_ptr<std::atomic<uint32>[]>	m_Shadow;
+};
+
+// 修改之前VulkanResourceHeapPage使用的分配方式：线性查找first fit，释放后排序合并。
+class LinearFreeList
+{
+public:
+	struct Range
+	{
+		uint32 offset;
+		uint32 size;
+	};
+
+	explicit LinearFreeList(uint32 capacity)
+	{
+		Range range = { 0, capacity };
+		m_FreeList.push_back(range);
+	}
+
+	bool Allocate(uint32 size, uint32 alignment, Range& outRange)
+	{
+		for (int32 index = 0; index < m_FreeList.size(); ++index)
+		{
+			Range& entry         = m_FreeList[index];
+			uint32 alignedOffset = Align(entry.offset, alignment);
+			uint32 allocatedSize = alignedOffset - entry.offset + size;
+			if (allocatedSize <= entry.size)
+			{
+				outRange.offset = entry.offset;
+				outRange.size   = allocatedSize;
+				if (allocatedSize < entry.size)
+				{
+					entry.size   -= allocatedSize;
+					entry.offset += allocatedSize;
+				}
+				else {
+					m_FreeList.erase(m_FreeList.begin() + index);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Free(const Range& range)
+	{
+		m_FreeList.push_back(range);
+		std::sort(m_FreeList.begin(), m_FreeList.end(), [](const Range& a, const Range& b) {
+			return a.offset < b.offset;
+		});
+		for (int32 index = (int32)m_FreeList.size() - 1; index > 0; --index)
+		{
+			Range& current = m_FreeList[index];
+			Range& prev    = m_FreeList[index - 1];
+			if (prev.offset + prev.size == current.offset)
+			{
+				prev.size += current.size;
+				m_FreeList.erase(m_FreeList.begin() + index);
+			}
+		}
+	}
+
+	uint32 GetNumFreeBlocks() const
+	{
+		return (uint32)m_FreeList.size();
+	}
+
+	uint32 GetLargestFreeBlock() const
+	{
+		uint32 largest = 0;
+		for (int32 index = 0; index < m_FreeList.size(); ++index) {
+			largest = MMath::Max(largest, m_FreeList[index].size);
+		}
+		return largest;
+	}
+
+private:
+	std::vector<Range> m_FreeList;
+};
+
+static int32 g_Failures = 0;
+
+#define CHECK(cond, ...) \
+	if (!(cond)) \
+	{ \
+		printf("FAILED: "); \
+		printf(__VA_ARGS__); \
+		printf("\n"); \
+		g_Failures += 1; \
+		return; \
+	}
+
+static void TestCorrectness(int32 ops, uint32 seed)
+{
+	struct Live
+	{
+		RangeAllocator::Range	range;
+		uint32					size;
+		uint32					owner;
+	};
+
+	Random random(seed);
+	RangeAllocator allocator(PAGE_SIZE);
+	MockDeviceMemory memory(PAGE_SIZE);
+	std::vector<Live> lives;
+	uint32 owner = 0;
+
+	for (int32 i = 0; i < ops; ++i)
+	{
+		bool doFree = lives.size() > 0 && (random.Next() % 100) < 45;
+		if (!doFree)
+		{
+			uint32 size      = random.Size();
+			uint32 alignment = random.Alignment();
+
+			Live live;
+			live.size  = size;
+			live.owner = ++owner;
+			if (!allocator.Allocate(size, alignment, live.range)) {
+				continue;
+			}
+
+			CHECK(IsAligned(live.range.offset, alignment), "offset %u not aligned to %u", live.range.offset, alignment);
+			CHECK(live.range.size >= size, "range size %u < requested %u", live.range.size, size);
+			CHECK(memory.Claim(live.range.offset, size, live.owner), "range [%u, %u) overlaps another allocation", live.range.offset, live.range.offset + size);
+			lives.push_back(live);
+		}
+		else
+		{
+			uint32 index = random.Next() % lives.size();
+			Live live = lives[index];
+			lives[index] = lives.back();
+			lives.pop_back();
+
+			CHECK(memory.Release(live.range.offset, live.size, live.owner), "range [%u, %u) was overwritten", live.range.offset, live.range.offset + live.size);
+			allocator.Free(live.range.handle);
+		}
+
+		CHECK(allocator.GetNumAllocations() == lives.size(), "allocation count %u != %u", allocator.GetNumAllocations(), (uint32)lives.size());
+	}
+
+	for (int32 i = 0; i < lives.size(); ++i)
+	{
+		CHECK(memory.Release(lives[i].range.offset, lives[i].size, lives[i].owner), "range [%u, %u) was overwritten", lives[i].range.offset, lives[i].range.offset + lives[i].size);
+		allocator.Free(lives[i].range.handle);
+	}
+
+	CHECK(allocator.IsEmpty() && allocator.GetUsedSize() == 0, "allocator not empty after freeing everything");
+	CHECK(allocator.GetNumFreeBlocks() == 1 && allocator.GetLargestFreeBlock() == PAGE_SIZE, "free blocks were not merged back, %u blocks", allocator.GetNumFreeBlocks());
+
+	printf("Correctness           %d ops, peak id %u, OK\n", ops, owner);
+}
+
+struct FragmentationResult
+{
+	double	nsPerOp = 0.0;
+	int32	failed = 0;
+	uint32	freeBlocks = 0;
+	float	fragmentation = 0.0f;
+	float	usage = 0.0f;
+};
+
+template <typename Allocator, typename RangeType, typename FreeFunc>
+static FragmentationResult RunFragmentation(Allocator& allocator, int32 ops, uint32 seed, FreeFunc freeFunc)
+{
+	struct Live
+	{
+		RangeType	range;
+		uint32		size;
+	};
+
+	// 按请求大小统计使用量，对齐浪费算作碎片
+	Random random(seed);
+	std::vector<Live> lives;
+	uint64 usedSize = 0;
+
+	FragmentationResult result;
+	double startTime = GenericPlatformTime::Seconds();
+
+	for (int32 i = 0; i < ops; ++i)
+	{
+		// 使用率低于75%时偏向分配，否则偏向释放
+		uint32 threshold = usedSize < PAGE_SIZE * 3ull / 4 ? 25 : 65;
+		if (lives.size() > 0 && (random.Next() % 100) < threshold)
+		{
+			uint32 index = random.Next() % lives.size();
+			usedSize -= lives[index].size;
+			freeFunc(allocator, lives[index].range);
+			lives[index] = lives.back();
+			lives.pop_back();
+		}
+		else
+		{
+			Live live;
+			live.size = random.Size();
+			if (allocator.Allocate(live.size, random.Alignment(), live.range))
+			{
+				usedSize += live.size;
+				lives.push_back(live);
+			}
+			else {
+				result.failed += 1;
+			}
+		}
+	}
+
+	result.nsPerOp = (GenericPlatformTime::Seconds() - startTime) * 1000000000.0 / ops;
+
+	uint64 freeSize = PAGE_SIZE - usedSize;
+	result.freeBlocks    = allocator.GetNumFreeBlocks();
+	result.fragmentation = freeSize > 0 ? 1.0f - (float)allocator.GetLargestFreeBlock() / (float)freeSize : 0.0f;
+	result.usage         = (float)usedSize / (float)PAGE_SIZE;
+
+	for (int32 i = 0; i < lives.size(); ++i) {
+		freeFunc(allocator, lives[i].range);
+	}
+
+	return result;
+}
+
+static void TestFragmentation(int32 ops, uint32 seed)
+{
+	RangeAllocator tlsf(PAGE_SIZE);
+	FragmentationResult tlsfResult = RunFragmentation<RangeAllocator, RangeAllocator::Range>(tlsf, ops, seed, [](RangeAllocator& allocator, const RangeAllocator::Range& range) {
+		allocator.Free(range.handle);
+	});
+
+	LinearFreeList linear(PAGE_SIZE);
+	FragmentationResult linearResult = RunFragmentation<LinearFreeList, LinearFreeList::Range>(linear, ops, seed, [](LinearFreeList& allocator, const LinearFreeList::Range& range) {
+		allocator.Free(range);
+	});
+
+	printf("%-21s %10s %10s %12s %14s %8s\n", "Fragmentation", "ns/op", "failed", "free blocks", "fragmentation", "usage");
+	printf("%-21s %10.1f %10d %12u %13.1f%% %7.1f%%\n", "  TLSF", tlsfResult.nsPerOp, tlsfResult.failed, tlsfResult.freeBlocks, tlsfResult.fragmentation * 100.0f, tlsfResult.usage * 100.0f);
+	printf("%-21s %10.1f %10d %12u %13.1f%% %7.1f%%\n", "  LinearFreeList", linearResult.nsPerOp, linearResult.failed, linearResult.freeBlocks, linearResult.fragmentation * 100.0f, linearResult.usage * 100.0f);
+
+	CHECK(tlsf.IsEmpty() && tlsf.GetNumFreeBlocks() == 1, "TLSF allocator not empty after fragmentation test");
+}
+
+// 与VulkanResourceHeap相同的结构：一把锁保护所有page，page满了就新建。
+class MockHeap
+{
+public:
+	struct Allocation
+	{
+		int32					page = -1;
+		RangeAllocator::Range	range;
+	};
+
+	bool Allocate(uint32 size, uint32 alignment, Allocation& outAllocation)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		for (int32 index = 0; index < m_Pages.size(); ++index)
+		{
+			if (m_Pages[index]->allocator.Allocate(size, alignment, outAllocation.range))
+			{
+				outAllocation.page = index;
+				return true;
+			}
+		}
+
+		if (m_Pages.size() >= 64) {
+			return false;
+		}
+
+		m_Pages.push_back(std::unique_ptr<Page>(new Page()));
+		outAllocation.page = (int32)m_Pages.size() - 1;
+		return m_Pages.back()->allocator.Allocate(size, alignment, outAllocation.range);
+	}
+
+	void Free(const Allocation& allocation)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Pages[allocation.page]->allocator.Free(allocation.range.handle);
+	}
+
+	MockDeviceMemory& GetMemory(int32 page)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Pages[page]->memory;
+	}
+
+	bool IsEmpty()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (int32 index = 0; index < m_Pages.size(); ++index)
+		{
+			if (!m_Pages[index]->allocator.IsEmpty() || m_Pages[index]->allocator.GetNumFreeBlocks() != 1) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	int32 GetNumPages()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return (int32)m_Pages.size();
+	}
+
+private:
+	struct Page
+	{
+		Page()
+			: allocator(PAGE_SIZE)
+			, memory(PAGE_SIZE)
+		{
+
+		}
+
+		RangeAllocator		allocator;
+		MockDeviceMemory	memory;
+	};
+
+	std::mutex							m_Mutex;
+	std::vector<std::unique_ptr<Page>>	m_Pages;
+};
+
+static void TestThreads(int32 ops, int32 numThreads, uint32 seed)
+{
+	MockHeap heap;
+	std::atomic<int32> errors(0);
+	std::vector<std::thread> threads;
+
+	double startTime = GenericPlatformTime::Seconds();
+
+	for (int32 t = 0; t < numThreads; ++t)
+	{
+		threads.push_back(std::thread([&heap, &errors, ops, seed, t]() {
+			struct Live
+			{
+				MockHeap::Allocation	allocation;
+				uint32					size;
+				uint32					owner;
+			};
+
+			Random random(seed * 31 + t + 1);
+			std::vector<Live> lives;
+			uint32 owner = (uint32)(t + 1) << 24;
+
+			for (int32 i = 0; i < ops; ++i)
+			{
+				if (lives.size() > 0 && (lives.size() > 256 || (random.Next() % 100) < 45))
+				{
+					uint32 index = random.Next() % lives.size();
+					Live live = lives[index];
+					lives[index] = lives.back();
+					lives.pop_back();
+
+					if (!heap.GetMemory(live.allocation.page).Release(live.allocation.range.offset, live.size, live.owner)) {
+						errors.fetch_add(1);
+					}
+					heap.Free(live.allocation);
+				}
+				else
+				{
+					Live live;
+					live.size  = random.Range(16, 64 * 1024);
+					live.owner = ++owner;
+					if (!heap.Allocate(live.size, random.Alignment(), live.allocation)) {
+						continue;
+					}
+					if (!heap.GetMemory(live.allocation.page).Claim(live.allocation.range.offset, live.size, live.owner)) {
+						errors.fetch_add(1);
+					}
+					lives.push_back(live);
+				}
+			}
+
+			for (int32 i = 0; i < lives.size(); ++i)
+			{
+				if (!heap.GetMemory(lives[i].allocation.page).Release(lives[i].allocation.range.offset, lives[i].size, lives[i].owner)) {
+					errors.fetch_add(1);
+				}
+				heap.Free(lives[i].allocation);
+			}
+		}));
+	}
+
+	for (int32 t = 0; t < threads.size(); ++t) {
+		threads[t].join();
+	}
+
+	double elapsed = GenericPlatformTime::Seconds() - startTime;
+	printf("Threads               %d threads x %d ops, %d pages, %.1f ns/op (including shadow checks)\n", numThreads, ops, heap.GetNumPages(), elapsed * 1000000000.0 / ((double)ops * numThreads));
+
+	CHECK(errors.load() == 0, "%d overlapping or overwritten ranges between threads", errors.load());
+	CHECK(heap.IsEmpty(), "heap pages not empty after all threads finished");
+}
+
+int main(int argc, char** argv)
+{
+	int32 ops        = 200000;
+	int32 numThreads = MMath::Max((int32)std::thread::hardware_concurrency(), 2);
+	uint32 seed      = 1024;
+
+	for (int32 i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--ops" && hasValue) {
+			ops = MMath::Max(atoi(argv[++i]), 1000);
+		}
+		else if (arg == "--threads" && hasValue) {
+			numThreads = MMath::Max(atoi(argv[++i]), 1);
+		}
+		else if (arg == "--seed" && hasValue) {
+			seed = (uint32)atoi(argv[++i]);
+		}
+		else
+		{
+			printf("Usage: %s [--ops n] [--threads n] [--seed n]\n", argv[0]);
+			return arg == "--help" ? 0 : 2;
+		}
+	}
+
+	printf("HeapAllocatorBenchmark page=%uMB ops=%d seed=%u\n", PAGE_SIZE / 1024 / 1024, ops, seed);
+
+	TestCorrectness(ops, seed);
+	TestFragmentation(ops, seed);
+	TestThreads(ops / 4, numThreads, seed);
+
+	if (g_Failures > 0)
+	{
+		printf("%d check(s) failed\n", g_Failures);
+		return 1;
+	}
+
+	return 0;
+}
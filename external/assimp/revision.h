@@ -1,7 +1,7 @@
 #ifndef ASSIMP_REVISION_H_INC
 #define ASSIMP_REVISION_H_INC
 
-#define GitVersion 0x68844f57
+#define GitVersion 0x84352260
 #define GitBranch "master"
 
 #endif // ASSIMP_REVISION_H_INC